@@ -33,25 +33,39 @@ uint64_t EffectMap::makeUniqueId() {
 
 uint64_t EffectMap::add(effect_handle_t handle) {
     uint64_t newId = makeUniqueId();
-    std::lock_guard<std::mutex> lock(mLock);
-    mEffects.add(newId, handle);
+    {
+        auto& shard = mEffectsById[shardIndex(newId)];
+        std::lock_guard<std::shared_mutex> lock(shard.lock);
+        shard.map.emplace(newId, handle);
+    }
+    {
+        auto& shard = mIdsByHandle[shardIndex(reinterpret_cast<uintptr_t>(handle))];
+        std::lock_guard<std::shared_mutex> lock(shard.lock);
+        shard.map[handle] = newId;
+    }
     return newId;
 }
 
 effect_handle_t EffectMap::get(const uint64_t& id) {
-    std::lock_guard<std::mutex> lock(mLock);
-    ssize_t idx = mEffects.indexOfKey(id);
-    return idx >= 0 ? mEffects[idx] : NULL;
+    auto& shard = mEffectsById[shardIndex(id)];
+    std::shared_lock<std::shared_mutex> lock(shard.lock);
+    auto it = shard.map.find(id);
+    return it != shard.map.end() ? it->second : NULL;
 }
 
 void EffectMap::remove(effect_handle_t handle) {
-    std::lock_guard<std::mutex> lock(mLock);
-    for (size_t i = 0; i < mEffects.size(); ++i) {
-        if (mEffects[i] == handle) {
-            mEffects.removeItemsAt(i);
-            break;
-        }
+    uint64_t id;
+    {
+        auto& shard = mIdsByHandle[shardIndex(reinterpret_cast<uintptr_t>(handle))];
+        std::lock_guard<std::shared_mutex> lock(shard.lock);
+        auto it = shard.map.find(handle);
+        if (it == shard.map.end()) return;
+        id = it->second;
+        shard.map.erase(it);
     }
+    auto& shard = mEffectsById[shardIndex(id)];
+    std::lock_guard<std::shared_mutex> lock(shard.lock);
+    shard.map.erase(id);
 }
 
 }  // namespace android
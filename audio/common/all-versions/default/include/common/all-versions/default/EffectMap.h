@@ -17,10 +17,11 @@
 #ifndef android_hardware_audio_common_EffectMap_H_
 #define android_hardware_audio_common_EffectMap_H_
 
-#include <mutex>
+#include <array>
+#include <shared_mutex>
+#include <unordered_map>
 
 #include <hardware/audio_effect.h>
-#include <utils/KeyedVector.h>
 #include <utils/Singleton.h>
 
 namespace android {
@@ -35,10 +36,23 @@ class EffectMap : public Singleton<EffectMap> {
     void remove(effect_handle_t handle);
 
    private:
+    // The effects are indexed both by id, for the lookups done by the streams, and by
+    // handle, for the removal done when an effect is closed. Each index is split into
+    // shards so that creating and destroying effects from several threads does not
+    // serialize on a single lock, and lookups only take a shared lock.
+    static constexpr size_t kShardCount = 16;
+
+    template <typename K, typename V>
+    struct Shard {
+        std::shared_mutex lock;
+        std::unordered_map<K, V> map;
+    };
+
     static uint64_t makeUniqueId();
+    static size_t shardIndex(uint64_t key) { return (key ^ (key >> 4)) % kShardCount; }
 
-    std::mutex mLock;
-    KeyedVector<uint64_t, effect_handle_t> mEffects;
+    std::array<Shard<uint64_t, effect_handle_t>, kShardCount> mEffectsById;
+    std::array<Shard<effect_handle_t, uint64_t>, kShardCount> mIdsByHandle;
 };
 
 }  // namespace android
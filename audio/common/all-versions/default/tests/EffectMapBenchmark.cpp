@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "common/all-versions/default/EffectMap.h"
+
+using ::android::EffectMap;
+
+namespace {
+
+// The map never dereferences the handles, so distinct fake pointers are enough.
+effect_handle_t makeHandle(int thread, size_t index) {
+    return reinterpret_cast<effect_handle_t>((thread * 0x10000 + index + 1) * 16);
+}
+
+// Simulates a sound pool churning effect sessions: each thread adds a batch of effects,
+// looks each of them up a few times as the streams would, then removes them.
+void BM_EffectMapChurn(benchmark::State& state) {
+    const size_t batchSize = state.range(0);
+    EffectMap& map = EffectMap::getInstance();
+    std::vector<effect_handle_t> handles(batchSize);
+    std::vector<uint64_t> ids(batchSize);
+    for (size_t i = 0; i < batchSize; ++i) {
+        handles[i] = makeHandle(state.thread_index, i);
+    }
+    for (auto _ : state) {
+        for (size_t i = 0; i < batchSize; ++i) {
+            ids[i] = map.add(handles[i]);
+        }
+        for (int lookup = 0; lookup < 4; ++lookup) {
+            for (size_t i = 0; i < batchSize; ++i) {
+                benchmark::DoNotOptimize(map.get(ids[i]));
+            }
+        }
+        for (size_t i = 0; i < batchSize; ++i) {
+            map.remove(handles[i]);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batchSize);
+}
+
+BENCHMARK(BM_EffectMapChurn)->Arg(16)->Arg(256)->ThreadRange(1, 8)->UseRealTime();
+
+}  // namespace
+
+BENCHMARK_MAIN();
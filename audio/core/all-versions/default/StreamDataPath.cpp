@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "StreamDataPathHAL"
+
+#include "core/default/StreamDataPath.h"
+
+#include <android/log.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace CPP_VERSION {
+namespace implementation {
+
+bool writeFromDataMQ(audio_stream_out_t* stream, StreamDataMQ* dataMQ, uint8_t* buffer,
+                     size_t bytes, ssize_t* writeResult) {
+    StreamDataMQ::MemTransaction tx;
+    if (!dataMQ->beginRead(bytes, &tx)) {
+        return false;
+    }
+    const uint8_t* data = tx.getFirstRegion().getAddress();
+    if (tx.getSecondRegion().getLength() != 0) {
+        if (!tx.copyFrom(buffer, 0, bytes)) {
+            ALOGE("data message queue copy failed");
+            return false;
+        }
+        data = buffer;
+    }
+    *writeResult = stream->write(stream, data, bytes);
+    // The client does not touch the queue until it receives the status, so the data
+    // is only released once the HAL is done with it.
+    dataMQ->commitRead(bytes);
+    return true;
+}
+
+ssize_t readIntoDataMQ(audio_stream_in_t* stream, StreamDataMQ* dataMQ, uint8_t* buffer,
+                       size_t bytes) {
+    StreamDataMQ::MemTransaction tx;
+    bool inPlace = false;
+    if (dataMQ->beginWrite(bytes, &tx) && tx.getFirstRegion().getLength() >= bytes) {
+        buffer = tx.getFirstRegion().getAddress();
+        inPlace = true;
+    }
+    ssize_t readResult = stream->read(stream, buffer, bytes);
+    if (readResult >= 0) {
+        if (inPlace) {
+            if (!dataMQ->commitWrite(readResult)) {
+                ALOGW("data message queue commit failed");
+            }
+        } else if (!dataMQ->write(buffer, readResult)) {
+            ALOGW("data message queue write failed");
+        }
+    }
+    return readResult;
+}
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
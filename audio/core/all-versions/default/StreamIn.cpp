@@ -18,6 +18,7 @@
 
 #include "core/default/StreamIn.h"
 #include "core/default/Conversions.h"
+#include "core/default/StreamDataPath.h"
 #include "core/default/Util.h"
 #include "common/all-versions/HidlSupport.h"
 
@@ -27,6 +28,7 @@
 #include <android/log.h>
 #include <hardware/audio.h>
 #include <utils/Trace.h>
+#include <algorithm>
 #include <memory>
 #include <cmath>
 
@@ -42,7 +44,8 @@ class ReadThread : public Thread {
    public:
     // ReadThread's lifespan never exceeds StreamIn's lifespan.
     ReadThread(std::atomic<bool>* stop, audio_stream_in_t* stream, StreamIn::CommandMQ* commandMQ,
-               StreamIn::DataMQ* dataMQ, StreamIn::StatusMQ* statusMQ, EventFlag* efGroup)
+               StreamIn::DataMQ* dataMQ, StreamIn::StatusMQ* statusMQ, EventFlag* efGroup,
+               StreamTimingStats* timingStats)
         : Thread(false /*canCallJava*/),
           mStop(stop),
           mStream(stream),
@@ -50,6 +53,7 @@ class ReadThread : public Thread {
           mDataMQ(dataMQ),
           mStatusMQ(statusMQ),
           mEfGroup(efGroup),
+          mTimingStats(timingStats),
           mBuffer(nullptr) {}
     bool init() {
         mBuffer.reset(new (std::nothrow) uint8_t[mDataMQ->getQuantumCount()]);
@@ -64,6 +68,7 @@ class ReadThread : public Thread {
     StreamIn::DataMQ* mDataMQ;
     StreamIn::StatusMQ* mStatusMQ;
     EventFlag* mEfGroup;
+    StreamTimingStats* mTimingStats;
     std::unique_ptr<uint8_t[]> mBuffer;
     IStreamIn::ReadParameters mParameters;
     IStreamIn::ReadStatus mStatus;
@@ -75,6 +80,7 @@ class ReadThread : public Thread {
 };
 
 void ReadThread::doRead() {
+    mTimingStats->onWakeup(systemTime());
     size_t availableToWrite = mDataMQ->availableToWrite();
     size_t requestedToRead = mParameters.params.read;
     if (requestedToRead > availableToWrite) {
@@ -84,13 +90,14 @@ void ReadThread::doRead() {
             (int32_t)requestedToRead, (int32_t)availableToWrite);
         requestedToRead = availableToWrite;
     }
-    ssize_t readResult = mStream->read(mStream, &mBuffer[0], requestedToRead);
+    const nsecs_t readStartNs = systemTime();
+    ssize_t readResult = readIntoDataMQ(mStream, mDataMQ, &mBuffer[0], requestedToRead);
+    mTimingStats->onTransfer(systemTime() - readStartNs, requestedToRead, readResult,
+                             mDataMQ->getQuantumCount() - availableToWrite,
+                             mDataMQ->getQuantumCount());
     mStatus.retval = Result::OK;
     if (readResult >= 0) {
         mStatus.reply.read = readResult;
-        if (!mDataMQ->write(&mBuffer[0], readResult)) {
-            ALOGW("data message queue write failed");
-        }
     } else {
         mStatus.retval = Stream::analyzeStatus("read", readResult);
     }
@@ -392,7 +399,8 @@ Return<void> StreamIn::prepareForReading(uint32_t frameSize, uint32_t framesCoun
     // Create and launch the thread.
     auto tempReadThread =
         std::make_unique<ReadThread>(&mStopReadThread, mStream, tempCommandMQ.get(),
-                                     tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get());
+                                     tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get(),
+                                     &mTimingStats);
     if (!tempReadThread->init()) {
         ALOGW("failed to start reader thread: %s", strerror(-status));
         sendError(Result::INVALID_ARGUMENTS);
@@ -448,6 +456,12 @@ Return<void> StreamIn::getCapturePosition(getCapturePosition_cb _hidl_cb) {
 }
 
 Return<void> StreamIn::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& options) {
+    if (fd.getNativeHandle() != nullptr && fd->numFds == 1 &&
+        std::find(options.begin(), options.end(), StreamTimingStats::kDebugOption) !=
+            options.end()) {
+        mTimingStats.dump(fd->data[0], "read");
+        return Void();
+    }
     return mStreamCommon->debug(fd, options);
 }
 
@@ -17,6 +17,7 @@
 #define LOG_TAG "StreamOutHAL"
 
 #include "core/default/StreamOut.h"
+#include "core/default/StreamDataPath.h"
 #include "core/default/Util.h"
 
 //#define LOG_NDEBUG 0
@@ -24,6 +25,7 @@
 
 #include <string.h>
 
+#include <algorithm>
 #include <memory>
 
 #include <android/log.h>
@@ -43,7 +45,8 @@ class WriteThread : public Thread {
     // WriteThread's lifespan never exceeds StreamOut's lifespan.
     WriteThread(std::atomic<bool>* stop, audio_stream_out_t* stream,
                 StreamOut::CommandMQ* commandMQ, StreamOut::DataMQ* dataMQ,
-                StreamOut::StatusMQ* statusMQ, EventFlag* efGroup)
+                StreamOut::StatusMQ* statusMQ, EventFlag* efGroup,
+                StreamTimingStats* timingStats)
         : Thread(false /*canCallJava*/),
           mStop(stop),
           mStream(stream),
@@ -51,6 +54,7 @@ class WriteThread : public Thread {
           mDataMQ(dataMQ),
           mStatusMQ(statusMQ),
           mEfGroup(efGroup),
+          mTimingStats(timingStats),
           mBuffer(nullptr) {}
     bool init() {
         mBuffer.reset(new (std::nothrow) uint8_t[mDataMQ->getQuantumCount()]);
@@ -65,6 +69,7 @@ class WriteThread : public Thread {
     StreamOut::DataMQ* mDataMQ;
     StreamOut::StatusMQ* mStatusMQ;
     EventFlag* mEfGroup;
+    StreamTimingStats* mTimingStats;
     std::unique_ptr<uint8_t[]> mBuffer;
     IStreamOut::WriteStatus mStatus;
 
@@ -76,16 +81,21 @@ class WriteThread : public Thread {
 };
 
 void WriteThread::doWrite() {
+    mTimingStats->onWakeup(systemTime());
     const size_t availToRead = mDataMQ->availableToRead();
     mStatus.retval = Result::OK;
     mStatus.reply.written = 0;
-    if (mDataMQ->read(&mBuffer[0], availToRead)) {
-        ssize_t writeResult = mStream->write(mStream, &mBuffer[0], availToRead);
-        if (writeResult >= 0) {
-            mStatus.reply.written = writeResult;
-        } else {
-            mStatus.retval = Stream::analyzeStatus("write", writeResult);
-        }
+    const nsecs_t writeStartNs = systemTime();
+    ssize_t writeResult;
+    if (!writeFromDataMQ(mStream, mDataMQ, &mBuffer[0], availToRead, &writeResult)) {
+        return;
+    }
+    mTimingStats->onTransfer(systemTime() - writeStartNs, availToRead, writeResult, availToRead,
+                             mDataMQ->getQuantumCount());
+    if (writeResult >= 0) {
+        mStatus.reply.written = writeResult;
+    } else {
+        mStatus.retval = Stream::analyzeStatus("write", writeResult);
     }
 }
 
@@ -378,7 +388,8 @@ Return<void> StreamOut::prepareForWriting(uint32_t frameSize, uint32_t framesCou
     // Create and launch the thread.
     auto tempWriteThread =
         std::make_unique<WriteThread>(&mStopWriteThread, mStream, tempCommandMQ.get(),
-                                      tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get());
+                                      tempDataMQ.get(), tempStatusMQ.get(), tempElfGroup.get(),
+                                      &mTimingStats);
     if (!tempWriteThread->init()) {
         ALOGW("failed to start writer thread: %s", strerror(-status));
         sendError(Result::INVALID_ARGUMENTS);
@@ -557,6 +568,12 @@ Return<void> StreamOut::getMmapPosition(getMmapPosition_cb _hidl_cb) {
 }
 
 Return<void> StreamOut::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& options) {
+    if (fd.getNativeHandle() != nullptr && fd->numFds == 1 &&
+        std::find(options.begin(), options.end(), StreamTimingStats::kDebugOption) !=
+            options.end()) {
+        mTimingStats.dump(fd->data[0], "write");
+        return Void();
+    }
     return mStreamCommon->debug(fd, options);
 }
 
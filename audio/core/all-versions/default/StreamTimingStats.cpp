@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/default/StreamTimingStats.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include <algorithm>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace CPP_VERSION {
+namespace implementation {
+
+namespace {
+
+void updateMax(std::atomic<nsecs_t>* max, nsecs_t value) {
+    nsecs_t current = max->load(std::memory_order_relaxed);
+    while (value > current &&
+           !max->compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+}  // namespace
+
+void StreamTimingStats::addTime(Histogram<kTimeBuckets>* histogram, nsecs_t ns) {
+    uint64_t us = ns > 0 ? static_cast<uint64_t>(ns) / 1000 : 0;
+    size_t bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+    (*histogram)[std::min(bucket, kTimeBuckets - 1)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void StreamTimingStats::onWakeup(nsecs_t now) {
+    nsecs_t last = mLastWakeupNs.exchange(now, std::memory_order_relaxed);
+    if (last == 0) return;
+    // The jitter is the difference between two consecutive wakeup intervals, which does
+    // not require knowing the period the client is using.
+    nsecs_t interval = now - last;
+    nsecs_t lastInterval = mLastIntervalNs.exchange(interval, std::memory_order_relaxed);
+    if (lastInterval == 0) return;
+    nsecs_t jitter = interval > lastInterval ? interval - lastInterval : lastInterval - interval;
+    addTime(&mJitter, jitter);
+    updateMax(&mMaxJitterNs, jitter);
+}
+
+void StreamTimingStats::onTransfer(nsecs_t durationNs, size_t requestedBytes,
+                                   ssize_t transferredBytes, size_t fillBytes,
+                                   size_t queueBytes) {
+    mTransferCount.fetch_add(1, std::memory_order_relaxed);
+    addTime(&mDuration, durationNs);
+    updateMax(&mMaxDurationNs, durationNs);
+    if (queueBytes != 0) {
+        size_t bucket = fillBytes * 10 / queueBytes;
+        mFill[std::min(bucket, kFillBuckets - 1)].fetch_add(1, std::memory_order_relaxed);
+    }
+    if (transferredBytes < 0) {
+        mErrorCount.fetch_add(1, std::memory_order_relaxed);
+    } else if (static_cast<size_t>(transferredBytes) < requestedBytes) {
+        mShortfallCount.fetch_add(1, std::memory_order_relaxed);
+        mShortfallBytes.fetch_add(requestedBytes - transferredBytes, std::memory_order_relaxed);
+    }
+}
+
+void StreamTimingStats::dumpTime(int fd, const char* name,
+                                 const Histogram<kTimeBuckets>& histogram) {
+    dprintf(fd, "  %s histogram (us):\n", name);
+    for (size_t i = 0; i < kTimeBuckets; ++i) {
+        uint64_t count = histogram[i].load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        uint64_t low = i == 0 ? 0 : 1ull << (i - 1);
+        if (i == kTimeBuckets - 1) {
+            dprintf(fd, "    >= %" PRIu64 ": %" PRIu64 "\n", low, count);
+        } else {
+            dprintf(fd, "    [%" PRIu64 ", %" PRIu64 "): %" PRIu64 "\n", low, 1ull << i, count);
+        }
+    }
+}
+
+void StreamTimingStats::dump(int fd, const char* direction) const {
+    dprintf(fd, "Stream %s timing:\n", direction);
+    dprintf(fd, "  transfers: %" PRIu64 ", errors: %" PRIu64 "\n",
+            mTransferCount.load(std::memory_order_relaxed),
+            mErrorCount.load(std::memory_order_relaxed));
+    dprintf(fd, "  shortfalls: %" PRIu64 " (%" PRIu64 " bytes)\n",
+            mShortfallCount.load(std::memory_order_relaxed),
+            mShortfallBytes.load(std::memory_order_relaxed));
+    dprintf(fd, "  max %s duration: %" PRId64 " us, max wakeup jitter: %" PRId64 " us\n",
+            direction, mMaxDurationNs.load(std::memory_order_relaxed) / 1000,
+            mMaxJitterNs.load(std::memory_order_relaxed) / 1000);
+    dumpTime(fd, direction, mDuration);
+    dumpTime(fd, "wakeup jitter", mJitter);
+    dprintf(fd, "  queue fill histogram (%%):\n");
+    for (size_t i = 0; i < kFillBuckets; ++i) {
+        uint64_t count = mFill[i].load(std::memory_order_relaxed);
+        if (count == 0) continue;
+        if (i == kFillBuckets - 1) {
+            dprintf(fd, "    full: %" PRIu64 "\n", count);
+        } else {
+            dprintf(fd, "    [%zu, %zu): %" PRIu64 "\n", i * 10, i * 10 + 10, count);
+        }
+    }
+}
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_AUDIO_STREAMDATAPATH_H
+#define ANDROID_HARDWARE_AUDIO_STREAMDATAPATH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <fmq/MessageQueue.h>
+#include <hardware/audio.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace CPP_VERSION {
+namespace implementation {
+
+// Same as StreamOut::DataMQ and StreamIn::DataMQ.
+typedef MessageQueue<uint8_t, kSynchronizedReadWrite> StreamDataMQ;
+
+// Writes |bytes| bytes from |dataMQ| to |stream|. The HAL gets a pointer into the queue
+// memory, the data is only copied to |buffer| when it wraps around the end of the queue.
+// |buffer| must be able to hold the whole queue.
+// Returns false if the data could not be taken from the queue, otherwise the result of
+// the HAL write is returned in |writeResult|.
+bool writeFromDataMQ(audio_stream_out_t* stream, StreamDataMQ* dataMQ, uint8_t* buffer,
+                     size_t bytes, ssize_t* writeResult);
+
+// Reads up to |bytes| bytes from |stream| into |dataMQ|. The HAL reads straight into the
+// queue memory when the free space is contiguous, otherwise it reads into |buffer| which is
+// then copied on both sides of the wrap. |buffer| must be able to hold the whole queue.
+// Returns the result of the HAL read.
+ssize_t readIntoDataMQ(audio_stream_in_t* stream, StreamDataMQ* dataMQ, uint8_t* buffer,
+                       size_t bytes);
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_AUDIO_STREAMDATAPATH_H
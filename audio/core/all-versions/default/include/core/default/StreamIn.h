@@ -21,6 +21,7 @@
 
 #include "Device.h"
 #include "Stream.h"
+#include "StreamTimingStats.h"
 
 #include <atomic>
 #include <memory>
@@ -130,6 +131,7 @@ struct StreamIn : public IStreamIn {
     EventFlag* mEfGroup;
     std::atomic<bool> mStopReadThread;
     sp<Thread> mReadThread;
+    StreamTimingStats mTimingStats;
 
     virtual ~StreamIn();
 };
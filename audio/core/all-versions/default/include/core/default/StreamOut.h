@@ -21,6 +21,7 @@
 
 #include "Device.h"
 #include "Stream.h"
+#include "StreamTimingStats.h"
 
 #include <atomic>
 #include <memory>
@@ -152,6 +153,7 @@ struct StreamOut : public IStreamOut {
     EventFlag* mEfGroup;
     std::atomic<bool> mStopWriteThread;
     sp<Thread> mWriteThread;
+    StreamTimingStats mTimingStats;
 
     virtual ~StreamOut();
 
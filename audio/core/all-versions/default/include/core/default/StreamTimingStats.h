@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_AUDIO_STREAMTIMINGSTATS_H
+#define ANDROID_HARDWARE_AUDIO_STREAMTIMINGSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <array>
+#include <atomic>
+
+#include <utils/Timers.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace CPP_VERSION {
+namespace implementation {
+
+// Always-on timing statistics of the data path of a stream, recorded by the
+// WriteThread/ReadThread and dumped by IStream::debug with the "--timing" option.
+// All the counters are relaxed atomics, so recording never blocks the audio thread
+// and a dump may observe a transfer half recorded.
+class StreamTimingStats {
+  public:
+    static constexpr const char* kDebugOption = "--timing";
+
+    // Called each time the thread is woken up to transfer data.
+    void onWakeup(nsecs_t now);
+    // Called after each call to the legacy HAL read or write function.
+    // |fillBytes| is the amount of data in the data queue before the transfer.
+    void onTransfer(nsecs_t durationNs, size_t requestedBytes, ssize_t transferredBytes,
+                    size_t fillBytes, size_t queueBytes);
+
+    void dump(int fd, const char* direction) const;
+
+  private:
+    // Bucket i counts the values in [2^(i-1), 2^i) microseconds, the last bucket
+    // also counts all the larger values.
+    static constexpr size_t kTimeBuckets = 20;
+    // Bucket i counts the queue fill levels in [10 * i, 10 * (i + 1)) percent, the last
+    // bucket counts a full queue.
+    static constexpr size_t kFillBuckets = 11;
+
+    template <size_t N>
+    using Histogram = std::array<std::atomic<uint64_t>, N>;
+
+    static void addTime(Histogram<kTimeBuckets>* histogram, nsecs_t ns);
+    static void dumpTime(int fd, const char* name, const Histogram<kTimeBuckets>& histogram);
+
+    std::atomic<nsecs_t> mLastWakeupNs{0};
+    std::atomic<nsecs_t> mLastIntervalNs{0};
+    std::atomic<uint64_t> mTransferCount{0};
+    std::atomic<uint64_t> mErrorCount{0};
+    std::atomic<uint64_t> mShortfallCount{0};
+    std::atomic<uint64_t> mShortfallBytes{0};
+    std::atomic<nsecs_t> mMaxDurationNs{0};
+    std::atomic<nsecs_t> mMaxJitterNs{0};
+    Histogram<kTimeBuckets> mDuration{};
+    Histogram<kTimeBuckets> mJitter{};
+    Histogram<kFillBuckets> mFill{};
+};
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_AUDIO_STREAMTIMINGSTATS_H
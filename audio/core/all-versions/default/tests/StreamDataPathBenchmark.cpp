@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "core/default/StreamDataPath.h"
+
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+using ::android::hardware::audio::CPP_VERSION::implementation::readIntoDataMQ;
+using ::android::hardware::audio::CPP_VERSION::implementation::StreamDataMQ;
+using ::android::hardware::audio::CPP_VERSION::implementation::writeFromDataMQ;
+
+namespace {
+
+// 16 bit stereo.
+constexpr size_t kFrameSize = 4;
+// The data queue holds this many periods, same as a typical client buffer.
+constexpr size_t kPeriodsPerQueue = 4;
+
+// Legacy HAL streams that move the data to / from a buffer of their own, like a HAL
+// filling a DMA buffer would.
+struct StubStreamOut {
+    audio_stream_out_t stream = {};
+    std::vector<uint8_t> sink;
+
+    explicit StubStreamOut(size_t bytes) : sink(bytes) { stream.write = write; }
+
+    static ssize_t write(audio_stream_out_t* stream, const void* buffer, size_t bytes) {
+        auto self = reinterpret_cast<StubStreamOut*>(stream);
+        memcpy(self->sink.data(), buffer, bytes);
+        return bytes;
+    }
+};
+
+struct StubStreamIn {
+    audio_stream_in_t stream = {};
+    std::vector<uint8_t> source;
+
+    explicit StubStreamIn(size_t bytes) : source(bytes, 0x5a) { stream.read = read; }
+
+    static ssize_t read(audio_stream_in_t* stream, void* buffer, size_t bytes) {
+        auto self = reinterpret_cast<StubStreamIn*>(stream);
+        memcpy(buffer, self->source.data(), bytes);
+        return bytes;
+    }
+};
+
+// Common period sizes in frames: 5, 10 and 20 ms at 48 kHz.
+void periodArgs(benchmark::internal::Benchmark* b) {
+    b->Arg(240)->Arg(480)->Arg(960);
+}
+
+// What the write thread did before: copy the period out of the queue, then write the copy.
+void BM_WriteCopied(benchmark::State& state) {
+    const size_t periodBytes = state.range(0) * kFrameSize;
+    StreamDataMQ dataMQ(periodBytes * kPeriodsPerQueue);
+    StubStreamOut stream(periodBytes);
+    std::vector<uint8_t> client(periodBytes, 0x5a);
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[dataMQ.getQuantumCount()]);
+    for (auto _ : state) {
+        dataMQ.write(client.data(), periodBytes);
+        dataMQ.read(&buffer[0], periodBytes);
+        benchmark::DoNotOptimize(stream.stream.write(&stream.stream, &buffer[0], periodBytes));
+    }
+    state.SetBytesProcessed(state.iterations() * periodBytes);
+}
+BENCHMARK(BM_WriteCopied)->Apply(periodArgs);
+
+void BM_WriteInPlace(benchmark::State& state) {
+    const size_t periodBytes = state.range(0) * kFrameSize;
+    StreamDataMQ dataMQ(periodBytes * kPeriodsPerQueue);
+    StubStreamOut stream(periodBytes);
+    std::vector<uint8_t> client(periodBytes, 0x5a);
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[dataMQ.getQuantumCount()]);
+    for (auto _ : state) {
+        dataMQ.write(client.data(), periodBytes);
+        ssize_t writeResult;
+        writeFromDataMQ(&stream.stream, &dataMQ, &buffer[0], periodBytes, &writeResult);
+        benchmark::DoNotOptimize(writeResult);
+    }
+    state.SetBytesProcessed(state.iterations() * periodBytes);
+}
+BENCHMARK(BM_WriteInPlace)->Apply(periodArgs);
+
+// Periods that don't divide the queue size, so some of the writes wrap around its end.
+void BM_WriteInPlaceWrapping(benchmark::State& state) {
+    const size_t periodBytes = state.range(0) * kFrameSize;
+    StreamDataMQ dataMQ(periodBytes * kPeriodsPerQueue + periodBytes / 2);
+    StubStreamOut stream(periodBytes);
+    std::vector<uint8_t> client(periodBytes, 0x5a);
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[dataMQ.getQuantumCount()]);
+    for (auto _ : state) {
+        dataMQ.write(client.data(), periodBytes);
+        ssize_t writeResult;
+        writeFromDataMQ(&stream.stream, &dataMQ, &buffer[0], periodBytes, &writeResult);
+        benchmark::DoNotOptimize(writeResult);
+    }
+    state.SetBytesProcessed(state.iterations() * periodBytes);
+}
+BENCHMARK(BM_WriteInPlaceWrapping)->Apply(periodArgs);
+
+void BM_ReadInPlace(benchmark::State& state) {
+    const size_t periodBytes = state.range(0) * kFrameSize;
+    StreamDataMQ dataMQ(periodBytes * kPeriodsPerQueue);
+    StubStreamIn stream(periodBytes);
+    std::vector<uint8_t> client(periodBytes);
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[dataMQ.getQuantumCount()]);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+                readIntoDataMQ(&stream.stream, &dataMQ, &buffer[0], periodBytes));
+        dataMQ.read(client.data(), periodBytes);
+    }
+    state.SetBytesProcessed(state.iterations() * periodBytes);
+}
+BENCHMARK(BM_ReadInPlace)->Apply(periodArgs);
+
+}  // namespace
+
+BENCHMARK_MAIN();
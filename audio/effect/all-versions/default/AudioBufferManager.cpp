@@ -25,29 +25,52 @@ namespace android {
 ANDROID_SINGLETON_STATIC_INSTANCE(AudioBufferManager);
 
 bool AudioBufferManager::wrap(const AudioBuffer& buffer, sp<AudioBufferWrapper>* wrapper) {
-    // Check if we have this buffer already
-    std::lock_guard<std::mutex> lock(mLock);
-    ssize_t idx = mBuffers.indexOfKey(buffer.id);
-    if (idx >= 0) {
-        *wrapper = mBuffers[idx].promote();
-        if (*wrapper != nullptr) {
-            (*wrapper)->getHalBuffer()->frameCount = buffer.frameCount;
-            return true;
-        }
-        mBuffers.removeItemsAt(idx);
+    // Strong references are only released after the shard lock, as releasing the last
+    // reference to a wrapper calls removeEntry.
+    sp<AudioBufferWrapper> result;
+    if (findWrapper(buffer, &result)) {
+        *wrapper = result;
+        return true;
     }
-    // Need to create and init a new AudioBufferWrapper.
+    // Need to create and init a new AudioBufferWrapper. Mapping the memory is done
+    // without holding the lock.
     sp<AudioBufferWrapper> tempBuffer(new AudioBufferWrapper(buffer));
     if (!tempBuffer->init()) return false;
-    *wrapper = tempBuffer;
-    mBuffers.add(buffer.id, *wrapper);
+    {
+        Shard& shard = getShard(buffer.id);
+        std::lock_guard<std::shared_mutex> lock(shard.lock);
+        auto it = shard.buffers.find(buffer.id);
+        if (it != shard.buffers.end()) {
+            // Another thread may have wrapped the same buffer in the meantime.
+            result = it->second.promote();
+        }
+        if (result == nullptr) {
+            shard.buffers[buffer.id] = tempBuffer;
+            result = tempBuffer;
+        } else {
+            result->getHalBuffer()->frameCount = buffer.frameCount;
+        }
+    }
+    *wrapper = result;
+    return true;
+}
+
+bool AudioBufferManager::findWrapper(const AudioBuffer& buffer, sp<AudioBufferWrapper>* wrapper) {
+    Shard& shard = getShard(buffer.id);
+    std::shared_lock<std::shared_mutex> lock(shard.lock);
+    auto it = shard.buffers.find(buffer.id);
+    if (it == shard.buffers.end()) return false;
+    *wrapper = it->second.promote();
+    if (*wrapper == nullptr) return false;
+    (*wrapper)->getHalBuffer()->frameCount = buffer.frameCount;
     return true;
 }
 
-void AudioBufferManager::removeEntry(uint64_t id) {
-    std::lock_guard<std::mutex> lock(mLock);
-    ssize_t idx = mBuffers.indexOfKey(id);
-    if (idx >= 0) mBuffers.removeItemsAt(idx);
+void AudioBufferManager::removeEntry(uint64_t id, AudioBufferWrapper* wrapper) {
+    Shard& shard = getShard(id);
+    std::lock_guard<std::shared_mutex> lock(shard.lock);
+    auto it = shard.buffers.find(id);
+    if (it != shard.buffers.end() && it->second == wrapper) shard.buffers.erase(it);
 }
 
 namespace hardware {
@@ -60,7 +83,7 @@ AudioBufferWrapper::AudioBufferWrapper(const AudioBuffer& buffer)
     : mHidlBuffer(buffer), mHalBuffer{0, {nullptr}} {}
 
 AudioBufferWrapper::~AudioBufferWrapper() {
-    AudioBufferManager::getInstance().removeEntry(mHidlBuffer.id);
+    AudioBufferManager::getInstance().removeEntry(mHidlBuffer.id, this);
 }
 
 bool AudioBufferWrapper::init() {
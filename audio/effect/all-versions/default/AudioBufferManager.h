@@ -19,11 +19,12 @@
 
 #include PATH(android/hardware/audio/effect/FILE_VERSION/types.h)
 
-#include <mutex>
+#include <array>
+#include <shared_mutex>
+#include <unordered_map>
 
 #include <android/hidl/memory/1.0/IMemory.h>
 #include <system/audio_effect.h>
-#include <utils/KeyedVector.h>
 #include <utils/RefBase.h>
 #include <utils/Singleton.h>
 
@@ -72,11 +73,23 @@ class AudioBufferManager : public Singleton<AudioBufferManager> {
    private:
     friend class hardware::audio::effect::CPP_VERSION::implementation::AudioBufferWrapper;
 
-    // Called by AudioBufferWrapper.
-    void removeEntry(uint64_t id);
+    // Buffers are indexed by id in shards, so that effects wrapping different buffers do not
+    // contend, and an already wrapped buffer is found under a shared lock.
+    static constexpr size_t kShardCount = 16;
 
-    std::mutex mLock;
-    KeyedVector<uint64_t, wp<AudioBufferWrapper>> mBuffers;
+    struct Shard {
+        std::shared_mutex lock;
+        std::unordered_map<uint64_t, wp<AudioBufferWrapper>> buffers;
+    };
+
+    Shard& getShard(uint64_t id) { return mShards[id % kShardCount]; }
+    // Looks up a live wrapper of |buffer| under a shared lock. |wrapper| must be empty.
+    bool findWrapper(const AudioBuffer& buffer, sp<AudioBufferWrapper>* wrapper);
+    // Called by AudioBufferWrapper. Only removes the entry if it still refers to |wrapper|,
+    // as a new wrapper may have replaced it before the old one was destroyed.
+    void removeEntry(uint64_t id, AudioBufferWrapper* wrapper);
+
+    std::array<Shard, kShardCount> mShards;
 };
 
 }  // namespace android
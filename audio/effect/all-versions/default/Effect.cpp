@@ -24,6 +24,8 @@
 #include "common/all-versions/default/EffectMap.h"
 
 #include <memory.h>
+#include <algorithm>
+#include <unordered_map>
 
 #define ATRACE_TAG ATRACE_TAG_AUDIO
 
@@ -107,19 +109,7 @@ bool ProcessThread::threadLoop() {
                 ALOGE("processing buffers were not set before calling 'process'");
                 processResult = -ENODEV;
             }
-            switch (processResult) {
-                case 0:
-                    retval = Result::OK;
-                    break;
-                case -ENODATA:
-                    retval = Result::INVALID_STATE;
-                    break;
-                case -EINVAL:
-                    retval = Result::INVALID_ARGUMENTS;
-                    break;
-                default:
-                    retval = Result::NOT_INITIALIZED;
-            }
+            retval = Effect::processResultFromHal(processResult);
         }
         if (!mStatusMQ->write(&retval)) {
             ALOGW("status message queue write failed");
@@ -130,6 +120,23 @@ bool ProcessThread::threadLoop() {
     return false;
 }
 
+// The Effect of each open HAL handle, for looking effects up by id.
+std::mutex sEffectsLock;
+std::unordered_map<effect_handle_t, wp<Effect>> sEffects;  // guarded by sEffectsLock
+
+void unregisterEffect(effect_handle_t handle, Effect* effect) {
+    std::lock_guard<std::mutex> lock(sEffectsLock);
+    auto it = sEffects.find(handle);
+    // A released handle can be reused by a newer effect.
+    if (it != sEffects.end() && it->second.unsafe_get() == effect) {
+        sEffects.erase(it);
+    }
+}
+
+// Replies larger than this get a buffer of their own, so that the reply buffer of an effect
+// does not keep the memory of one unusually large reply, e.g. to a client command.
+constexpr size_t kMaxLentReplySize = 4096;
+
 }  // namespace
 
 // static
@@ -138,7 +145,14 @@ const char* Effect::sContextCallToCommand = "error";
 const char* Effect::sContextCallFunction = sContextCallToCommand;
 
 Effect::Effect(effect_handle_t handle)
-    : mHandle(handle), mEfGroup(nullptr), mStopProcessThread(false) {}
+    : mHandle(handle),
+      mProcessingMode(ProcessingMode::NONE),
+      mEfGroup(nullptr),
+      mStopProcessThread(false),
+      mReplyBufferLent(false) {
+    std::lock_guard<std::mutex> lock(sEffectsLock);
+    sEffects[handle] = this;
+}
 
 Effect::~Effect() {
     ATRACE_CALL();
@@ -158,10 +172,67 @@ Effect::~Effect() {
     int status = EffectRelease(mHandle);
     ALOGW_IF(status, "Error releasing effect %p: %s", mHandle, strerror(-status));
 #endif
+    unregisterEffect(mHandle, this);
     EffectMap::getInstance().remove(mHandle);
     mHandle = 0;
 }
 
+// static
+sp<Effect> Effect::getEffect(uint64_t effectId) {
+    effect_handle_t handle = EffectMap::getInstance().get(effectId);
+    if (handle == nullptr) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(sEffectsLock);
+    auto it = sEffects.find(handle);
+    return it != sEffects.end() ? it->second.promote() : nullptr;
+}
+
+// static
+Result Effect::processResultFromHal(int32_t processResult) {
+    switch (processResult) {
+        case 0:
+            return Result::OK;
+        case -ENODATA:
+            return Result::INVALID_STATE;
+        case -EINVAL:
+            return Result::INVALID_ARGUMENTS;
+        default:
+            return Result::NOT_INITIALIZED;
+    }
+}
+
+bool Effect::joinChain() {
+    ProcessingMode mode = ProcessingMode::NONE;
+    return mProcessingMode.compare_exchange_strong(mode, ProcessingMode::CHAIN);
+}
+
+void Effect::leaveChain() {
+    mProcessingMode.store(ProcessingMode::NONE);
+}
+
+Effect::ReplyBuffer::ReplyBuffer(Effect* effect) : mEffect(effect) {
+    std::lock_guard<std::mutex> lock(effect->mCommandLock);
+    mLent = !effect->mReplyBufferLent;
+    effect->mReplyBufferLent = true;
+}
+
+Effect::ReplyBuffer::~ReplyBuffer() {
+    if (mLent) {
+        std::lock_guard<std::mutex> lock(mEffect->mCommandLock);
+        mEffect->mReplyBufferLent = false;
+    }
+}
+
+std::vector<uint8_t>* Effect::ReplyBuffer::get(size_t size) {
+    std::vector<uint8_t>* buffer =
+            mLent && size <= kMaxLentReplySize ? &mEffect->mReplyBuffer : &mOwnBuffer;
+    // The buffer only grows, so that it is not reallocated for each reply.
+    if (buffer->size() < size) buffer->resize(size);
+    if (size > 0) memset(buffer->data(), 0, size);
+    return buffer;
+}
+
 // static
 template <typename T>
 size_t Effect::alignedSizeIn(size_t s) {
@@ -170,14 +241,16 @@ size_t Effect::alignedSizeIn(size_t s) {
 
 // static
 template <typename T>
-std::unique_ptr<uint8_t[]> Effect::hidlVecToHal(const hidl_vec<T>& vec, uint32_t* halDataSize) {
+void* Effect::hidlVecToHal(const hidl_vec<T>& vec, std::vector<uint8_t>* halBuffer,
+                           uint32_t* halDataSize) {
     // Due to bugs in HAL, they may attempt to write into the provided
     // input buffer. The original binder buffer is r/o, thus it is needed
     // to create a r/w version.
     *halDataSize = vec.size() * sizeof(T);
-    std::unique_ptr<uint8_t[]> halData(new uint8_t[*halDataSize]);
-    memcpy(&halData[0], &vec[0], *halDataSize);
-    return halData;
+    if (*halDataSize == 0) return nullptr;
+    if (halBuffer->size() < *halDataSize) halBuffer->resize(*halDataSize);
+    memcpy(halBuffer->data(), &vec[0], *halDataSize);
+    return halBuffer->data();
 }
 
 // static
@@ -243,12 +316,22 @@ void Effect::effectOffloadParamToHal(const EffectOffloadParameter& offload,
 }
 
 // static
-std::vector<uint8_t> Effect::parameterToHal(uint32_t paramSize, const void* paramData,
-                                            uint32_t valueSize, const void** valueData) {
+size_t Effect::parameterSizeInHal(uint32_t paramSize, uint32_t valueSize) {
+    return sizeof(effect_param_t) + alignedSizeIn<uint32_t>(paramSize) * sizeof(uint32_t) +
+           valueSize;
+}
+
+// static
+uint32_t Effect::parameterToHal(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                                const void** valueData, std::vector<uint8_t>* halParamBuffer) {
     size_t valueOffsetFromData = alignedSizeIn<uint32_t>(paramSize) * sizeof(uint32_t);
-    size_t halParamBufferSize = sizeof(effect_param_t) + valueOffsetFromData + valueSize;
-    std::vector<uint8_t> halParamBuffer(halParamBufferSize, 0);
-    effect_param_t* halParam = reinterpret_cast<effect_param_t*>(&halParamBuffer[0]);
+    size_t halParamBufferSize = parameterSizeInHal(paramSize, valueSize);
+    // The buffer only grows, so that it is not reallocated for each parameter.
+    if (halParamBuffer->size() < halParamBufferSize) {
+        halParamBuffer->resize(halParamBufferSize);
+    }
+    memset(halParamBuffer->data(), 0, halParamBufferSize);
+    effect_param_t* halParam = reinterpret_cast<effect_param_t*>(halParamBuffer->data());
     halParam->psize = paramSize;
     halParam->vsize = valueSize;
     memcpy(halParam->data, paramData, paramSize);
@@ -261,7 +344,7 @@ std::vector<uint8_t> Effect::parameterToHal(uint32_t paramSize, const void* para
             *valueData = halParam->data + valueOffsetFromData;
         }
     }
-    return halParamBuffer;
+    return halParamBufferSize;
 }
 
 Result Effect::analyzeCommandStatus(const char* commandName, const char* context, status_t status) {
@@ -307,42 +390,56 @@ void Effect::getConfigImpl(int commandCode, const char* commandName, GetConfigCa
 Result Effect::getCurrentConfigImpl(uint32_t featureId, uint32_t configSize,
                                     GetCurrentConfigSuccessCallback onSuccess) {
     uint32_t halCmd = featureId;
-    std::vector<uint32_t> halResult(alignedSizeIn<uint32_t>(sizeof(uint32_t) + configSize), 0);
+    ReplyBuffer reply(this);
+    uint32_t* halResult = reinterpret_cast<uint32_t*>(
+            reply.get(alignedSizeIn<uint32_t>(sizeof(uint32_t) + configSize) * sizeof(uint32_t))
+                    ->data());
     uint32_t halResultSize = 0;
     return sendCommandReturningStatusAndData(
             EFFECT_CMD_GET_FEATURE_CONFIG, "GET_FEATURE_CONFIG", sizeof(uint32_t), &halCmd,
-            &halResultSize, &halResult[0], sizeof(uint32_t), [&] { onSuccess(&halResult[1]); });
+            &halResultSize, halResult, sizeof(uint32_t), [&] { onSuccess(&halResult[1]); });
 }
 
 Result Effect::getParameterImpl(uint32_t paramSize, const void* paramData,
                                 uint32_t requestValueSize, uint32_t replyValueSize,
                                 GetParameterSuccessCallback onSuccess) {
+    // The value is read in place once the command lock is released, so that the callback
+    // can call back into the effect.
+    ReplyBuffer reply(this);
+    std::vector<uint8_t>* halReply = reply.get(parameterSizeInHal(paramSize, replyValueSize));
     // As it is unknown what method HAL uses for copying the provided parameter data,
     // it is safer to make sure that input and output buffers do not overlap.
-    std::vector<uint8_t> halCmdBuffer =
-        parameterToHal(paramSize, paramData, requestValueSize, nullptr);
     const void* valueData = nullptr;
-    std::vector<uint8_t> halParamBuffer =
-        parameterToHal(paramSize, paramData, replyValueSize, &valueData);
-    uint32_t halParamBufferSize = halParamBuffer.size();
-
-    return sendCommandReturningStatusAndData(
-        EFFECT_CMD_GET_PARAM, "GET_PARAM", halCmdBuffer.size(), &halCmdBuffer[0],
-        &halParamBufferSize, &halParamBuffer[0], sizeof(effect_param_t), [&] {
-            effect_param_t* halParam = reinterpret_cast<effect_param_t*>(&halParamBuffer[0]);
-            onSuccess(halParam->vsize, valueData);
-        });
+    uint32_t halParamBufferSize =
+        parameterToHal(paramSize, paramData, replyValueSize, &valueData, halReply);
+    bool succeeded = false;
+    Result retval;
+    {
+        std::lock_guard<std::mutex> lock(mCommandLock);
+        uint32_t halCmdBufferSize =
+            parameterToHal(paramSize, paramData, requestValueSize, nullptr, &mCommandBuffer);
+        retval = sendCommandReturningStatusAndData(
+            EFFECT_CMD_GET_PARAM, "GET_PARAM", halCmdBufferSize, mCommandBuffer.data(),
+            &halParamBufferSize, halReply->data(), sizeof(effect_param_t),
+            [&] { succeeded = true; });
+    }
+    if (succeeded) {
+        const effect_param_t* halParam = reinterpret_cast<effect_param_t*>(halReply->data());
+        onSuccess(std::min(halParam->vsize, replyValueSize), valueData);
+    }
+    return retval;
 }
 
 Result Effect::getSupportedConfigsImpl(uint32_t featureId, uint32_t maxConfigs, uint32_t configSize,
                                        GetSupportedConfigsSuccessCallback onSuccess) {
     uint32_t halCmd[2] = {featureId, maxConfigs};
     uint32_t halResultSize = 2 * sizeof(uint32_t) + maxConfigs * sizeof(configSize);
-    std::vector<uint8_t> halResult(static_cast<size_t>(halResultSize), 0);
+    ReplyBuffer reply(this);
+    uint8_t* halResult = reply.get(halResultSize)->data();
     return sendCommandReturningStatusAndData(
         EFFECT_CMD_GET_FEATURE_SUPPORTED_CONFIGS, "GET_FEATURE_SUPPORTED_CONFIGS", sizeof(halCmd),
-        halCmd, &halResultSize, &halResult[0], 2 * sizeof(uint32_t), [&] {
-            uint32_t* halResult32 = reinterpret_cast<uint32_t*>(&halResult[0]);
+        halCmd, &halResultSize, halResult, 2 * sizeof(uint32_t), [&] {
+            uint32_t* halResult32 = reinterpret_cast<uint32_t*>(halResult);
             uint32_t supportedConfigs = *(++halResult32);  // skip status field
             if (supportedConfigs > maxConfigs) supportedConfigs = maxConfigs;
             onSuccess(supportedConfigs, ++halResult32);
@@ -351,21 +448,30 @@ Result Effect::getSupportedConfigsImpl(uint32_t featureId, uint32_t maxConfigs,
 
 Return<void> Effect::prepareForProcessing(prepareForProcessing_cb _hidl_cb) {
     status_t status;
-    // Create message queue.
-    if (mStatusMQ) {
-        ALOGE("the client attempts to call prepareForProcessing_cb twice");
+    ProcessingMode mode = ProcessingMode::NONE;
+    if (!mProcessingMode.compare_exchange_strong(mode, ProcessingMode::OWN_THREAD)) {
+        if (mode == ProcessingMode::CHAIN) {
+            ALOGE("the effect is processed by an effect chain");
+        } else if (mode == ProcessingMode::CLOSED) {
+            ALOGE("the client attempts to call prepareForProcessing_cb on a closed effect");
+        } else {
+            ALOGE("the client attempts to call prepareForProcessing_cb twice");
+        }
         _hidl_cb(Result::INVALID_STATE, StatusMQ::Descriptor());
         return Void();
     }
+    // Create message queue.
     std::unique_ptr<StatusMQ> tempStatusMQ(new StatusMQ(1, true /*EventFlag*/));
     if (!tempStatusMQ->isValid()) {
         ALOGE_IF(!tempStatusMQ->isValid(), "status MQ is invalid");
+        mProcessingMode.store(ProcessingMode::NONE);
         _hidl_cb(Result::INVALID_ARGUMENTS, StatusMQ::Descriptor());
         return Void();
     }
     status = EventFlag::createEventFlag(tempStatusMQ->getEventFlagWord(), &mEfGroup);
     if (status != OK || !mEfGroup) {
         ALOGE("failed creating event flag for status MQ: %s", strerror(-status));
+        mProcessingMode.store(ProcessingMode::NONE);
         _hidl_cb(Result::INVALID_ARGUMENTS, StatusMQ::Descriptor());
         return Void();
     }
@@ -376,6 +482,7 @@ Return<void> Effect::prepareForProcessing(prepareForProcessing_cb _hidl_cb) {
     status = mProcessThread->run("effect", PRIORITY_URGENT_AUDIO);
     if (status != OK) {
         ALOGW("failed to start effect processing thread: %s", strerror(-status));
+        mProcessingMode.store(ProcessingMode::NONE);
         _hidl_cb(Result::INVALID_ARGUMENTS, MQDescriptorSync<Result>());
         return Void();
     }
@@ -477,10 +584,37 @@ Result Effect::setConfigImpl(int commandCode, const char* commandName, const Eff
 
 Result Effect::setParameterImpl(uint32_t paramSize, const void* paramData, uint32_t valueSize,
                                 const void* valueData) {
-    std::vector<uint8_t> halParamBuffer =
-        parameterToHal(paramSize, paramData, valueSize, &valueData);
-    return sendCommandReturningStatus(EFFECT_CMD_SET_PARAM, "SET_PARAM", halParamBuffer.size(),
-                                      &halParamBuffer[0]);
+    std::lock_guard<std::mutex> lock(mCommandLock);
+    return setParameterLocked(paramSize, paramData, valueSize, valueData);
+}
+
+Result Effect::setParameters(const ParameterUpdate* updates, size_t count) {
+    std::lock_guard<std::mutex> lock(mCommandLock);
+    for (size_t i = 0; i < count; ++i) {
+        Result retval = setParameterLocked(updates[i].paramSize, updates[i].paramData,
+                                           updates[i].valueSize, updates[i].valueData);
+        if (retval != Result::OK) return retval;
+    }
+    return Result::OK;
+}
+
+Result Effect::setParameterLocked(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                                  const void* valueData) {
+    uint32_t halParamBufferSize =
+        parameterToHal(paramSize, paramData, valueSize, &valueData, &mCommandBuffer);
+    return sendCommandReturningStatus(EFFECT_CMD_SET_PARAM, "SET_PARAM", halParamBufferSize,
+                                      mCommandBuffer.data());
+}
+
+Result Effect::setParameterInPlace(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                                   SetParameterFillCallback fillValue) {
+    std::lock_guard<std::mutex> lock(mCommandLock);
+    const void* valueData = nullptr;
+    uint32_t halParamBufferSize =
+        parameterToHal(paramSize, paramData, valueSize, &valueData, &mCommandBuffer);
+    fillValue(const_cast<void*>(valueData));
+    return sendCommandReturningStatus(EFFECT_CMD_SET_PARAM, "SET_PARAM", halParamBufferSize,
+                                      mCommandBuffer.data());
 }
 
 // Methods from ::android::hardware::audio::effect::CPP_VERSION::IEffect follow.
@@ -514,24 +648,32 @@ Return<Result> Effect::setDevice(AudioDeviceBitfield device) {
 
 Return<void> Effect::setAndGetVolume(const hidl_vec<uint32_t>& volumes,
                                      setAndGetVolume_cb _hidl_cb) {
-    uint32_t halDataSize;
-    std::unique_ptr<uint8_t[]> halData = hidlVecToHal(volumes, &halDataSize);
-    uint32_t halResultSize = halDataSize;
-    std::vector<uint32_t> halResult(volumes.size(), 0);
-    Result retval = sendCommandReturningData(EFFECT_CMD_SET_VOLUME, "SET_VOLUME", halDataSize,
-                                             &halData[0], &halResultSize, &halResult[0]);
+    uint32_t halResultSize;
+    ReplyBuffer reply(this);
+    uint32_t* halResult =
+            reinterpret_cast<uint32_t*>(reply.get(volumes.size() * sizeof(uint32_t))->data());
+    Result retval;
+    {
+        std::lock_guard<std::mutex> lock(mCommandLock);
+        uint32_t halDataSize;
+        void* halData = hidlVecToHal(volumes, &mCommandBuffer, &halDataSize);
+        halResultSize = halDataSize;
+        retval = sendCommandReturningData(EFFECT_CMD_SET_VOLUME, "SET_VOLUME", halDataSize,
+                                          halData, &halResultSize, halResult);
+    }
     hidl_vec<uint32_t> result;
     if (retval == Result::OK) {
-        result.setToExternal(&halResult[0], halResultSize);
+        result.setToExternal(halResult, halResultSize);
     }
     _hidl_cb(retval, result);
     return Void();
 }
 
 Return<Result> Effect::volumeChangeNotification(const hidl_vec<uint32_t>& volumes) {
+    std::lock_guard<std::mutex> lock(mCommandLock);
     uint32_t halDataSize;
-    std::unique_ptr<uint8_t[]> halData = hidlVecToHal(volumes, &halDataSize);
-    return sendCommand(EFFECT_CMD_SET_VOLUME, "SET_VOLUME", halDataSize, &halData[0]);
+    void* halData = hidlVecToHal(volumes, &mCommandBuffer, &halDataSize);
+    return sendCommand(EFFECT_CMD_SET_VOLUME, "SET_VOLUME", halDataSize, halData);
 }
 
 Return<Result> Effect::setAudioMode(AudioMode mode) {
@@ -625,19 +767,22 @@ Return<void> Effect::getDescriptor(getDescriptor_cb _hidl_cb) {
 
 Return<void> Effect::command(uint32_t commandId, const hidl_vec<uint8_t>& data,
                              uint32_t resultMaxSize, command_cb _hidl_cb) {
-    uint32_t halDataSize;
-    std::unique_ptr<uint8_t[]> halData = hidlVecToHal(data, &halDataSize);
     uint32_t halResultSize = resultMaxSize;
-    std::unique_ptr<uint8_t[]> halResult(new uint8_t[halResultSize]);
-    memset(&halResult[0], 0, halResultSize);
+    ReplyBuffer reply(this);
+    uint8_t* halResult = reply.get(halResultSize)->data();
 
-    void* dataPtr = halDataSize > 0 ? &halData[0] : NULL;
-    void* resultPtr = halResultSize > 0 ? &halResult[0] : NULL;
-    status_t status =
-        (*mHandle)->command(mHandle, commandId, halDataSize, dataPtr, &halResultSize, resultPtr);
+    void* resultPtr = halResultSize > 0 ? halResult : NULL;
+    status_t status;
+    {
+        std::lock_guard<std::mutex> lock(mCommandLock);
+        uint32_t halDataSize;
+        void* dataPtr = hidlVecToHal(data, &mCommandBuffer, &halDataSize);
+        status = (*mHandle)->command(mHandle, commandId, halDataSize, dataPtr, &halResultSize,
+                                     resultPtr);
+    }
     hidl_vec<uint8_t> result;
     if (status == OK && resultPtr != NULL) {
-        result.setToExternal(&halResult[0], halResultSize);
+        result.setToExternal(halResult, halResultSize);
     }
     _hidl_cb(status, result);
     return Void();
@@ -650,14 +795,20 @@ Return<Result> Effect::setParameter(const hidl_vec<uint8_t>& parameter,
 
 Return<void> Effect::getParameter(const hidl_vec<uint8_t>& parameter, uint32_t valueMaxSize,
                                   getParameter_cb _hidl_cb) {
-    hidl_vec<uint8_t> value;
+    // The value is only valid during the callback, so it is sent back from there.
+    bool replied = false;
     Result retval = getParameterImpl(
         parameter.size(), &parameter[0], valueMaxSize,
         [&](uint32_t valueSize, const void* valueData) {
+            hidl_vec<uint8_t> value;
             value.setToExternal(reinterpret_cast<uint8_t*>(const_cast<void*>(valueData)),
                                 valueSize);
+            _hidl_cb(Result::OK, value);
+            replied = true;
         });
-    _hidl_cb(retval, value);
+    if (!replied) {
+        _hidl_cb(retval, hidl_vec<uint8_t>());
+    }
     return Void();
 }
 
@@ -697,9 +848,17 @@ Return<Result> Effect::setCurrentConfigForFeature(uint32_t featureId,
 }
 
 Return<Result> Effect::close() {
-    if (mStopProcessThread.load(std::memory_order_relaxed)) {  // only this thread modifies
-        return Result::INVALID_STATE;
-    }
+    ProcessingMode mode = mProcessingMode.load();
+    do {
+        if (mode == ProcessingMode::CLOSED) {
+            return Result::INVALID_STATE;
+        }
+        if (mode == ProcessingMode::CHAIN) {
+            ALOGE("effect %p is processed by an effect chain, which must be closed first",
+                  mHandle);
+            return Result::INVALID_STATE;
+        }
+    } while (!mProcessingMode.compare_exchange_weak(mode, ProcessingMode::CLOSED));
     mStopProcessThread.store(true, std::memory_order_release);
     if (mEfGroup) {
         mEfGroup->wake(static_cast<uint32_t>(MessageQueueFlagBits::REQUEST_QUIT));
@@ -711,6 +870,7 @@ Return<Result> Effect::close() {
     // must finish processing before closing the effect.
     Result retval =
             analyzeStatus("EffectRelease", "", sContextCallFunction, EffectRelease(mHandle));
+    unregisterEffect(mHandle, this);
     EffectMap::getInstance().remove(mHandle);
     return retval;
 #endif
@@ -23,6 +23,7 @@
 
 #include <atomic>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include <fmq/EventFlag.h>
@@ -55,9 +56,22 @@ struct Effect : public IEffect {
     typedef MessageQueue<Result, kSynchronizedReadWrite> StatusMQ;
     using GetParameterSuccessCallback =
         std::function<void(uint32_t valueSize, const void* valueData)>;
+    using SetParameterFillCallback = std::function<void(void* valueData)>;
+    // One parameter of a batch applied by setParameters.
+    struct ParameterUpdate {
+        uint32_t paramSize;
+        const void* paramData;
+        uint32_t valueSize;
+        const void* valueData;
+    };
 
     explicit Effect(effect_handle_t handle);
 
+    // Returns the effect of an id handed out by IEffectsFactory::createEffect, or nullptr if
+    // the effect is gone or closed.
+    static sp<Effect> getEffect(uint64_t effectId);
+    static Result processResultFromHal(int32_t processResult);
+
     // Methods from ::android::hardware::audio::effect::CPP_VERSION::IEffect follow.
     Return<Result> init() override;
     Return<Result> setConfig(
@@ -155,8 +169,17 @@ struct Effect : public IEffect {
                             uint32_t replyValueSize, GetParameterSuccessCallback onSuccess);
     Result setParameterImpl(uint32_t paramSize, const void* paramData, uint32_t valueSize,
                             const void* valueData);
+    // Lets the caller write the value directly into the command buffer, for values that
+    // need to be converted to the HAL layout.
+    Result setParameterInPlace(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                               SetParameterFillCallback fillValue);
+    // Applies the parameters in order, stopping at the first one that fails. For extensions
+    // whose settings span several parameters: concurrent parameter calls on the effect can
+    // not interleave with the batch.
+    Result setParameters(const ParameterUpdate* updates, size_t count);
 
    private:
+    friend class EffectChain;         // to process the effect on the chain's thread
     friend struct VirtualizerEffect;  // for getParameterImpl
     friend struct VisualizerEffect;   // to allow executing commands
 
@@ -170,7 +193,29 @@ struct Effect : public IEffect {
     static const char* sContextCallToCommand;
     static const char* sContextCallFunction;
 
+    // What processes the audio of the effect. An effect in a chain can neither be prepared
+    // for processing on its own nor be closed until the chain lets it go.
+    enum class ProcessingMode { NONE, OWN_THREAD, CHAIN, CLOSED };
+
+    // Lends mReplyBuffer to one call at a time, so that HAL replies are received without
+    // allocating and can be read after mCommandLock is released, e.g. by client callbacks.
+    // A call made while the buffer is lent out, like one from such a callback, and a reply
+    // too large to be kept around get a buffer of their own.
+    class ReplyBuffer {
+       public:
+        explicit ReplyBuffer(Effect* effect);
+        ~ReplyBuffer();
+        // Returns a buffer of at least |size| bytes, the first |size| of them zeroed.
+        std::vector<uint8_t>* get(size_t size);
+
+       private:
+        Effect* const mEffect;
+        bool mLent;
+        std::vector<uint8_t> mOwnBuffer;
+    };
+
     effect_handle_t mHandle;
+    std::atomic<ProcessingMode> mProcessingMode;
     sp<AudioBufferWrapper> mInBuffer;
     sp<AudioBufferWrapper> mOutBuffer;
     std::atomic<audio_buffer_t*> mHalInBufferPtr;
@@ -179,13 +224,25 @@ struct Effect : public IEffect {
     EventFlag* mEfGroup;
     std::atomic<bool> mStopProcessThread;
     sp<Thread> mProcessThread;
+    // Buffers for building HAL commands and receiving their replies. They are reused
+    // across calls so that parameter updates stop allocating once the buffers have grown.
+    std::mutex mCommandLock;
+    std::vector<uint8_t> mCommandBuffer;  // guarded by mCommandLock
+    bool mReplyBufferLent;                // guarded by mCommandLock
+    std::vector<uint8_t> mReplyBuffer;    // only used through ReplyBuffer
 
     virtual ~Effect();
 
+    // Called by EffectChain. joinChain() fails if the effect is processed on its own, part of
+    // another chain or closed.
+    bool joinChain();
+    void leaveChain();
+
     template <typename T>
     static size_t alignedSizeIn(size_t s);
     template <typename T>
-    std::unique_ptr<uint8_t[]> hidlVecToHal(const hidl_vec<T>& vec, uint32_t* halDataSize);
+    static void* hidlVecToHal(const hidl_vec<T>& vec, std::vector<uint8_t>* halBuffer,
+                              uint32_t* halDataSize);
     static void effectAuxChannelsConfigFromHal(const channel_config_t& halConfig,
                                                EffectAuxChannelsConfig* config);
     static void effectAuxChannelsConfigToHal(const EffectAuxChannelsConfig& config,
@@ -198,8 +255,9 @@ struct Effect : public IEffect {
     static void effectConfigToHal(const EffectConfig& config, effect_config_t* halConfig);
     static void effectOffloadParamToHal(const EffectOffloadParameter& offload,
                                         effect_offload_param_t* halOffload);
-    static std::vector<uint8_t> parameterToHal(uint32_t paramSize, const void* paramData,
-                                               uint32_t valueSize, const void** valueData);
+    static size_t parameterSizeInHal(uint32_t paramSize, uint32_t valueSize);
+    static uint32_t parameterToHal(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                                   const void** valueData, std::vector<uint8_t>* halParamBuffer);
 
     Result analyzeCommandStatus(const char* commandName, const char* context, status_t status);
     Result analyzeStatus(const char* funcName, const char* subFuncName,
@@ -222,6 +280,8 @@ struct Effect : public IEffect {
                                              uint32_t size, void* data, uint32_t* replySize,
                                              void* replyData, uint32_t minReplySize,
                                              CommandSuccessCallback onSuccess);
+    Result setParameterLocked(uint32_t paramSize, const void* paramData, uint32_t valueSize,
+                              const void* valueData);
     Result setConfigImpl(int commandCode, const char* commandName, const EffectConfig& config,
                          const sp<IEffectBufferProviderCallback>& inputBufferProvider,
                          const sp<IEffectBufferProviderCallback>& outputBufferProvider);
@@ -0,0 +1,335 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "EffectChainHAL"
+#define ATRACE_TAG ATRACE_TAG_AUDIO
+
+#include "EffectChain.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include <android/log.h>
+#include <utils/Trace.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+
+namespace {
+
+uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+void updateMax(std::atomic<uint64_t>* max, uint64_t value) {
+    // Only the processing thread writes, so a plain load/store pair is enough.
+    if (value > max->load(std::memory_order_relaxed)) {
+        max->store(value, std::memory_order_relaxed);
+    }
+}
+
+}  // namespace
+
+class EffectChain::ProcessThread : public Thread {
+   public:
+    // ProcessThread's lifespan never exceeds EffectChain's lifespan.
+    ProcessThread(EffectChain* chain) : Thread(false /*canCallJava*/), mChain(chain) {}
+    virtual ~ProcessThread() {}
+
+   private:
+    EffectChain* mChain;
+
+    bool threadLoop() override;
+};
+
+bool EffectChain::ProcessThread::threadLoop() {
+    // Same as the processing thread of a single effect, this doesn't return control back to
+    // the Thread until it decides to stop, to avoid priority inversion on the Thread mutexes.
+    while (!mChain->mStopProcessThread.load(std::memory_order_acquire)) {
+        uint32_t efState = 0;
+        mChain->mEfGroup->wait(static_cast<uint32_t>(MessageQueueFlagBits::REQUEST_PROCESS_ALL),
+                               &efState);
+        if (!(efState & static_cast<uint32_t>(MessageQueueFlagBits::REQUEST_PROCESS_ALL)) ||
+            (efState & static_cast<uint32_t>(MessageQueueFlagBits::REQUEST_QUIT))) {
+            continue;  // Nothing to do or time to quit.
+        }
+        const bool reverse =
+                !(efState & static_cast<uint32_t>(MessageQueueFlagBits::REQUEST_PROCESS));
+        Result retval = mChain->processAll(reverse);
+        if (!mChain->mStatusMQ->write(&retval)) {
+            ALOGW("status message queue write failed");
+        }
+        mChain->mEfGroup->wake(static_cast<uint32_t>(MessageQueueFlagBits::DONE_PROCESSING));
+    }
+
+    return false;
+}
+
+// static
+Result EffectChain::create(const std::vector<uint64_t>& effectIds, sp<EffectChain>* chain) {
+    if (effectIds.empty()) {
+        return Result::INVALID_ARGUMENTS;
+    }
+    sp<EffectChain> tempChain = new EffectChain();
+    for (uint64_t effectId : effectIds) {
+        sp<Effect> effect = Effect::getEffect(effectId);
+        if (effect == nullptr) {
+            ALOGE("%s: no effect with id %" PRIu64, __func__, effectId);
+            return Result::INVALID_ARGUMENTS;
+        }
+        if (!effect->joinChain()) {
+            // Either in the chain already, or used elsewhere.
+            ALOGE("%s: effect %" PRIu64 " can not be added to a chain", __func__, effectId);
+            return std::any_of(tempChain->mEffects.begin(), tempChain->mEffects.end(),
+                               [&](const Entry& entry) { return entry.effect == effect; })
+                           ? Result::INVALID_ARGUMENTS
+                           : Result::INVALID_STATE;
+        }
+        // From here on, the destructor of the chain lets the effect go on failure.
+        tempChain->mEffects.push_back(
+                {effectId, effect, effect->mHandle, std::make_unique<EffectStats>()});
+    }
+    *chain = tempChain;
+    return Result::OK;
+}
+
+EffectChain::EffectChain()
+    : mHalInBufferPtr(nullptr),
+      mHalOutBufferPtr(nullptr),
+      mEfGroup(nullptr),
+      mStopProcessThread(false) {}
+
+EffectChain::~EffectChain() {
+    ATRACE_CALL();
+    (void)close();
+    if (mEfGroup) {
+        status_t status = EventFlag::deleteEventFlag(&mEfGroup);
+        ALOGE_IF(status, "processing MQ event flag deletion error: %s", strerror(-status));
+    }
+    mInBuffer.clear();
+    mOutBuffer.clear();
+}
+
+void EffectChain::prepareForProcessing(PrepareForProcessingCallback cb) {
+    status_t status;
+    if (mStopProcessThread.load(std::memory_order_relaxed)) {
+        ALOGE("the client attempts to prepare a closed chain for processing");
+        cb(Result::INVALID_STATE, StatusMQ::Descriptor());
+        return;
+    }
+    // Create message queue.
+    if (mStatusMQ) {
+        ALOGE("the client attempts to call prepareForProcessing twice");
+        cb(Result::INVALID_STATE, StatusMQ::Descriptor());
+        return;
+    }
+    std::unique_ptr<StatusMQ> tempStatusMQ(new StatusMQ(1, true /*EventFlag*/));
+    if (!tempStatusMQ->isValid()) {
+        ALOGE("status MQ is invalid");
+        cb(Result::INVALID_ARGUMENTS, StatusMQ::Descriptor());
+        return;
+    }
+    status = EventFlag::createEventFlag(tempStatusMQ->getEventFlagWord(), &mEfGroup);
+    if (status != OK || !mEfGroup) {
+        ALOGE("failed creating event flag for status MQ: %s", strerror(-status));
+        cb(Result::INVALID_ARGUMENTS, StatusMQ::Descriptor());
+        return;
+    }
+    // The processing thread accesses the status MQ via the chain.
+    mStatusMQ = std::move(tempStatusMQ);
+
+    // Create and launch the thread.
+    mProcessThread = new ProcessThread(this);
+    status = mProcessThread->run("effect_chain", PRIORITY_URGENT_AUDIO);
+    if (status != OK) {
+        ALOGW("failed to start effect chain processing thread: %s", strerror(-status));
+        mProcessThread.clear();
+        mStatusMQ.reset();
+        cb(Result::INVALID_ARGUMENTS, StatusMQ::Descriptor());
+        return;
+    }
+
+    cb(Result::OK, *mStatusMQ->getDesc());
+}
+
+Result EffectChain::setProcessBuffers(const AudioBuffer& inBuffer, const AudioBuffer& outBuffer) {
+    AudioBufferManager& manager = AudioBufferManager::getInstance();
+    sp<AudioBufferWrapper> tempInBuffer, tempOutBuffer;
+    if (!manager.wrap(inBuffer, &tempInBuffer)) {
+        ALOGE("Could not map memory of the input buffer");
+        return Result::INVALID_ARGUMENTS;
+    }
+    if (!manager.wrap(outBuffer, &tempOutBuffer)) {
+        ALOGE("Could not map memory of the output buffer");
+        return Result::INVALID_ARGUMENTS;
+    }
+    mInBuffer = tempInBuffer;
+    mOutBuffer = tempOutBuffer;
+
+    uint32_t samplingRate = getSamplingRate();
+    if (samplingRate != 0) {
+        mStats.deadlineNs.store(inBuffer.frameCount * 1000000000ull / samplingRate,
+                                std::memory_order_relaxed);
+    }
+
+    // The processing thread only reads these pointers after waking up by an event flag,
+    // so it's OK to update the pair non-atomically.
+    mHalInBufferPtr.store(mInBuffer->getHalBuffer(), std::memory_order_release);
+    mHalOutBufferPtr.store(mOutBuffer->getHalBuffer(), std::memory_order_release);
+    return Result::OK;
+}
+
+Result EffectChain::close() {
+    if (mStopProcessThread.exchange(true, std::memory_order_acq_rel)) {
+        return Result::INVALID_STATE;
+    }
+    if (mEfGroup) {
+        mEfGroup->wake(static_cast<uint32_t>(MessageQueueFlagBits::REQUEST_QUIT));
+    }
+    // Unlike a single effect, the chain has to wait for its thread: the effects may be
+    // closed as soon as they are let go.
+    if (mProcessThread.get()) {
+        ATRACE_NAME("mProcessThread->join");
+        status_t status = mProcessThread->join();
+        ALOGE_IF(status, "processing thread exit error: %s", strerror(-status));
+    }
+    for (auto& entry : mEffects) {
+        entry.effect->leaveChain();
+        entry.effect.clear();
+    }
+    return Result::OK;
+}
+
+uint32_t EffectChain::getSamplingRate() {
+    uint32_t samplingRate = 0;
+    if (!mEffects.empty() && mEffects.front().effect != nullptr) {
+        mEffects.front().effect->getConfig([&](Result retval, const EffectConfig& config) {
+            if (retval == Result::OK) {
+                samplingRate = config.inputCfg.samplingRateHz;
+            }
+        });
+    }
+    return samplingRate;
+}
+
+Result EffectChain::processAll(bool reverse) {
+    // affects both buffer pointers and their contents.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    audio_buffer_t* inBuffer = mHalInBufferPtr.load(std::memory_order_relaxed);
+    audio_buffer_t* outBuffer = mHalOutBufferPtr.load(std::memory_order_relaxed);
+    if (inBuffer == nullptr || outBuffer == nullptr) {
+        ALOGE("processing buffers were not set before calling 'process'");
+        return Result::NOT_INITIALIZED;
+    }
+
+    const uint64_t startNs = nowNs();
+    uint64_t effectStartNs = startNs;
+    // Effects after the first one that produced output work in place on the output buffer.
+    audio_buffer_t* currentIn = inBuffer;
+    bool processed = false;
+    bool called = false;
+    Result error = Result::OK;
+    for (auto& entry : mEffects) {
+        effect_handle_t handle = entry.handle;
+        int32_t processResult;
+        if (!reverse) {
+            processResult = (*handle)->process(handle, currentIn, outBuffer);
+        } else if ((*handle)->process_reverse != NULL) {
+            processResult = (*handle)->process_reverse(handle, currentIn, outBuffer);
+        } else {
+            continue;
+        }
+        called = true;
+        const uint64_t effectEndNs = nowNs();
+        const uint64_t elapsedNs = effectEndNs - effectStartNs;
+        effectStartNs = effectEndNs;
+
+        EffectStats& stats = *entry.stats;
+        stats.processCount.fetch_add(1, std::memory_order_relaxed);
+        stats.totalNs.fetch_add(elapsedNs, std::memory_order_relaxed);
+        updateMax(&stats.maxNs, elapsedNs);
+        if (processResult == 0) {
+            currentIn = outBuffer;
+            processed = true;
+        } else if (processResult != -ENODATA) {
+            // -ENODATA only means that the effect is disabled. The first real error is
+            // reported, the following effects still run.
+            stats.errorCount.fetch_add(1, std::memory_order_relaxed);
+            if (error == Result::OK) {
+                error = Effect::processResultFromHal(processResult);
+            }
+        }
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const uint64_t elapsedNs = nowNs() - startNs;
+    mStats.periodCount.fetch_add(1, std::memory_order_relaxed);
+    mStats.totalNs.fetch_add(elapsedNs, std::memory_order_relaxed);
+    updateMax(&mStats.maxNs, elapsedNs);
+    const uint64_t deadlineNs = mStats.deadlineNs.load(std::memory_order_relaxed);
+    if (deadlineNs != 0 && elapsedNs > deadlineNs) {
+        mStats.deadlineMissCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (!called) {
+        // Same as a single effect without process_reverse.
+        return Result::NOT_SUPPORTED;
+    }
+    if (error != Result::OK) {
+        return error;
+    }
+    // Same as a single disabled effect: nothing was written to the output buffer.
+    return processed ? Result::OK : Result::INVALID_STATE;
+}
+
+void EffectChain::debug(int fd) {
+    const uint64_t periods = mStats.periodCount.load(std::memory_order_relaxed);
+    dprintf(fd,
+            "Effect chain of %zu effects%s: %" PRIu64 " periods, %" PRIu64
+            " deadline misses (deadline %" PRIu64 " us)\n",
+            mEffects.size(), mStopProcessThread.load() ? " (closed)" : "", periods,
+            mStats.deadlineMissCount.load(std::memory_order_relaxed),
+            mStats.deadlineNs.load(std::memory_order_relaxed) / 1000);
+    dprintf(fd, "  chain: avg %" PRIu64 " us, max %" PRIu64 " us\n",
+            periods ? mStats.totalNs.load(std::memory_order_relaxed) / periods / 1000 : 0,
+            mStats.maxNs.load(std::memory_order_relaxed) / 1000);
+    for (const auto& entry : mEffects) {
+        const EffectStats& stats = *entry.stats;
+        const uint64_t count = stats.processCount.load(std::memory_order_relaxed);
+        dprintf(fd,
+                "  effect %" PRIu64 ": %" PRIu64 " calls, %" PRIu64 " errors, avg %" PRIu64
+                " us, max %" PRIu64 " us\n",
+                entry.effectId, count, stats.errorCount.load(std::memory_order_relaxed),
+                count ? stats.totalNs.load(std::memory_order_relaxed) / count / 1000 : 0,
+                stats.maxNs.load(std::memory_order_relaxed) / 1000);
+    }
+}
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
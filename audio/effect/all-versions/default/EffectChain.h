@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTCHAIN_H
+#define ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTCHAIN_H
+
+#include "AudioBufferManager.h"
+#include "Effect.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <fmq/EventFlag.h>
+#include <fmq/MessageQueue.h>
+#include <utils/RefBase.h>
+#include <utils/Thread.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+
+// Runs an ordered list of effects (e.g. AEC, NS and AGC on a capture stream) on a single
+// real-time thread. The first effect reads the input buffer and writes the output buffer,
+// the following effects process the output buffer in place. The client uses the status
+// queue and event flag exactly as for a single effect, so each audio period costs one
+// request/done handshake for the whole chain instead of one per effect.
+//
+// Chains are created and closed through EffectsFactory. The chain keeps its effects open
+// until it is closed: they can not be prepared for processing on their own, nor closed.
+class EffectChain : public RefBase {
+   public:
+    using StatusMQ = Effect::StatusMQ;
+    using PrepareForProcessingCallback =
+            std::function<void(Result retval, const StatusMQ::Descriptor& statusMQ)>;
+
+    // Fails with INVALID_ARGUMENTS if an id is unknown or repeated, and with INVALID_STATE if
+    // an effect is closed, prepared for processing on its own or part of another chain.
+    static Result create(const std::vector<uint64_t>& effectIds, sp<EffectChain>* chain);
+
+    void prepareForProcessing(PrepareForProcessingCallback cb);
+    Result setProcessBuffers(const AudioBuffer& inBuffer, const AudioBuffer& outBuffer);
+    // Stops the processing thread and lets the effects go.
+    Result close();
+
+    // Dumps per-effect processing time and deadline misses.
+    void debug(int fd);
+
+   private:
+    class ProcessThread;
+
+    // Processing statistics of one effect of the chain, updated by the processing thread.
+    struct EffectStats {
+        std::atomic<uint64_t> processCount{0};
+        std::atomic<uint64_t> errorCount{0};
+        std::atomic<uint64_t> totalNs{0};
+        std::atomic<uint64_t> maxNs{0};
+    };
+
+    // Processing statistics of the whole chain, updated by the processing thread.
+    struct ChainStats {
+        std::atomic<uint64_t> periodCount{0};
+        std::atomic<uint64_t> deadlineMissCount{0};
+        std::atomic<uint64_t> totalNs{0};
+        std::atomic<uint64_t> maxNs{0};
+        // Duration of one audio period, derived from the buffer size and sampling rate.
+        std::atomic<uint64_t> deadlineNs{0};
+    };
+
+    struct Entry {
+        uint64_t effectId;
+        sp<Effect> effect;  // cleared by close()
+        effect_handle_t handle;
+        std::unique_ptr<EffectStats> stats;
+    };
+
+    EffectChain();
+    virtual ~EffectChain();
+
+    uint32_t getSamplingRate();
+    // Called on the processing thread for each period.
+    Result processAll(bool reverse);
+
+    // Fixed by create(), the effects in it are cleared by close().
+    std::vector<Entry> mEffects;
+    sp<AudioBufferWrapper> mInBuffer;
+    sp<AudioBufferWrapper> mOutBuffer;
+    std::atomic<audio_buffer_t*> mHalInBufferPtr;
+    std::atomic<audio_buffer_t*> mHalOutBufferPtr;
+    std::unique_ptr<StatusMQ> mStatusMQ;
+    EventFlag* mEfGroup;
+    std::atomic<bool> mStopProcessThread;
+    sp<Thread> mProcessThread;
+    ChainStats mStats;
+};
+
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
+
+#endif  // ANDROID_HARDWARE_AUDIO_EFFECT_EFFECTCHAIN_H
@@ -32,6 +32,8 @@
 #include "VisualizerEffect.h"
 #include "common/all-versions/default/EffectMap.h"
 
+#include <algorithm>
+
 #include <android/log.h>
 #include <media/EffectsFactoryApi.h>
 #include <system/audio_effects/effect_aec.h>
@@ -214,10 +216,43 @@ Return<void> EffectsFactory::debug(const hidl_handle& fd,
                                    const hidl_vec<hidl_string>& /* options */) {
     if (fd.getNativeHandle() != nullptr && fd->numFds == 1) {
         EffectDumpEffects(fd->data[0]);
+        std::vector<sp<EffectChain>> chains;
+        {
+            std::lock_guard<std::mutex> lock(mChainsLock);
+            chains = mChains;
+        }
+        for (const auto& chain : chains) {
+            chain->debug(fd->data[0]);
+        }
     }
     return Void();
 }
 
+Result EffectsFactory::createEffectChain(const std::vector<uint64_t>& effectIds,
+                                         sp<EffectChain>* chain) {
+    sp<EffectChain> tempChain;
+    Result retval = EffectChain::create(effectIds, &tempChain);
+    if (retval != Result::OK) {
+        return retval;
+    }
+    std::lock_guard<std::mutex> lock(mChainsLock);
+    mChains.push_back(tempChain);
+    *chain = tempChain;
+    return Result::OK;
+}
+
+Result EffectsFactory::closeEffectChain(const sp<EffectChain>& chain) {
+    {
+        std::lock_guard<std::mutex> lock(mChainsLock);
+        auto it = std::find(mChains.begin(), mChains.end(), chain);
+        if (it == mChains.end()) {
+            return Result::INVALID_ARGUMENTS;
+        }
+        mChains.erase(it);
+    }
+    return chain->close();
+}
+
 IEffectsFactory* HIDL_FETCH_IEffectsFactory(const char* name) {
     return strcmp(name, "default") == 0 ? new EffectsFactory() : nullptr;
 }
@@ -29,6 +29,12 @@
 #include <hidl/Status.h>
 
 #include <hidl/MQDescriptor.h>
+
+#include <mutex>
+#include <vector>
+
+#include "EffectChain.h"
+
 namespace android {
 namespace hardware {
 namespace audio {
@@ -60,11 +66,20 @@ struct EffectsFactory : public IEffectsFactory {
         const hidl_handle& fd);  //< in CPP_VERSION::IEffectsFactory only, alias of debug
     Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& options) override;
 
+    // In-process only, IEffectsFactory has no method for chains. Creates a chain that
+    // processes the effects of |effectIds|, in this order, on one thread. The factory keeps
+    // the chain, and dumps its statistics in debug(), until it is closed.
+    Result createEffectChain(const std::vector<uint64_t>& effectIds, sp<EffectChain>* chain);
+    Result closeEffectChain(const sp<EffectChain>& chain);
+
    private:
     static sp<IEffect> dispatchEffectInstanceCreation(const effect_descriptor_t& halDescriptor,
                                                       effect_handle_t handle);
     Return<void> createEffectImpl(const Uuid& uuid, int32_t session, int32_t ioHandle,
                                   int32_t device, createEffect_cb _hidl_cb);
+
+    std::mutex mChainsLock;
+    std::vector<sp<EffectChain>> mChains;  // guarded by mChainsLock
 };
 
 extern "C" IEffectsFactory* HIDL_FETCH_IEffectsFactory(const char* name);
@@ -46,15 +46,17 @@ void EqualizerEffect::propertiesFromHal(const t_equalizer_settings& halPropertie
                                          halProperties.numBands);
 }
 
-std::vector<uint8_t> EqualizerEffect::propertiesToHal(
-    const IEqualizerEffect::AllProperties& properties, t_equalizer_settings** halProperties) {
-    size_t bandsSize = properties.bandLevels.size() * sizeof(uint16_t);
-    std::vector<uint8_t> halBuffer(sizeof(t_equalizer_settings) + bandsSize, 0);
-    *halProperties = reinterpret_cast<t_equalizer_settings*>(&halBuffer[0]);
-    (*halProperties)->curPreset = properties.curPreset;
-    (*halProperties)->numBands = properties.bandLevels.size();
-    memcpy((*halProperties)->bandLevels, &properties.bandLevels[0], bandsSize);
-    return halBuffer;
+// static
+size_t EqualizerEffect::halPropertiesSize(const IEqualizerEffect::AllProperties& properties) {
+    return sizeof(t_equalizer_settings) + properties.bandLevels.size() * sizeof(uint16_t);
+}
+
+void EqualizerEffect::propertiesToHal(const IEqualizerEffect::AllProperties& properties,
+                                      t_equalizer_settings* halProperties) {
+    halProperties->curPreset = properties.curPreset;
+    halProperties->numBands = properties.bandLevels.size();
+    memcpy(halProperties->bandLevels, &properties.bandLevels[0],
+           properties.bandLevels.size() * sizeof(uint16_t));
 }
 
 // Methods from ::android::hardware::audio::effect::CPP_VERSION::IEffect follow.
@@ -264,10 +266,11 @@ Return<void> EqualizerEffect::getCurrentPreset(getCurrentPreset_cb _hidl_cb) {
 
 Return<Result> EqualizerEffect::setAllProperties(
     const IEqualizerEffect::AllProperties& properties) {
-    t_equalizer_settings* halPropertiesPtr = nullptr;
-    std::vector<uint8_t> halBuffer = propertiesToHal(properties, &halPropertiesPtr);
     uint32_t paramId = EQ_PARAM_PROPERTIES;
-    return mEffect->setParameterImpl(sizeof(paramId), &paramId, halBuffer.size(), halPropertiesPtr);
+    return mEffect->setParameterInPlace(
+        sizeof(paramId), &paramId, halPropertiesSize(properties), [&](void* valueData) {
+            propertiesToHal(properties, static_cast<t_equalizer_settings*>(valueData));
+        });
 }
 
 Return<void> EqualizerEffect::getAllProperties(getAllProperties_cb _hidl_cb) {
@@ -115,8 +115,9 @@ struct EqualizerEffect : public IEqualizerEffect {
 
     void propertiesFromHal(const t_equalizer_settings& halProperties,
                            IEqualizerEffect::AllProperties* properties);
-    std::vector<uint8_t> propertiesToHal(const IEqualizerEffect::AllProperties& properties,
-                                         t_equalizer_settings** halProperties);
+    static size_t halPropertiesSize(const IEqualizerEffect::AllProperties& properties);
+    void propertiesToHal(const IEqualizerEffect::AllProperties& properties,
+                         t_equalizer_settings* halProperties);
 };
 
 }  // namespace implementation
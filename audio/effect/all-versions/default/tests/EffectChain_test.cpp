@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../Effect.h"
+#include "../EffectChain.h"
+#include "../EffectsFactory.h"
+#include "common/all-versions/default/EffectMap.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <cutils/ashmem.h>
+#include <gtest/gtest.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+namespace {
+
+constexpr uint32_t kFrameCount = 4;
+constexpr uint32_t kSamplingRate = 48000;
+constexpr int64_t kTimeoutNs = 5000000000;
+
+// A legacy HAL effect that applies |op| to each sample of a mono 16-bit buffer, or fails
+// with |status| without writing anything.
+struct FakeEffect {
+    const struct effect_interface_s* itfe;
+    std::function<int16_t(int16_t)> op;
+    int32_t status = 0;
+    std::atomic<int> calls{0};
+
+    effect_handle_t handle() { return reinterpret_cast<effect_handle_t>(this); }
+};
+
+int32_t fakeProcess(effect_handle_t self, audio_buffer_t* in, audio_buffer_t* out) {
+    FakeEffect* effect = reinterpret_cast<FakeEffect*>(self);
+    effect->calls++;
+    if (effect->status != 0) {
+        return effect->status;
+    }
+    for (size_t i = 0; i < in->frameCount; ++i) {
+        out->s16[i] = effect->op(in->s16[i]);
+    }
+    return 0;
+}
+
+int32_t fakeCommand(effect_handle_t, uint32_t cmdCode, uint32_t, void*, uint32_t* replySize,
+                    void* pReplyData) {
+    if (cmdCode != EFFECT_CMD_GET_CONFIG || *replySize != sizeof(effect_config_t)) {
+        return -EINVAL;
+    }
+    effect_config_t* config = static_cast<effect_config_t*>(pReplyData);
+    *config = {};
+    config->inputCfg.samplingRate = kSamplingRate;
+    config->outputCfg.samplingRate = kSamplingRate;
+    return 0;
+}
+
+int32_t fakeGetDescriptor(effect_handle_t, effect_descriptor_t* descriptor) {
+    *descriptor = {};
+    return 0;
+}
+
+const struct effect_interface_s kFakeInterface = {fakeProcess, fakeCommand, fakeGetDescriptor,
+                                                  nullptr};
+
+// An audio buffer in shared memory, mapped for the test as well.
+struct SharedBuffer {
+    AudioBuffer buffer;
+    int16_t* samples = nullptr;
+
+    bool init(uint64_t id) {
+        const size_t size = kFrameCount * sizeof(int16_t);
+        int fd = ashmem_create_region("EffectChainTest", size);
+        if (fd < 0) return false;
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        samples = static_cast<int16_t*>(data);
+        native_handle_t* handle = native_handle_create(1, 0);
+        handle->data[0] = fd;
+        hidl_handle hidlHandle;
+        hidlHandle.setTo(handle, true /* shouldOwn */);
+        buffer.id = id;
+        buffer.frameCount = kFrameCount;
+        buffer.data = hidl_memory("ashmem", std::move(hidlHandle), size);
+        return true;
+    }
+
+    ~SharedBuffer() {
+        if (samples != nullptr) munmap(samples, kFrameCount * sizeof(int16_t));
+    }
+};
+
+class EffectChainTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mFactory = new EffectsFactory();
+        ASSERT_TRUE(mIn.init(1001));
+        ASSERT_TRUE(mOut.init(1002));
+    }
+
+    void TearDown() override {
+        if (mEfGroup != nullptr) EventFlag::deleteEventFlag(&mEfGroup);
+        if (mChain != nullptr) mFactory->closeEffectChain(mChain);
+    }
+
+    uint64_t addEffect(std::function<int16_t(int16_t)> op, int32_t status = 0) {
+        mFakes.emplace_back(new FakeEffect());
+        FakeEffect* fake = mFakes.back().get();
+        fake->itfe = &kFakeInterface;
+        fake->op = op;
+        fake->status = status;
+        mEffects.push_back(new Effect(fake->handle()));
+        return EffectMap::getInstance().add(fake->handle());
+    }
+
+    // Creates the chain and gets it ready for process().
+    void startChain(const std::vector<uint64_t>& effectIds) {
+        ASSERT_EQ(Result::OK, mFactory->createEffectChain(effectIds, &mChain));
+        Result retval = Result::NOT_INITIALIZED;
+        EffectChain::StatusMQ::Descriptor descriptor;
+        mChain->prepareForProcessing([&](Result r, const EffectChain::StatusMQ::Descriptor& d) {
+            retval = r;
+            descriptor = d;
+        });
+        ASSERT_EQ(Result::OK, retval);
+        mStatusMQ.reset(new EffectChain::StatusMQ(descriptor));
+        ASSERT_TRUE(mStatusMQ->isValid());
+        ASSERT_EQ(OK, EventFlag::createEventFlag(mStatusMQ->getEventFlagWord(), &mEfGroup));
+        ASSERT_EQ(Result::OK, mChain->setProcessBuffers(mIn.buffer, mOut.buffer));
+    }
+
+    // One request/done handshake, the way a stream processes one period.
+    Result process(const std::vector<int16_t>& input) {
+        std::copy(input.begin(), input.end(), mIn.samples);
+        std::fill(mOut.samples, mOut.samples + kFrameCount, 0);
+        mEfGroup->wake(static_cast<uint32_t>(MessageQueueFlagBits::REQUEST_PROCESS));
+        uint32_t efState = 0;
+        mEfGroup->wait(static_cast<uint32_t>(MessageQueueFlagBits::DONE_PROCESSING), &efState,
+                       kTimeoutNs);
+        Result retval = Result::NOT_INITIALIZED;
+        EXPECT_TRUE(mStatusMQ->read(&retval));
+        EXPECT_EQ(0u, mStatusMQ->availableToRead());
+        return retval;
+    }
+
+    std::vector<int16_t> output() const {
+        return std::vector<int16_t>(mOut.samples, mOut.samples + kFrameCount);
+    }
+
+    sp<EffectsFactory> mFactory;
+    SharedBuffer mIn;
+    SharedBuffer mOut;
+    std::vector<std::unique_ptr<FakeEffect>> mFakes;
+    std::vector<sp<Effect>> mEffects;
+    sp<EffectChain> mChain;
+    std::unique_ptr<EffectChain::StatusMQ> mStatusMQ;
+    EventFlag* mEfGroup = nullptr;
+};
+
+TEST_F(EffectChainTest, ProcessesTheEffectsInOrderWithOneHandshake) {
+    startChain({addEffect([](int16_t s) { return s * 2; }),
+                addEffect([](int16_t s) { return s + 1; }),
+                addEffect([](int16_t s) { return s * 3; })});
+
+    ASSERT_EQ(Result::OK, process({1, 2, 3, 4}));
+    EXPECT_EQ(std::vector<int16_t>({9, 15, 21, 27}), output());
+    for (const auto& fake : mFakes) {
+        EXPECT_EQ(1, fake->calls);
+    }
+}
+
+TEST_F(EffectChainTest, SkipsDisabledEffects) {
+    startChain({addEffect([](int16_t s) { return s * 2; }),
+                addEffect([](int16_t s) { return s + 100; }, -ENODATA),
+                addEffect([](int16_t s) { return s + 1; })});
+
+    ASSERT_EQ(Result::OK, process({1, 2, 3, 4}));
+    EXPECT_EQ(std::vector<int16_t>({3, 5, 7, 9}), output());
+}
+
+TEST_F(EffectChainTest, ReportsTheFirstErrorAndRunsTheOtherEffects) {
+    startChain({addEffect([](int16_t s) { return s; }, -EINVAL),
+                addEffect([](int16_t s) { return s + 1; }),
+                addEffect([](int16_t s) { return s; }, -EIO)});
+
+    EXPECT_EQ(Result::INVALID_ARGUMENTS, process({1, 2, 3, 4}));
+    // The second effect read the input, as the first one did not produce anything.
+    EXPECT_EQ(std::vector<int16_t>({2, 3, 4, 5}), output());
+    EXPECT_EQ(1, mFakes[2]->calls);
+}
+
+TEST_F(EffectChainTest, ReportsAChainOfDisabledEffectsAsSuch) {
+    startChain({addEffect([](int16_t s) { return s; }, -ENODATA)});
+    EXPECT_EQ(Result::INVALID_STATE, process({1, 2, 3, 4}));
+}
+
+TEST_F(EffectChainTest, KeepsItsEffectsUntilClosed) {
+    uint64_t id = addEffect([](int16_t s) { return s; });
+    startChain({id});
+    const sp<Effect>& effect = mEffects[0];
+
+    Result retval = Result::OK;
+    effect->prepareForProcessing(
+            [&](Result r, const EffectChain::StatusMQ::Descriptor&) { retval = r; });
+    EXPECT_EQ(Result::INVALID_STATE, retval);
+    EXPECT_EQ(Result::INVALID_STATE, effect->close());
+    sp<EffectChain> other;
+    EXPECT_EQ(Result::INVALID_STATE, mFactory->createEffectChain({id}, &other));
+
+    ASSERT_EQ(Result::OK, mFactory->closeEffectChain(mChain));
+    EXPECT_EQ(Result::INVALID_ARGUMENTS, mFactory->closeEffectChain(mChain));
+    mChain.clear();
+    EXPECT_EQ(Result::OK, effect->close());
+}
+
+TEST_F(EffectChainTest, RejectsUnknownAndRepeatedEffects) {
+    uint64_t id = addEffect([](int16_t s) { return s; });
+    sp<EffectChain> chain;
+    EXPECT_EQ(Result::INVALID_ARGUMENTS, mFactory->createEffectChain({}, &chain));
+    EXPECT_EQ(Result::INVALID_ARGUMENTS, mFactory->createEffectChain({id, id}, &chain));
+    EXPECT_EQ(Result::INVALID_ARGUMENTS,
+              mFactory->createEffectChain({id, EffectMap::INVALID_ID}, &chain));
+    EXPECT_EQ(nullptr, chain);
+
+    // The failed attempts let the effect go.
+    ASSERT_EQ(Result::OK, mFactory->createEffectChain({id}, &chain));
+    EXPECT_EQ(Result::OK, mFactory->closeEffectChain(chain));
+}
+
+TEST_F(EffectChainTest, EffectThatIsProcessedOnItsOwnCanNotBeChained) {
+    uint64_t id = addEffect([](int16_t s) { return s; });
+    Result retval = Result::NOT_INITIALIZED;
+    mEffects[0]->prepareForProcessing(
+            [&](Result r, const EffectChain::StatusMQ::Descriptor&) { retval = r; });
+    ASSERT_EQ(Result::OK, retval);
+    sp<EffectChain> chain;
+    EXPECT_EQ(Result::INVALID_STATE, mFactory->createEffectChain({id}, &chain));
+}
+
+TEST_F(EffectChainTest, FactoryDumpsTheChainStatistics) {
+    uint64_t first = addEffect([](int16_t s) { return s; });
+    uint64_t second = addEffect([](int16_t s) { return s; }, -EINVAL);
+    startChain({first, second});
+    process({1, 2, 3, 4});
+    process({1, 2, 3, 4});
+
+    TemporaryFile dump;
+    native_handle_t* handle = native_handle_create(1, 0);
+    handle->data[0] = dump.fd;
+    mFactory->debug(hidl_handle(handle), {});
+    native_handle_delete(handle);
+    std::string text;
+    ASSERT_TRUE(android::base::ReadFileToString(dump.path, &text));
+
+    // A period of 4 frames at 48 kHz lasts 83 us.
+    EXPECT_NE(std::string::npos, text.find("Effect chain of 2 effects: 2 periods"));
+    EXPECT_NE(std::string::npos, text.find("(deadline 83 us)"));
+    EXPECT_NE(std::string::npos,
+              text.find("effect " + std::to_string(first) + ": 2 calls, 0 errors"));
+    EXPECT_NE(std::string::npos,
+              text.find("effect " + std::to_string(second) + ": 2 calls, 2 errors"));
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
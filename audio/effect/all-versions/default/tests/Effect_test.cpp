@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../Effect.h"
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace hardware {
+namespace audio {
+namespace effect {
+namespace CPP_VERSION {
+namespace implementation {
+namespace {
+
+constexpr uint32_t kFailingParam = 99;
+
+// A legacy HAL effect with 32-bit parameters holding 32-bit values.
+struct FakeEffect {
+    const struct effect_interface_s* itfe;
+    std::map<uint32_t, int32_t> values;
+    std::vector<std::pair<uint32_t, int32_t>> setCalls;
+    std::vector<void*> replyBuffers;
+
+    effect_handle_t handle() { return reinterpret_cast<effect_handle_t>(this); }
+};
+
+int32_t fakeProcess(effect_handle_t, audio_buffer_t*, audio_buffer_t*) {
+    return -ENODATA;
+}
+
+int32_t fakeCommand(effect_handle_t self, uint32_t cmdCode, uint32_t, void* pCmdData,
+                    uint32_t* replySize, void* pReplyData) {
+    FakeEffect* effect = reinterpret_cast<FakeEffect*>(self);
+    if (replySize != nullptr && *replySize > 0) {
+        effect->replyBuffers.push_back(pReplyData);
+    }
+    const effect_param_t* cmdParam = static_cast<const effect_param_t*>(pCmdData);
+    uint32_t paramId;
+    switch (cmdCode) {
+        case EFFECT_CMD_SET_PARAM: {
+            memcpy(&paramId, cmdParam->data, sizeof(paramId));
+            int32_t value;
+            memcpy(&value, cmdParam->data + sizeof(paramId), sizeof(value));
+            effect->setCalls.emplace_back(paramId, value);
+            int32_t status = paramId == kFailingParam ? -EINVAL : 0;
+            if (status == 0) effect->values[paramId] = value;
+            *static_cast<int32_t*>(pReplyData) = status;
+            *replySize = sizeof(int32_t);
+            return 0;
+        }
+        case EFFECT_CMD_GET_PARAM: {
+            memcpy(&paramId, cmdParam->data, sizeof(paramId));
+            effect_param_t* reply = static_cast<effect_param_t*>(pReplyData);
+            reply->status = 0;
+            reply->psize = sizeof(paramId);
+            reply->vsize = sizeof(int32_t);
+            memcpy(reply->data, &paramId, sizeof(paramId));
+            memcpy(reply->data + sizeof(paramId), &effect->values[paramId], sizeof(int32_t));
+            *replySize = sizeof(effect_param_t) + sizeof(paramId) + sizeof(int32_t);
+            return 0;
+        }
+        default:
+            // Other commands succeed without a reply.
+            if (replySize != nullptr) *replySize = 0;
+            return 0;
+    }
+}
+
+int32_t fakeGetDescriptor(effect_handle_t, effect_descriptor_t* descriptor) {
+    *descriptor = {};
+    return 0;
+}
+
+const struct effect_interface_s kFakeInterface = {fakeProcess, fakeCommand, fakeGetDescriptor,
+                                                  nullptr};
+
+class EffectTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mFake.itfe = &kFakeInterface;
+        mEffect = new Effect(mFake.handle());
+    }
+
+    FakeEffect mFake;
+    sp<Effect> mEffect;
+};
+
+TEST_F(EffectTest, SetParametersAppliesTheBatchInOrder) {
+    const uint32_t ids[] = {1, 2, 3};
+    const int32_t values[] = {10, 20, 30};
+    const Effect::ParameterUpdate updates[] = {
+            {sizeof(uint32_t), &ids[0], sizeof(int32_t), &values[0]},
+            {sizeof(uint32_t), &ids[1], sizeof(int32_t), &values[1]},
+            {sizeof(uint32_t), &ids[2], sizeof(int32_t), &values[2]},
+    };
+    ASSERT_EQ(Result::OK, mEffect->setParameters(updates, 3));
+    EXPECT_EQ((std::vector<std::pair<uint32_t, int32_t>>{{1, 10}, {2, 20}, {3, 30}}),
+              mFake.setCalls);
+
+    int32_t value = 0;
+    ASSERT_EQ(Result::OK, mEffect->getParam(2, value));
+    EXPECT_EQ(20, value);
+}
+
+TEST_F(EffectTest, SetParametersStopsAtTheFirstFailure) {
+    const uint32_t ids[] = {1, kFailingParam, 3};
+    const int32_t value = 5;
+    const Effect::ParameterUpdate updates[] = {
+            {sizeof(uint32_t), &ids[0], sizeof(int32_t), &value},
+            {sizeof(uint32_t), &ids[1], sizeof(int32_t), &value},
+            {sizeof(uint32_t), &ids[2], sizeof(int32_t), &value},
+    };
+    EXPECT_EQ(Result::INVALID_ARGUMENTS, mEffect->setParameters(updates, 3));
+    EXPECT_EQ((std::vector<std::pair<uint32_t, int32_t>>{{1, 5}, {kFailingParam, 5}}),
+              mFake.setCalls);
+}
+
+TEST_F(EffectTest, GetParameterReusesTheReplyBuffer) {
+    int32_t value;
+    ASSERT_EQ(Result::OK, mEffect->getParam(1, value));
+    ASSERT_EQ(Result::OK, mEffect->getParam(2, value));
+    ASSERT_EQ(2u, mFake.replyBuffers.size());
+    EXPECT_EQ(mFake.replyBuffers[0], mFake.replyBuffers[1]);
+}
+
+TEST_F(EffectTest, CallbackCanCallBackIntoTheEffect) {
+    ASSERT_EQ(Result::OK, mEffect->setParam(1, int32_t(10)));
+    ASSERT_EQ(Result::OK, mEffect->setParam(2, int32_t(20)));
+    mFake.replyBuffers.clear();
+
+    int32_t outer = 0;
+    int32_t inner = 0;
+    uint32_t paramId = 1;
+    Result retval = mEffect->getParameterImpl(
+            sizeof(paramId), &paramId, sizeof(int32_t), [&](uint32_t, const void* valueData) {
+                // Would deadlock if the callback ran with the command lock held.
+                EXPECT_EQ(Result::OK, mEffect->getParam(2, inner));
+                memcpy(&outer, valueData, sizeof(outer));
+            });
+    ASSERT_EQ(Result::OK, retval);
+    EXPECT_EQ(10, outer);
+    EXPECT_EQ(20, inner);
+    // The nested call did not overwrite the reply the callback was reading.
+    ASSERT_EQ(2u, mFake.replyBuffers.size());
+    EXPECT_NE(mFake.replyBuffers[0], mFake.replyBuffers[1]);
+}
+
+TEST_F(EffectTest, LargeReplyDoesNotReplaceTheReplyBuffer) {
+    int32_t value;
+    ASSERT_EQ(Result::OK, mEffect->getParam(1, value));
+    mEffect->command(EFFECT_CMD_FIRST_PROPRIETARY, {}, 64 * 1024,
+                     [](int32_t, const hidl_vec<uint8_t>&) {});
+    ASSERT_EQ(Result::OK, mEffect->getParam(1, value));
+    ASSERT_EQ(3u, mFake.replyBuffers.size());
+    EXPECT_NE(mFake.replyBuffers[0], mFake.replyBuffers[1]);
+    EXPECT_EQ(mFake.replyBuffers[0], mFake.replyBuffers[2]);
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace CPP_VERSION
+}  // namespace effect
+}  // namespace audio
+}  // namespace hardware
+}  // namespace android
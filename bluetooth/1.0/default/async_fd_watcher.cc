@@ -26,14 +26,19 @@
 #include <mutex>
 #include <thread>
 #include <vector>
-#include "fcntl.h"
-#include "sys/select.h"
+#include "sys/epoll.h"
+#include "sys/eventfd.h"
+#include "sys/timerfd.h"
 #include "unistd.h"
 
 static const int INVALID_FD = -1;
 
 static const int BT_RT_PRIORITY = 1;
 
+// The transports watch one or two file descriptors, plus the notification and
+// timer file descriptors of the watcher itself.
+static const int MAX_EVENTS_PER_WAKEUP = 8;
+
 namespace android {
 namespace hardware {
 namespace bluetooth {
@@ -41,14 +46,24 @@ namespace async {
 
 int AsyncFdWatcher::WatchFdForNonBlockingReads(
     int file_descriptor, const ReadCallback& on_read_fd_ready_callback) {
+  // Start the thread if not started yet
+  if (tryStartThread()) return -1;
+
   // Add file descriptor and callback
-  {
-    std::unique_lock<std::mutex> guard(internal_mutex_);
-    watched_fds_[file_descriptor] = on_read_fd_ready_callback;
+  std::unique_lock<std::mutex> guard(internal_mutex_);
+  watched_fds_[file_descriptor] = on_read_fd_ready_callback;
+
+  struct epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = file_descriptor;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, file_descriptor, &event) &&
+      errno != EEXIST) {
+    ALOGE("%s unable to watch fd %d: %s", __func__, file_descriptor,
+          strerror(errno));
+    watched_fds_.erase(file_descriptor);
+    return -1;
   }
-
-  // Start the thread if not started yet
-  return tryStartThread();
+  return 0;
 }
 
 int AsyncFdWatcher::ConfigureTimeout(
@@ -61,6 +76,7 @@ int AsyncFdWatcher::ConfigureTimeout(
     timeout_ms_ = timeout;
   }
 
+  // The thread restarts the timer when it is notified.
   notifyThread();
   return 0;
 }
@@ -69,20 +85,41 @@ void AsyncFdWatcher::StopWatchingFileDescriptors() { stopThread(); }
 
 AsyncFdWatcher::~AsyncFdWatcher() {}
 
-// Make sure to call this with at least one file descriptor ready to be
-// watched upon or the thread routine will return immediately
 int AsyncFdWatcher::tryStartThread() {
   if (std::atomic_exchange(&running_, true)) return 0;
 
-  // Set up the communication channel
-  int pipe_fds[2];
-  if (pipe2(pipe_fds, O_NONBLOCK)) return -1;
+  // Undoes the partial setup, so that the next call starts over.
+  auto fail = [this]() {
+    closeFds();
+    running_ = false;
+    return -1;
+  };
+
+  // Set up the epoll instance with the notification and timer fds
+  epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+  notification_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  timer_fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (epoll_fd_ == INVALID_FD || notification_fd_ == INVALID_FD ||
+      timer_fd_ == INVALID_FD) {
+    ALOGE("%s unable to create fds: %s", __func__, strerror(errno));
+    return fail();
+  }
 
-  notification_listen_fd_ = pipe_fds[0];
-  notification_write_fd_ = pipe_fds[1];
+  for (int fd : {notification_fd_, timer_fd_}) {
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event)) {
+      ALOGE("%s unable to watch fd %d: %s", __func__, fd, strerror(errno));
+      return fail();
+    }
+  }
 
   thread_ = std::thread([this]() { ThreadRoutine(); });
-  if (!thread_.joinable()) return -1;
+  if (!thread_.joinable()) {
+    ALOGE("%s unable to start the thread", __func__);
+    return fail();
+  }
 
   return 0;
 }
@@ -91,7 +128,7 @@ int AsyncFdWatcher::stopThread() {
   if (!std::atomic_exchange(&running_, false)) return 0;
 
   notifyThread();
-  if (std::this_thread::get_id() != thread_.get_id()) {
+  if (std::this_thread::get_id() != thread_.get_id() && thread_.joinable()) {
     thread_.join();
   }
 
@@ -105,20 +142,76 @@ int AsyncFdWatcher::stopThread() {
     timeout_cb_ = nullptr;
   }
 
-  close(notification_listen_fd_);
-  close(notification_write_fd_);
-
+  closeFds();
   return 0;
 }
 
+void AsyncFdWatcher::closeFds() {
+  // Closing the epoll fd also drops the watched fds from it.
+  for (int* fd : {&epoll_fd_, &notification_fd_, &timer_fd_}) {
+    if (*fd != INVALID_FD) close(*fd);
+    *fd = INVALID_FD;
+  }
+}
+
 int AsyncFdWatcher::notifyThread() {
-  uint8_t buffer[] = {0};
-  if (TEMP_FAILURE_RETRY(write(notification_write_fd_, &buffer, 1)) < 0) {
+  if (notification_fd_ == INVALID_FD) return -1;
+  uint64_t value = 1;
+  if (TEMP_FAILURE_RETRY(write(notification_fd_, &value, sizeof(value))) < 0) {
     return -1;
   }
   return 0;
 }
 
+void AsyncFdWatcher::ArmTimer(std::chrono::nanoseconds duration) {
+  // A zero duration disarms the timer.
+  struct itimerspec spec = {};
+  spec.it_value.tv_sec =
+      std::chrono::duration_cast<std::chrono::seconds>(duration).count();
+  spec.it_value.tv_nsec = (duration % std::chrono::seconds(1)).count();
+  if (timerfd_settime(timer_fd_, 0, &spec, nullptr)) {
+    ALOGE("%s unable to set the timer: %s", __func__, strerror(errno));
+  }
+}
+
+void AsyncFdWatcher::RestartTimeout() {
+  std::chrono::milliseconds timeout;
+  {
+    std::unique_lock<std::mutex> guard(timeout_mutex_);
+    timeout = std::max(timeout_ms_, std::chrono::milliseconds(0));
+  }
+  last_activity_ = std::chrono::steady_clock::now();
+  ArmTimer(timeout);
+}
+
+void AsyncFdWatcher::OnTimerExpired() {
+  uint64_t expirations;
+  TEMP_FAILURE_RETRY(read(timer_fd_, &expirations, sizeof(expirations)));
+
+  // Allow the timeout callback to modify the timeout.
+  TimeoutCallback saved_cb;
+  std::chrono::milliseconds timeout;
+  {
+    std::unique_lock<std::mutex> guard(timeout_mutex_);
+    timeout = timeout_ms_;
+    if (timeout > std::chrono::milliseconds(0)) saved_cb = timeout_cb_;
+  }
+  // Disabled since the timer was armed; the pending notification handles it.
+  if (timeout <= std::chrono::milliseconds(0)) return;
+
+  // Push the timer back if the watcher has not been idle long enough.
+  auto now = std::chrono::steady_clock::now();
+  auto idle = now - last_activity_;
+  if (idle < timeout) {
+    ArmTimer(timeout - idle);
+    return;
+  }
+
+  last_activity_ = now;
+  ArmTimer(timeout);
+  if (saved_cb != nullptr) saved_cb();
+}
+
 void AsyncFdWatcher::ThreadRoutine() {
   // Make watching thread RT.
   struct sched_param rt_params;
@@ -128,58 +221,59 @@ void AsyncFdWatcher::ThreadRoutine() {
           getpid(), gettid(), strerror(errno));
   }
 
+  // Pick up a timeout configured before the thread was started.
+  RestartTimeout();
+
+  struct epoll_event events[MAX_EVENTS_PER_WAKEUP];
   while (running_) {
-    fd_set read_fds;
-    FD_ZERO(&read_fds);
-    FD_SET(notification_listen_fd_, &read_fds);
-    int max_read_fd = INVALID_FD;
-    for (auto& it : watched_fds_) {
-      FD_SET(it.first, &read_fds);
-      max_read_fd = std::max(max_read_fd, it.first);
+    // Wait until there is data available to read on some FD.
+    int num_events = TEMP_FAILURE_RETRY(
+        epoll_wait(epoll_fd_, events, MAX_EVENTS_PER_WAKEUP, -1));
+
+    // There was some error.
+    if (num_events < 0) {
+      ALOGE("%s epoll_wait failed: %s", __func__, strerror(errno));
+      continue;
     }
 
-    struct timeval timeout;
-    struct timeval* timeout_ptr = NULL;
-    if (timeout_ms_ > std::chrono::milliseconds(0)) {
-      timeout.tv_sec = timeout_ms_.count() / 1000;
-      timeout.tv_usec = (timeout_ms_.count() % 1000) * 1000;
-      timeout_ptr = &timeout;
+    bool notified = false;
+    bool timer_expired = false;
+    int num_ready_fds = 0;
+    for (int i = 0; i < num_events; i++) {
+      int fd = events[i].data.fd;
+      if (fd == notification_fd_) {
+        uint64_t value;
+        TEMP_FAILURE_RETRY(read(notification_fd_, &value, sizeof(value)));
+        notified = true;
+      } else if (fd == timer_fd_) {
+        timer_expired = true;
+      } else {
+        events[num_ready_fds++] = events[i];
+      }
     }
 
-    // Wait until there is data available to read on some FD.
-    int nfds = std::max(notification_listen_fd_, max_read_fd);
-    int retval = select(nfds + 1, &read_fds, NULL, NULL, timeout_ptr);
+    if (!running_) break;
 
-    // There was some error.
-    if (retval < 0) continue;
-
-    // Timeout.
-    if (retval == 0) {
-      // Allow the timeout callback to modify the timeout.
-      TimeoutCallback saved_cb;
-      {
-        std::unique_lock<std::mutex> guard(timeout_mutex_);
-        if (timeout_ms_ > std::chrono::milliseconds(0)) saved_cb = timeout_cb_;
-      }
-      if (saved_cb != nullptr) saved_cb();
-      continue;
+    if (num_ready_fds > 0) {
+      last_activity_ = std::chrono::steady_clock::now();
     }
 
-    // Read data from the notification FD.
-    if (FD_ISSET(notification_listen_fd_, &read_fds)) {
-      char buffer[] = {0};
-      TEMP_FAILURE_RETRY(read(notification_listen_fd_, buffer, 1));
-      continue;
+    // The timeout was reconfigured, or the watcher is being stopped.
+    if (notified) {
+      RestartTimeout();
+    } else if (timer_expired) {
+      OnTimerExpired();
     }
 
-    // Invoke the data ready callbacks if appropriate.
+    if (num_ready_fds == 0) continue;
+
+    // Invoke the data ready callbacks.
     {
       // Hold the mutex to make sure that the callbacks are still valid.
       std::unique_lock<std::mutex> guard(internal_mutex_);
-      for (auto& it : watched_fds_) {
-        if (FD_ISSET(it.first, &read_fds)) {
-          it.second(it.first);
-        }
+      for (int i = 0; i < num_ready_fds; i++) {
+        auto it = watched_fds_.find(events[i].data.fd);
+        if (it != watched_fds_.end()) it->second(it->first);
       }
     }
   }
@@ -16,6 +16,9 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <map>
 #include <mutex>
 #include <thread>
@@ -28,6 +31,14 @@ namespace async {
 using ReadCallback = std::function<void(int)>;
 using TimeoutCallback = std::function<void(void)>;
 
+// Watches file descriptors with epoll on a single real-time thread. Watched
+// file descriptors are level-triggered, so a read callback may consume only
+// part of the available data and is called again for the rest. All the file
+// descriptors that became ready in one wakeup are handled as a batch.
+//
+// The timeout fires after the watcher has been idle, with no watched file
+// descriptor ready, for the configured duration, and then again every
+// duration until it is reconfigured. A zero timeout disables it.
 class AsyncFdWatcher {
  public:
   AsyncFdWatcher() = default;
@@ -45,8 +56,13 @@ class AsyncFdWatcher {
 
   int tryStartThread();
   int stopThread();
+  void closeFds();
   int notifyThread();
   void ThreadRoutine();
+  // Called on the watcher thread.
+  void RestartTimeout();
+  void OnTimerExpired();
+  void ArmTimer(std::chrono::nanoseconds duration);
 
   std::atomic_bool running_{false};
   std::thread thread_;
@@ -54,10 +70,14 @@ class AsyncFdWatcher {
   std::mutex timeout_mutex_;
 
   std::map<int, ReadCallback> watched_fds_;
-  int notification_listen_fd_;
-  int notification_write_fd_;
+  int epoll_fd_ = -1;
+  int notification_fd_ = -1;
+  int timer_fd_ = -1;
   TimeoutCallback timeout_cb_;
-  std::chrono::milliseconds timeout_ms_;
+  std::chrono::milliseconds timeout_ms_{0};
+  // Only accessed by the watcher thread. The timer is not re-armed on every
+  // wakeup; when it expires, it is pushed back if there was activity since.
+  std::chrono::steady_clock::time_point last_activity_;
 };
 
 }  // namespace async
@@ -53,7 +53,6 @@ class H4Protocol : public HciProtocol {
   PacketReadCallback sco_cb_;
   PacketReadCallback iso_cb_;
 
-  HciPacketType hci_packet_type_{HCI_PACKET_TYPE_UNKNOWN};
   hci::HciPacketizer hci_packetizer_;
 };
 
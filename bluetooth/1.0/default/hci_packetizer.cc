@@ -26,6 +26,9 @@
 
 namespace {
 
+// Large enough for a burst of LE ACL packets. Grown for bigger packets.
+const size_t kInitialBufferSize = 4096;
+
 const size_t preamble_size_for_type[] = {
     0, HCI_COMMAND_PREAMBLE_SIZE, HCI_ACL_PREAMBLE_SIZE, HCI_SCO_PREAMBLE_SIZE,
     HCI_EVENT_PREAMBLE_SIZE};
@@ -46,62 +49,80 @@ namespace hardware {
 namespace bluetooth {
 namespace hci {
 
+HciPacketizer::HciPacketizer(HciPacketReadyCallback packet_cb)
+    : buffer_(kInitialBufferSize), packet_ready_cb_(packet_cb) {}
+
 const hidl_vec<uint8_t>& HciPacketizer::GetPacket() const { return packet_; }
 
+HciPacketType HciPacketizer::GetPacketType() const { return packet_type_; }
+
 void HciPacketizer::OnDataReady(int fd, HciPacketType packet_type) {
-  switch (state_) {
-    case HCI_PREAMBLE: {
-      ssize_t bytes_read = TEMP_FAILURE_RETRY(
-          read(fd, preamble_ + bytes_read_,
-               preamble_size_for_type[packet_type] - bytes_read_));
-      if (bytes_read == 0) {
-        // This is only expected if the UART got closed when shutting down.
-        ALOGE("%s: Unexpected EOF reading the header!", __func__);
-        sleep(5);  // Expect to be shut down within 5 seconds.
-        return;
-      }
-      if (bytes_read < 0) {
-        LOG_ALWAYS_FATAL("%s: Read header error: %s", __func__,
-                         strerror(errno));
-      }
-      bytes_read_ += bytes_read;
-      if (bytes_read_ == preamble_size_for_type[packet_type]) {
-        size_t packet_length =
-            HciGetPacketLengthForType(packet_type, preamble_);
-        packet_.resize(preamble_size_for_type[packet_type] + packet_length);
-        memcpy(packet_.data(), preamble_, preamble_size_for_type[packet_type]);
-        bytes_remaining_ = packet_length;
-        state_ = HCI_PAYLOAD;
-        bytes_read_ = 0;
+  if (ReadAvailable(fd)) DispatchPackets(packet_type);
+}
+
+void HciPacketizer::OnH4DataReady(int fd) {
+  if (ReadAvailable(fd)) DispatchPackets(HCI_PACKET_TYPE_UNKNOWN);
+}
+
+bool HciPacketizer::ReadAvailable(int fd) {
+  ssize_t bytes_read = TEMP_FAILURE_RETRY(
+      read(fd, buffer_.data() + buffer_end_, buffer_.size() - buffer_end_));
+  if (bytes_read == 0) {
+    // This is only expected if the UART got closed when shutting down.
+    ALOGE("%s: Unexpected EOF reading from the UART!", __func__);
+    sleep(5);  // Expect to be shut down within 5 seconds.
+    return false;
+  }
+  if (bytes_read < 0) {
+    LOG_ALWAYS_FATAL("%s: Read error: %s", __func__, strerror(errno));
+  }
+  buffer_end_ += bytes_read;
+  return true;
+}
+
+void HciPacketizer::DispatchPackets(HciPacketType channel_type) {
+  const size_t type_size = channel_type == HCI_PACKET_TYPE_UNKNOWN ? 1 : 0;
+  // Size of the incomplete packet at the end of the buffer, if known.
+  size_t pending_size = 0;
+
+  while (buffer_end_ > buffer_start_) {
+    uint8_t* data = buffer_.data() + buffer_start_;
+    size_t available = buffer_end_ - buffer_start_;
+
+    HciPacketType type = channel_type;
+    if (type_size) {
+      type = static_cast<HciPacketType>(data[0]);
+      if (type != HCI_PACKET_TYPE_ACL_DATA &&
+          type != HCI_PACKET_TYPE_SCO_DATA && type != HCI_PACKET_TYPE_EVENT) {
+        LOG_ALWAYS_FATAL("%s: Unimplemented packet type %d", __func__,
+                         static_cast<int>(type));
       }
-      break;
     }
 
-    case HCI_PAYLOAD: {
-      ssize_t bytes_read = TEMP_FAILURE_RETRY(read(
-          fd,
-          packet_.data() + preamble_size_for_type[packet_type] + bytes_read_,
-          bytes_remaining_));
-      if (bytes_read == 0) {
-        // This is only expected if the UART got closed when shutting down.
-        ALOGE("%s: Unexpected EOF reading the payload!", __func__);
-        sleep(5);  // Expect to be shut down within 5 seconds.
-        return;
-      }
-      if (bytes_read < 0) {
-        LOG_ALWAYS_FATAL("%s: Read payload error: %s", __func__,
-                         strerror(errno));
-      }
-      bytes_remaining_ -= bytes_read;
-      bytes_read_ += bytes_read;
-      if (bytes_remaining_ == 0) {
-        packet_ready_cb_();
-        state_ = HCI_PREAMBLE;
-        bytes_read_ = 0;
-      }
+    size_t preamble_size = preamble_size_for_type[type];
+    if (available < type_size + preamble_size) break;
+    size_t packet_size =
+        preamble_size + HciGetPacketLengthForType(type, data + type_size);
+    if (available < type_size + packet_size) {
+      pending_size = type_size + packet_size;
       break;
     }
+
+    packet_type_ = type;
+    packet_.setToExternal(data + type_size, packet_size);
+    buffer_start_ += type_size + packet_size;
+    packet_ready_cb_();
+  }
+  packet_.setToExternal(nullptr, 0);
+
+  // Move the incomplete packet to the start of the buffer.
+  size_t remaining = buffer_end_ - buffer_start_;
+  if (remaining > 0 && buffer_start_ > 0) {
+    memmove(buffer_.data(), buffer_.data() + buffer_start_, remaining);
   }
+  buffer_start_ = 0;
+  buffer_end_ = remaining;
+  if (pending_size > buffer_.size()) buffer_.resize(pending_size);
 }
 
 }  // namespace hci
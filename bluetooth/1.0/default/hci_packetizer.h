@@ -17,6 +17,7 @@
 #pragma once
 
 #include <functional>
+#include <vector>
 
 #include <hidl/HidlSupport.h>
 
@@ -30,20 +31,38 @@ namespace hci {
 using ::android::hardware::hidl_vec;
 using HciPacketReadyCallback = std::function<void(void)>;
 
+// Reassembles HCI packets from a transport fd. Each call reads all the data
+// that fits in the read buffer and reports every complete packet in it, so a
+// burst of packets costs one read() instead of one or more per packet.
+//
+// The packet returned by GetPacket() refers to the read buffer and is only
+// valid in the packet ready callback. Callers that keep it must copy it.
 class HciPacketizer {
  public:
-  HciPacketizer(HciPacketReadyCallback packet_cb)
-      : packet_ready_cb_(packet_cb){};
+  HciPacketizer(HciPacketReadyCallback packet_cb);
+
+  // Reads from a channel that only carries |packet_type| packets (MCT).
   void OnDataReady(int fd, HciPacketType packet_type);
+  // Reads from an H4 stream, in which each packet starts with its type.
+  void OnH4DataReady(int fd);
+
   const hidl_vec<uint8_t>& GetPacket() const;
+  HciPacketType GetPacketType() const;
 
  protected:
-  enum State { HCI_PREAMBLE, HCI_PAYLOAD };
-  State state_{HCI_PREAMBLE};
-  uint8_t preamble_[HCI_PREAMBLE_SIZE_MAX];
+  // Returns false if nothing was read.
+  bool ReadAvailable(int fd);
+  // |channel_type| is HCI_PACKET_TYPE_UNKNOWN for an H4 stream.
+  void DispatchPackets(HciPacketType channel_type);
+
+  // Bytes [buffer_start_, buffer_end_) of |buffer_| are received but not yet
+  // dispatched. Only an incomplete packet is left after dispatching; it is
+  // moved to the start of the buffer, which grows if the packet does not fit.
+  std::vector<uint8_t> buffer_;
+  size_t buffer_start_{0};
+  size_t buffer_end_{0};
+  HciPacketType packet_type_{HCI_PACKET_TYPE_UNKNOWN};
   hidl_vec<uint8_t> packet_;
-  size_t bytes_remaining_{0};
-  size_t bytes_read_{0};
   HciPacketReadyCallback packet_ready_cb_;
 };
 
@@ -18,13 +18,17 @@
 
 #include "async_fd_watcher.h"
 #include <gtest/gtest.h>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
 #include <cstring>
+#include <mutex>
 #include <vector>
 
 #include <log/log.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -385,6 +389,153 @@ TEST_F(AsyncFdWatcherSocketTest, RepeatedTimeOutTest) {
   CleanUpServer();
 }
 
+// Watches the local ends of socketpairs, like the event and ACL fds of an MCT
+// transport.
+class AsyncFdWatcherLoopbackTest : public ::testing::Test {
+ public:
+  static const int kNumChannels = 4;
+
+ protected:
+  void SetUp() override {
+    for (auto& fds : socket_pairs_) {
+      ASSERT_EQ(0, socketpair(AF_LOCAL, SOCK_STREAM, 0, fds));
+    }
+  }
+
+  void TearDown() override {
+    watcher_.StopWatchingFileDescriptors();
+    for (auto& fds : socket_pairs_) {
+      close(fds[0]);
+      close(fds[1]);
+    }
+  }
+
+  // Reads at most one byte per call, so the rest of the data is only seen if
+  // the watcher keeps reporting the fd as ready.
+  void WatchChannel(int channel) {
+    watcher_.WatchFdForNonBlockingReads(
+        socket_pairs_[channel][0], [this, channel](int fd) {
+          char byte;
+          if (TEMP_FAILURE_RETRY(read(fd, &byte, 1)) != 1) return;
+          std::unique_lock<std::mutex> lock(mutex_);
+          bytes_read_[channel]++;
+          cv_.notify_all();
+        });
+  }
+
+  void Write(int channel, size_t num_bytes) {
+    std::vector<char> data(num_bytes, 'x');
+    size_t written = 0;
+    while (written < num_bytes) {
+      ssize_t n = TEMP_FAILURE_RETRY(write(socket_pairs_[channel][1],
+                                           data.data() + written,
+                                           num_bytes - written));
+      ASSERT_GT(n, 0);
+      written += n;
+    }
+  }
+
+  bool WaitForBytes(int channel, size_t num_bytes) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, std::chrono::seconds(5), [&] {
+      return bytes_read_[channel] >= num_bytes;
+    });
+  }
+
+  AsyncFdWatcher watcher_;
+  int socket_pairs_[kNumChannels][2];
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  size_t bytes_read_[kNumChannels] = {};
+};
+
+// Data that is ready on several fds at once is delivered on every fd, and data
+// left unread by a callback is reported again.
+TEST_F(AsyncFdWatcherLoopbackTest, SimultaneouslyReadyFds) {
+  for (int channel = 0; channel < kNumChannels; channel++) {
+    Write(channel, 16);
+  }
+  for (int channel = 0; channel < kNumChannels; channel++) {
+    WatchChannel(channel);
+  }
+  for (int channel = 0; channel < kNumChannels; channel++) {
+    EXPECT_TRUE(WaitForBytes(channel, 16)) << "channel " << channel;
+  }
+}
+
+// Sustained traffic from writer threads on two fds.
+TEST_F(AsyncFdWatcherLoopbackTest, HighRateTraffic) {
+  const size_t kBytesPerChannel = 64 * 1024;
+  WatchChannel(0);
+  WatchChannel(1);
+
+  std::vector<std::thread> writers;
+  for (int channel = 0; channel < 2; channel++) {
+    writers.emplace_back([this, channel, kBytesPerChannel] {
+      for (size_t i = 0; i < kBytesPerChannel / 64; i++) Write(channel, 64);
+    });
+  }
+  for (auto& writer : writers) writer.join();
+
+  EXPECT_TRUE(WaitForBytes(0, kBytesPerChannel));
+  EXPECT_TRUE(WaitForBytes(1, kBytesPerChannel));
+}
+
+// The timeout only fires once the fds have been idle for its duration.
+TEST_F(AsyncFdWatcherLoopbackTest, TimeoutRestartedByActivity) {
+  std::atomic<int> num_timeouts{0};
+  WatchChannel(0);
+  watcher_.ConfigureTimeout(std::chrono::milliseconds(300),
+                            [&num_timeouts]() { num_timeouts++; });
+
+  for (int i = 0; i < 10; i++) {
+    Write(0, 1);
+    usleep(50 * 1000);
+  }
+  EXPECT_EQ(0, num_timeouts);
+
+  usleep(500 * 1000);
+  EXPECT_EQ(1, num_timeouts);
+}
+
+// A zero timeout disables the timeout callback.
+TEST_F(AsyncFdWatcherLoopbackTest, ZeroTimeoutDisablesTimeout) {
+  std::atomic<int> num_timeouts{0};
+  WatchChannel(0);
+  watcher_.ConfigureTimeout(std::chrono::milliseconds(100),
+                            [&num_timeouts]() { num_timeouts++; });
+  watcher_.ConfigureTimeout(std::chrono::seconds(0),
+                            [&num_timeouts]() { num_timeouts++; });
+  usleep(300 * 1000);
+  EXPECT_EQ(0, num_timeouts);
+}
+
+// A watcher that fails to start closes what it had set up, and starts on the
+// next attempt.
+TEST_F(AsyncFdWatcherLoopbackTest, RecoversFromAFailedStart) {
+  // Only leave room for the epoll fd, so that creating the eventfd fails.
+  const int lowest_free_fd = dup(0);
+  ASSERT_GE(lowest_free_fd, 0);
+  close(lowest_free_fd);
+  struct rlimit old_limit;
+  ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &old_limit));
+  struct rlimit limit = old_limit;
+  limit.rlim_cur = lowest_free_fd + 1;
+  ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &limit));
+  const int result =
+      watcher_.WatchFdForNonBlockingReads(socket_pairs_[0][0], [](int) {});
+  ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &old_limit));
+  EXPECT_EQ(-1, result);
+
+  const int fd = dup(0);
+  EXPECT_EQ(lowest_free_fd, fd);
+  close(fd);
+
+  WatchChannel(0);
+  Write(0, 1);
+  EXPECT_TRUE(WaitForBytes(0, 1));
+}
+
 }  // namespace implementation
 }  // namespace V1_0
 }  // namespace bluetooth
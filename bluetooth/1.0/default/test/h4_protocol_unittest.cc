@@ -213,6 +213,32 @@ class H4ProtocolTest : public ::testing::Test {
     }
   }
 
+  // Appends an H4 packet with a |preamble_length| byte preamble, the last one
+  // or two bytes of which are the payload length, to |stream|.
+  void AppendPacket(std::vector<uint8_t>* stream, uint8_t type,
+                    size_t preamble_length, const std::vector<uint8_t>& payload) {
+    stream->push_back(type);
+    for (size_t i = 0; i + 2 < preamble_length; i++) stream->push_back(i);
+    if (type == HCI_PACKET_TYPE_ACL_DATA) {
+      stream->push_back(payload.size() & 0xFF);
+      stream->push_back((payload.size() >> 8) & 0xFF);
+    } else {
+      stream->push_back(0x42);
+      stream->push_back(payload.size() & 0xFF);
+    }
+    stream->insert(stream->end(), payload.begin(), payload.end());
+  }
+
+  void WriteToUart(const std::vector<uint8_t>& data) {
+    size_t written = 0;
+    while (written < data.size()) {
+      ssize_t n = TEMP_FAILURE_RETRY(
+          write(fake_uart_, data.data() + written, data.size() - written));
+      ASSERT_GT(n, 0);
+      written += n;
+    }
+  }
+
   testing::MockFunction<void(const hidl_vec<uint8_t>&)> event_cb_;
   testing::MockFunction<void(const hidl_vec<uint8_t>&)> acl_cb_;
   testing::MockFunction<void(const hidl_vec<uint8_t>&)> sco_cb_;
@@ -238,6 +264,71 @@ TEST_F(H4ProtocolTest, TestReads) {
   WriteAndExpectInboundIsoData(iso_data);
 }
 
+// Packets that arrive together are all delivered, in order.
+TEST_F(H4ProtocolTest, TestReadsBatchedPackets) {
+  std::vector<uint8_t> acl1(27, 'a'), event(12, 'e'), sco(60, 's'),
+      acl2(251, 'b');
+  std::vector<uint8_t> stream;
+  AppendPacket(&stream, HCI_PACKET_TYPE_ACL_DATA, HCI_ACL_PREAMBLE_SIZE, acl1);
+  AppendPacket(&stream, HCI_PACKET_TYPE_EVENT, HCI_EVENT_PREAMBLE_SIZE, event);
+  AppendPacket(&stream, HCI_PACKET_TYPE_SCO_DATA, HCI_SCO_PREAMBLE_SIZE, sco);
+  AppendPacket(&stream, HCI_PACKET_TYPE_ACL_DATA, HCI_ACL_PREAMBLE_SIZE, acl2);
+
+  std::mutex mutex;
+  std::condition_variable done;
+  std::vector<size_t> acl_sizes;
+  ::testing::InSequence sequence;
+  EXPECT_CALL(acl_cb_, Call(::testing::_))
+      .WillOnce([&acl_sizes](const hidl_vec<uint8_t>& packet) {
+        acl_sizes.push_back(packet.size());
+      });
+  EXPECT_CALL(event_cb_, Call(::testing::SizeIs(HCI_EVENT_PREAMBLE_SIZE + 12)));
+  EXPECT_CALL(sco_cb_, Call(::testing::SizeIs(HCI_SCO_PREAMBLE_SIZE + 60)));
+  EXPECT_CALL(acl_cb_, Call(::testing::_))
+      .WillOnce([&](const hidl_vec<uint8_t>& packet) {
+        std::unique_lock<std::mutex> lock(mutex);
+        acl_sizes.push_back(packet.size());
+        EXPECT_EQ('b', packet[packet.size() - 1]);
+        done.notify_one();
+      });
+
+  std::unique_lock<std::mutex> lock(mutex);
+  WriteToUart(stream);
+  EXPECT_TRUE(done.wait_for(lock, std::chrono::seconds(1), [&acl_sizes] {
+    return acl_sizes.size() == 2;
+  }));
+  EXPECT_THAT(acl_sizes, ::testing::ElementsAre(HCI_ACL_PREAMBLE_SIZE + 27,
+                                                HCI_ACL_PREAMBLE_SIZE + 251));
+}
+
+// Packets larger than the initial read buffer, split across writes.
+TEST_F(H4ProtocolTest, TestReadsLargeAclPacket) {
+  std::vector<uint8_t> payload(16 * 1024);
+  for (size_t i = 0; i < payload.size(); i++) payload[i] = i & 0xFF;
+  std::vector<uint8_t> stream;
+  AppendPacket(&stream, HCI_PACKET_TYPE_ACL_DATA, HCI_ACL_PREAMBLE_SIZE,
+               payload);
+
+  std::mutex mutex;
+  std::condition_variable done;
+  bool received = false;
+  EXPECT_CALL(acl_cb_, Call(::testing::_))
+      .WillOnce([&](const hidl_vec<uint8_t>& packet) {
+        std::unique_lock<std::mutex> lock(mutex);
+        EXPECT_EQ(stream.size() - 1, packet.size());
+        EXPECT_EQ(0, memcmp(stream.data() + 1, packet.data(), packet.size()));
+        received = true;
+        done.notify_one();
+      });
+
+  std::unique_lock<std::mutex> lock(mutex);
+  size_t half = stream.size() / 2;
+  WriteToUart(std::vector<uint8_t>(stream.begin(), stream.begin() + half));
+  WriteToUart(std::vector<uint8_t>(stream.begin() + half, stream.end()));
+  EXPECT_TRUE(done.wait_for(lock, std::chrono::seconds(1),
+                            [&received] { return received; }));
+}
+
 }  // namespace implementation
 }  // namespace V1_0
 }  // namespace bluetooth
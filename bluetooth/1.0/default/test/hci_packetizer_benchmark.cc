@@ -0,0 +1,96 @@
+//
+// Copyright 2020 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstdint>
+#include <vector>
+
+#include "h4_protocol.h"
+
+namespace android {
+namespace hardware {
+namespace bluetooth {
+namespace hci {
+namespace {
+
+// Stays well below the default pipe capacity of 64KiB.
+const size_t kMaxBurstSize = 32 * 1024;
+
+// A burst of H4 ACL packets with |payload_size| bytes of payload each.
+std::vector<uint8_t> MakeAclBurst(size_t payload_size, size_t* num_packets) {
+  size_t packet_size = 1 + HCI_ACL_PREAMBLE_SIZE + payload_size;
+  *num_packets = kMaxBurstSize / packet_size;
+  std::vector<uint8_t> burst;
+  for (size_t i = 0; i < *num_packets; i++) {
+    burst.push_back(HCI_PACKET_TYPE_ACL_DATA);
+    burst.push_back(0x01);  // Handle
+    burst.push_back(0x20);
+    burst.push_back(payload_size & 0xFF);
+    burst.push_back((payload_size >> 8) & 0xFF);
+    burst.insert(burst.end(), payload_size, static_cast<uint8_t>(i));
+  }
+  return burst;
+}
+
+// Pushes bursts of ACL packets through a pipe into an H4Protocol.
+// Arg: ACL payload size (LE default, LE DLE maximum, 2-DH5).
+void BM_H4AclThroughput(benchmark::State& state) {
+  size_t payload_size = state.range(0);
+  size_t num_packets;
+  std::vector<uint8_t> burst = MakeAclBurst(payload_size, &num_packets);
+
+  int pipe_fds[2];
+  if (pipe2(pipe_fds, O_NONBLOCK)) {
+    state.SkipWithError("pipe2 failed");
+    return;
+  }
+
+  size_t packets_received = 0;
+  auto ignore = [](const hidl_vec<uint8_t>&) {};
+  H4Protocol h4(pipe_fds[0], ignore,
+                [&packets_received](const hidl_vec<uint8_t>& packet) {
+                  benchmark::DoNotOptimize(packet.data());
+                  packets_received++;
+                },
+                ignore, ignore);
+
+  for (auto _ : state) {
+    if (write(pipe_fds[1], burst.data(), burst.size()) !=
+        static_cast<ssize_t>(burst.size())) {
+      state.SkipWithError("short write");
+      break;
+    }
+    // Called once per wakeup of the fd watcher.
+    packets_received = 0;
+    while (packets_received < num_packets) h4.OnDataReady(pipe_fds[0]);
+  }
+  state.SetItemsProcessed(state.iterations() * num_packets);
+  state.SetBytesProcessed(state.iterations() * burst.size());
+
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+}
+BENCHMARK(BM_H4AclThroughput)->Arg(27)->Arg(251)->Arg(1021);
+
+}  // namespace
+}  // namespace hci
+}  // namespace bluetooth
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
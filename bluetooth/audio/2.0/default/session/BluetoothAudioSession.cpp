@@ -18,6 +18,9 @@
 
 #include "BluetoothAudioSession.h"
 
+#include <algorithm>
+#include <chrono>
+
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 
@@ -45,13 +48,46 @@ AudioConfiguration BluetoothAudioSession::invalidOffloadAudioConfiguration = {};
 static constexpr int kFmqSendTimeoutMs = 1000;  // 1000 ms timeout for sending
 static constexpr int kWritePollMs = 1;          // polled non-blocking interval
 
+// The default notifications of MessageQueue::readBlocking / writeBlocking
+static constexpr uint32_t kDataMqNotEmpty = 1 << 0;
+static constexpr uint32_t kDataMqNotFull = 1 << 1;
+
+// The FMQ of a software encoding session, with the event flag its reader
+// wakes after freeing space, and the statistics of the writes to it
+struct BluetoothAudioSession::DataPath {
+  std::unique_ptr<DataMQ> mq;
+  // nullptr if the FMQ has no event flag word
+  EventFlag* event_flag = nullptr;
+
+  std::atomic<uint64_t> write_calls{0};
+  std::atomic<uint64_t> bytes_written{0};
+  std::atomic<uint64_t> overflow_count{0};
+  std::atomic<uint64_t> wait_count{0};
+  std::atomic<uint64_t> total_wait_ns{0};
+  std::atomic<uint64_t> max_wait_ns{0};
+  std::atomic<uint64_t> total_fill_bytes{0};
+  std::atomic<uint64_t> max_fill_bytes{0};
+
+  ~DataPath() {
+    if (event_flag != nullptr) EventFlag::deleteEventFlag(&event_flag);
+  }
+};
+
+static inline void update_max(std::atomic<uint64_t>* max, uint64_t value) {
+  uint64_t current = max->load(std::memory_order_relaxed);
+  while (value > current &&
+         !max->compare_exchange_weak(current, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
 static inline timespec timespec_convert_from_hal(const TimeSpec& TS) {
   return {.tv_sec = static_cast<long>(TS.tvSec),
           .tv_nsec = static_cast<long>(TS.tvNSec)};
 }
 
 BluetoothAudioSession::BluetoothAudioSession(const SessionType& session_type)
-    : session_type_(session_type), stack_iface_(nullptr), mDataMQ(nullptr) {
+    : session_type_(session_type), stack_iface_(nullptr), data_path_(nullptr) {
   invalidSoftwareAudioConfiguration.pcmConfig(kInvalidPcmParameters);
   invalidOffloadAudioConfiguration.codecConfig(kInvalidCodecConfiguration);
 }
@@ -147,24 +183,51 @@ bool BluetoothAudioSession::IsSessionReady() {
   std::lock_guard<std::recursive_mutex> guard(mutex_);
   bool dataMQ_valid =
       (session_type_ == SessionType::A2DP_HARDWARE_OFFLOAD_DATAPATH ||
-       (mDataMQ != nullptr && mDataMQ->isValid()));
+       std::atomic_load(&data_path_) != nullptr);
   return stack_iface_ != nullptr && dataMQ_valid;
 }
 
 bool BluetoothAudioSession::UpdateDataPath(const DataMQ::Descriptor* dataMQ) {
-  if (dataMQ == nullptr) {
-    // usecase of reset by nullptr
-    mDataMQ = nullptr;
-    return true;
+  std::shared_ptr<DataPath> data_path;
+  bool retval = true;
+  if (dataMQ != nullptr) {
+    data_path = std::make_shared<DataPath>();
+    data_path->mq.reset(new DataMQ(*dataMQ));
+    if (!data_path->mq->isValid()) {
+      data_path = nullptr;
+      retval = false;
+    } else if (data_path->mq->getEventFlagWord() != nullptr &&
+               EventFlag::createEventFlag(data_path->mq->getEventFlagWord(),
+                                          &data_path->event_flag) != OK) {
+      LOG(WARNING) << __func__ << " - SessionType=" << toString(session_type_)
+                   << " failed to create the event flag, polling the FMQ";
+      data_path->event_flag = nullptr;
+    }
   }
-  std::unique_ptr<DataMQ> tempDataMQ;
-  tempDataMQ.reset(new DataMQ(*dataMQ));
-  if (!tempDataMQ || !tempDataMQ->isValid()) {
-    mDataMQ = nullptr;
-    return false;
+  // A writer that is waiting for space bails out once it sees the swap.
+  std::shared_ptr<DataPath> old_data_path =
+      std::atomic_exchange(&data_path_, data_path);
+  if (old_data_path != nullptr) {
+    if (old_data_path->event_flag != nullptr) {
+      old_data_path->event_flag->wake(kDataMqNotFull);
+    }
+    LogDataPathStats(*old_data_path);
   }
-  mDataMQ = std::move(tempDataMQ);
-  return true;
+  return retval;
+}
+
+void BluetoothAudioSession::LogDataPathStats(const DataPath& data_path) {
+  uint64_t write_calls = data_path.write_calls.load();
+  if (write_calls == 0) return;
+  LOG(INFO) << __func__ << " - SessionType=" << toString(session_type_)
+            << ", writes=" << write_calls
+            << ", bytes=" << data_path.bytes_written.load()
+            << ", overflows=" << data_path.overflow_count.load()
+            << ", waits=" << data_path.wait_count.load() << " (max "
+            << data_path.max_wait_ns.load() / 1000 << " us), fill avg="
+            << data_path.total_fill_bytes.load() / write_calls
+            << " max=" << data_path.max_fill_bytes.load() << "/"
+            << data_path.mq->getQuantumCount() << " bytes";
 }
 
 bool BluetoothAudioSession::UpdateAudioConfig(
@@ -370,36 +433,93 @@ void BluetoothAudioSession::UpdateTracksMetadata(
 size_t BluetoothAudioSession::OutWritePcmData(const void* buffer,
                                               size_t bytes) {
   if (buffer == nullptr || !bytes) return 0;
+  // No mutex_ on the data path; holding the DataPath keeps the FMQ alive if the
+  // session ends meanwhile.
+  std::shared_ptr<DataPath> data_path = std::atomic_load(&data_path_);
+  if (data_path == nullptr) return 0;
+  DataMQ* data_mq = data_path->mq.get();
+
+  size_t fill = data_mq->availableToRead();
+  data_path->write_calls.fetch_add(1, std::memory_order_relaxed);
+  data_path->total_fill_bytes.fetch_add(fill, std::memory_order_relaxed);
+  update_max(&data_path->max_fill_bytes, fill);
+
+  using std::chrono::steady_clock;
+  const auto deadline =
+      steady_clock::now() + std::chrono::milliseconds(kFmqSendTimeoutMs);
   size_t totalWritten = 0;
-  int ms_timeout = kFmqSendTimeoutMs;
-  do {
-    std::unique_lock<std::recursive_mutex> lock(mutex_);
-    if (!IsSessionReady()) break;
-    size_t availableToWrite = mDataMQ->availableToWrite();
+  while (totalWritten < bytes) {
+    size_t availableToWrite =
+        std::min(data_mq->availableToWrite(), bytes - totalWritten);
     if (availableToWrite) {
-      if (availableToWrite > (bytes - totalWritten)) {
-        availableToWrite = bytes - totalWritten;
-      }
-
-      if (!mDataMQ->write(static_cast<const uint8_t*>(buffer) + totalWritten,
+      if (!data_mq->write(static_cast<const uint8_t*>(buffer) + totalWritten,
                           availableToWrite)) {
         ALOGE("FMQ datapath writting %zu/%zu failed", totalWritten, bytes);
-        return totalWritten;
+        break;
       }
       totalWritten += availableToWrite;
-    } else if (ms_timeout >= kWritePollMs) {
-      lock.unlock();
-      usleep(kWritePollMs * 1000);
-      ms_timeout -= kWritePollMs;
-    } else {
+      // Only a syscall if the reader has consumed the previous notification
+      if (data_path->event_flag != nullptr) {
+        data_path->event_flag->wake(kDataMqNotEmpty);
+      }
+      continue;
+    }
+
+    auto now = steady_clock::now();
+    if (now >= deadline) {
       ALOGD("data %zu/%zu overflow %d ms", totalWritten, bytes,
-            (kFmqSendTimeoutMs - ms_timeout));
-      return totalWritten;
+            kFmqSendTimeoutMs);
+      data_path->overflow_count.fetch_add(1, std::memory_order_relaxed);
+      break;
     }
-  } while (totalWritten < bytes);
+    if (std::atomic_load(&data_path_) != data_path) break;
+
+    // Wait for the reader to free space. A reader that does not wake the event
+    // flag is still picked up every poll interval.
+    auto timeout = std::min<steady_clock::duration>(
+        deadline - now, std::chrono::milliseconds(kWritePollMs));
+    if (data_path->event_flag != nullptr) {
+      uint32_t efState = 0;
+      data_path->event_flag->wait(
+          kDataMqNotFull, &efState,
+          std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count(),
+          true /* retry */);
+    } else {
+      usleep(std::chrono::duration_cast<std::chrono::microseconds>(timeout)
+                 .count());
+    }
+    uint64_t wait_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           steady_clock::now() - now)
+                           .count();
+    data_path->wait_count.fetch_add(1, std::memory_order_relaxed);
+    data_path->total_wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
+    update_max(&data_path->max_wait_ns, wait_ns);
+  }
+  data_path->bytes_written.fetch_add(totalWritten, std::memory_order_relaxed);
   return totalWritten;
 }
 
+// The control function gets the FMQ statistics of the current session
+bool BluetoothAudioSession::GetDataPathStats(DataPathStats* stats) {
+  std::shared_ptr<DataPath> data_path = std::atomic_load(&data_path_);
+  if (data_path == nullptr || stats == nullptr) return false;
+  uint64_t write_calls = data_path->write_calls.load();
+  *stats = {
+      .write_calls = write_calls,
+      .bytes_written = data_path->bytes_written.load(),
+      .overflow_count = data_path->overflow_count.load(),
+      .wait_count = data_path->wait_count.load(),
+      .total_wait_ns = data_path->total_wait_ns.load(),
+      .max_wait_ns = data_path->max_wait_ns.load(),
+      .queue_size_bytes = data_path->mq->getQuantumCount(),
+      .average_fill_bytes = static_cast<size_t>(
+          write_calls ? data_path->total_fill_bytes.load() / write_calls : 0),
+      .max_fill_bytes =
+          static_cast<size_t>(data_path->max_fill_bytes.load()),
+  };
+  return true;
+}
+
 std::unique_ptr<BluetoothAudioSessionInstance>
     BluetoothAudioSessionInstance::instance_ptr =
         std::unique_ptr<BluetoothAudioSessionInstance>(
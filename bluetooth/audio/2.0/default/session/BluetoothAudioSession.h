@@ -16,10 +16,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <unordered_map>
 
 #include <android/hardware/bluetooth/audio/2.0/IBluetoothAudioPort.h>
+#include <fmq/EventFlag.h>
 #include <fmq/MessageQueue.h>
 #include <hardware/audio.h>
 #include <hidl/MQDescriptor.h>
@@ -29,6 +32,7 @@ namespace bluetooth {
 namespace audio {
 
 using ::android::sp;
+using ::android::hardware::EventFlag;
 using ::android::hardware::kSynchronizedReadWrite;
 using ::android::hardware::MessageQueue;
 using ::android::hardware::bluetooth::audio::V2_0::AudioConfiguration;
@@ -78,6 +82,23 @@ struct PortStatusCallbacks {
   std::function<void(uint16_t cookie)> session_changed_cb_;
 };
 
+// Statistics of the FMQ data path of a software encoding session, since the
+// session started
+struct DataPathStats {
+  uint64_t write_calls;
+  uint64_t bytes_written;
+  // Writes that ran into the send timeout before all data was written
+  uint64_t overflow_count;
+  // Waits for the reader to free space in the FMQ, and the time they took
+  uint64_t wait_count;
+  uint64_t total_wait_ns;
+  uint64_t max_wait_ns;
+  // Bytes that were still queued at the start of each write
+  size_t queue_size_bytes;
+  size_t average_fill_bytes;
+  size_t max_fill_bytes;
+};
+
 class BluetoothAudioSession {
  private:
   // using recursive_mutex to allow hwbinder to re-enter agian.
@@ -86,8 +107,11 @@ class BluetoothAudioSession {
 
   // audio control path to use for both software and offloading
   sp<IBluetoothAudioPort> stack_iface_;
-  // audio data path (FMQ) for software encoding
-  std::unique_ptr<DataMQ> mDataMQ;
+  // audio data path (FMQ) for software encoding. OutWritePcmData() uses it
+  // without mutex_, so it is replaced with std::atomic_store() and read with
+  // std::atomic_load(); a writer keeps the data path it loaded alive.
+  struct DataPath;
+  std::shared_ptr<DataPath> data_path_;
   // audio data configuration for both software and offloading
   AudioConfiguration audio_config_;
 
@@ -99,6 +123,7 @@ class BluetoothAudioSession {
       observers_;
 
   bool UpdateDataPath(const DataMQ::Descriptor* dataMQ);
+  void LogDataPathStats(const DataPath& data_path);
   bool UpdateAudioConfig(const AudioConfiguration& audio_config);
   // invoking the registered session_changed_cb_
   void ReportSessionStatus();
@@ -151,9 +176,15 @@ class BluetoothAudioSession {
                                timespec* data_position);
   void UpdateTracksMetadata(const struct source_metadata* source_metadata);
 
-  // The control function writes stream to FMQ
+  // The control function writes stream to FMQ. It blocks until all data is
+  // written, the send timeout expires or the session ends, and returns the
+  // number of bytes written.
   size_t OutWritePcmData(const void* buffer, size_t bytes);
 
+  // The control function gets the FMQ statistics of the current session
+  // @return: false if there is no software encoding session
+  bool GetDataPathStats(DataPathStats* stats);
+
   static constexpr PcmParameters kInvalidPcmParameters = {
       .sampleRate = SampleRate::RATE_UNKNOWN,
       .channelMode = ChannelMode::UNKNOWN,
@@ -136,6 +136,17 @@ class BluetoothAudioSessionControl {
     }
     return 0;
   }
+
+  // The control API gets the FMQ statistics of the current session
+  static bool GetDataPathStats(const SessionType& session_type,
+                               DataPathStats* stats) {
+    std::shared_ptr<BluetoothAudioSession> session_ptr =
+        BluetoothAudioSessionInstance::GetSessionInstance(session_type);
+    if (session_ptr != nullptr) {
+      return session_ptr->GetDataPathStats(stats);
+    }
+    return false;
+  }
 };
 
 }  // namespace audio
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "BTAudioSessionTest"
+
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "BluetoothAudioSession.h"
+
+namespace android {
+namespace bluetooth {
+namespace audio {
+
+using ::android::hardware::hidl_vec;
+using ::android::hardware::Return;
+using ::android::hardware::Void;
+using ::android::hardware::audio::common::V5_0::SourceMetadata;
+
+namespace {
+
+// Small enough that the writer has to wait for the reader
+constexpr size_t kDataMqSize = 1024;
+constexpr size_t kWriteSize = 512;
+constexpr size_t kTotalBytes = 64 * 1024;
+constexpr uint32_t kNotEmpty = 1 << 0;
+constexpr uint32_t kNotFull = 1 << 1;
+
+// Stands in for the Bluetooth stack, which owns the reading end of the FMQ
+class FakeBluetoothAudioPort : public IBluetoothAudioPort {
+ public:
+  Return<void> startStream() override { return Void(); }
+  Return<void> suspendStream() override { return Void(); }
+  Return<void> stopStream() override { return Void(); }
+  Return<void> getPresentationPosition(
+      getPresentationPosition_cb _hidl_cb) override {
+    _hidl_cb(BluetoothAudioStatus::FAILURE, 0, 0, {});
+    return Void();
+  }
+  Return<void> updateMetadata(const SourceMetadata&) override {
+    return Void();
+  }
+};
+
+class BluetoothAudioSessionTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    data_mq_.reset(new DataMQ(kDataMqSize, /* EventFlag */ true));
+    ASSERT_TRUE(data_mq_->isValid());
+    session_ = std::make_shared<BluetoothAudioSession>(
+        SessionType::A2DP_SOFTWARE_ENCODING_DATAPATH);
+    AudioConfiguration audio_config = {};
+    audio_config.pcmConfig({.sampleRate = SampleRate::RATE_44100,
+                            .channelMode = ChannelMode::STEREO,
+                            .bitsPerSample = BitsPerSample::BITS_16});
+    session_->OnSessionStarted(new FakeBluetoothAudioPort(),
+                               data_mq_->getDesc(), audio_config);
+    ASSERT_TRUE(session_->IsSessionReady());
+
+    pcm_data_.resize(kTotalBytes);
+    for (size_t i = 0; i < pcm_data_.size(); i++) pcm_data_[i] = i * 7;
+  }
+
+  void TearDown() override { session_->OnSessionEnded(); }
+
+  // Writes |pcm_data_| like the audio HAL, and returns the bytes written
+  size_t WriteAll() {
+    size_t written = 0;
+    while (written < pcm_data_.size()) {
+      size_t bytes = session_->OutWritePcmData(pcm_data_.data() + written,
+                                               kWriteSize);
+      if (bytes == 0) break;
+      written += bytes;
+    }
+    return written;
+  }
+
+  // Reads kTotalBytes like a Bluetooth stack that blocks on the event flag
+  std::vector<uint8_t> ReadBlocking() {
+    std::vector<uint8_t> received(kTotalBytes);
+    for (size_t read = 0; read < received.size(); read += kWriteSize) {
+      if (!data_mq_->readBlocking(received.data() + read, kWriteSize, kNotFull,
+                                  kNotEmpty, 1000000000 /* 1s */)) {
+        received.resize(read);
+        break;
+      }
+    }
+    return received;
+  }
+
+  // Reads kTotalBytes like a Bluetooth stack that polls the FMQ
+  std::vector<uint8_t> ReadPolling() {
+    std::vector<uint8_t> received(kTotalBytes);
+    size_t read = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (read < received.size() &&
+           std::chrono::steady_clock::now() < deadline) {
+      size_t available =
+          std::min(data_mq_->availableToRead(), received.size() - read);
+      if (available && data_mq_->read(received.data() + read, available)) {
+        read += available;
+      } else {
+        usleep(500);
+      }
+    }
+    received.resize(read);
+    return received;
+  }
+
+  std::unique_ptr<DataMQ> data_mq_;
+  std::shared_ptr<BluetoothAudioSession> session_;
+  std::vector<uint8_t> pcm_data_;
+};
+
+}  // namespace
+
+TEST_F(BluetoothAudioSessionTest, WriteToBlockingReader) {
+  auto reader = std::async(std::launch::async, [this] { return ReadBlocking(); });
+  EXPECT_EQ(kTotalBytes, WriteAll());
+  EXPECT_EQ(pcm_data_, reader.get());
+
+  DataPathStats stats;
+  ASSERT_TRUE(session_->GetDataPathStats(&stats));
+  EXPECT_EQ(kTotalBytes, stats.bytes_written);
+  EXPECT_EQ(0u, stats.overflow_count);
+  EXPECT_EQ(kDataMqSize, stats.queue_size_bytes);
+  EXPECT_LE(stats.max_fill_bytes, kDataMqSize);
+  EXPECT_LE(stats.average_fill_bytes, stats.max_fill_bytes);
+}
+
+TEST_F(BluetoothAudioSessionTest, WriteToPollingReader) {
+  auto reader = std::async(std::launch::async, [this] { return ReadPolling(); });
+  EXPECT_EQ(kTotalBytes, WriteAll());
+  EXPECT_EQ(pcm_data_, reader.get());
+
+  DataPathStats stats;
+  ASSERT_TRUE(session_->GetDataPathStats(&stats));
+  EXPECT_EQ(kTotalBytes, stats.bytes_written);
+  EXPECT_EQ(0u, stats.overflow_count);
+}
+
+// Without a reader, the write returns what fit once the send timeout expires
+TEST_F(BluetoothAudioSessionTest, WriteTimesOutWithoutReader) {
+  EXPECT_EQ(kDataMqSize,
+            session_->OutWritePcmData(pcm_data_.data(), kDataMqSize + 1));
+
+  DataPathStats stats;
+  ASSERT_TRUE(session_->GetDataPathStats(&stats));
+  EXPECT_EQ(1u, stats.write_calls);
+  EXPECT_EQ(1u, stats.overflow_count);
+  EXPECT_GT(stats.wait_count, 0u);
+  EXPECT_GE(stats.total_wait_ns, 900000000u);
+}
+
+// Ending the session releases a writer that waits for space
+TEST_F(BluetoothAudioSessionTest, SessionEndReleasesWriter) {
+  ASSERT_EQ(kDataMqSize,
+            session_->OutWritePcmData(pcm_data_.data(), kDataMqSize));
+  auto start = std::chrono::steady_clock::now();
+  auto writer = std::async(std::launch::async, [this] {
+    return session_->OutWritePcmData(pcm_data_.data(), kWriteSize);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  session_->OnSessionEnded();
+
+  EXPECT_EQ(0u, writer.get());
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(500));
+  DataPathStats stats;
+  EXPECT_FALSE(session_->GetDataPathStats(&stats));
+  EXPECT_EQ(0u, session_->OutWritePcmData(pcm_data_.data(), kWriteSize));
+}
+
+}  // namespace audio
+}  // namespace bluetooth
+}  // namespace android
@@ -29,13 +29,9 @@ namespace implementation {
 
 using namespace std::chrono_literals;
 
-using utils::tunesTo;
-
 using std::lock_guard;
 using std::move;
 using std::mutex;
-using std::sort;
-using std::vector;
 
 namespace delay {
 
@@ -43,9 +39,14 @@ static constexpr auto seek = 200ms;
 static constexpr auto step = 100ms;
 static constexpr auto tune = 150ms;
 static constexpr auto list = 1s;
+static constexpr auto listRescan = 1s;
 
 }  // namespace delay
 
+/* Binder buffers are 1MB per process and oneway calls get only half of it, shared with every
+ * other call in flight. */
+static constexpr size_t kProgramListChunkSize = 64 * 1024;
+
 TunerSession::TunerSession(BroadcastRadio& module, const sp<ITunerCallback>& callback)
     : mCallback(callback), mModule(module) {
     auto&& ranges = module.getAmFmConfig().ranges;
@@ -125,9 +126,8 @@ Return<Result> TunerSession::scan(bool directionUp, bool skipSubChannel) {
 
     cancelLocked();
 
-    auto list = virtualRadio().getProgramList();
-
-    if (list.empty()) {
+    VirtualProgram found;
+    if (!virtualRadio().getNextProgram(mCurrentProgram, directionUp, found)) {
         mIsTuneCompleted = false;
         auto task = [this]() {
             LOG(DEBUG) << "program list is empty, seek couldn't stop";
@@ -138,26 +138,7 @@ Return<Result> TunerSession::scan(bool directionUp, bool skipSubChannel) {
 
         return Result::OK;
     }
-
-    // Not optimal (O(sort) instead of O(n)), but not a big deal here;
-    // also, it's likely that list is already sorted (so O(n) anyway).
-    sort(list.begin(), list.end());
-    auto current = mCurrentProgram;
-    auto found = lower_bound(list.begin(), list.end(), VirtualProgram({current}));
-    if (directionUp) {
-        if (found < list.end() - 1) {
-            if (tunesTo(current, found->selector)) found++;
-        } else {
-            found = list.begin();
-        }
-    } else {
-        if (found > list.begin() && found != list.end()) {
-            found--;
-        } else {
-            found = list.end() - 1;
-        }
-    }
-    auto tuneTo = found->selector;
+    auto tuneTo = found.selector;
 
     mIsTuneCompleted = false;
     auto task = [this, tuneTo, directionUp]() {
@@ -234,30 +215,52 @@ Return<Result> TunerSession::startProgramListUpdates(const ProgramFilter& filter
     lock_guard<mutex> lk(mMut);
     if (mIsClosed) return Result::INVALID_STATE;
 
-    auto list = virtualRadio().getProgramList();
-    vector<VirtualProgram> filteredList;
-    auto filterCb = [&filter](const VirtualProgram& program) {
-        return utils::satisfies(filter, program.selector);
-    };
-    std::copy_if(list.begin(), list.end(), std::back_inserter(filteredList), filterCb);
+    // The client drops its list on this call, so the first update starts over.
+    mListThread.cancelAll();
+    mProgramFilter = filter;
+    mProgramListSent.clear();
+    auto generation = ++mProgramListGeneration;
 
-    auto task = [this, list]() {
+    auto task = [this, generation]() {
         lock_guard<mutex> lk(mMut);
-
-        ProgramListChunk chunk = {};
-        chunk.purge = true;
-        chunk.complete = true;
-        chunk.modified = hidl_vec<ProgramInfo>(list.begin(), list.end());
-
-        mCallback->onProgramListUpdated(chunk);
+        updateProgramListLocked(generation, true);
     };
-    mThread.schedule(task, delay::list);
+    mListThread.schedule(task, delay::list);
 
     return Result::OK;
 }
 
+void TunerSession::updateProgramListLocked(uint64_t generation, bool purge) {
+    // Tasks that were already running when updates got restarted or stopped.
+    if (!mProgramFilter || generation != mProgramListGeneration) return;
+
+    if (purge || virtualRadio().getRevision() != mProgramListRevision) {
+        utils::ProgramInfoSet list;
+        mProgramListRevision = virtualRadio().getProgramList(*mProgramFilter, list);
+        auto chunks = utils::makeProgramListChunks(mProgramListSent, move(list), purge,
+                                                   kProgramListChunkSize);
+        LOG(VERBOSE) << "sending " << chunks.size() << " program list chunks, purge=" << purge;
+        for (auto&& chunk : chunks) {
+            mCallback->onProgramListUpdated(chunk);
+        }
+    }
+
+    // Like a background tuner, keep watching the air and report what changed.
+    auto task = [this, generation]() {
+        lock_guard<mutex> lk(mMut);
+        updateProgramListLocked(generation, false);
+    };
+    mListThread.schedule(task, delay::listRescan);
+}
+
 Return<void> TunerSession::stopProgramListUpdates() {
     LOG(DEBUG) << "requested program list updates to stop";
+    lock_guard<mutex> lk(mMut);
+    if (mIsClosed) return {};
+
+    mListThread.cancelAll();
+    mProgramFilter.reset();
+    mProgramListSent.clear();
     return {};
 }
 
@@ -293,6 +296,8 @@ Return<void> TunerSession::close() {
 
     mIsClosed = true;
     mThread.cancelAll();
+    mListThread.cancelAll();
+    mProgramFilter.reset();
     return {};
 }
 
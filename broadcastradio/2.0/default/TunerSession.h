@@ -63,8 +63,16 @@ struct TunerSession : public ITunerSession {
     bool mIsTuneCompleted = false;
     ProgramSelector mCurrentProgram = {};
 
+    // Program list updates, kept off mThread so that tuning does not cancel them.
+    std::optional<ProgramFilter> mProgramFilter;
+    utils::ProgramInfoSet mProgramListSent;
+    uint64_t mProgramListRevision = 0;
+    uint64_t mProgramListGeneration = 0;
+    WorkerThread mListThread;
+
     void cancelLocked();
     void tuneInternalLocked(const ProgramSelector& sel);
+    void updateProgramListLocked(uint64_t generation, bool purge);
     const VirtualRadio& virtualRadio() const;
     const BroadcastRadio& module() const;
 };
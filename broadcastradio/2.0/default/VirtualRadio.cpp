@@ -26,6 +26,8 @@ namespace implementation {
 using std::lock_guard;
 using std::move;
 using std::mutex;
+using std::next;
+using std::prev;
 using std::vector;
 using utils::make_selector_amfm;
 using utils::make_selector_dab;
@@ -53,7 +55,7 @@ VirtualRadio gDabRadio(
 // clang-format on
 
 VirtualRadio::VirtualRadio(const std::string& name, const vector<VirtualProgram>& initialList)
-    : mName(name), mPrograms(initialList) {}
+    : mName(name), mPrograms(initialList.begin(), initialList.end()) {}
 
 std::string VirtualRadio::getName() const {
     return mName;
@@ -61,11 +63,19 @@ std::string VirtualRadio::getName() const {
 
 vector<VirtualProgram> VirtualRadio::getProgramList() const {
     lock_guard<mutex> lk(mMut);
-    return mPrograms;
+    return vector<VirtualProgram>(mPrograms.begin(), mPrograms.end());
 }
 
 bool VirtualRadio::getProgram(const ProgramSelector& selector, VirtualProgram& programOut) const {
     lock_guard<mutex> lk(mMut);
+
+    auto exact = mPrograms.find(VirtualProgram({selector}));
+    if (exact != mPrograms.end() && utils::tunesTo(selector, exact->selector)) {
+        programOut = *exact;
+        return true;
+    }
+
+    // Selectors may point to a program by its secondary identifiers.
     for (auto&& program : mPrograms) {
         if (utils::tunesTo(selector, program.selector)) {
             programOut = program;
@@ -75,6 +85,61 @@ bool VirtualRadio::getProgram(const ProgramSelector& selector, VirtualProgram& p
     return false;
 }
 
+bool VirtualRadio::getNextProgram(const ProgramSelector& current, bool directionUp,
+                                  VirtualProgram& programOut) const {
+    lock_guard<mutex> lk(mMut);
+    if (mPrograms.empty()) return false;
+
+    auto found = mPrograms.lower_bound(VirtualProgram({current}));
+    if (directionUp) {
+        if (found != mPrograms.end() && next(found) != mPrograms.end()) {
+            if (utils::tunesTo(current, found->selector)) found++;
+        } else {
+            found = mPrograms.begin();
+        }
+    } else {
+        if (found != mPrograms.begin() && found != mPrograms.end()) {
+            found--;
+        } else {
+            found = prev(mPrograms.end());
+        }
+    }
+
+    programOut = *found;
+    return true;
+}
+
+uint64_t VirtualRadio::getProgramList(const ProgramFilter& filter,
+                                      utils::ProgramInfoSet& list) const {
+    lock_guard<mutex> lk(mMut);
+    list.reserve(list.size() + mPrograms.size());
+    for (auto&& program : mPrograms) {
+        if (utils::satisfies(filter, program.selector)) list.insert(program);
+    }
+    return mRevision;
+}
+
+uint64_t VirtualRadio::getRevision() const {
+    lock_guard<mutex> lk(mMut);
+    return mRevision;
+}
+
+void VirtualRadio::updateProgram(const VirtualProgram& program) {
+    lock_guard<mutex> lk(mMut);
+    mPrograms.erase(program);
+    mPrograms.insert(program);
+    mRevision++;
+}
+
+bool VirtualRadio::removeProgram(const ProgramIdentifier& id) {
+    lock_guard<mutex> lk(mMut);
+    VirtualProgram program = {};
+    program.selector.primaryId = id;
+    if (mPrograms.erase(program) == 0) return false;
+    mRevision++;
+    return true;
+}
+
 }  // namespace implementation
 }  // namespace V2_0
 }  // namespace broadcastradio
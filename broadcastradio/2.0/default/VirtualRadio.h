@@ -18,7 +18,10 @@
 
 #include "VirtualProgram.h"
 
+#include <broadcastradio-utils-2x/Utils.h>
+
 #include <mutex>
+#include <set>
 #include <vector>
 
 namespace android {
@@ -43,10 +46,35 @@ class VirtualRadio {
     std::vector<VirtualProgram> getProgramList() const;
     bool getProgram(const ProgramSelector& selector, VirtualProgram& program) const;
 
+    /**
+     * Finds the program a seek from {@code current} stops at, wrapping around
+     * at the ends of the list.
+     *
+     * @return False, if there are no programs at all.
+     */
+    bool getNextProgram(const ProgramSelector& current, bool directionUp,
+                        VirtualProgram& program) const;
+
+    /**
+     * Collects the programs satisfying a filter, as sent to the client.
+     *
+     * @return Revision of the program list the result comes from.
+     */
+    uint64_t getProgramList(const ProgramFilter& filter, utils::ProgramInfoSet& list) const;
+
+    /** Revision of the program list, bumped on every change. */
+    uint64_t getRevision() const;
+
+    /** Adds a program, or replaces the one with the same primaryId. */
+    void updateProgram(const VirtualProgram& program);
+    bool removeProgram(const ProgramIdentifier& id);
+
    private:
     mutable std::mutex mMut;
     std::string mName;
-    std::vector<VirtualProgram> mPrograms;
+    // Sorted in scan order; set nodes also keep program addresses stable across updates.
+    std::set<VirtualProgram> mPrograms;
+    uint64_t mRevision = 0;
 };
 
 /** AM/FM virtual radio space. */
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../VirtualRadio.h"
+
+#include <benchmark/benchmark.h>
+#include <broadcastradio-utils-2x/Utils.h>
+
+namespace android {
+namespace hardware {
+namespace broadcastradio {
+namespace V2_0 {
+namespace implementation {
+namespace {
+
+using std::vector;
+
+constexpr size_t kChunkSize = 64 * 1024;
+
+ProgramSelector makeSelectorHd(uint32_t frequency, uint32_t stationId, uint32_t subchannel) {
+    ProgramSelector sel = {};
+    uint64_t id = stationId | (static_cast<uint64_t>(subchannel) << 32) |
+                  (static_cast<uint64_t>(frequency) << 36);
+    sel.primaryId = utils::make_identifier(IdentifierType::HD_STATION_ID_EXT, id);
+    sel.secondaryIds = hidl_vec<ProgramIdentifier>({
+            utils::make_identifier(IdentifierType::AMFM_FREQUENCY, frequency),
+    });
+    return sel;
+}
+
+// Half DAB services spread over ensembles, half HD Radio subchannels spread over the FM band.
+vector<VirtualProgram> makePrograms(size_t count) {
+    vector<VirtualProgram> programs;
+    programs.reserve(count);
+    for (uint32_t i = 0; programs.size() < count; ++i) {
+        auto name = "Station " + std::to_string(i);
+        if (i % 2 == 0) {
+            auto sel = utils::make_selector_dab(0xE10000 + i, 0xCE15 + i / 32);
+            programs.push_back({sel, name, "Artist", "Song"});
+        } else {
+            auto frequency = 87900 + (i / 16) % 100 * 200;
+            auto sel = makeSelectorHd(frequency, 1000 + i, i % 8);
+            programs.push_back({sel, name, "Artist", "Song"});
+        }
+    }
+    return programs;
+}
+
+void countArgs(benchmark::internal::Benchmark* b) {
+    b->Arg(5000)->Arg(10000);
+}
+
+// The first update after startProgramListUpdates(): the whole list, in chunks.
+void BM_FullUpdate(benchmark::State& state) {
+    VirtualRadio radio("benchmark", makePrograms(state.range(0)));
+    size_t chunks = 0;
+    for (auto _ : state) {
+        utils::ProgramInfoSet sent;
+        utils::ProgramInfoSet list;
+        radio.getProgramList({}, list);
+        chunks = utils::makeProgramListChunks(sent, std::move(list), true, kChunkSize).size();
+    }
+    state.counters["chunks"] = chunks;
+}
+BENCHMARK(BM_FullUpdate)->Apply(countArgs);
+
+// A rescan after a few stations changed their metadata and one went off the air.
+void BM_IncrementalUpdate(benchmark::State& state) {
+    auto programs = makePrograms(state.range(0));
+    VirtualRadio radio("benchmark", programs);
+    utils::ProgramInfoSet sent;
+    utils::ProgramInfoSet initial;
+    radio.getProgramList({}, initial);
+    utils::makeProgramListChunks(sent, std::move(initial), true, kChunkSize);
+
+    uint32_t song = 0;
+    size_t modified = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (size_t i = 0; i < 10; ++i) {
+            auto program = programs[(song * 10 + i) * 97 % programs.size()];
+            program.songTitle = "Song " + std::to_string(song);
+            radio.updateProgram(program);
+        }
+        radio.removeProgram(programs[song * 89 % programs.size()].selector.primaryId);
+        song++;
+        state.ResumeTiming();
+
+        utils::ProgramInfoSet list;
+        radio.getProgramList({}, list);
+        auto chunks = utils::makeProgramListChunks(sent, std::move(list), false, kChunkSize);
+        modified = chunks.empty() ? 0 : chunks[0].modified.size();
+    }
+    state.counters["modified"] = modified;
+}
+BENCHMARK(BM_IncrementalUpdate)->Apply(countArgs);
+
+// The view startProgramListUpdates() takes of the index for a DAB-only filter.
+void BM_FilteredList(benchmark::State& state) {
+    VirtualRadio radio("benchmark", makePrograms(state.range(0)));
+    ProgramFilter filter = {};
+    filter.identifierTypes = hidl_vec<uint32_t>({
+            static_cast<uint32_t>(IdentifierType::DAB_SID_EXT),
+    });
+    for (auto _ : state) {
+        utils::ProgramInfoSet list;
+        radio.getProgramList(filter, list);
+        benchmark::DoNotOptimize(list.size());
+    }
+}
+BENCHMARK(BM_FilteredList)->Apply(countArgs);
+
+void BM_Seek(benchmark::State& state) {
+    auto programs = makePrograms(state.range(0));
+    VirtualRadio radio("benchmark", programs);
+    VirtualProgram current = programs[programs.size() / 2];
+    for (auto _ : state) {
+        radio.getNextProgram(current.selector, true, current);
+    }
+}
+BENCHMARK(BM_Seek)->Apply(countArgs);
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace broadcastradio
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
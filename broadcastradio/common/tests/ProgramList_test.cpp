@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <broadcastradio-utils-2x/Utils.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+namespace V2_0 = android::hardware::broadcastradio::V2_0;
+namespace utils = android::hardware::broadcastradio::utils;
+
+static constexpr size_t kChunkSize = 64 * 1024;
+
+V2_0::ProgramInfo makeProgramInfo(uint32_t sid, const std::string& title) {
+    V2_0::ProgramInfo info = {};
+    info.selector = utils::make_selector_dab(0xE10000 + sid, 0xCE15);
+    info.metadata = android::hardware::hidl_vec<V2_0::Metadata>({
+            utils::make_metadata(V2_0::MetadataKey::SONG_TITLE, title),
+    });
+    return info;
+}
+
+utils::ProgramInfoSet makeProgramList(uint32_t count, const std::string& title) {
+    utils::ProgramInfoSet list;
+    for (uint32_t sid = 0; sid < count; sid++) {
+        list.insert(makeProgramInfo(sid, title));
+    }
+    return list;
+}
+
+TEST(ProgramListTest, purgeSendsWholeListInChunks) {
+    auto current = makeProgramList(5000, "Song");
+    utils::ProgramInfoSet sent;
+    auto chunks = utils::makeProgramListChunks(sent, current, true, kChunkSize);
+
+    ASSERT_GT(chunks.size(), 1u);
+    utils::ProgramInfoSet client = makeProgramList(10, "Stale");
+    for (size_t i = 0; i < chunks.size(); i++) {
+        EXPECT_EQ(i == 0, chunks[i].purge);
+        EXPECT_EQ(i == chunks.size() - 1, chunks[i].complete);
+        EXPECT_EQ(0u, chunks[i].removed.size());
+        utils::updateProgramList(client, chunks[i]);
+    }
+    EXPECT_EQ(current.size(), client.size());
+    EXPECT_EQ(current.size(), sent.size());
+}
+
+TEST(ProgramListTest, purgeOfEmptyListCompletes) {
+    utils::ProgramInfoSet sent = makeProgramList(3, "Song");
+    auto chunks = utils::makeProgramListChunks(sent, {}, true, kChunkSize);
+
+    ASSERT_EQ(1u, chunks.size());
+    EXPECT_TRUE(chunks[0].purge);
+    EXPECT_TRUE(chunks[0].complete);
+    EXPECT_EQ(0u, chunks[0].modified.size());
+    EXPECT_TRUE(sent.empty());
+}
+
+TEST(ProgramListTest, updateSendsOnlyChanges) {
+    utils::ProgramInfoSet sent = makeProgramList(100, "Song");
+    utils::ProgramInfoSet client = sent;
+
+    auto current = makeProgramList(100, "Song");
+    current.erase(makeProgramInfo(7, ""));
+    current.erase(makeProgramInfo(42, ""));
+    current.insert(makeProgramInfo(42, "Other song"));
+    current.insert(makeProgramInfo(100, "Song"));
+    auto chunks = utils::makeProgramListChunks(sent, current, false, kChunkSize);
+
+    ASSERT_EQ(1u, chunks.size());
+    EXPECT_FALSE(chunks[0].purge);
+    EXPECT_TRUE(chunks[0].complete);
+    EXPECT_EQ(2u, chunks[0].modified.size());
+    ASSERT_EQ(1u, chunks[0].removed.size());
+    EXPECT_EQ(makeProgramInfo(7, "").selector.primaryId, chunks[0].removed[0]);
+
+    utils::updateProgramList(client, chunks[0]);
+    EXPECT_EQ(current.size(), client.size());
+    for (auto&& info : current) {
+        auto it = client.find(info);
+        ASSERT_NE(client.end(), it);
+        EXPECT_EQ(info, *it);
+    }
+
+    EXPECT_TRUE(utils::makeProgramListChunks(sent, current, false, kChunkSize).empty());
+}
+
+}  // anonymous namespace
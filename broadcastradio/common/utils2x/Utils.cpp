@@ -371,7 +371,11 @@ bool ProgramInfoKeyEqual::operator()(const ProgramInfo& info1, const ProgramInfo
 void updateProgramList(ProgramInfoSet& list, const ProgramListChunk& chunk) {
     if (chunk.purge) list.clear();
 
-    list.insert(chunk.modified.begin(), chunk.modified.end());
+    // Modified entries replace the ones with the same primaryId.
+    for (auto&& info : chunk.modified) {
+        list.erase(info);
+        list.insert(info);
+    }
 
     for (auto&& id : chunk.removed) {
         ProgramInfo info = {};
@@ -380,6 +384,80 @@ void updateProgramList(ProgramInfoSet& list, const ProgramListChunk& chunk) {
     }
 }
 
+/* Rough size of an entry in a parcel: every vector and string is a separate buffer there,
+ * which comes with a buffer object on top of its contents. */
+static constexpr size_t kParcelBufferOverhead = 40;
+
+static size_t getParceledSize(const hidl_string& str) {
+    return kParcelBufferOverhead + str.size() + 1;
+}
+
+static size_t getParceledSize(const ProgramInfo& info) {
+    size_t size = sizeof(ProgramInfo);
+    size += kParcelBufferOverhead +
+            info.selector.secondaryIds.size() * sizeof(ProgramIdentifier);
+    size += kParcelBufferOverhead + info.relatedContent.size() * sizeof(ProgramIdentifier);
+    size += kParcelBufferOverhead + info.metadata.size() * sizeof(Metadata);
+    for (auto&& item : info.metadata) {
+        size += getParceledSize(item.stringValue);
+    }
+    size += kParcelBufferOverhead + info.vendorInfo.size() * sizeof(V2_0::VendorKeyValue);
+    for (auto&& kv : info.vendorInfo) {
+        size += getParceledSize(kv.key) + getParceledSize(kv.value);
+    }
+    return size;
+}
+
+vector<ProgramListChunk> makeProgramListChunks(ProgramInfoSet& list, ProgramInfoSet current,
+                                               bool purge, size_t maxChunkBytes) {
+    vector<ProgramListChunk> chunks;
+    vector<ProgramInfo> modified;
+    vector<ProgramIdentifier> removed;
+    size_t chunkSize = 0;
+
+    auto flush = [&]() {
+        ProgramListChunk chunk = {};
+        chunk.purge = purge && chunks.empty();
+        chunk.modified = modified;
+        chunk.removed = removed;
+        chunks.push_back(std::move(chunk));
+        modified.clear();
+        removed.clear();
+        chunkSize = 0;
+    };
+    auto reserve = [&](size_t size) {
+        if (chunkSize + size > maxChunkBytes && (!modified.empty() || !removed.empty())) {
+            flush();
+        }
+        chunkSize += size;
+    };
+
+    // A purge drops everything on the client side, so there is nothing left to remove.
+    if (!purge) {
+        for (auto&& info : list) {
+            if (current.count(info) > 0) continue;
+            reserve(sizeof(ProgramIdentifier));
+            removed.push_back(info.selector.primaryId);
+        }
+    }
+    for (auto&& info : current) {
+        if (!purge) {
+            auto it = list.find(info);
+            if (it != list.end() && *it == info) continue;
+        }
+        reserve(getParceledSize(info));
+        modified.push_back(info);
+    }
+
+    if (!modified.empty() || !removed.empty() || purge) {
+        flush();
+        chunks.back().complete = true;
+    }
+
+    list = std::move(current);
+    return chunks;
+}
+
 std::optional<std::string> getMetadataString(const V2_0::ProgramInfo& info,
                                              const V2_0::MetadataKey key) {
     auto isKey = [key](const V2_0::Metadata& item) {
@@ -145,6 +145,23 @@ typedef std::unordered_set<V2_0::ProgramInfo, ProgramInfoHasher, ProgramInfoKeyE
 
 void updateProgramList(ProgramInfoSet& list, const V2_0::ProgramListChunk& chunk);
 
+/**
+ * Makes the chunks that bring a client's program list up to date.
+ *
+ * Only programs that were added, changed or removed since the client got {@code list} are
+ * sent. They are split into chunks of about {@code maxChunkBytes} when parceled, to stay well
+ * below the binder transaction limit. The last chunk has the complete flag set.
+ *
+ * @param list Programs the client already has; replaced with {@code current}.
+ * @param current Programs the client should have.
+ * @param purge Clear the client's list with the first chunk and send all of {@code current}.
+ * @param maxChunkBytes Size the chunks should fit in.
+ * @return Chunks to send in order; empty if neither purging nor anything changed.
+ */
+std::vector<V2_0::ProgramListChunk> makeProgramListChunks(ProgramInfoSet& list,
+                                                          ProgramInfoSet current, bool purge,
+                                                          size_t maxChunkBytes);
+
 std::optional<std::string> getMetadataString(const V2_0::ProgramInfo& info,
                                              const V2_0::MetadataKey key);
 
@@ -18,13 +18,21 @@
 
 #include "Gnss.h"
 #include "GnssAntennaInfo.h"
+#include "GnssBatching.h"
 #include "GnssDebug.h"
 #include "GnssMeasurement.h"
 #include "GnssMeasurementCorrections.h"
 #include "Utils.h"
 
+#include <android-base/parsedouble.h>
+#include <android-base/properties.h>
 #include <log/log.h>
 
+using ::android::base::GetProperty;
+using ::android::base::ParseDouble;
+using ::android::hardware::gnss::common::GnssEpoch;
+using ::android::hardware::gnss::common::GnssReplayEngine;
+using ::android::hardware::gnss::common::NmeaTrace;
 using ::android::hardware::gnss::common::Utils;
 using ::android::hardware::gnss::measurement_corrections::V1_1::implementation::
         GnssMeasurementCorrections;
@@ -40,7 +48,33 @@ sp<V2_0::IGnssCallback> Gnss::sGnssCallback_2_0 = nullptr;
 sp<V1_1::IGnssCallback> Gnss::sGnssCallback_1_1 = nullptr;
 sp<V1_0::IGnssCallback> Gnss::sGnssCallback_1_0 = nullptr;
 
-Gnss::Gnss() : mMinIntervalMs(1000), mGnssConfiguration{new GnssConfiguration()} {}
+// An NMEA trace to replay instead of reporting the mock location, e.g. a recorded drive, and how
+// many times faster than real time to play it.
+constexpr char kReplayFileProperty[] = "vendor.gnss.replay.file";
+constexpr char kReplaySpeedProperty[] = "vendor.gnss.replay.speed";
+
+static std::shared_ptr<GnssReplayEngine> createReplayEngine() {
+    std::unique_ptr<NmeaTrace> trace;
+    std::string path = GetProperty(kReplayFileProperty, "");
+    if (!path.empty()) {
+        trace = NmeaTrace::open(path);
+    }
+    double speed = 1.0;
+    std::string speedValue = GetProperty(kReplaySpeedProperty, "");
+    if (!speedValue.empty() && !ParseDouble(speedValue, &speed, 0.01, 1000.0)) {
+        ALOGE("%s: Ignoring invalid replay speed %s", __func__, speedValue.c_str());
+        speed = 1.0;
+    }
+    return std::make_shared<GnssReplayEngine>(std::move(trace), speed);
+}
+
+Gnss::Gnss()
+    : mMinIntervalMs(1000),
+      mGnssConfiguration{new GnssConfiguration()},
+      mIsActive(false),
+      mReplayEngine(createReplayEngine()),
+      mGnssDebug{new V1_1::implementation::GnssDebug(mReplayEngine)},
+      mListenerId(-1) {}
 
 Gnss::~Gnss() {
     stop();
@@ -54,25 +88,38 @@ Return<bool> Gnss::start() {
     }
 
     mIsActive = true;
-    mThread = std::thread([this]() {
-        while (mIsActive == true) {
-            auto svStatus = filterBlacklistedSatellitesV2_1(Utils::getMockSvInfoListV2_1());
-            this->reportSvStatus(svStatus);
-
-            if (sGnssCallback_2_1 != nullptr || sGnssCallback_2_0 != nullptr) {
-                const auto location = Utils::getMockLocationV2_0();
-                this->reportLocation(location);
-            } else {
-                const auto location = Utils::getMockLocationV1_0();
-                this->reportLocation(location);
-            }
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(mMinIntervalMs));
-        }
-    });
+    int id = mReplayEngine->addListener("location", std::chrono::milliseconds(mMinIntervalMs),
+                                        [this](const GnssEpoch* epoch) { reportEpoch(epoch); });
+    // A concurrent start() may have added a listener since stop(); only one of them is kept.
+    int previousId = mListenerId.exchange(id);
+    if (previousId >= 0) {
+        mReplayEngine->removeListener(previousId);
+    }
     return true;
 }
 
+void Gnss::reportEpoch(const GnssEpoch* epoch) {
+    auto svInfoList = epoch != nullptr ? Utils::getSvInfoListV2_1(*epoch)
+                                       : Utils::getMockSvInfoListV2_1();
+    auto svStatus = filterBlacklistedSatellitesV2_1(svInfoList);
+    this->reportSvStatus(svStatus);
+
+    if (epoch != nullptr &&
+        !(epoch->gnssLocationFlags & V1_0::GnssLocationFlags::HAS_LAT_LONG)) {
+        // The receiver had no fix at this point of the trace.
+        return;
+    }
+    if (sGnssCallback_2_1 != nullptr || sGnssCallback_2_0 != nullptr) {
+        const auto location = epoch != nullptr ? Utils::getLocationV2_0(*epoch)
+                                               : Utils::getMockLocationV2_0();
+        this->reportLocation(location);
+    } else {
+        const auto location = epoch != nullptr ? Utils::getLocationV1_0(*epoch)
+                                               : Utils::getMockLocationV1_0();
+        this->reportLocation(location);
+    }
+}
+
 hidl_vec<GnssSvInfo> Gnss::filterBlacklistedSatellitesV2_1(hidl_vec<GnssSvInfo> gnssSvInfoList) {
     for (uint32_t i = 0; i < gnssSvInfoList.size(); i++) {
         if (mGnssConfiguration->isBlacklistedV2_1(gnssSvInfoList[i])) {
@@ -86,8 +133,9 @@ hidl_vec<GnssSvInfo> Gnss::filterBlacklistedSatellitesV2_1(hidl_vec<GnssSvInfo>
 Return<bool> Gnss::stop() {
     ALOGD("stop");
     mIsActive = false;
-    if (mThread.joinable()) {
-        mThread.join();
+    int id = mListenerId.exchange(-1);
+    if (id >= 0) {
+        mReplayEngine->removeListener(id);
     }
     return true;
 }
@@ -141,6 +189,10 @@ Return<bool> Gnss::setPositionMode(V1_0::IGnss::GnssPositionMode,
                                    V1_0::IGnss::GnssPositionRecurrence, uint32_t minIntervalMs,
                                    uint32_t, uint32_t) {
     mMinIntervalMs = minIntervalMs;
+    int id = mListenerId;
+    if (id >= 0) {
+        mReplayEngine->setInterval(id, std::chrono::milliseconds(mMinIntervalMs));
+    }
     return true;
 }
 
@@ -166,7 +218,7 @@ Return<sp<V1_0::IGnssNi>> Gnss::getExtensionGnssNi() {
 
 Return<sp<V1_0::IGnssMeasurement>> Gnss::getExtensionGnssMeasurement() {
     ALOGD("Gnss::getExtensionGnssMeasurement");
-    return new GnssMeasurement();
+    return new GnssMeasurement(mReplayEngine);
 }
 
 Return<sp<V1_0::IGnssNavigationMessage>> Gnss::getExtensionGnssNavigationMessage() {
@@ -185,7 +237,7 @@ Return<sp<V1_0::IGnssConfiguration>> Gnss::getExtensionGnssConfiguration() {
 }
 
 Return<sp<V1_0::IGnssDebug>> Gnss::getExtensionGnssDebug() {
-    return new V1_1::implementation::GnssDebug();
+    return mGnssDebug;
 }
 
 Return<sp<V1_0::IGnssBatching>> Gnss::getExtensionGnssBatching() {
@@ -228,6 +280,10 @@ Return<bool> Gnss::setPositionMode_1_1(V1_0::IGnss::GnssPositionMode,
                                        V1_0::IGnss::GnssPositionRecurrence, uint32_t minIntervalMs,
                                        uint32_t, uint32_t, bool) {
     mMinIntervalMs = minIntervalMs;
+    int id = mListenerId;
+    if (id >= 0) {
+        mReplayEngine->setInterval(id, std::chrono::milliseconds(mMinIntervalMs));
+    }
     return true;
 }
 
@@ -301,7 +357,7 @@ Return<sp<V2_0::IAGnssRil>> Gnss::getExtensionAGnssRil_2_0() {
 
 Return<sp<V2_0::IGnssMeasurement>> Gnss::getExtensionGnssMeasurement_2_0() {
     ALOGD("Gnss::getExtensionGnssMeasurement_2_0");
-    return new GnssMeasurement();
+    return new GnssMeasurement(mReplayEngine);
 }
 
 Return<sp<measurement_corrections::V1_0::IMeasurementCorrections>>
@@ -316,8 +372,8 @@ Return<sp<visibility_control::V1_0::IGnssVisibilityControl>> Gnss::getExtensionV
 }
 
 Return<sp<V2_0::IGnssBatching>> Gnss::getExtensionGnssBatching_2_0() {
-    // TODO implement
-    return ::android::sp<V2_0::IGnssBatching>{};
+    ALOGD("Gnss::getExtensionGnssBatching_2_0");
+    return new GnssBatching(mReplayEngine);
 }
 
 Return<bool> Gnss::injectBestLocation_2_0(const V2_0::GnssLocation&) {
@@ -362,7 +418,7 @@ Return<bool> Gnss::setCallback_2_1(const sp<V2_1::IGnssCallback>& callback) {
 
 Return<sp<V2_1::IGnssMeasurement>> Gnss::getExtensionGnssMeasurement_2_1() {
     ALOGD("Gnss::getExtensionGnssMeasurement_2_1");
-    return new GnssMeasurement();
+    return new GnssMeasurement(mReplayEngine);
 }
 
 Return<sp<V2_1::IGnssConfiguration>> Gnss::getExtensionGnssConfiguration_2_1() {
@@ -381,6 +437,10 @@ Return<sp<V2_1::IGnssAntennaInfo>> Gnss::getExtensionGnssAntennaInfo() {
     return new GnssAntennaInfo();
 }
 
+Return<void> Gnss::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& options) {
+    return mGnssDebug->debug(fd, options);
+}
+
 void Gnss::reportSvStatus(const hidl_vec<GnssSvInfo>& svInfoList) const {
     std::unique_lock<std::mutex> lock(mMutex);
     // TODO(skz): update this to call 2_0 callback if non-null
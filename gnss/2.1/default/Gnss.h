@@ -20,10 +20,12 @@
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 #include <atomic>
+#include <memory>
 #include <mutex>
-#include <thread>
 #include "GnssAntennaInfo.h"
 #include "GnssConfiguration.h"
+#include "GnssDebug.h"
+#include "GnssReplayEngine.h"
 
 namespace android {
 namespace hardware {
@@ -94,10 +96,14 @@ struct Gnss : public IGnss {
     getExtensionMeasurementCorrections_1_1() override;
     Return<sp<V2_1::IGnssAntennaInfo>> getExtensionGnssAntennaInfo() override;
 
+    // Methods from ::android::hidl::base::V1_0::IBase follow.
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& options) override;
+
   private:
     void reportLocation(const V2_0::GnssLocation&) const;
     void reportLocation(const V1_0::GnssLocation&) const;
     void reportSvStatus(const hidl_vec<GnssSvInfo>&) const;
+    void reportEpoch(const common::GnssEpoch* epoch);
 
     static sp<V2_1::IGnssCallback> sGnssCallback_2_1;
     static sp<V2_0::IGnssCallback> sGnssCallback_2_0;
@@ -106,7 +112,11 @@ struct Gnss : public IGnss {
     std::atomic<long> mMinIntervalMs;
     sp<GnssConfiguration> mGnssConfiguration;
     std::atomic<bool> mIsActive;
-    std::thread mThread;
+    // Drives location, measurement and batching reports, replaying a trace if one is set up.
+    std::shared_ptr<common::GnssReplayEngine> mReplayEngine;
+    sp<V1_1::implementation::GnssDebug> mGnssDebug;
+    // Set and cleared from different binder threads.
+    std::atomic<int> mListenerId;
     mutable std::mutex mMutex;
     hidl_vec<GnssSvInfo> filterBlacklistedSatellitesV2_1(hidl_vec<GnssSvInfo> gnssSvInfoList);
 };
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GnssBatching"
+
+#include "GnssBatching.h"
+#include <log/log.h>
+#include <cinttypes>
+#include "Utils.h"
+
+namespace android {
+namespace hardware {
+namespace gnss {
+
+using common::GnssEpoch;
+using common::GnssReplayEngine;
+using common::Utils;
+
+namespace V2_1 {
+namespace implementation {
+
+constexpr uint16_t GnssBatching::kBatchSize;
+
+GnssBatching::GnssBatching(std::shared_ptr<GnssReplayEngine> replayEngine)
+    : mReplayEngine(std::move(replayEngine)), mListenerId(-1), mWakeupOnFifoFull(false) {}
+
+GnssBatching::~GnssBatching() {
+    stop();
+}
+
+// Methods from ::android::hardware::gnss::V1_0::IGnssBatching follow.
+Return<bool> GnssBatching::init(const sp<V1_0::IGnssBatchingCallback>&) {
+    ALOGE("%s: Only the v2.0 callback is supported", __func__);
+    return false;
+}
+
+Return<uint16_t> GnssBatching::getBatchSize() {
+    return kBatchSize;
+}
+
+Return<bool> GnssBatching::start(const V1_0::IGnssBatching::Options& options) {
+    ALOGD("start: periodNanos %" PRIu64 ", flags 0x%x", options.periodNanos, options.flags);
+    stop();
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mCallback == nullptr) {
+            ALOGE("%s: init_2_0() has not been called", __func__);
+            return false;
+        }
+        mWakeupOnFifoFull = options.flags & V1_0::IGnssBatching::Flag::WAKEUP_ON_FIFO_FULL;
+    }
+
+    auto period = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::nanoseconds(options.periodNanos));
+    int id = mReplayEngine->addListener("batching", period, [this](const GnssEpoch* epoch) {
+        if (epoch == nullptr) {
+            addLocation(Utils::getMockLocationV2_0());
+        } else if (epoch->gnssLocationFlags & V1_0::GnssLocationFlags::HAS_LAT_LONG) {
+            addLocation(Utils::getLocationV2_0(*epoch));
+        }
+    });
+    // Drop the listener of a start() that raced with this one.
+    int previousId = mListenerId.exchange(id);
+    if (previousId >= 0) {
+        mReplayEngine->removeListener(previousId);
+    }
+    return true;
+}
+
+Return<void> GnssBatching::flush() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    deliverBatch(&lock);
+    return Void();
+}
+
+Return<bool> GnssBatching::stop() {
+    // The batch stays around for flush().
+    int id = mListenerId.exchange(-1);
+    if (id >= 0) {
+        mReplayEngine->removeListener(id);
+    }
+    return true;
+}
+
+Return<void> GnssBatching::cleanup() {
+    stop();
+    std::unique_lock<std::mutex> lock(mMutex);
+    mBatch.clear();
+    mCallback = nullptr;
+    return Void();
+}
+
+// Methods from V2_0::IGnssBatching follow.
+Return<bool> GnssBatching::init_2_0(const sp<V2_0::IGnssBatchingCallback>& callback) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCallback = callback;
+    return true;
+}
+
+void GnssBatching::addLocation(const V2_0::GnssLocation& location) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mBatch.size() == kBatchSize) {
+        mBatch.pop_front();
+    }
+    mBatch.push_back(location);
+    if (mBatch.size() == kBatchSize && mWakeupOnFifoFull) {
+        deliverBatch(&lock);
+    }
+}
+
+void GnssBatching::deliverBatch(std::unique_lock<std::mutex>* lock) {
+    hidl_vec<V2_0::GnssLocation> locations(mBatch.begin(), mBatch.end());
+    mBatch.clear();
+    sp<V2_0::IGnssBatchingCallback> callback = mCallback;
+    lock->unlock();
+
+    if (callback == nullptr) {
+        ALOGE("%s: No callback for %zu locations", __func__, locations.size());
+        return;
+    }
+    auto ret = callback->gnssLocationBatchCb(locations);
+    if (!ret.isOk()) {
+        ALOGE("%s: Unable to invoke callback", __func__);
+    }
+}
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/hardware/gnss/2.0/IGnssBatching.h>
+#include <hidl/MQDescriptor.h>
+#include <hidl/Status.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "GnssReplayEngine.h"
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace V2_1 {
+namespace implementation {
+
+using ::android::sp;
+using ::android::hardware::hidl_vec;
+using ::android::hardware::Return;
+using ::android::hardware::Void;
+
+/*
+ * Batches the locations of the replay engine at the requested period and hands them over in
+ * one gnssLocationBatchCb() on flush(), or as soon as the batch is full if the client asked to
+ * be woken up for it. Otherwise the oldest locations make room for new ones.
+ */
+struct GnssBatching : public V2_0::IGnssBatching {
+    explicit GnssBatching(std::shared_ptr<common::GnssReplayEngine> replayEngine);
+    ~GnssBatching();
+
+    // Methods from ::android::hardware::gnss::V1_0::IGnssBatching follow.
+    Return<bool> init(const sp<V1_0::IGnssBatchingCallback>& callback) override;
+    Return<uint16_t> getBatchSize() override;
+    Return<bool> start(const V1_0::IGnssBatching::Options& options) override;
+    Return<void> flush() override;
+    Return<bool> stop() override;
+    Return<void> cleanup() override;
+
+    // Methods from V2_0::IGnssBatching follow.
+    Return<bool> init_2_0(const sp<V2_0::IGnssBatchingCallback>& callback) override;
+
+  private:
+    static constexpr uint16_t kBatchSize = 256;
+
+    void addLocation(const V2_0::GnssLocation& location);
+    void deliverBatch(std::unique_lock<std::mutex>* lock);
+
+    const std::shared_ptr<common::GnssReplayEngine> mReplayEngine;
+    // start() and stop() can run on different binder threads.
+    std::atomic<int> mListenerId;
+
+    // Guards the members below.
+    std::mutex mMutex;
+    sp<V2_0::IGnssBatchingCallback> mCallback;
+    std::deque<V2_0::GnssLocation> mBatch;
+    bool mWakeupOnFifoFull;
+};
+
+}  // namespace implementation
+}  // namespace V2_1
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
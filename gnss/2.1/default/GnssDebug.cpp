@@ -29,8 +29,34 @@ namespace gnss {
 namespace V1_1 {
 namespace implementation {
 
+GnssDebug::GnssDebug(std::shared_ptr<GnssReplayEngine> replayEngine)
+    : mReplayEngine(std::move(replayEngine)) {}
+
 // Methods from ::android::hardware::gnss::V1_0::IGnssDebug follow.
 Return<void> GnssDebug::getDebugData(V1_0::IGnssDebug::getDebugData_cb _hidl_cb) {
+    GnssEpoch epoch;
+    if (mReplayEngine->getLastEpoch(&epoch)) {
+        PositionDebug positionDebug = {
+                .valid = static_cast<bool>(epoch.gnssLocationFlags &
+                                           V1_0::GnssLocationFlags::HAS_LAT_LONG),
+                .latitudeDegrees = epoch.latitudeDegrees,
+                .longitudeDegrees = epoch.longitudeDegrees,
+                .altitudeMeters = static_cast<float>(epoch.altitudeMeters),
+                .speedMetersPerSec = epoch.speedMetersPerSec,
+                .bearingDegrees = epoch.bearingDegrees,
+                .horizontalAccuracyMeters = epoch.horizontalAccuracyMeters,
+                .verticalAccuracyMeters = epoch.verticalAccuracyMeters,
+                .speedAccuracyMetersPerSecond = kMockSpeedAccuracyMetersPerSecond,
+                .bearingAccuracyDegrees = kMockBearingAccuracyDegrees,
+                .ageSeconds = 0};
+        TimeDebug timeDebug = {.timeEstimate = epoch.utcTimeMs,
+                               .timeUncertaintyNs = 1000,
+                               .frequencyUncertaintyNsPerSec = 5.0e4};
+        DebugData data = {.position = positionDebug, .time = timeDebug};
+        _hidl_cb(data);
+        return Void();
+    }
+
     PositionDebug positionDebug = {
             .valid = true,
             .latitudeDegrees = kMockLatitudeDegrees,
@@ -55,6 +81,16 @@ Return<void> GnssDebug::getDebugData(V1_0::IGnssDebug::getDebugData_cb _hidl_cb)
     return Void();
 }
 
+// Methods from ::android::hidl::base::V1_0::IBase follow.
+Return<void> GnssDebug::debug(const hidl_handle& fd, const hidl_vec<hidl_string>&) {
+    if (fd == nullptr || fd->numFds == 0) {
+        ALOGE("%s: No fd to write to", __func__);
+        return Void();
+    }
+    mReplayEngine->dump(fd->data[0]);
+    return Void();
+}
+
 }  // namespace implementation
 }  // namespace V1_1
 }  // namespace gnss
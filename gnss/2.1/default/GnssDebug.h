@@ -19,6 +19,8 @@
 
 #include <android/hardware/gnss/1.0/IGnssDebug.h>
 #include <hidl/Status.h>
+#include <memory>
+#include "GnssReplayEngine.h"
 
 namespace android {
 namespace hardware {
@@ -27,19 +29,31 @@ namespace V1_1 {
 namespace implementation {
 
 using ::android::sp;
+using ::android::hardware::hidl_handle;
 using ::android::hardware::hidl_string;
 using ::android::hardware::hidl_vec;
 using ::android::hardware::Return;
 using ::android::hardware::Void;
 using V1_0::IGnssDebug;
 
-/* Interface for GNSS Debug support. */
+/*
+ * Interface for GNSS Debug support. Reports the position being replayed, and the timing of the
+ * replay engine's reports through debug().
+ */
 struct GnssDebug : public IGnssDebug {
+    explicit GnssDebug(std::shared_ptr<common::GnssReplayEngine> replayEngine);
+
     /*
      * Methods from ::android::hardware::gnss::V1_0::IGnssDebug follow.
      * These declarations were generated from IGnssDebug.hal.
      */
     Return<void> getDebugData(V1_0::IGnssDebug::getDebugData_cb _hidl_cb) override;
+
+    // Methods from ::android::hidl::base::V1_0::IBase follow.
+    Return<void> debug(const hidl_handle& fd, const hidl_vec<hidl_string>& options) override;
+
+  private:
+    const std::shared_ptr<common::GnssReplayEngine> mReplayEngine;
 };
 
 }  // namespace implementation
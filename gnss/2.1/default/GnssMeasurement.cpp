@@ -24,6 +24,8 @@ namespace android {
 namespace hardware {
 namespace gnss {
 
+using common::GnssEpoch;
+using common::GnssReplayEngine;
 using common::Utils;
 
 namespace V2_1 {
@@ -32,7 +34,11 @@ namespace implementation {
 sp<V2_1::IGnssMeasurementCallback> GnssMeasurement::sCallback_2_1 = nullptr;
 sp<V2_0::IGnssMeasurementCallback> GnssMeasurement::sCallback_2_0 = nullptr;
 
-GnssMeasurement::GnssMeasurement() : mMinIntervalMillis(1000) {}
+GnssMeasurement::GnssMeasurement(std::shared_ptr<GnssReplayEngine> replayEngine)
+    : mMinIntervalMillis(1000),
+      mIsActive(false),
+      mReplayEngine(std::move(replayEngine)),
+      mListenerId(-1) {}
 
 GnssMeasurement::~GnssMeasurement() {
     stop();
@@ -65,9 +71,12 @@ Return<V1_0::IGnssMeasurement::GnssMeasurementStatus> GnssMeasurement::setCallba
 Return<V1_0::IGnssMeasurement::GnssMeasurementStatus> GnssMeasurement::setCallback_2_0(
         const sp<V2_0::IGnssMeasurementCallback>& callback, bool) {
     ALOGD("setCallback_2_0");
-    std::unique_lock<std::mutex> lock(mMutex);
-    sCallback_2_0 = callback;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        sCallback_2_0 = callback;
+    }
 
+    // Not under mMutex, which the measurement listener takes while stop() waits for it.
     if (mIsActive) {
         ALOGW("GnssMeasurement callback already set. Resetting the callback...");
         stop();
@@ -81,8 +90,10 @@ Return<V1_0::IGnssMeasurement::GnssMeasurementStatus> GnssMeasurement::setCallba
 Return<V1_0::IGnssMeasurement::GnssMeasurementStatus> GnssMeasurement::setCallback_2_1(
         const sp<V2_1::IGnssMeasurementCallback>& callback, bool) {
     ALOGD("setCallback_2_1");
-    std::unique_lock<std::mutex> lock(mMutex);
-    sCallback_2_1 = callback;
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        sCallback_2_1 = callback;
+    }
 
     if (mIsActive) {
         ALOGW("GnssMeasurement callback already set. Resetting the callback...");
@@ -96,26 +107,32 @@ Return<V1_0::IGnssMeasurement::GnssMeasurementStatus> GnssMeasurement::setCallba
 void GnssMeasurement::start() {
     ALOGD("start");
     mIsActive = true;
-    mThread = std::thread([this]() {
-        while (mIsActive == true) {
-            if (sCallback_2_1 != nullptr) {
-                auto measurement = Utils::getMockMeasurementV2_1();
-                this->reportMeasurement(measurement);
-            } else {
-                auto measurement = Utils::getMockMeasurementV2_0();
-                this->reportMeasurement(measurement);
-            }
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(mMinIntervalMillis));
-        }
-    });
+    int id = mReplayEngine->addListener(
+            "measurement", std::chrono::milliseconds(mMinIntervalMillis),
+            [this](const GnssEpoch* epoch) {
+                if (sCallback_2_1 != nullptr) {
+                    auto measurement = epoch != nullptr ? Utils::getMeasurementV2_1(*epoch)
+                                                        : Utils::getMockMeasurementV2_1();
+                    this->reportMeasurement(measurement);
+                } else {
+                    auto measurement = epoch != nullptr ? Utils::getMeasurementV2_0(*epoch)
+                                                        : Utils::getMockMeasurementV2_0();
+                    this->reportMeasurement(measurement);
+                }
+            });
+    // Drop the listener of a start() that raced with this one.
+    int previousId = mListenerId.exchange(id);
+    if (previousId >= 0) {
+        mReplayEngine->removeListener(previousId);
+    }
 }
 
 void GnssMeasurement::stop() {
     ALOGD("stop");
     mIsActive = false;
-    if (mThread.joinable()) {
-        mThread.join();
+    int id = mListenerId.exchange(-1);
+    if (id >= 0) {
+        mReplayEngine->removeListener(id);
     }
 }
 
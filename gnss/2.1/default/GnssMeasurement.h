@@ -20,8 +20,9 @@
 #include <hidl/MQDescriptor.h>
 #include <hidl/Status.h>
 #include <atomic>
+#include <memory>
 #include <mutex>
-#include <thread>
+#include "GnssReplayEngine.h"
 
 namespace android {
 namespace hardware {
@@ -41,7 +42,7 @@ using ::android::hardware::Return;
 using ::android::hardware::Void;
 
 struct GnssMeasurement : public IGnssMeasurement {
-    GnssMeasurement();
+    explicit GnssMeasurement(std::shared_ptr<common::GnssReplayEngine> replayEngine);
     ~GnssMeasurement();
     // Methods from V1_0::IGnssMeasurement follow.
     Return<V1_0::IGnssMeasurement::GnssMeasurementStatus> setCallback(
@@ -74,7 +75,9 @@ struct GnssMeasurement : public IGnssMeasurement {
 
     std::atomic<long> mMinIntervalMillis;
     std::atomic<bool> mIsActive;
-    std::thread mThread;
+    const std::shared_ptr<common::GnssReplayEngine> mReplayEngine;
+    // start() and stop() can run on different binder threads.
+    std::atomic<int> mListenerId;
 
     // Synchronization lock for sCallback_2_1 and sCallback_2_0
     mutable std::mutex mMutex;
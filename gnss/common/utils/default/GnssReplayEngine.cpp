@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "GnssReplayEngine"
+
+#include <GnssReplayEngine.h>
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <vector>
+
+#include <log/log.h>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace common {
+
+using GnssLocationFlags = V1_0::GnssLocationFlags;
+using std::chrono::duration;
+
+constexpr std::chrono::milliseconds GnssReplayEngine::kMinInterval;
+
+namespace {
+
+double lerp(double from, double to, double fraction) {
+    return from + (to - from) * fraction;
+}
+
+// Interpolates between two angles in degrees along the shorter way around.
+double lerpDegrees(double from, double to, double fraction) {
+    double delta = std::remainder(to - from, 360.0);
+    return from + delta * fraction;
+}
+
+}  // namespace
+
+void GnssReplayEngine::Stats::add(double latenessUs, uint64_t missedIntervals) {
+    calls++;
+    missed += missedIntervals;
+    latenessSumUs += latenessUs;
+    latenessSquareSumUs += latenessUs * latenessUs;
+    maxLatenessUs = std::max(maxLatenessUs, latenessUs);
+}
+
+void GnssReplayEngine::Stats::merge(const Stats& other) {
+    calls += other.calls;
+    missed += other.missed;
+    latenessSumUs += other.latenessSumUs;
+    latenessSquareSumUs += other.latenessSquareSumUs;
+    maxLatenessUs = std::max(maxLatenessUs, other.maxLatenessUs);
+}
+
+GnssReplayEngine::GnssReplayEngine(std::unique_ptr<NmeaTrace> trace, double speed)
+    : mTrace(std::move(trace)), mSpeed(speed > 0 ? speed : 1), mStartTime(Clock::now()) {
+    if (mTrace != nullptr) {
+        updateEpoch(mStartTime);
+    }
+    mThread = std::thread([this]() { run(); });
+}
+
+GnssReplayEngine::~GnssReplayEngine() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_one();
+    if (mThread.joinable()) {
+        mThread.join();
+    }
+}
+
+int GnssReplayEngine::addListener(const std::string& name, std::chrono::milliseconds interval,
+                                  Listener listener) {
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        id = mNextId++;
+        Entry& entry = mEntries[id];
+        entry.name = name;
+        entry.interval = std::max(interval, kMinInterval);
+        entry.deadline = Clock::now();
+        entry.listener = std::make_shared<Listener>(std::move(listener));
+    }
+    mCondition.notify_one();
+    return id;
+}
+
+void GnssReplayEngine::setInterval(int id, std::chrono::milliseconds interval) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mEntries.find(id);
+        if (it == mEntries.end()) return;
+        Entry& entry = it->second;
+        Clock::duration newInterval = std::max(interval, kMinInterval);
+        entry.deadline += newInterval - entry.interval;
+        entry.interval = newInterval;
+    }
+    mCondition.notify_one();
+}
+
+void GnssReplayEngine::removeListener(int id) {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mEntries.find(id);
+        if (it == mEntries.end()) return;
+        mFinishedStats[it->second.name].merge(it->second.stats);
+        mEntries.erase(it);
+    }
+    if (std::this_thread::get_id() != mThread.get_id()) {
+        // The engine thread picks the listeners to call and takes this lock under mMutex, so
+        // once we get it, a call to the removed listener is either done or never happens.
+        std::lock_guard<std::mutex> dispatchLock(mDispatchMutex);
+    }
+}
+
+bool GnssReplayEngine::getLastEpoch(GnssEpoch* epoch) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mTrace == nullptr) return false;
+    *epoch = mEpoch;
+    return true;
+}
+
+void GnssReplayEngine::run() {
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mStopping) {
+        if (mEntries.empty()) {
+            mCondition.wait(lock);
+            continue;
+        }
+        Clock::time_point deadline = Clock::time_point::max();
+        for (const auto& [id, entry] : mEntries) {
+            deadline = std::min(deadline, entry.deadline);
+        }
+        // Woken up early when listeners come and go; look at the deadlines again.
+        if (mCondition.wait_until(lock, deadline) == std::cv_status::no_timeout) continue;
+
+        Clock::time_point now = Clock::now();
+        std::vector<std::shared_ptr<Listener>> due;
+        for (auto& [id, entry] : mEntries) {
+            if (entry.deadline > now) continue;
+            double latenessUs = duration<double, std::micro>(now - entry.deadline).count();
+            entry.deadline += entry.interval;
+            uint64_t missed = 0;
+            if (entry.deadline <= now) {
+                // Fell behind by whole intervals; skip them instead of calling back to back.
+                missed = (now - entry.deadline) / entry.interval + 1;
+                entry.deadline += missed * entry.interval;
+            }
+            entry.stats.add(latenessUs, missed);
+            due.push_back(entry.listener);
+        }
+        if (due.empty()) continue;
+
+        if (mTrace != nullptr) {
+            updateEpoch(now);
+        }
+        const GnssEpoch epoch = mEpoch;
+
+        std::unique_lock<std::mutex> dispatchLock(mDispatchMutex);
+        lock.unlock();
+        // Serially: a slow listener holds up the ones after it, see the class comment.
+        for (const auto& listener : due) {
+            (*listener)(mTrace != nullptr ? &epoch : nullptr);
+        }
+        dispatchLock.unlock();
+        lock.lock();
+    }
+}
+
+bool GnssReplayEngine::loadNextEpoch(size_t index) {
+    if (index + 1 < mTrace->size()) {
+        return mTrace->getEpoch(index + 1, &mCachedNextEpoch);
+    }
+    mCachedNextEpoch = mCachedEpoch;
+    return true;
+}
+
+void GnssReplayEngine::updateEpoch(Clock::time_point now) {
+    const int64_t durationMs = mTrace->getDurationMs();
+    const double replayMs = duration<double, std::milli>(now - mStartTime).count() * mSpeed;
+    const int64_t loops = static_cast<int64_t>(replayMs) / durationMs;
+    const double timeMs = std::fmod(replayMs, static_cast<double>(durationMs));
+
+    const size_t index = mTrace->findEpoch(static_cast<int64_t>(timeMs));
+    if (index != mCachedIndex) {
+        bool ok;
+        if (mCachedIndex != SIZE_MAX && index == mCachedIndex + 1) {
+            // Moving on to the next epoch, which is already parsed.
+            std::swap(mCachedEpoch, mCachedNextEpoch);
+            ok = loadNextEpoch(index);
+        } else {
+            ok = mTrace->getEpoch(index, &mCachedEpoch) && loadNextEpoch(index);
+        }
+        if (!ok) {
+            ALOGE("%s: Unable to parse epoch %zu", __func__, index);
+            mCachedIndex = SIZE_MAX;
+            return;
+        }
+        mCachedIndex = index;
+    }
+
+    const GnssEpoch& from = mCachedEpoch;
+    const GnssEpoch& to = mCachedNextEpoch;
+    mEpoch = from;
+    const int64_t fromMs = mTrace->getTimeMs(index);
+    mEpoch.utcTimeMs = from.utcTimeMs - fromMs + loops * durationMs + static_cast<int64_t>(timeMs);
+
+    if (index + 1 >= mTrace->size()) return;
+    const int64_t toMs = mTrace->getTimeMs(index + 1);
+    const double fraction = std::clamp((timeMs - fromMs) / (toMs - fromMs), 0.0, 1.0);
+    auto both = [&from, &to](GnssLocationFlags flag) {
+        return (from.gnssLocationFlags & flag) && (to.gnssLocationFlags & flag);
+    };
+    if (both(GnssLocationFlags::HAS_LAT_LONG)) {
+        mEpoch.latitudeDegrees = lerp(from.latitudeDegrees, to.latitudeDegrees, fraction);
+        mEpoch.longitudeDegrees = std::remainder(
+                lerpDegrees(from.longitudeDegrees, to.longitudeDegrees, fraction), 360.0);
+    }
+    if (both(GnssLocationFlags::HAS_ALTITUDE)) {
+        mEpoch.altitudeMeters = lerp(from.altitudeMeters, to.altitudeMeters, fraction);
+    }
+    if (both(GnssLocationFlags::HAS_SPEED)) {
+        mEpoch.speedMetersPerSec = lerp(from.speedMetersPerSec, to.speedMetersPerSec, fraction);
+    }
+    if (both(GnssLocationFlags::HAS_BEARING)) {
+        double bearing = lerpDegrees(from.bearingDegrees, to.bearingDegrees, fraction);
+        mEpoch.bearingDegrees = bearing < 0 ? bearing + 360 : bearing;
+    }
+    if (both(GnssLocationFlags::HAS_HORIZONTAL_ACCURACY)) {
+        mEpoch.horizontalAccuracyMeters =
+                lerp(from.horizontalAccuracyMeters, to.horizontalAccuracyMeters, fraction);
+    }
+    if (both(GnssLocationFlags::HAS_VERTICAL_ACCURACY)) {
+        mEpoch.verticalAccuracyMeters =
+                lerp(from.verticalAccuracyMeters, to.verticalAccuracyMeters, fraction);
+    }
+}
+
+void GnssReplayEngine::dump(int fd) const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mTrace != nullptr) {
+        dprintf(fd, "Replaying %zu epochs over %" PRId64 " ms at %.2fx\n", mTrace->size(),
+                mTrace->getDurationMs(), mSpeed);
+    } else {
+        dprintf(fd, "No trace, reporting mock data\n");
+    }
+
+    auto print = [fd](const std::string& name, const char* state, const Stats& stats) {
+        double meanUs = stats.calls ? stats.latenessSumUs / stats.calls : 0;
+        double varianceUs =
+                stats.calls ? stats.latenessSquareSumUs / stats.calls - meanUs * meanUs : 0;
+        dprintf(fd,
+                "  %s%s: %" PRIu64 " calls, %" PRIu64
+                " intervals missed, lateness avg %.0f us, stddev %.0f us, max %.0f us\n",
+                name.c_str(), state, stats.calls, stats.missed, meanUs,
+                std::sqrt(std::max(varianceUs, 0.0)), stats.maxLatenessUs);
+    };
+    for (const auto& [id, entry] : mEntries) {
+        auto intervalMs = std::chrono::duration_cast<std::chrono::milliseconds>(entry.interval);
+        std::string state = " every " + std::to_string(intervalMs.count()) + " ms";
+        print(entry.name, state.c_str(), entry.stats);
+    }
+    for (const auto& [name, stats] : mFinishedStats) {
+        print(name, " (stopped)", stats);
+    }
+}
+
+}  // namespace common
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
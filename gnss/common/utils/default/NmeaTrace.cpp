@@ -0,0 +1,449 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "NmeaTrace"
+
+#include <NmeaTrace.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cmath>
+#include <cstdlib>
+#include <string_view>
+
+#include <log/log.h>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace common {
+
+using GnssConstellationType = V2_0::GnssConstellationType;
+using GnssLocationFlags = V1_0::GnssLocationFlags;
+
+namespace {
+
+constexpr int64_t kMillisPerDay = 24 * 60 * 60 * 1000;
+constexpr float kMetersPerSecPerKnot = 0.514444;
+// Typical user equivalent range error, to turn a dilution of precision into meters.
+constexpr float kUereMeters = 5.0;
+// Enough for the longest standard sentence, $--GSV with four satellites and a signal id.
+constexpr size_t kMaxFields = 24;
+
+struct Sentence {
+    std::string_view talker;  // e.g. "GP", "GN"
+    std::string_view type;    // e.g. "RMC", "GGA"
+    std::array<std::string_view, kMaxFields> fields;
+    size_t numFields;
+
+    std::string_view field(size_t i) const { return i < numFields ? fields[i] : ""; }
+};
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+// Splits "$GPRMC,...*hh" into its fields. Fails on malformed sentences, proprietary sentences
+// and checksum mismatches.
+bool parseSentence(std::string_view line, Sentence* sentence) {
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) line.remove_suffix(1);
+    if (line.size() < 6 || line[0] != '$') return false;
+    std::string_view body = line.substr(1);
+
+    size_t star = body.find('*');
+    if (star != std::string_view::npos) {
+        if (star + 3 != body.size()) return false;
+        int high = hexValue(body[star + 1]);
+        int low = hexValue(body[star + 2]);
+        if (high < 0 || low < 0) return false;
+        uint8_t checksum = 0;
+        for (size_t i = 0; i < star; i++) checksum ^= static_cast<uint8_t>(body[i]);
+        if (checksum != ((high << 4) | low)) return false;
+        body = body.substr(0, star);
+    }
+
+    sentence->numFields = 0;
+    while (sentence->numFields < kMaxFields) {
+        size_t comma = body.find(',');
+        sentence->fields[sentence->numFields++] = body.substr(0, comma);
+        if (comma == std::string_view::npos) break;
+        body.remove_prefix(comma + 1);
+    }
+
+    std::string_view address = sentence->fields[0];
+    if (address.size() != 5 || address[0] == 'P') return false;
+    sentence->talker = address.substr(0, 2);
+    sentence->type = address.substr(2);
+    return true;
+}
+
+// Calls |f| with the offset and contents of every line in [data, data + size).
+template <typename F>
+void forEachLine(const char* data, size_t size, F f) {
+    size_t offset = 0;
+    while (offset < size) {
+        const char* begin = data + offset;
+        const char* newline = static_cast<const char*>(memchr(begin, '\n', size - offset));
+        size_t length = newline != nullptr ? newline - begin : size - offset;
+        if (!f(offset, std::string_view(begin, length))) return;
+        offset += length + 1;
+    }
+}
+
+bool parseDouble(std::string_view s, double* value) {
+    char buffer[32];
+    if (s.empty() || s.size() >= sizeof(buffer)) return false;
+    memcpy(buffer, s.data(), s.size());
+    buffer[s.size()] = '\0';
+    char* end;
+    *value = strtod(buffer, &end);
+    return end == buffer + s.size();
+}
+
+bool parseFloat(std::string_view s, float* value) {
+    double d;
+    if (!parseDouble(s, &d)) return false;
+    *value = d;
+    return true;
+}
+
+bool parseInt(std::string_view s, int* value) {
+    double d;
+    if (!parseDouble(s, &d) || d != std::floor(d)) return false;
+    *value = d;
+    return true;
+}
+
+bool parseDigits(std::string_view s, int* value) {
+    *value = 0;
+    for (char c : s) {
+        if (c < '0' || c > '9') return false;
+        *value = *value * 10 + (c - '0');
+    }
+    return !s.empty();
+}
+
+// "hhmmss.sss" to milliseconds since midnight.
+bool parseTimeOfDay(std::string_view s, int64_t* timeOfDayMs) {
+    int hours, minutes;
+    double seconds;
+    if (s.size() < 6 || !parseDigits(s.substr(0, 2), &hours) ||
+        !parseDigits(s.substr(2, 2), &minutes) || !parseDouble(s.substr(4), &seconds)) {
+        return false;
+    }
+    *timeOfDayMs = (hours * 60 + minutes) * 60 * 1000 + std::llround(seconds * 1000);
+    return true;
+}
+
+// Days since 1970-01-01 of a date in the proleptic Gregorian calendar.
+int64_t daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int yearOfEra = year - era * 400;
+    const int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return static_cast<int64_t>(era) * 146097 + dayOfEra - 719468;
+}
+
+// "ddmmyy" to milliseconds since the epoch.
+bool parseDate(std::string_view s, int64_t* dateMs) {
+    int day, month, year;
+    if (s.size() != 6 || !parseDigits(s.substr(0, 2), &day) ||
+        !parseDigits(s.substr(2, 2), &month) || !parseDigits(s.substr(4, 2), &year) ||
+        month < 1 || month > 12 || day < 1 || day > 31) {
+        return false;
+    }
+    *dateMs = daysFromCivil(2000 + year, month, day) * kMillisPerDay;
+    return true;
+}
+
+// "ddmm.mmmm" or "dddmm.mmmm" and a hemisphere to signed degrees.
+bool parseCoordinate(std::string_view value, std::string_view hemisphere, double* degrees) {
+    double raw;
+    if (!parseDouble(value, &raw) || hemisphere.size() != 1) return false;
+    double wholeDegrees = std::floor(raw / 100);
+    *degrees = wholeDegrees + (raw - wholeDegrees * 100) / 60;
+    if (hemisphere[0] == 'S' || hemisphere[0] == 'W') *degrees = -*degrees;
+    return true;
+}
+
+// Maps the satellite number of a sentence from |talker| to the Android constellation and svid.
+// Mixed ("GN") and GPS talkers use the NMEA 4.x numbering ranges.
+bool toAndroidSv(std::string_view talker, int nmeaId, GnssConstellationType* constellation,
+                 int16_t* svid) {
+    if (talker == "GL") {
+        *constellation = GnssConstellationType::GLONASS;
+        *svid = nmeaId > 64 ? nmeaId - 64 : nmeaId;
+    } else if (talker == "GA") {
+        *constellation = GnssConstellationType::GALILEO;
+        *svid = nmeaId > 300 ? nmeaId - 300 : nmeaId;
+    } else if (talker == "GB" || talker == "BD") {
+        *constellation = GnssConstellationType::BEIDOU;
+        *svid = nmeaId > 200 ? nmeaId - 200 : nmeaId;
+    } else if (talker == "GQ") {
+        *constellation = GnssConstellationType::QZSS;
+        *svid = nmeaId < 193 ? nmeaId + 192 : nmeaId;
+    } else if (talker == "GI") {
+        *constellation = GnssConstellationType::IRNSS;
+        *svid = nmeaId;
+    } else if (nmeaId >= 1 && nmeaId <= 32) {
+        *constellation = GnssConstellationType::GPS;
+        *svid = nmeaId;
+    } else if (nmeaId >= 33 && nmeaId <= 64) {
+        *constellation = GnssConstellationType::SBAS;
+        *svid = nmeaId + 87;
+    } else if (nmeaId >= 65 && nmeaId <= 96) {
+        *constellation = GnssConstellationType::GLONASS;
+        *svid = nmeaId - 64;
+    } else if (nmeaId >= 193 && nmeaId <= 200) {
+        *constellation = GnssConstellationType::QZSS;
+        *svid = nmeaId;
+    } else if (nmeaId >= 201 && nmeaId <= 263) {
+        *constellation = GnssConstellationType::BEIDOU;
+        *svid = nmeaId - 200;
+    } else if (nmeaId >= 301 && nmeaId <= 336) {
+        *constellation = GnssConstellationType::GALILEO;
+        *svid = nmeaId - 300;
+    } else {
+        return false;
+    }
+    return *svid > 0;
+}
+
+// $--RMC,time,status,lat,N/S,lon,E/W,speed over ground (knots),course,date,...
+void parseRmc(const Sentence& s, GnssEpoch* epoch) {
+    if (s.field(2) != "A") return;
+    if (parseCoordinate(s.field(3), s.field(4), &epoch->latitudeDegrees) &&
+        parseCoordinate(s.field(5), s.field(6), &epoch->longitudeDegrees)) {
+        epoch->gnssLocationFlags |= GnssLocationFlags::HAS_LAT_LONG;
+    }
+    if (parseFloat(s.field(7), &epoch->speedMetersPerSec)) {
+        epoch->speedMetersPerSec *= kMetersPerSecPerKnot;
+        epoch->gnssLocationFlags |= GnssLocationFlags::HAS_SPEED;
+    }
+    if (parseFloat(s.field(8), &epoch->bearingDegrees)) {
+        epoch->gnssLocationFlags |= GnssLocationFlags::HAS_BEARING;
+    }
+}
+
+// $--GGA,time,lat,N/S,lon,E/W,quality,satellites,HDOP,altitude,M,...
+void parseGga(const Sentence& s, GnssEpoch* epoch) {
+    if (s.field(6).empty() || s.field(6) == "0") return;
+    if (parseCoordinate(s.field(2), s.field(3), &epoch->latitudeDegrees) &&
+        parseCoordinate(s.field(4), s.field(5), &epoch->longitudeDegrees)) {
+        epoch->gnssLocationFlags |= GnssLocationFlags::HAS_LAT_LONG;
+    }
+    if (parseDouble(s.field(9), &epoch->altitudeMeters)) {
+        epoch->gnssLocationFlags |= GnssLocationFlags::HAS_ALTITUDE;
+    }
+    float hdop;
+    if (parseFloat(s.field(8), &hdop)) {
+        epoch->horizontalAccuracyMeters = hdop * kUereMeters;
+        epoch->gnssLocationFlags |= GnssLocationFlags::HAS_HORIZONTAL_ACCURACY;
+    }
+}
+
+// $--GSA,mode,fix type,12 x satellite used in fix,PDOP,HDOP,VDOP
+void parseGsa(const Sentence& s, GnssEpoch* epoch, std::vector<GnssSv>* usedSvs) {
+    for (size_t i = 3; i < 15; i++) {
+        int nmeaId;
+        GnssSv sv = {};
+        if (parseInt(s.field(i), &nmeaId) &&
+            toAndroidSv(s.talker, nmeaId, &sv.constellation, &sv.svid)) {
+            usedSvs->push_back(sv);
+        }
+    }
+    float vdop;
+    if (parseFloat(s.field(17), &vdop)) {
+        epoch->verticalAccuracyMeters = vdop * kUereMeters;
+        epoch->gnssLocationFlags |= GnssLocationFlags::HAS_VERTICAL_ACCURACY;
+    }
+}
+
+// $--GSV,messages,message,satellites in view,4 x (id,elevation,azimuth,SNR)
+void parseGsv(const Sentence& s, std::vector<GnssSv>* svs) {
+    for (size_t i = 4; i + 3 < s.numFields; i += 4) {
+        int nmeaId;
+        GnssSv sv = {};
+        if (!parseInt(s.field(i), &nmeaId) ||
+            !toAndroidSv(s.talker, nmeaId, &sv.constellation, &sv.svid)) {
+            continue;
+        }
+        parseFloat(s.field(i + 1), &sv.elevationDegrees);
+        parseFloat(s.field(i + 2), &sv.azimuthDegrees);
+        parseFloat(s.field(i + 3), &sv.cN0DbHz);
+
+        // Receivers tracking several signals list a satellite once per signal.
+        auto same = std::find_if(svs->begin(), svs->end(), [&sv](const GnssSv& other) {
+            return other.constellation == sv.constellation && other.svid == sv.svid;
+        });
+        if (same == svs->end()) {
+            svs->push_back(sv);
+        } else if (sv.cN0DbHz > same->cN0DbHz) {
+            same->cN0DbHz = sv.cN0DbHz;
+        }
+    }
+}
+
+}  // namespace
+
+std::unique_ptr<NmeaTrace> NmeaTrace::open(const std::string& path) {
+    int fd = TEMP_FAILURE_RETRY(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+    if (fd < 0) {
+        ALOGE("%s: Unable to open %s: %s", __func__, path.c_str(), strerror(errno));
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ALOGE("%s: %s is empty or unreadable", __func__, path.c_str());
+        close(fd);
+        return nullptr;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        ALOGE("%s: Unable to map %s: %s", __func__, path.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    std::unique_ptr<NmeaTrace> trace(new NmeaTrace(static_cast<const char*>(data), st.st_size));
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    trace->index();
+    madvise(data, st.st_size, MADV_NORMAL);
+    if (trace->size() == 0) {
+        ALOGE("%s: No fixes in %s", __func__, path.c_str());
+        return nullptr;
+    }
+    ALOGD("%s: %zu epochs over %" PRId64 " ms in %s", __func__, trace->size(),
+          trace->getDurationMs(), path.c_str());
+    return trace;
+}
+
+NmeaTrace::NmeaTrace(const char* data, size_t size) : mData(data), mSize(size) {}
+
+NmeaTrace::~NmeaTrace() {
+    munmap(const_cast<char*>(mData), mSize);
+}
+
+void NmeaTrace::index() {
+    // $--GGA has no date. Take it from the first $--RMC until the next one comes along.
+    int64_t dateMs = 0;
+    forEachLine(mData, mSize, [&dateMs](size_t, std::string_view line) {
+        Sentence s;
+        return !(parseSentence(line, &s) && s.type == "RMC" && parseDate(s.field(9), &dateMs));
+    });
+
+    int64_t lastTimeOfDayMs = -1;
+    forEachLine(mData, mSize, [&](size_t offset, std::string_view line) {
+        Sentence s;
+        int64_t timeOfDayMs;
+        if (!parseSentence(line, &s) || (s.type != "RMC" && s.type != "GGA") ||
+            !parseTimeOfDay(s.field(1), &timeOfDayMs)) {
+            return true;
+        }
+        if (s.type == "RMC") {
+            parseDate(s.field(9), &dateMs);
+        } else if (timeOfDayMs < lastTimeOfDayMs - kMillisPerDay / 2) {
+            dateMs += kMillisPerDay;
+        }
+        lastTimeOfDayMs = timeOfDayMs;
+
+        // Sentences up to the next fix time, including $--GSA and $--GSV, make up the epoch.
+        int64_t utcTimeMs = dateMs + timeOfDayMs;
+        if (mEpochs.empty()) {
+            mEpochs.push_back({0, 0, utcTimeMs});
+        } else if (utcTimeMs > mEpochs.back().utcTimeMs) {
+            mEpochs.push_back({offset, 0, utcTimeMs});
+        }
+        return true;
+    });
+
+    for (size_t i = 0; i < mEpochs.size(); i++) {
+        size_t end = i + 1 < mEpochs.size() ? mEpochs[i + 1].offset : mSize;
+        mEpochs[i].length = end - mEpochs[i].offset;
+    }
+
+    size_t n = mEpochs.size();
+    if (n >= 2) {
+        mDurationMs = mEpochs[n - 1].utcTimeMs - mEpochs[0].utcTimeMs +
+                      (mEpochs[n - 1].utcTimeMs - mEpochs[n - 2].utcTimeMs);
+    } else {
+        mDurationMs = 1000;
+    }
+}
+
+int64_t NmeaTrace::getTimeMs(size_t index) const {
+    return mEpochs[index].utcTimeMs - mEpochs[0].utcTimeMs;
+}
+
+size_t NmeaTrace::findEpoch(int64_t timeMs) const {
+    int64_t utcTimeMs = mEpochs[0].utcTimeMs + timeMs;
+    auto next = std::upper_bound(
+            mEpochs.begin(), mEpochs.end(), utcTimeMs,
+            [](int64_t time, const EpochIndex& epoch) { return time < epoch.utcTimeMs; });
+    return next == mEpochs.begin() ? 0 : next - mEpochs.begin() - 1;
+}
+
+bool NmeaTrace::getEpoch(size_t index, GnssEpoch* epoch) const {
+    if (index >= mEpochs.size()) return false;
+    const EpochIndex& entry = mEpochs[index];
+
+    *epoch = {};
+    epoch->utcTimeMs = entry.utcTimeMs;
+    std::vector<GnssSv> usedSvs;
+    forEachLine(mData + entry.offset, entry.length, [&](size_t, std::string_view line) {
+        Sentence s;
+        if (!parseSentence(line, &s)) return true;
+        if (s.type == "RMC") {
+            parseRmc(s, epoch);
+        } else if (s.type == "GGA") {
+            parseGga(s, epoch);
+        } else if (s.type == "GSA") {
+            parseGsa(s, epoch, &usedSvs);
+        } else if (s.type == "GSV") {
+            parseGsv(s, &epoch->svs);
+        }
+        return true;
+    });
+
+    if ((epoch->gnssLocationFlags & GnssLocationFlags::HAS_HORIZONTAL_ACCURACY) &&
+        !(epoch->gnssLocationFlags & GnssLocationFlags::HAS_VERTICAL_ACCURACY)) {
+        epoch->verticalAccuracyMeters = epoch->horizontalAccuracyMeters * 1.5f;
+        epoch->gnssLocationFlags |= GnssLocationFlags::HAS_VERTICAL_ACCURACY;
+    }
+    for (GnssSv& sv : epoch->svs) {
+        sv.usedInFix = std::any_of(usedSvs.begin(), usedSvs.end(), [&sv](const GnssSv& used) {
+            return used.constellation == sv.constellation && used.svid == sv.svid;
+        });
+    }
+    return true;
+}
+
+}  // namespace common
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
@@ -18,6 +18,9 @@
 #include <Utils.h>
 #include <utils/SystemClock.h>
 
+#include <algorithm>
+#include <vector>
+
 namespace android {
 namespace hardware {
 namespace gnss {
@@ -32,23 +35,36 @@ using ElapsedRealtimeFlags = V2_0::ElapsedRealtimeFlags;
 using GnssConstellationTypeV2_0 = V2_0::GnssConstellationType;
 using IGnssMeasurementCallbackV2_0 = V2_0::IGnssMeasurementCallback;
 using GnssSignalType = V2_1::GnssSignalType;
+using GnssLocationFlags = V1_0::GnssLocationFlags;
 
-GnssDataV2_1 Utils::getMockMeasurementV2_1() {
-    GnssDataV2_0 gnssDataV2_0 = Utils::getMockMeasurementV2_0();
-    V2_1::IGnssMeasurementCallback::GnssMeasurement gnssMeasurementV2_1 = {
-            .v2_0 = gnssDataV2_0.measurements[0],
-            .flags = (uint32_t)(GnssMeasurementFlagsV2_1::HAS_CARRIER_FREQUENCY |
-                                GnssMeasurementFlagsV2_1::HAS_CARRIER_PHASE |
-                                GnssMeasurementFlagsV2_1::HAS_FULL_ISB |
-                                GnssMeasurementFlagsV2_1::HAS_FULL_ISB_UNCERTAINTY |
-                                GnssMeasurementFlagsV2_1::HAS_SATELLITE_ISB |
-                                GnssMeasurementFlagsV2_1::HAS_SATELLITE_ISB_UNCERTAINTY),
-            .fullInterSignalBiasNs = 30.0,
-            .fullInterSignalBiasUncertaintyNs = 250.0,
-            .satelliteInterSignalBiasNs = 20.0,
-            .satelliteInterSignalBiasUncertaintyNs = 150.0,
-            .basebandCN0DbHz = 25.0,
-    };
+namespace {
+
+// How much weaker the baseband C/N0 of the mock signals is than their antenna C/N0.
+constexpr float kMockBasebandCN0OffsetDbHz = 5.0;
+// Start of GPS time, 1980-01-06, in UTC milliseconds, and GPS time ahead of UTC since 2017.
+constexpr int64_t kGpsEpochUtcMs = 315964800000;
+constexpr int64_t kGpsLeapSeconds = 18;
+
+GnssDataV2_1 toMeasurementV2_1(const GnssDataV2_0& gnssDataV2_0) {
+    hidl_vec<V2_1::IGnssMeasurementCallback::GnssMeasurement> measurements(
+            gnssDataV2_0.measurements.size());
+    for (size_t i = 0; i < measurements.size(); i++) {
+        measurements[i] = {
+                .v2_0 = gnssDataV2_0.measurements[i],
+                .flags = (uint32_t)(GnssMeasurementFlagsV2_1::HAS_CARRIER_FREQUENCY |
+                                    GnssMeasurementFlagsV2_1::HAS_CARRIER_PHASE |
+                                    GnssMeasurementFlagsV2_1::HAS_FULL_ISB |
+                                    GnssMeasurementFlagsV2_1::HAS_FULL_ISB_UNCERTAINTY |
+                                    GnssMeasurementFlagsV2_1::HAS_SATELLITE_ISB |
+                                    GnssMeasurementFlagsV2_1::HAS_SATELLITE_ISB_UNCERTAINTY),
+                .fullInterSignalBiasNs = 30.0,
+                .fullInterSignalBiasUncertaintyNs = 250.0,
+                .satelliteInterSignalBiasNs = 20.0,
+                .satelliteInterSignalBiasUncertaintyNs = 150.0,
+                .basebandCN0DbHz = gnssDataV2_0.measurements[i].v1_1.v1_0.cN0DbHz -
+                                   kMockBasebandCN0OffsetDbHz,
+        };
+    }
     GnssSignalType referenceSignalTypeForIsb = {
             .constellation = GnssConstellationTypeV2_0::GPS,
             .carrierFrequencyHz = 1.59975e+09,
@@ -58,8 +74,6 @@ GnssDataV2_1 Utils::getMockMeasurementV2_1() {
             .v1_0 = gnssDataV2_0.clock,
             .referenceSignalTypeForIsb = referenceSignalTypeForIsb,
     };
-    hidl_vec<V2_1::IGnssMeasurementCallback::GnssMeasurement> measurements(1);
-    measurements[0] = gnssMeasurementV2_1;
     GnssDataV2_1 gnssDataV2_1 = {
             .measurements = measurements,
             .clock = gnssClockV2_1,
@@ -68,6 +82,18 @@ GnssDataV2_1 Utils::getMockMeasurementV2_1() {
     return gnssDataV2_1;
 }
 
+V1_0::GnssConstellationType toConstellationV1_0(V2_0::GnssConstellationType type) {
+    return type <= V2_0::GnssConstellationType::GALILEO
+                   ? static_cast<V1_0::GnssConstellationType>(type)
+                   : V1_0::GnssConstellationType::UNKNOWN;
+}
+
+}  // namespace
+
+GnssDataV2_1 Utils::getMockMeasurementV2_1() {
+    return toMeasurementV2_1(Utils::getMockMeasurementV2_0());
+}
+
 GnssDataV2_0 Utils::getMockMeasurementV2_0() {
     V1_0::IGnssMeasurementCallback::GnssMeasurement measurement_1_0 = {
             .flags = (uint32_t)GnssMeasurementFlagsV1_0::HAS_CARRIER_FREQUENCY,
@@ -287,6 +313,79 @@ hidl_vec<GnssAntennaInfo> Utils::getMockAntennaInfos() {
     return mockAntennaInfos;
 }
 
+GnssDataV2_0 Utils::getMeasurementV2_0(const GnssEpoch& epoch) {
+    GnssDataV2_0 gnssData = Utils::getMockMeasurementV2_0();
+    const IGnssMeasurementCallbackV2_0::GnssMeasurement reference = gnssData.measurements[0];
+
+    // Satellites in view without a signal are not measured.
+    std::vector<IGnssMeasurementCallbackV2_0::GnssMeasurement> measurements;
+    measurements.reserve(epoch.svs.size());
+    for (const GnssSv& sv : epoch.svs) {
+        if (sv.cN0DbHz <= 0) continue;
+        IGnssMeasurementCallbackV2_0::GnssMeasurement measurement = reference;
+        measurement.v1_1.v1_0.svid = sv.svid;
+        measurement.v1_1.v1_0.cN0DbHz = sv.cN0DbHz;
+        measurement.constellation = sv.constellation;
+        measurements.push_back(measurement);
+    }
+    gnssData.measurements = measurements;
+
+    // Let the GPS time of the clock follow the trace.
+    const int64_t gpsTimeNs = (epoch.utcTimeMs - kGpsEpochUtcMs + kGpsLeapSeconds * 1000) * 1000000;
+    gnssData.clock.fullBiasNs = gnssData.clock.timeNs - gpsTimeNs;
+    return gnssData;
+}
+
+GnssDataV2_1 Utils::getMeasurementV2_1(const GnssEpoch& epoch) {
+    return toMeasurementV2_1(Utils::getMeasurementV2_0(epoch));
+}
+
+V2_0::GnssLocation Utils::getLocationV2_0(const GnssEpoch& epoch) {
+    V2_0::GnssLocation location = Utils::getMockLocationV2_0();
+    location.v1_0 = Utils::getLocationV1_0(epoch);
+    return location;
+}
+
+V1_0::GnssLocation Utils::getLocationV1_0(const GnssEpoch& epoch) {
+    V1_0::GnssLocation location = {
+            .gnssLocationFlags = epoch.gnssLocationFlags,
+            .latitudeDegrees = epoch.latitudeDegrees,
+            .longitudeDegrees = epoch.longitudeDegrees,
+            .altitudeMeters = epoch.altitudeMeters,
+            .speedMetersPerSec = epoch.speedMetersPerSec,
+            .bearingDegrees = epoch.bearingDegrees,
+            .horizontalAccuracyMeters = epoch.horizontalAccuracyMeters,
+            .verticalAccuracyMeters = epoch.verticalAccuracyMeters,
+            .timestamp = epoch.utcTimeMs};
+    // NMEA has no speed or bearing accuracy, so use the mock ones.
+    if (epoch.gnssLocationFlags & GnssLocationFlags::HAS_SPEED) {
+        location.speedAccuracyMetersPerSecond = kMockSpeedAccuracyMetersPerSecond;
+        location.gnssLocationFlags |= GnssLocationFlags::HAS_SPEED_ACCURACY;
+    }
+    if (epoch.gnssLocationFlags & GnssLocationFlags::HAS_BEARING) {
+        location.bearingAccuracyDegrees = kMockBearingAccuracyDegrees;
+        location.gnssLocationFlags |= GnssLocationFlags::HAS_BEARING_ACCURACY;
+    }
+    return location;
+}
+
+hidl_vec<GnssSvInfoV2_1> Utils::getSvInfoListV2_1(const GnssEpoch& epoch) {
+    hidl_vec<GnssSvInfoV2_1> gnssSvInfoList(epoch.svs.size());
+    for (size_t i = 0; i < epoch.svs.size(); i++) {
+        const GnssSv& sv = epoch.svs[i];
+        GnssSvInfoV1_0 gnssSvInfoV1_0 =
+                getMockSvInfoV1_0(sv.svid, toConstellationV1_0(sv.constellation), sv.cN0DbHz,
+                                  sv.elevationDegrees, sv.azimuthDegrees);
+        if (!sv.usedInFix) {
+            gnssSvInfoV1_0.svFlag &= ~static_cast<uint8_t>(GnssSvFlags::USED_IN_FIX);
+        }
+        gnssSvInfoList[i] =
+                getMockSvInfoV2_1(getMockSvInfoV2_0(gnssSvInfoV1_0, sv.constellation),
+                                  std::max(sv.cN0DbHz - kMockBasebandCN0OffsetDbHz, 0.0f));
+    }
+    return gnssSvInfoList;
+}
+
 }  // namespace common
 }  // namespace gnss
 }  // namespace hardware
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_gnss_common_default_GnssReplayEngine_H_
+#define android_hardware_gnss_common_default_GnssReplayEngine_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "NmeaTrace.h"
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace common {
+
+/*
+ * Drives the periodic reports of a mock GNSS HAL from one timer thread.
+ *
+ * Each listener is called at its own interval, against absolute deadlines so that the time
+ * spent in callbacks does not add up to drift. With a trace, every call gets the epoch due at
+ * that moment: the trace is played back at |speed| times real time, looping at its end, and
+ * locations are interpolated between the recorded epochs so that listeners can run faster than
+ * the receiver did. Without a trace, listeners get nullptr and report mock data instead.
+ *
+ * Listeners due at the same time are called one after the other on the engine thread, so a
+ * listener that blocks, e.g. in a synchronous HIDL callback to a slow client, delays every other
+ * listener by as long. The engine does not bound this: the delayed calls show up as lateness,
+ * and intervals they fall behind on are skipped and counted as missed. Listeners should hand
+ * their data over and return.
+ *
+ * How late each call was made is kept per listener and written out by dump().
+ */
+class GnssReplayEngine {
+  public:
+    using Clock = std::chrono::steady_clock;
+    using Listener = std::function<void(const GnssEpoch* epoch)>;
+
+    static constexpr std::chrono::milliseconds kMinInterval{10};
+
+    GnssReplayEngine(std::unique_ptr<NmeaTrace> trace, double speed);
+    ~GnssReplayEngine();
+
+    bool hasTrace() const { return mTrace != nullptr; }
+
+    /*
+     * Calls |listener| on the engine thread every |interval|, the first time right away, until
+     * removeListener() is called with the returned id. Intervals below kMinInterval are raised.
+     */
+    int addListener(const std::string& name, std::chrono::milliseconds interval,
+                    Listener listener);
+
+    /* Changes how often a listener is called, starting with its next call. */
+    void setInterval(int id, std::chrono::milliseconds interval);
+
+    /*
+     * Stops calling the listener and waits for a call in progress to return. Must not be called
+     * from a listener, or with a lock the listener takes.
+     */
+    void removeListener(int id);
+
+    /* The epoch most recently handed to a listener. Returns false without a trace. */
+    bool getLastEpoch(GnssEpoch* epoch) const;
+
+    void dump(int fd) const;
+
+  private:
+    struct Stats {
+        uint64_t calls = 0;
+        uint64_t missed = 0;
+        double latenessSumUs = 0;
+        double latenessSquareSumUs = 0;
+        double maxLatenessUs = 0;
+
+        void add(double latenessUs, uint64_t missedIntervals);
+        void merge(const Stats& other);
+    };
+
+    struct Entry {
+        std::string name;
+        Clock::duration interval;
+        Clock::time_point deadline;
+        std::shared_ptr<Listener> listener;
+        Stats stats;
+    };
+
+    void run();
+    void updateEpoch(Clock::time_point now);
+    bool loadNextEpoch(size_t index);
+
+    const std::unique_ptr<NmeaTrace> mTrace;
+    const double mSpeed;
+    const Clock::time_point mStartTime;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStopping = false;
+    int mNextId = 0;
+    std::map<int, Entry> mEntries;
+    // Kept across removals so that dump() still shows listeners that ran earlier.
+    std::map<std::string, Stats> mFinishedStats;
+    GnssEpoch mEpoch;
+
+    // Held while listeners are called, so that removeListener() can wait for them.
+    std::mutex mDispatchMutex;
+
+    // Only used on the engine thread: the two parsed epochs around the replay time.
+    size_t mCachedIndex = SIZE_MAX;
+    GnssEpoch mCachedEpoch;
+    GnssEpoch mCachedNextEpoch;
+
+    std::thread mThread;
+};
+
+}  // namespace common
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_gnss_common_default_GnssReplayEngine_H_
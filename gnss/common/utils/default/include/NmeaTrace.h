@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef android_hardware_gnss_common_default_NmeaTrace_H_
+#define android_hardware_gnss_common_default_NmeaTrace_H_
+
+#include <android/hardware/gnss/2.0/types.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace common {
+
+/* A satellite reported by the receiver in one epoch, with its Android svid. */
+struct GnssSv {
+    int16_t svid;
+    V2_0::GnssConstellationType constellation;
+    float cN0DbHz;
+    float elevationDegrees;
+    float azimuthDegrees;
+    bool usedInFix;
+};
+
+/*
+ * Everything the receiver reported for one fix time. gnssLocationFlags uses the
+ * V1_0::GnssLocationFlags bits and tells which of the location fields are set.
+ */
+struct GnssEpoch {
+    int64_t utcTimeMs;
+    uint16_t gnssLocationFlags;
+    double latitudeDegrees;
+    double longitudeDegrees;
+    double altitudeMeters;
+    float speedMetersPerSec;
+    float bearingDegrees;
+    float horizontalAccuracyMeters;
+    float verticalAccuracyMeters;
+    std::vector<GnssSv> svs;
+};
+
+/*
+ * A recording of NMEA 0183 sentences, memory-mapped read-only. Locations come from $--RMC and
+ * $--GGA, satellites from $--GSV and $--GSA; other sentences and sentences with a bad checksum
+ * are skipped.
+ *
+ * Opening a trace only indexes where each epoch starts, so that long drives cost neither memory
+ * nor start-up time. Epochs are parsed from the mapping when they are asked for.
+ */
+class NmeaTrace {
+  public:
+    static std::unique_ptr<NmeaTrace> open(const std::string& path);
+
+    ~NmeaTrace();
+
+    size_t size() const { return mEpochs.size(); }
+
+    /* Time of epoch |index| since the first epoch. */
+    int64_t getTimeMs(size_t index) const;
+
+    /* Length of one pass over the trace, including the interval before it starts over. */
+    int64_t getDurationMs() const { return mDurationMs; }
+
+    /* Index of the last epoch at or before |timeMs| since the first epoch. */
+    size_t findEpoch(int64_t timeMs) const;
+
+    bool getEpoch(size_t index, GnssEpoch* epoch) const;
+
+  private:
+    struct EpochIndex {
+        size_t offset;
+        size_t length;
+        int64_t utcTimeMs;
+    };
+
+    NmeaTrace(const char* data, size_t size);
+
+    void index();
+
+    const char* mData;
+    const size_t mSize;
+    std::vector<EpochIndex> mEpochs;
+    int64_t mDurationMs = 0;
+};
+
+}  // namespace common
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
+
+#endif  // android_hardware_gnss_common_default_NmeaTrace_H_
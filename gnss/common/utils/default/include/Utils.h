@@ -21,6 +21,8 @@
 #include <android/hardware/gnss/2.0/IGnss.h>
 #include <android/hardware/gnss/2.1/IGnss.h>
 
+#include "NmeaTrace.h"
+
 using ::android::hardware::hidl_vec;
 
 namespace android {
@@ -50,6 +52,13 @@ struct Utils {
                                             float cN0DbHz, float elevationDegrees,
                                             float azimuthDegrees);
     static hidl_vec<GnssAntennaInfo> getMockAntennaInfos();
+
+    // Reports for an epoch replayed from a trace, filled in like the mock ones above.
+    static GnssDataV2_0 getMeasurementV2_0(const GnssEpoch& epoch);
+    static GnssDataV2_1 getMeasurementV2_1(const GnssEpoch& epoch);
+    static V2_0::GnssLocation getLocationV2_0(const GnssEpoch& epoch);
+    static V1_0::GnssLocation getLocationV1_0(const GnssEpoch& epoch);
+    static hidl_vec<GnssSvInfoV2_1> getSvInfoListV2_1(const GnssEpoch& epoch);
 };
 
 }  // namespace common
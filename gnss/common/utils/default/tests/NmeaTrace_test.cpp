@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <NmeaTrace.h>
+
+#include <stdio.h>
+
+#include <string>
+
+#include <android-base/file.h>
+#include <gtest/gtest.h>
+
+namespace android {
+namespace hardware {
+namespace gnss {
+namespace common {
+namespace {
+
+using GnssConstellationType = V2_0::GnssConstellationType;
+using GnssLocationFlags = V1_0::GnssLocationFlags;
+
+// Frames |body| as a sentence: "$" body "*" checksum.
+std::string sentence(const std::string& body) {
+    uint8_t checksum = 0;
+    for (char c : body) checksum ^= static_cast<uint8_t>(c);
+    char suffix[4];
+    snprintf(suffix, sizeof(suffix), "*%02X", checksum);
+    return "$" + body + suffix;
+}
+
+const std::string kRmc = sentence("GPRMC,123519,A,4807.038,N,01131.000,E,022.4,084.4,230394,,");
+const std::string kGga = sentence("GPGGA,123519,4807.038,N,01131.000,E,1,08,0.9,545.4,M,46.9,M,,");
+const std::string kNextRmc =
+        sentence("GPRMC,123520,A,4807.040,N,01131.000,E,022.4,084.4,230394,,");
+
+class NmeaTraceTest : public ::testing::Test {
+  protected:
+    std::unique_ptr<NmeaTrace> open(const std::string& contents) {
+        EXPECT_TRUE(android::base::WriteStringToFile(contents, mFile.path));
+        return NmeaTrace::open(mFile.path);
+    }
+
+    TemporaryFile mFile;
+};
+
+TEST_F(NmeaTraceTest, ParsesAnEpoch) {
+    auto trace = open(kRmc + "\r\n" + kGga + "\r\n" +
+                      sentence("GPGSA,A,3,04,05,,,,,,,,,,,2.5,1.3,2.1") + "\r\n" +
+                      sentence("GPGSV,1,1,02,04,40,083,46,05,17,308,41") + "\r\n");
+    ASSERT_NE(nullptr, trace);
+    ASSERT_EQ(1u, trace->size());
+
+    GnssEpoch epoch;
+    ASSERT_TRUE(trace->getEpoch(0, &epoch));
+    EXPECT_TRUE(epoch.gnssLocationFlags & GnssLocationFlags::HAS_LAT_LONG);
+    EXPECT_NEAR(48.1173, epoch.latitudeDegrees, 1e-6);
+    EXPECT_NEAR(11.516667, epoch.longitudeDegrees, 1e-6);
+    EXPECT_DOUBLE_EQ(545.4, epoch.altitudeMeters);
+    ASSERT_EQ(2u, epoch.svs.size());
+    EXPECT_EQ(GnssConstellationType::GPS, epoch.svs[0].constellation);
+    EXPECT_EQ(4, epoch.svs[0].svid);
+    EXPECT_FLOAT_EQ(46, epoch.svs[0].cN0DbHz);
+    EXPECT_TRUE(epoch.svs[0].usedInFix);
+    EXPECT_TRUE(epoch.svs[1].usedInFix);
+}
+
+TEST_F(NmeaTraceTest, SkipsSentencesWithABadChecksum) {
+    std::string badRmc = kRmc;
+    badRmc[badRmc.size() - 1] = badRmc.back() == '0' ? '1' : '0';
+    std::string badGga = kGga;
+    badGga[10] = '6';  // The time, the checksum is left as it was.
+
+    EXPECT_EQ(nullptr, open(badRmc + "\n" + badGga + "\n"));
+
+    auto trace = open(kRmc + "\n" + badGga + "\n");
+    ASSERT_NE(nullptr, trace);
+    GnssEpoch epoch;
+    ASSERT_TRUE(trace->getEpoch(0, &epoch));
+    // The altitude only comes from $GPGGA.
+    EXPECT_FALSE(epoch.gnssLocationFlags & GnssLocationFlags::HAS_ALTITUDE);
+}
+
+TEST_F(NmeaTraceTest, SkipsSentencesWithAMalformedChecksum) {
+    const std::string body = kRmc.substr(0, kRmc.find('*'));
+    EXPECT_EQ(nullptr, open(body + "*G1\n" + body + "*1\n" + body + "*123\n" + body + "*\n"));
+}
+
+TEST_F(NmeaTraceTest, SkipsMalformedLines) {
+    auto trace = open(std::string("\n\r\n$\n$GP\n*00\nGPRMC,123519,A\n$,,,,,\n") +
+                      sentence("PGRME,15.0,M,45.0,M,25.0,M") + "\n" +
+                      sentence("GPRMC123518A") + "\n" + std::string("\0\xff\x01", 3) + "\n" +
+                      kRmc + "\n");
+    ASSERT_NE(nullptr, trace);
+    ASSERT_EQ(1u, trace->size());
+    GnssEpoch epoch;
+    ASSERT_TRUE(trace->getEpoch(0, &epoch));
+    EXPECT_TRUE(epoch.gnssLocationFlags & GnssLocationFlags::HAS_LAT_LONG);
+}
+
+TEST_F(NmeaTraceTest, SkipsATruncatedLastLine) {
+    // Recordings cut off while writing end in the middle of a sentence.
+    auto trace = open(kRmc + "\n" + kNextRmc.substr(0, kNextRmc.size() - 1));
+    ASSERT_NE(nullptr, trace);
+    EXPECT_EQ(1u, trace->size());
+}
+
+TEST_F(NmeaTraceTest, TruncatedFixHasNoLocation) {
+    // Without a checksum there is nothing to tell the sentence was cut short, the fields that
+    // are missing are left unset.
+    auto trace = open(kRmc + "\n$GPRMC,123520,A,4807.040,N\n");
+    ASSERT_NE(nullptr, trace);
+    ASSERT_EQ(2u, trace->size());
+    EXPECT_EQ(1000, trace->getTimeMs(1));
+    GnssEpoch epoch;
+    ASSERT_TRUE(trace->getEpoch(1, &epoch));
+    EXPECT_FALSE(epoch.gnssLocationFlags & GnssLocationFlags::HAS_LAT_LONG);
+    EXPECT_FALSE(epoch.gnssLocationFlags & GnssLocationFlags::HAS_SPEED);
+}
+
+TEST_F(NmeaTraceTest, SkipsATruncatedSatelliteGroup) {
+    auto trace = open(kRmc + "\n" + sentence("GPGSV,1,1,02,04,40,083,46,05,17") + "\n");
+    ASSERT_NE(nullptr, trace);
+    GnssEpoch epoch;
+    ASSERT_TRUE(trace->getEpoch(0, &epoch));
+    ASSERT_EQ(1u, epoch.svs.size());
+    EXPECT_EQ(4, epoch.svs[0].svid);
+}
+
+TEST_F(NmeaTraceTest, IgnoresFixesWithoutAValidTime) {
+    EXPECT_EQ(nullptr,
+              open(sentence("GPRMC,,A,4807.038,N,01131.000,E,022.4,084.4,230394,,") + "\n" +
+                   sentence("GPGGA,12:35,4807.038,N,01131.000,E,1,08,0.9,545.4,M,,,,") + "\n"));
+}
+
+TEST_F(NmeaTraceTest, IgnoresLinesWithoutFixes) {
+    EXPECT_EQ(nullptr, open(sentence("GPGSV,1,1,01,04,40,083,46") + "\n"));
+}
+
+}  // namespace
+}  // namespace common
+}  // namespace gnss
+}  // namespace hardware
+}  // namespace android
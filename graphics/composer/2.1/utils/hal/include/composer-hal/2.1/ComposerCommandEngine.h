@@ -292,6 +292,7 @@ class ComposerCommandEngine : protected CommandReaderBase {
                            ? Error::NOT_VALIDATED
                            : mHal->presentDisplay(mCurrentDisplay, &presentFence, &layers, &fences);
             if (err == Error::NONE) {
+                ComposerHandleStats::getInstance().onFramePresented();
                 mWriter->setPresentOrValidateResult(1);
                 mWriter->setPresentFence(presentFence);
                 mWriter->setReleaseFences(layers, fences);
@@ -331,6 +332,7 @@ class ComposerCommandEngine : protected CommandReaderBase {
         std::vector<int> fences;
         auto err = mHal->presentDisplay(mCurrentDisplay, &presentFence, &layers, &fences);
         if (err == Error::NONE) {
+            ComposerHandleStats::getInstance().onFramePresented();
             mWriter->setPresentFence(presentFence);
             mWriter->setReleaseFences(layers, fences);
         } else {
@@ -26,8 +26,10 @@
 #include <inttypes.h>
 
 #include <chrono>
+#include <condition_variable>
 #include <cstdlib>
 #include <sstream>
+#include <thread>
 
 #include <hardware/hwcomposer.h>
 #include <log/log.h>
@@ -83,6 +85,73 @@ class HWC2On1Adapter::Callbacks : public hwc_procs_t {
         HWC2On1Adapter& mAdapter;
 };
 
+// Prepares displays on a thread that lives as long as the adapter, so frames
+// with more than one display to rebuild don't start a new thread each time.
+class HWC2On1Adapter::PrepareWorker {
+    public:
+        PrepareWorker() : mThread(&PrepareWorker::run, this) {}
+
+        ~PrepareWorker() {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mStopping = true;
+            }
+            mCondition.notify_all();
+            mThread.join();
+        }
+
+        // Queues display to be prepared on the worker thread.
+        void prepare(Display* display) {
+            {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mPending.push_back(display);
+                ++mRemaining;
+            }
+            mCondition.notify_all();
+        }
+
+        // Waits for all the queued displays and returns whether all of them
+        // were prepared.
+        bool wait() {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this] { return mRemaining == 0; });
+            bool prepared = mPrepared;
+            mPrepared = true;
+            return prepared;
+        }
+
+    private:
+        void run() {
+            std::unique_lock<std::mutex> lock(mMutex);
+            while (true) {
+                mCondition.wait(lock,
+                        [this] { return mStopping || !mPending.empty(); });
+                if (mStopping) {
+                    return;
+                }
+                auto display = mPending.back();
+                mPending.pop_back();
+
+                lock.unlock();
+                bool prepared = display->prepare();
+                lock.lock();
+
+                mPrepared = mPrepared && prepared;
+                if (--mRemaining == 0) {
+                    mCondition.notify_all();
+                }
+            }
+        }
+
+        std::mutex mMutex;
+        std::condition_variable mCondition;
+        std::vector<Display*> mPending;
+        size_t mRemaining = 0;
+        bool mPrepared = true;
+        bool mStopping = false;
+        std::thread mThread;
+};
+
 static int closeHook(hw_device_t* /*device*/)
 {
     // Do nothing, since the real work is done in the class destructor, but we
@@ -378,6 +447,9 @@ void HWC2On1Adapter::dump(uint32_t* outSize, char* outBuffer) {
         }
     }
 
+    output << "HWC1 prepare: " << mHwc1PrepareTime.toString() << '\n';
+    output << "HWC1 set: " << mHwc1SetTime.toString() << '\n';
+
     output << "Displays:\n";
     for (const auto& element : mDisplays) {
         const auto& display = element.second;
@@ -502,6 +574,31 @@ Error HWC2On1Adapter::registerCallback(Callback descriptor,
     return Error::None;
 }
 
+// TimingStats functions
+
+void HWC2On1Adapter::TimingStats::add(std::chrono::nanoseconds duration) {
+    ++mCount;
+    mLast = duration;
+    mTotal += duration;
+    mMax = std::max(mMax, duration);
+}
+
+std::string HWC2On1Adapter::TimingStats::toString() const {
+    if (mCount == 0) {
+        return "no samples";
+    }
+
+    using std::chrono::microseconds;
+    using std::chrono::duration_cast;
+    std::stringstream output;
+    output << "last " << duration_cast<microseconds>(mLast).count() << "us";
+    output << "  avg " << duration_cast<microseconds>(mTotal / mCount).count()
+            << "us";
+    output << "  max " << duration_cast<microseconds>(mMax).count() << "us";
+    output << "  (" << mCount << " samples)";
+    return output.str();
+}
+
 // Display functions
 
 std::atomic<hwc2_display_t> HWC2On1Adapter::Display::sNextId(1);
@@ -528,7 +625,10 @@ HWC2On1Adapter::Display::Display(HWC2On1Adapter& device, HWC2::DisplayType type)
     mHwc1LayerMap(),
     mNumAvailableRects(0),
     mNextAvailableRect(nullptr),
-    mGeometryChanged(false)
+    mGeometryChanged(false),
+    mLayoutChanged(true),
+    mPrepareTime(),
+    mSetTime()
     {}
 
 Error HWC2On1Adapter::Display::acceptChanges() {
@@ -567,6 +667,7 @@ Error HWC2On1Adapter::Display::createLayer(hwc2_layer_t* outLayerId) {
     *outLayerId = layer->getId();
     ALOGV("[%" PRIu64 "] created layer %" PRIu64, mId, *outLayerId);
     markGeometryChanged();
+    markLayoutChanged();
     return Error::None;
 }
 
@@ -590,6 +691,7 @@ Error HWC2On1Adapter::Display::destroyLayer(hwc2_layer_t layerId) {
     }
     ALOGV("[%" PRIu64 "] destroyed layer %" PRIu64, mId, layerId);
     markGeometryChanged();
+    markLayoutChanged();
     return Error::None;
 }
 
@@ -1024,6 +1126,7 @@ Error HWC2On1Adapter::Display::updateLayerZ(hwc2_layer_t layerId, uint32_t z) {
     layer->setZ(z);
     mLayers.emplace(std::move(layer));
     markGeometryChanged();
+    markLayoutChanged();
 
     return Error::None;
 }
@@ -1214,8 +1317,17 @@ bool HWC2On1Adapter::Display::prepare() {
         return false;
     }
 
-    allocateRequestedContents();
-    assignHwc1LayerIds();
+    auto startTime = std::chrono::steady_clock::now();
+
+    // The HWC1 contents are only reallocated when the set of layers or their
+    // order changed. Otherwise the previous contents are reused and only the
+    // layers with dirty state are fully reapplied.
+    bool rebuild = mLayoutChanged || !mHwc1RequestedContents;
+    if (rebuild) {
+        allocateRequestedContents();
+        assignHwc1LayerIds();
+        mLayoutChanged = false;
+    }
 
     mHwc1RequestedContents->retireFenceFd = -1;
     mHwc1RequestedContents->flags = 0;
@@ -1231,17 +1343,35 @@ bool HWC2On1Adapter::Display::prepare() {
         auto& hwc1Layer = mHwc1RequestedContents->hwLayers[layer->getHwc1Id()];
         hwc1Layer.releaseFenceFd = -1;
         hwc1Layer.acquireFenceFd = -1;
-        ALOGV("Applying states for layer %" PRIu64 " ", layer->getId());
-        layer->applyState(hwc1Layer);
+        hwc1Layer.hints = 0;
+        if (rebuild || layer->isStateDirty()) {
+            ALOGV("Applying states for layer %" PRIu64 " ", layer->getId());
+            layer->applyState(hwc1Layer);
+        } else {
+            layer->applyFrameState(hwc1Layer);
+        }
     }
 
     prepareFramebufferTarget();
 
     resetGeometryMarker();
 
+    mPrepareTime.add(std::chrono::steady_clock::now() - startTime);
+
     return true;
 }
 
+bool HWC2On1Adapter::Display::needsRebuild() const {
+    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    return mHwc1Id != -1 &&
+            (mLayoutChanged || mGeometryChanged || !mHwc1RequestedContents);
+}
+
+void HWC2On1Adapter::Display::recordSetTime(std::chrono::nanoseconds duration) {
+    std::unique_lock<std::recursive_mutex> lock(mStateMutex);
+    mSetTime.add(duration);
+}
+
 void HWC2On1Adapter::Display::generateChanges() {
     std::unique_lock<std::recursive_mutex> lock(mStateMutex);
 
@@ -1521,6 +1651,9 @@ std::string HWC2On1Adapter::Display::dump() const {
     output << "Power mode: " << to_string(mPowerMode) << "  ";
     output << "Vsync: " << to_string(mVsyncEnabled) << '\n';
 
+    output << "    Prepare: " << mPrepareTime.toString() << '\n';
+    output << "    Set: " << mSetTime.toString() << '\n';
+
     output << "    Color modes [active]:";
     for (const auto& mode : mColorModes) {
         if (mode == mActiveColorMode) {
@@ -1886,8 +2019,13 @@ void HWC2On1Adapter::Display::prepareFramebufferTarget() {
     hwc1Target.displayFrame = {0, 0, width, height};
     hwc1Target.planeAlpha = 255;
 
+    // The rect pool is owned by this display, so it is safe to write through
+    // a rect handed to HWC1 on a previous frame.
+    auto rects = const_cast<hwc_rect_t*>(hwc1Target.visibleRegionScreen.rects);
+    if (rects == nullptr) {
+        rects = GetRects(1);
+    }
     hwc1Target.visibleRegionScreen.numRects = 1;
-    hwc_rect_t* rects = GetRects(1);
     rects[0].left = 0;
     rects[0].top = 0;
     rects[0].right = width;
@@ -1919,7 +2057,8 @@ HWC2On1Adapter::Layer::Layer(Display& display)
     mZ(0),
     mReleaseFence(),
     mHwc1Id(0),
-    mHasUnsupportedPlaneAlpha(false) {}
+    mHasUnsupportedPlaneAlpha(false),
+    mStateDirty(true) {}
 
 bool HWC2On1Adapter::SortLayersByZ::operator()(const std::shared_ptr<Layer>& lhs,
                                                const std::shared_ptr<Layer>& rhs) const {
@@ -1963,19 +2102,19 @@ Error HWC2On1Adapter::Layer::setSurfaceDamage(hwc_region_t damage) {
 
 Error HWC2On1Adapter::Layer::setBlendMode(BlendMode mode) {
     mBlendMode = mode;
-    mDisplay.markGeometryChanged();
+    markStateDirty();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setColor(hwc_color_t color) {
     mColor = color;
-    mDisplay.markGeometryChanged();
+    markStateDirty();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setCompositionType(Composition type) {
     mCompositionType = type;
-    mDisplay.markGeometryChanged();
+    markStateDirty();
     return Error::None;
 }
 
@@ -1985,31 +2124,31 @@ Error HWC2On1Adapter::Layer::setDataspace(android_dataspace_t) {
 
 Error HWC2On1Adapter::Layer::setDisplayFrame(hwc_rect_t frame) {
     mDisplayFrame = frame;
-    mDisplay.markGeometryChanged();
+    markStateDirty();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setPlaneAlpha(float alpha) {
     mPlaneAlpha = alpha;
-    mDisplay.markGeometryChanged();
+    markStateDirty();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setSidebandStream(const native_handle_t* stream) {
     mSidebandStream = stream;
-    mDisplay.markGeometryChanged();
+    markStateDirty();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setSourceCrop(hwc_frect_t crop) {
     mSourceCrop = crop;
-    mDisplay.markGeometryChanged();
+    markStateDirty();
     return Error::None;
 }
 
 Error HWC2On1Adapter::Layer::setTransform(Transform transform) {
     mTransform = transform;
-    mDisplay.markGeometryChanged();
+    markStateDirty();
     return Error::None;
 }
 
@@ -2021,12 +2160,17 @@ static bool compareRects(const hwc_rect_t& rect1, const hwc_rect_t& rect2) {
 }
 
 Error HWC2On1Adapter::Layer::setVisibleRegion(hwc_region_t visible) {
+    if (getNumVisibleRegions() != visible.numRects) {
+        // The rect pool of the cached HWC1 contents is sized for the
+        // previous number of rects
+        mDisplay.markLayoutChanged();
+    }
     if ((getNumVisibleRegions() != visible.numRects) ||
         !std::equal(mVisibleRegion.begin(), mVisibleRegion.end(), visible.rects,
                     compareRects)) {
         mVisibleRegion.resize(visible.numRects);
         std::copy_n(visible.rects, visible.numRects, mVisibleRegion.begin());
-        mDisplay.markGeometryChanged();
+        markStateDirty();
     }
     return Error::None;
 }
@@ -2047,6 +2191,11 @@ const sp<MiniFence>& HWC2On1Adapter::Layer::getReleaseFence() const {
 
 void HWC2On1Adapter::Layer::applyState(hwc_layer_1_t& hwc1Layer) {
     applyCommonState(hwc1Layer);
+    applyFrameState(hwc1Layer);
+    mStateDirty = false;
+}
+
+void HWC2On1Adapter::Layer::applyFrameState(hwc_layer_1_t& hwc1Layer) {
     applyCompositionType(hwc1Layer);
     switch (mCompositionType) {
         case Composition::SolidColor : applySolidColorState(hwc1Layer); break;
@@ -2055,6 +2204,11 @@ void HWC2On1Adapter::Layer::applyState(hwc_layer_1_t& hwc1Layer) {
     }
 }
 
+void HWC2On1Adapter::Layer::markStateDirty() {
+    mStateDirty = true;
+    mDisplay.markGeometryChanged();
+}
+
 static std::string regionStrings(const std::vector<hwc_rect_t>& visibleRegion,
         const std::vector<hwc_rect_t>& surfaceDamage) {
     std::string regions;
@@ -2151,9 +2305,14 @@ void HWC2On1Adapter::Layer::applyCommonState(hwc_layer_1_t& hwc1Layer) {
 
     hwc1Layer.transform = static_cast<uint32_t>(mTransform);
 
+    // A non-null rects pointer means the contents are cached and the rects
+    // were already allocated from the display's pool with the same count.
     auto& hwc1VisibleRegion = hwc1Layer.visibleRegionScreen;
+    auto rects = const_cast<hwc_rect_t*>(hwc1VisibleRegion.rects);
+    if (rects == nullptr) {
+        rects = mDisplay.GetRects(mVisibleRegion.size());
+    }
     hwc1VisibleRegion.numRects = mVisibleRegion.size();
-    hwc_rect_t* rects = mDisplay.GetRects(hwc1VisibleRegion.numRects);
     hwc1VisibleRegion.rects = rects;
     for (size_t i = 0; i < mVisibleRegion.size(); i++) {
         rects[i] = mVisibleRegion[i];
@@ -2316,11 +2475,35 @@ bool HWC2On1Adapter::prepareAllDisplays() {
 
     std::unique_lock<std::recursive_timed_mutex> lock(mStateMutex);
 
+    // Displays only share the HWC1 device, which is not touched until all of
+    // them are prepared, so displays with layers to rebuild are prepared
+    // concurrently. Displays with cached contents only refresh their buffers
+    // and fences, which is cheaper than handing them to another thread.
+    std::vector<Display*> rebuiltDisplays;
     for (const auto& displayPair : mDisplays) {
         auto& display = displayPair.second;
-        if (!display->prepare()) {
+        if (display->needsRebuild()) {
+            rebuiltDisplays.push_back(display.get());
+        } else if (!display->prepare()) {
+            return false;
+        }
+    }
+
+    if (rebuiltDisplays.size() > 1) {
+        // The worker thread is only started once a second display shows up
+        if (!mPrepareWorker) {
+            mPrepareWorker = std::make_unique<PrepareWorker>();
+        }
+        for (size_t d = 1; d < rebuiltDisplays.size(); ++d) {
+            mPrepareWorker->prepare(rebuiltDisplays[d]);
+        }
+        bool prepared = rebuiltDisplays[0]->prepare();
+        prepared = mPrepareWorker->wait() && prepared;
+        if (!prepared) {
             return false;
         }
+    } else if (!rebuiltDisplays.empty() && !rebuiltDisplays[0]->prepare()) {
+        return false;
     }
 
     if (mHwc1DisplayMap.count(HWC_DISPLAY_PRIMARY) == 0) {
@@ -2373,8 +2556,10 @@ bool HWC2On1Adapter::prepareAllDisplays() {
     ALOGV("Calling HWC1 prepare");
     {
         ATRACE_NAME("HWC1 prepare");
+        auto startTime = std::chrono::steady_clock::now();
         mHwc1Device->prepare(mHwc1Device, mHwc1Contents.size(),
                 mHwc1Contents.data());
+        mHwc1PrepareTime.add(std::chrono::steady_clock::now() - startTime);
     }
 
     for (size_t c = 0; c < mHwc1Contents.size(); ++c) {
@@ -2492,20 +2677,24 @@ Error HWC2On1Adapter::setAllDisplays() {
 
         auto displayId = mHwc1DisplayMap[hwc1Id];
         auto& display = mDisplays[displayId];
+        auto startTime = std::chrono::steady_clock::now();
         Error error = display->set(*mHwc1Contents[hwc1Id]);
         if (error != Error::None) {
             ALOGE("setAllDisplays: Failed to set display %zd: %s", hwc1Id,
                     to_string(error).c_str());
             return error;
         }
+        display->recordSetTime(std::chrono::steady_clock::now() - startTime);
     }
 
     ALOGV("Calling HWC1 set");
     {
         ATRACE_NAME("HWC1 set");
         //dumpHWC1Message(mHwc1Device, mHwc1Contents.size(), mHwc1Contents.data());
+        auto startTime = std::chrono::steady_clock::now();
         mHwc1Device->set(mHwc1Device, mHwc1Contents.size(),
                 mHwc1Contents.data());
+        mHwc1SetTime.add(std::chrono::steady_clock::now() - startTime);
     }
 
     // Add retire and release fences
@@ -26,10 +26,12 @@
 #include "MiniFence.h"
 
 #include <atomic>
+#include <chrono>
 #include <map>
 #include <mutex>
 #include <queue>
 #include <set>
+#include <string>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -186,6 +188,26 @@ private:
             sp<MiniFence> mFence;
     };
 
+    // Accumulates the durations of a repeated operation (e.g. preparing a
+    // display) so they can be reported in dump().
+    class TimingStats {
+        public:
+            TimingStats()
+              : mCount(0),
+                mLast(0),
+                mTotal(0),
+                mMax(0) {}
+
+            void add(std::chrono::nanoseconds duration);
+            std::string toString() const;
+
+        private:
+            uint64_t mCount;
+            std::chrono::nanoseconds mLast;
+            std::chrono::nanoseconds mTotal;
+            std::chrono::nanoseconds mMax;
+    };
+
     class Display {
         public:
             Display(HWC2On1Adapter& device, HWC2::DisplayType type);
@@ -259,6 +281,11 @@ private:
 
             bool prepare();
 
+            // True if prepare() will have to rebuild the HWC1 contents of
+            // this display or reapply the state of some of its layers, as
+            // opposed to only refreshing buffers and fences.
+            bool needsRebuild() const;
+
             // Called after hwc.prepare() with responses from the device.
             void generateChanges();
 
@@ -278,6 +305,13 @@ private:
 
             void markGeometryChanged() { mGeometryChanged = true; }
             void resetGeometryMarker() { mGeometryChanged = false;}
+
+            // Called when layers are added, removed, reordered or change the
+            // number of rects they use, which invalidates the layout of the
+            // cached HWC1 contents.
+            void markLayoutChanged() { mLayoutChanged = true; }
+
+            void recordSetTime(std::chrono::nanoseconds duration);
         private:
             class Config {
                 public:
@@ -387,7 +421,8 @@ private:
                     const Layer& layer);
 
             // Set all fields in HWC1 comm array for layer containing the
-            // HWC_FRAMEBUFFER_TARGET (always the last layer).
+            // HWC_FRAMEBUFFER_TARGET (always the last layer). Reuses the
+            // visible region rect when the contents are cached.
             void prepareFramebufferTarget();
 
             // Display ID generator.
@@ -414,7 +449,8 @@ private:
             void allocateRequestedContents();
 
             // Array of structs exchanged between client and hwc1 device.
-            // Sent to device upon calling prepare().
+            // Sent to device upon calling prepare(). It is kept across frames
+            // and only reallocated when mLayoutChanged is set.
             std::unique_ptr<hwc_display_contents_1> mHwc1RequestedContents;
     private:
             DeferredFence mRetireFence;
@@ -458,6 +494,13 @@ private:
             // updated with anything other than a buffer since last call to
             // Display::set()
             bool mGeometryChanged;
+
+            // True if mHwc1RequestedContents no longer matches mLayers and
+            // must be reallocated on the next prepare().
+            bool mLayoutChanged;
+
+            TimingStats mPrepareTime;
+            TimingStats mSetTime;
     };
 
     // Utility template calling a Display object method directly based on the
@@ -563,6 +606,15 @@ private:
             // Write state to HWC1 communication struct.
             void applyState(struct hwc_layer_1& hwc1Layer);
 
+            // Write only the state that changes every frame (composition
+            // type, buffer and fences) to a HWC1 communication struct
+            // previously filled by applyState().
+            void applyFrameState(struct hwc_layer_1& hwc1Layer);
+
+            // True if some state other than the buffer has been updated since
+            // the last call to applyState().
+            bool isStateDirty() const { return mStateDirty; }
+
             std::string dump() const;
 
             std::size_t getNumVisibleRegions() { return mVisibleRegion.size(); }
@@ -582,6 +634,8 @@ private:
             void applyBufferState(struct hwc_layer_1& hwc1Layer);
             void applyCompositionType(struct hwc_layer_1& hwc1Layer);
 
+            void markStateDirty();
+
             static std::atomic<hwc2_layer_t> sNextId;
             const hwc2_layer_t mId;
             Display& mDisplay;
@@ -605,6 +659,7 @@ private:
 
             size_t mHwc1Id;
             bool mHasUnsupportedPlaneAlpha;
+            bool mStateDirty;
     };
 
     // Utility tempate calling a Layer object method based on ID parameters:
@@ -677,8 +732,16 @@ private:
 
     bool prepareAllDisplays();
     std::vector<struct hwc_display_contents_1*> mHwc1Contents;
+
+    // Prepares displays next to the calling thread, see prepareAllDisplays.
+    class PrepareWorker;
+    std::unique_ptr<PrepareWorker> mPrepareWorker;
     HWC2::Error setAllDisplays();
 
+    // Time spent inside the HWC1 prepare() and set() calls for all displays.
+    TimingStats mHwc1PrepareTime;
+    TimingStats mHwc1SetTime;
+
     // Callbacks
     void hwc1Invalidate();
     void hwc1Vsync(int hwc1DisplayId, int64_t timestamp);
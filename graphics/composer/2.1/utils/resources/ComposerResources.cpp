@@ -18,6 +18,8 @@
 
 #include "composer-resources/2.1/ComposerResources.h"
 
+#include <sstream>
+
 namespace android {
 namespace hardware {
 namespace graphics {
@@ -25,6 +27,57 @@ namespace composer {
 namespace V2_1 {
 namespace hal {
 
+ComposerHandleStats& ComposerHandleStats::getInstance() {
+    static ComposerHandleStats stats;
+    return stats;
+}
+
+void ComposerHandleStats::onFramePresented() {
+    const uint64_t imports = mImports;
+    const uint64_t frees = mFrees;
+    const uint64_t frameImports = imports - mFrameStartImports;
+    const uint64_t frameFrees = frees - mFrameStartFrees;
+    mFrameStartImports = imports;
+    mFrameStartFrees = frees;
+
+    mLastFrameImports = frameImports;
+    mLastFrameFrees = frameFrees;
+    if (frameImports > mMaxFrameImports) {
+        mMaxFrameImports = frameImports;
+    }
+    if (frameFrees > mMaxFrameFrees) {
+        mMaxFrameFrees = frameFrees;
+    }
+    mFrames++;
+}
+
+std::string ComposerHandleStats::dump() const {
+    std::ostringstream os;
+    os << "Handle imports/frees:\n";
+    os << "  total: " << mImports << " imported, " << mFrees << " freed ("
+       << mDeferredFrees << " deferred) over " << mFrames << " frames\n";
+    os << "  last frame: " << mLastFrameImports << " imported, " << mLastFrameFrees
+       << " freed\n";
+    os << "  max per frame: " << mMaxFrameImports << " imported, " << mMaxFrameFrees
+       << " freed\n";
+    return os.str();
+}
+
+ComposerHandleImporter::~ComposerHandleImporter() {
+    std::vector<PendingRelease> releases;
+    {
+        std::lock_guard<std::mutex> lock(mReleaseMutex);
+        mReleaseThreadExit = true;
+        releases.swap(mPendingReleases);
+    }
+    mReleaseCondition.notify_one();
+    if (mReleaseThread.joinable()) {
+        mReleaseThread.join();
+    }
+
+    freePendingReleases(&releases);
+}
+
 bool ComposerHandleImporter::init() {
     mMapper4 = mapper::V4_0::IMapper::getService();
     if (mMapper4) {
@@ -83,6 +136,8 @@ Error ComposerHandleImporter::importBuffer(const native_handle_t* rawHandle,
         }
     }
 
+    ComposerHandleStats::getInstance().onImport();
+
     *outBufferHandle = bufferHandle;
     return Error::NONE;
 }
@@ -96,6 +151,7 @@ void ComposerHandleImporter::freeBuffer(const native_handle_t* bufferHandle) {
         } else if (mMapper4) {
             mMapper4->freeBuffer(static_cast<void*>(const_cast<native_handle_t*>(bufferHandle)));
         }
+        ComposerHandleStats::getInstance().onFree();
     }
 }
 
@@ -107,6 +163,7 @@ Error ComposerHandleImporter::importStream(const native_handle_t* rawHandle,
         if (!streamHandle) {
             return Error::NO_RESOURCES;
         }
+        ComposerHandleStats::getInstance().onImport();
     }
 
     *outStreamHandle = streamHandle;
@@ -117,7 +174,67 @@ void ComposerHandleImporter::freeStream(const native_handle_t* streamHandle) {
     if (streamHandle) {
         native_handle_close(streamHandle);
         native_handle_delete(const_cast<native_handle_t*>(streamHandle));
+        ComposerHandleStats::getInstance().onFree();
+    }
+}
+
+void ComposerHandleImporter::releaseBuffer(const native_handle_t* bufferHandle) {
+    if (bufferHandle) {
+        queueRelease(bufferHandle, true);
+    }
+}
+
+void ComposerHandleImporter::releaseStream(const native_handle_t* streamHandle) {
+    if (streamHandle) {
+        queueRelease(streamHandle, false);
+    }
+}
+
+void ComposerHandleImporter::queueRelease(const native_handle_t* handle, bool isBuffer) {
+    {
+        std::lock_guard<std::mutex> lock(mReleaseMutex);
+        if (mReleaseThreadExit) {
+            // only possible while being destroyed; free synchronously
+            if (isBuffer) {
+                freeBuffer(handle);
+            } else {
+                freeStream(handle);
+            }
+            return;
+        }
+        if (!mReleaseThread.joinable()) {
+            mReleaseThread = std::thread(&ComposerHandleImporter::releaseThreadLoop, this);
+        }
+        mPendingReleases.push_back({handle, isBuffer});
+    }
+    mReleaseCondition.notify_one();
+}
+
+void ComposerHandleImporter::releaseThreadLoop() {
+    std::vector<PendingRelease> releases;
+    std::unique_lock<std::mutex> lock(mReleaseMutex);
+    while (!mReleaseThreadExit) {
+        mReleaseCondition.wait(lock,
+                               [this] { return mReleaseThreadExit || !mPendingReleases.empty(); });
+        releases.swap(mPendingReleases);
+
+        lock.unlock();
+        freePendingReleases(&releases);
+        lock.lock();
+    }
+}
+
+void ComposerHandleImporter::freePendingReleases(std::vector<PendingRelease>* releases) {
+    for (const auto& release : *releases) {
+        if (release.isBuffer) {
+            freeBuffer(release.handle);
+        } else {
+            freeStream(release.handle);
+        }
+        ComposerHandleStats::getInstance().onDeferredFree();
     }
+    // keep the capacity for the next batch
+    releases->clear();
 }
 
 ComposerHandleCache::ComposerHandleCache(ComposerHandleImporter& importer, HandleType type,
@@ -238,6 +355,7 @@ Error ComposerDisplayResource::getOutputBuffer(uint32_t slot, bool fromCache,
     return mOutputBufferCache.getHandle(slot, fromCache, inHandle, outHandle, outReplacedHandle);
 }
 
+// The layer functions below must be called with getMutex() held.
 bool ComposerDisplayResource::addLayer(Layer layer,
                                        std::unique_ptr<ComposerLayerResource> layerResource) {
     auto result = mLayerResources.emplace(layer, std::move(layerResource));
@@ -248,6 +366,17 @@ bool ComposerDisplayResource::removeLayer(Layer layer) {
     return mLayerResources.erase(layer) > 0;
 }
 
+std::unique_ptr<ComposerLayerResource> ComposerDisplayResource::takeLayer(Layer layer) {
+    auto layerIter = mLayerResources.find(layer);
+    if (layerIter == mLayerResources.end()) {
+        return nullptr;
+    }
+
+    auto layerResource = std::move(layerIter->second);
+    mLayerResources.erase(layerIter);
+    return layerResource;
+}
+
 ComposerLayerResource* ComposerDisplayResource::findLayerResource(Layer layer) {
     auto layerIter = mLayerResources.find(layer);
     if (layerIter == mLayerResources.end()) {
@@ -287,10 +416,16 @@ void ComposerResources::clear(RemoveDisplay removeDisplay) {
     std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
     for (const auto& displayKey : mDisplayResources) {
         Display display = displayKey.first;
-        const ComposerDisplayResource& displayResource = *displayKey.second;
-        removeDisplay(display, displayResource.isVirtual(), displayResource.getLayers());
+        ComposerDisplayResource& displayResource = *displayKey.second;
+        std::vector<Layer> layers;
+        {
+            std::lock_guard<std::mutex> displayLock(displayResource.getMutex());
+            layers = displayResource.getLayers();
+        }
+        removeDisplay(display, displayResource.isVirtual(), layers);
     }
     mDisplayResources.clear();
+    publishDisplayResourcesLocked();
 }
 
 Error ComposerResources::addPhysicalDisplay(Display display) {
@@ -298,7 +433,11 @@ Error ComposerResources::addPhysicalDisplay(Display display) {
 
     std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
     auto result = mDisplayResources.emplace(display, std::move(displayResource));
-    return result.second ? Error::NONE : Error::BAD_DISPLAY;
+    if (!result.second) {
+        return Error::BAD_DISPLAY;
+    }
+    publishDisplayResourcesLocked();
+    return Error::NONE;
 }
 
 Error ComposerResources::addVirtualDisplay(Display display, uint32_t outputBufferCacheSize) {
@@ -307,22 +446,30 @@ Error ComposerResources::addVirtualDisplay(Display display, uint32_t outputBuffe
 
     std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
     auto result = mDisplayResources.emplace(display, std::move(displayResource));
-    return result.second ? Error::NONE : Error::BAD_DISPLAY;
+    if (!result.second) {
+        return Error::BAD_DISPLAY;
+    }
+    publishDisplayResourcesLocked();
+    return Error::NONE;
 }
 
 Error ComposerResources::removeDisplay(Display display) {
     std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    return mDisplayResources.erase(display) > 0 ? Error::NONE : Error::BAD_DISPLAY;
+    if (mDisplayResources.erase(display) == 0) {
+        return Error::BAD_DISPLAY;
+    }
+    publishDisplayResourcesLocked();
+    return Error::NONE;
 }
 
 Error ComposerResources::setDisplayClientTargetCacheSize(Display display,
                                                          uint32_t clientTargetCacheSize) {
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    ComposerDisplayResource* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (!displayResource) {
         return Error::BAD_DISPLAY;
     }
 
+    std::lock_guard<std::mutex> lock(displayResource->getMutex());
     return displayResource->initClientTargetCache(clientTargetCacheSize) ? Error::NONE
                                                                          : Error::BAD_PARAMETER;
 }
@@ -330,24 +477,30 @@ Error ComposerResources::setDisplayClientTargetCacheSize(Display display,
 Error ComposerResources::addLayer(Display display, Layer layer, uint32_t bufferCacheSize) {
     auto layerResource = createLayerResource(bufferCacheSize);
 
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    ComposerDisplayResource* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (!displayResource) {
         return Error::BAD_DISPLAY;
     }
 
+    std::lock_guard<std::mutex> lock(displayResource->getMutex());
     return displayResource->addLayer(layer, std::move(layerResource)) ? Error::NONE
                                                                       : Error::BAD_LAYER;
 }
 
 Error ComposerResources::removeLayer(Display display, Layer layer) {
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    ComposerDisplayResource* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (!displayResource) {
         return Error::BAD_DISPLAY;
     }
 
-    return displayResource->removeLayer(layer) ? Error::NONE : Error::BAD_LAYER;
+    // destroy the layer resource, and free its handles, outside of the lock
+    std::unique_ptr<ComposerLayerResource> layerResource;
+    {
+        std::lock_guard<std::mutex> lock(displayResource->getMutex());
+        layerResource = displayResource->takeLayer(layer);
+    }
+
+    return layerResource ? Error::NONE : Error::BAD_LAYER;
 }
 
 Error ComposerResources::getDisplayClientTarget(Display display, uint32_t slot, bool fromCache,
@@ -383,16 +536,14 @@ Error ComposerResources::getLayerSidebandStream(Display display, Layer layer,
 }
 
 void ComposerResources::setDisplayMustValidateState(Display display, bool mustValidate) {
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    auto* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (displayResource) {
         displayResource->setMustValidateState(mustValidate);
     }
 }
 
 bool ComposerResources::mustValidateDisplay(Display display) {
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-    auto* displayResource = findDisplayResourceLocked(display);
+    auto displayResource = findDisplayResource(display);
     if (displayResource) {
         return displayResource->mustValidate();
     }
@@ -417,6 +568,22 @@ ComposerDisplayResource* ComposerResources::findDisplayResourceLocked(Display di
     return iter->second.get();
 }
 
+std::shared_ptr<ComposerDisplayResource> ComposerResources::findDisplayResource(
+        Display display) const {
+    auto displayResources = std::atomic_load(&mDisplayResourcesSnapshot);
+    auto iter = displayResources->find(display);
+    if (iter == displayResources->end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+void ComposerResources::publishDisplayResourcesLocked() {
+    std::atomic_store(&mDisplayResourcesSnapshot,
+                      std::shared_ptr<const DisplayResourceMap>(
+                              std::make_shared<DisplayResourceMap>(mDisplayResources)));
+}
+
 Error ComposerResources::getHandle(Display display, Layer layer, uint32_t slot, Cache cache,
                                    bool fromCache, const native_handle_t* rawHandle,
                                    const native_handle_t** outHandle,
@@ -434,12 +601,14 @@ Error ComposerResources::getHandle(Display display, Layer layer, uint32_t slot,
         }
     }
 
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-
     // find display/layer resource
     const bool needLayerResource = (cache == ComposerResources::Cache::LAYER_BUFFER ||
                                     cache == ComposerResources::Cache::LAYER_SIDEBAND_STREAM);
-    ComposerDisplayResource* displayResource = findDisplayResourceLocked(display);
+    std::shared_ptr<ComposerDisplayResource> displayResource = findDisplayResource(display);
+    std::unique_lock<std::mutex> lock;
+    if (displayResource) {
+        lock = std::unique_lock<std::mutex>(displayResource->getMutex());
+    }
     ComposerLayerResource* layerResource = (displayResource && needLayerResource)
                                                    ? displayResource->findLayerResource(layer)
                                                    : nullptr;
@@ -20,8 +20,12 @@
 #warning "ComposerResources.h included without LOG_TAG"
 #endif
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -39,9 +43,44 @@ namespace composer {
 namespace V2_1 {
 namespace hal {
 
+// process-wide counters of imported and freed handles, reported in the composer dump
+class ComposerHandleStats {
+  public:
+    static ComposerHandleStats& getInstance();
+
+    void onImport() { mImports++; }
+    void onFree() { mFrees++; }
+    void onDeferredFree() { mDeferredFrees++; }
+
+    // called once per presented frame to compute the per-frame counters
+    void onFramePresented();
+
+    std::string dump() const;
+
+  private:
+    std::atomic<uint64_t> mImports{0};
+    std::atomic<uint64_t> mFrees{0};
+    std::atomic<uint64_t> mDeferredFrees{0};
+    std::atomic<uint64_t> mFrames{0};
+
+    // only updated by onFramePresented, which is called from the command engine thread
+    uint64_t mFrameStartImports = 0;
+    uint64_t mFrameStartFrees = 0;
+    std::atomic<uint64_t> mLastFrameImports{0};
+    std::atomic<uint64_t> mLastFrameFrees{0};
+    std::atomic<uint64_t> mMaxFrameImports{0};
+    std::atomic<uint64_t> mMaxFrameFrees{0};
+};
+
 // wrapper for IMapper to import buffers and sideband streams
 class ComposerHandleImporter {
   public:
+    ComposerHandleImporter() = default;
+    ~ComposerHandleImporter();
+
+    ComposerHandleImporter(const ComposerHandleImporter&) = delete;
+    ComposerHandleImporter& operator=(const ComposerHandleImporter&) = delete;
+
     bool init();
 
     Error importBuffer(const native_handle_t* rawHandle, const native_handle_t** outBufferHandle);
@@ -49,10 +88,33 @@ class ComposerHandleImporter {
     Error importStream(const native_handle_t* rawHandle, const native_handle_t** outStreamHandle);
     void freeStream(const native_handle_t* streamHandle);
 
+    // Queue a handle to be freed on the release thread. Used for handles
+    // replaced in a cache, so that freeing them does not add to the latency
+    // of the command that replaced them.
+    void releaseBuffer(const native_handle_t* bufferHandle);
+    void releaseStream(const native_handle_t* streamHandle);
+
   private:
+    struct PendingRelease {
+        const native_handle_t* handle;
+        bool isBuffer;
+    };
+
+    void queueRelease(const native_handle_t* handle, bool isBuffer);
+    void releaseThreadLoop();
+    void freePendingReleases(std::vector<PendingRelease>* releases);
+
     sp<mapper::V2_0::IMapper> mMapper2;
     sp<mapper::V3_0::IMapper> mMapper3;
     sp<mapper::V4_0::IMapper> mMapper4;
+
+    // the release thread swaps mPendingReleases with its own vector, so the
+    // storage of both is reused from one frame to the next
+    std::mutex mReleaseMutex;
+    std::condition_variable mReleaseCondition;
+    std::vector<PendingRelease> mPendingReleases;
+    bool mReleaseThreadExit = false;
+    std::thread mReleaseThread;
 };
 
 class ComposerHandleCache {
@@ -133,6 +195,9 @@ class ComposerDisplayResource {
 
     bool addLayer(Layer layer, std::unique_ptr<ComposerLayerResource> layerResource);
     bool removeLayer(Layer layer);
+    // remove a layer and hand its resource to the caller, so that its handles
+    // can be freed without holding getMutex()
+    std::unique_ptr<ComposerLayerResource> takeLayer(Layer layer);
     ComposerLayerResource* findLayerResource(Layer layer);
     std::vector<Layer> getLayers() const;
 
@@ -140,11 +205,17 @@ class ComposerDisplayResource {
 
     bool mustValidate() const;
 
+    // Guards the handle caches and the layer resources of this display.
+    // ComposerResources holds it while updating a cache so that it does not
+    // need to hold its display map lock.
+    std::mutex& getMutex() { return mMutex; }
+
   protected:
     const DisplayType mType;
+    std::mutex mMutex;
     ComposerHandleCache mClientTargetCache;
     ComposerHandleCache mOutputBufferCache;
-    bool mMustValidate;
+    std::atomic<bool> mMustValidate;
 
     std::unordered_map<Layer, std::unique_ptr<ComposerLayerResource>> mLayerResources;
 };
@@ -188,13 +259,15 @@ class ComposerResources {
 
         bool isBuffer() { return mIsBuffer; }
 
+        // the previous handle has been replaced in ComposerHal by now, and is
+        // freed asynchronously by the importer
         void reset(ComposerHandleImporter* importer = nullptr,
                    const native_handle_t* handle = nullptr) {
             if (mHandle) {
                 if (mIsBuffer) {
-                    mImporter->freeBuffer(mHandle);
+                    mImporter->releaseBuffer(mHandle);
                 } else {
-                    mImporter->freeStream(mHandle);
+                    mImporter->releaseStream(mHandle);
                 }
             }
 
@@ -227,6 +300,9 @@ class ComposerResources {
                                  ReplacedHandle* outReplacedStream);
 
   protected:
+    using DisplayResourceMap =
+            std::unordered_map<Display, std::shared_ptr<ComposerDisplayResource>>;
+
     virtual std::unique_ptr<ComposerDisplayResource> createDisplayResource(
             ComposerDisplayResource::DisplayType type, uint32_t outputBufferCacheSize);
 
@@ -234,10 +310,22 @@ class ComposerResources {
 
     ComposerDisplayResource* findDisplayResourceLocked(Display display);
 
+    // Look up a display without taking mDisplayResourcesMutex. The returned
+    // resource stays valid even if the display is removed concurrently.
+    std::shared_ptr<ComposerDisplayResource> findDisplayResource(Display display) const;
+
+    // Publish a copy of mDisplayResources for findDisplayResource. Must be
+    // called with mDisplayResourcesMutex held after mDisplayResources changes.
+    void publishDisplayResourcesLocked();
+
     ComposerHandleImporter mImporter;
 
     std::mutex mDisplayResourcesMutex;
-    std::unordered_map<Display, std::unique_ptr<ComposerDisplayResource>> mDisplayResources;
+    DisplayResourceMap mDisplayResources;
+
+    // read-only snapshot of mDisplayResources, swapped atomically
+    std::shared_ptr<const DisplayResourceMap> mDisplayResourcesSnapshot =
+            std::make_shared<const DisplayResourceMap>();
 
   private:
     enum class Cache {
@@ -54,15 +54,15 @@ Error ComposerResources::getDisplayReadbackBuffer(Display display, const native_
         return error;
     }
 
-    std::lock_guard<std::mutex> lock(mDisplayResourcesMutex);
-
-    auto iter = mDisplayResources.find(display);
-    if (iter == mDisplayResources.end()) {
+    auto resource = findDisplayResource(display);
+    if (!resource) {
         mImporter.freeBuffer(importedHandle);
         return Error::BAD_DISPLAY;
     }
     ComposerDisplayResource& displayResource =
-            *static_cast<ComposerDisplayResource*>(iter->second.get());
+            *static_cast<ComposerDisplayResource*>(resource.get());
+
+    std::lock_guard<std::mutex> lock(displayResource.getMutex());
 
     // update cache
     const native_handle_t* replacedHandle;
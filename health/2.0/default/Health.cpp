@@ -23,6 +23,8 @@
 #include <hal_conversion.h>
 #include <hidl/HidlTransportSupport.h>
 
+#include "HealthInfoNotifier.h"
+
 using HealthInfo_1_0 = android::hardware::health::V1_0::HealthInfo;
 using android::hardware::health::V1_0::hal_conversion::convertFromHealthInfo;
 
@@ -50,8 +52,13 @@ Return<Result> Health::registerCallback(const sp<IHealthInfoCallback>& callback)
     }
 
     {
+        wp<Health> weak_this(this);
+        auto on_dead = [weak_this](const sp<IHealthInfoCallback>& dead) {
+            sp<Health> self = weak_this.promote();
+            if (self != nullptr) (void)self->unregisterCallbackInternal(dead);
+        };
         std::lock_guard<decltype(callbacks_lock_)> lock(callbacks_lock_);
-        callbacks_.push_back(callback);
+        callbacks_.push_back(HealthInfoNotifier::Start(callback, std::move(on_dead)));
         // unlock
     }
 
@@ -71,7 +78,8 @@ bool Health::unregisterCallbackInternal(const sp<IBase>& callback) {
     bool removed = false;
     std::lock_guard<decltype(callbacks_lock_)> lock(callbacks_lock_);
     for (auto it = callbacks_.begin(); it != callbacks_.end();) {
-        if (interfacesEqual(*it, callback)) {
+        if (interfacesEqual((*it)->callback(), callback)) {
+            (*it)->Stop();
             it = callbacks_.erase(it);
             removed = true;
         } else {
@@ -171,13 +179,11 @@ Return<Result> Health::update() {
 
 Return<Result> Health::updateAndNotify(const sp<IHealthInfoCallback>& callback) {
     std::lock_guard<decltype(callbacks_lock_)> lock(callbacks_lock_);
-    std::vector<sp<IHealthInfoCallback>> storedCallbacks{std::move(callbacks_)};
-    callbacks_.clear();
-    if (callback != nullptr) {
-        callbacks_.push_back(callback);
-    }
+    notify_target_only_ = true;
+    notify_target_ = callback;
     Return<Result> result = update();
-    callbacks_ = std::move(storedCallbacks);
+    notify_target_only_ = false;
+    notify_target_.clear();
     return result;
 }
 
@@ -200,14 +206,13 @@ void Health::notifyListeners(HealthInfo* healthInfo) {
     healthInfo->diskStats = stats;
     healthInfo->storageInfos = info;
 
+    // Shared by all clients; each client's notifier delivers it on its own thread.
+    auto shared_info = std::make_shared<const HealthInfo>(*healthInfo);
+
     std::lock_guard<decltype(callbacks_lock_)> lock(callbacks_lock_);
-    for (auto it = callbacks_.begin(); it != callbacks_.end();) {
-        auto ret = (*it)->healthInfoChanged(*healthInfo);
-        if (!ret.isOk() && ret.isDeadObject()) {
-            it = callbacks_.erase(it);
-        } else {
-            ++it;
-        }
+    for (const auto& notifier : callbacks_) {
+        if (notify_target_only_ && notifier->callback() != notify_target_) continue;
+        notifier->Post(shared_info);
     }
 }
 
@@ -226,6 +231,16 @@ Return<void> Health::debug(const hidl_handle& handle, const hidl_vec<hidl_string
             android::base::WriteStringToFd("\n", fd);
         });
 
+        {
+            std::lock_guard<decltype(callbacks_lock_)> lock(callbacks_lock_);
+            android::base::WriteStringToFd(
+                    "\nhealthInfoChanged callbacks: " + std::to_string(callbacks_.size()) + "\n",
+                    fd);
+            for (const auto& notifier : callbacks_) {
+                notifier->Dump(fd);
+            }
+        }
+
         fsync(fd);
     }
     return Void();
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "android.hardware.health@2.0-impl"
+#include <android-base/logging.h>
+
+#include "HealthInfoNotifier.h"
+
+#include <thread>
+
+#include <android-base/file.h>
+#include <android-base/stringprintf.h>
+
+using android::base::StringPrintf;
+using android::base::WriteStringToFd;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+constexpr std::chrono::milliseconds HealthInfoNotifier::kDefaultDeadline;
+
+HealthInfoNotifier::HealthInfoNotifier(const sp<IHealthInfoCallback>& callback,
+                                       DeadCallback on_dead, Clock::duration deadline)
+    : callback_(callback), on_dead_(std::move(on_dead)), deadline_(deadline) {}
+
+std::shared_ptr<HealthInfoNotifier> HealthInfoNotifier::Start(
+        const sp<IHealthInfoCallback>& callback, DeadCallback on_dead, Clock::duration deadline) {
+    auto notifier = std::make_shared<HealthInfoNotifier>(callback, std::move(on_dead), deadline);
+    std::thread([notifier] { notifier->Run(); }).detach();
+    return notifier;
+}
+
+void HealthInfoNotifier::Post(std::shared_ptr<const HealthInfo> info) {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        if (stopped_) return;
+        if (pending_ != nullptr) {
+            superseded_count_++;
+        } else {
+            pending_since_ = Clock::now();
+        }
+        pending_ = std::move(info);
+    }
+    cv_.notify_one();
+}
+
+void HealthInfoNotifier::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(lock_);
+        stopped_ = true;
+        pending_.reset();
+    }
+    cv_.notify_one();
+}
+
+void HealthInfoNotifier::Run() {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (true) {
+        cv_.wait(lock, [this] { return stopped_ || pending_ != nullptr; });
+        if (stopped_) return;
+
+        auto info = std::move(pending_);
+        pending_.reset();
+        Clock::time_point posted = pending_since_;
+
+        lock.unlock();
+        auto ret = callback_->healthInfoChanged(*info);
+        Clock::duration latency = Clock::now() - posted;
+        info.reset();
+        lock.lock();
+
+        if (!ret.isOk()) {
+            failed_count_++;
+            if (ret.isDeadObject()) {
+                stopped_ = true;
+                pending_.reset();
+                lock.unlock();
+                on_dead_(callback_);
+                return;
+            }
+            LOG(WARNING) << "healthInfoChanged failed: " << ret.description();
+            continue;
+        }
+
+        delivered_count_++;
+        last_latency_ = latency;
+        total_latency_ += latency;
+        if (latency > max_latency_) max_latency_ = latency;
+        if (latency > deadline_) {
+            deadline_miss_count_++;
+            LOG(WARNING) << "healthInfoChanged took "
+                         << duration_cast<microseconds>(latency).count() << "us, deadline is "
+                         << duration_cast<microseconds>(deadline_).count() << "us";
+        }
+    }
+}
+
+void HealthInfoNotifier::Dump(int fd) const {
+    std::lock_guard<std::mutex> lock(lock_);
+    auto us = [](Clock::duration d) {
+        return static_cast<long long>(duration_cast<microseconds>(d).count());
+    };
+    long long avg_us = delivered_count_ ? us(total_latency_) / delivered_count_ : 0;
+    WriteStringToFd(
+            StringPrintf("  callback %p: delivered %llu, superseded %llu, failed %llu, "
+                         "deadline misses %llu, pending %d, latency last %lldus avg %lldus "
+                         "max %lldus\n",
+                         callback_.get(), static_cast<unsigned long long>(delivered_count_),
+                         static_cast<unsigned long long>(superseded_count_),
+                         static_cast<unsigned long long>(failed_count_),
+                         static_cast<unsigned long long>(deadline_miss_count_),
+                         pending_ != nullptr, us(last_latency_), avg_us, us(max_latency_)),
+            fd);
+}
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
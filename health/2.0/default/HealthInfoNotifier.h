@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+#include <android/hardware/health/2.0/IHealthInfoCallback.h>
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+
+// Delivers HealthInfo updates to one IHealthInfoCallback on a thread of its own, so that a
+// slow or dead client holds up neither the health loop nor the other clients.
+//
+// Only the latest update is kept: updates posted while a delivery is in flight replace each
+// other, and the client receives the newest one once its previous call returns. A delivery
+// that takes longer than the deadline is reported as a deadline miss.
+class HealthInfoNotifier {
+   public:
+    using Clock = std::chrono::steady_clock;
+    // Called on the delivery thread when the client is found dead.
+    using DeadCallback = std::function<void(const sp<IHealthInfoCallback>&)>;
+
+    static constexpr std::chrono::milliseconds kDefaultDeadline{500};
+
+    // Starts the delivery thread, which keeps the notifier alive until Stop() is called or the
+    // client dies.
+    static std::shared_ptr<HealthInfoNotifier> Start(const sp<IHealthInfoCallback>& callback,
+                                                     DeadCallback on_dead,
+                                                     Clock::duration deadline = kDefaultDeadline);
+
+    const sp<IHealthInfoCallback>& callback() const { return callback_; }
+
+    // Queues |info| for delivery, replacing any update that has not been delivered yet.
+    void Post(std::shared_ptr<const HealthInfo> info);
+
+    // Drops the pending update and lets the delivery thread exit after the in-flight call.
+    void Stop();
+
+    // Writes delivery count and latency of this client to |fd|.
+    void Dump(int fd) const;
+
+    HealthInfoNotifier(const sp<IHealthInfoCallback>& callback, DeadCallback on_dead,
+                       Clock::duration deadline);
+
+   private:
+    void Run();
+
+    const sp<IHealthInfoCallback> callback_;
+    const DeadCallback on_dead_;
+    const Clock::duration deadline_;
+
+    mutable std::mutex lock_;
+    std::condition_variable cv_;
+    bool stopped_ = false;
+    std::shared_ptr<const HealthInfo> pending_;
+    Clock::time_point pending_since_;
+
+    // Statistics, guarded by |lock_|.
+    uint64_t delivered_count_ = 0;
+    uint64_t superseded_count_ = 0;
+    uint64_t failed_count_ = 0;
+    uint64_t deadline_miss_count_ = 0;
+    Clock::duration last_latency_{};
+    Clock::duration max_latency_{};
+    Clock::duration total_latency_{};
+};
+
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
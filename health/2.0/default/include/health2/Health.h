@@ -25,6 +25,8 @@ using V1_0::BatteryStatus;
 
 using ::android::hidl::base::V1_0::IBase;
 
+class HealthInfoNotifier;
+
 struct Health : public IHealth, hidl_death_recipient {
    public:
     static sp<IHealth> initInstance(struct healthd_config* c);
@@ -60,7 +62,11 @@ struct Health : public IHealth, hidl_death_recipient {
     static sp<Health> instance_;
 
     std::recursive_mutex callbacks_lock_;
-    std::vector<sp<IHealthInfoCallback>> callbacks_;
+    std::vector<std::shared_ptr<HealthInfoNotifier>> callbacks_;
+    // Set by updateAndNotify() while it runs update(), which calls notifyListeners() on the
+    // same thread. Guarded by callbacks_lock_.
+    bool notify_target_only_ = false;
+    sp<IHealthInfoCallback> notify_target_;
     std::unique_ptr<BatteryMonitor> battery_monitor_;
 
     bool unregisterCallbackInternal(const sp<IBase>& cb);
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../HealthInfoNotifier.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <utils/Errors.h>
+
+using android::hardware::Return;
+using android::hardware::Status;
+using android::hardware::Void;
+using namespace std::chrono_literals;
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace V2_0 {
+namespace implementation {
+namespace {
+
+constexpr auto kTimeout = 5s;
+
+// Records the battery level of each update. Deliveries can be held up with Block(), and the
+// client can be made to look dead.
+class FakeHealthInfoCallback : public IHealthInfoCallback {
+   public:
+    Return<void> healthInfoChanged(const HealthInfo& info) override {
+        std::unique_lock<std::mutex> lock(lock_);
+        levels_.push_back(info.legacy.batteryLevel);
+        cv_.notify_all();
+        cv_.wait(lock, [this] { return !blocked_; });
+        if (dead_) {
+            return Status::fromStatusT(DEAD_OBJECT);
+        }
+        return Void();
+    }
+
+    void Block() {
+        std::lock_guard<std::mutex> lock(lock_);
+        blocked_ = true;
+    }
+
+    void Unblock() {
+        std::lock_guard<std::mutex> lock(lock_);
+        blocked_ = false;
+        cv_.notify_all();
+    }
+
+    void SetDead() {
+        std::lock_guard<std::mutex> lock(lock_);
+        dead_ = true;
+    }
+
+    // Waits until |count| updates have been received, and returns their levels.
+    std::vector<int32_t> WaitForLevels(size_t count) {
+        std::unique_lock<std::mutex> lock(lock_);
+        cv_.wait_for(lock, kTimeout, [&] { return levels_.size() >= count; });
+        return levels_;
+    }
+
+    std::vector<int32_t> levels() {
+        std::lock_guard<std::mutex> lock(lock_);
+        return levels_;
+    }
+
+   private:
+    std::mutex lock_;
+    std::condition_variable cv_;
+    std::vector<int32_t> levels_;
+    bool blocked_ = false;
+    bool dead_ = false;
+};
+
+std::shared_ptr<const HealthInfo> MakeInfo(int32_t level) {
+    auto info = std::make_shared<HealthInfo>();
+    info->legacy.batteryLevel = level;
+    return info;
+}
+
+class HealthInfoNotifierTest : public ::testing::Test {
+   protected:
+    void SetUp() override {
+        callback_ = new FakeHealthInfoCallback();
+        notifier_ = HealthInfoNotifier::Start(callback_, [this](const auto& callback) {
+            std::lock_guard<std::mutex> lock(dead_lock_);
+            dead_callbacks_.push_back(callback);
+            dead_cv_.notify_all();
+        });
+    }
+
+    void TearDown() override {
+        callback_->Unblock();
+        if (notifier_ != nullptr) notifier_->Stop();
+    }
+
+    // Drops the test's reference, and waits for the delivery thread to drop its own.
+    bool WaitForExit() {
+        std::weak_ptr<HealthInfoNotifier> notifier = notifier_;
+        notifier_.reset();
+        auto deadline = std::chrono::steady_clock::now() + kTimeout;
+        while (!notifier.expired()) {
+            if (std::chrono::steady_clock::now() > deadline) return false;
+            std::this_thread::sleep_for(1ms);
+        }
+        return true;
+    }
+
+    sp<FakeHealthInfoCallback> callback_;
+    std::shared_ptr<HealthInfoNotifier> notifier_;
+
+    std::mutex dead_lock_;
+    std::condition_variable dead_cv_;
+    std::vector<sp<IHealthInfoCallback>> dead_callbacks_;
+};
+
+TEST_F(HealthInfoNotifierTest, DeliversEachUpdateWhenIdle) {
+    notifier_->Post(MakeInfo(1));
+    EXPECT_EQ(std::vector<int32_t>({1}), callback_->WaitForLevels(1));
+    notifier_->Post(MakeInfo(2));
+    EXPECT_EQ(std::vector<int32_t>({1, 2}), callback_->WaitForLevels(2));
+}
+
+TEST_F(HealthInfoNotifierTest, CoalescesUpdatesPostedDuringADelivery) {
+    callback_->Block();
+    notifier_->Post(MakeInfo(1));
+    ASSERT_EQ(1u, callback_->WaitForLevels(1).size());
+
+    // The client is busy with the first update, only the latest of these is kept.
+    notifier_->Post(MakeInfo(2));
+    notifier_->Post(MakeInfo(3));
+    notifier_->Post(MakeInfo(4));
+    callback_->Unblock();
+
+    EXPECT_EQ(std::vector<int32_t>({1, 4}), callback_->WaitForLevels(2));
+    std::this_thread::sleep_for(50ms);
+    EXPECT_EQ(std::vector<int32_t>({1, 4}), callback_->levels());
+}
+
+TEST_F(HealthInfoNotifierTest, StopDropsThePendingUpdate) {
+    callback_->Block();
+    notifier_->Post(MakeInfo(1));
+    ASSERT_EQ(1u, callback_->WaitForLevels(1).size());
+    notifier_->Post(MakeInfo(2));
+    notifier_->Stop();
+    callback_->Unblock();
+
+    EXPECT_TRUE(WaitForExit());
+    EXPECT_EQ(std::vector<int32_t>({1}), callback_->levels());
+}
+
+TEST_F(HealthInfoNotifierTest, PostAfterStopIsIgnored) {
+    notifier_->Stop();
+    notifier_->Post(MakeInfo(1));
+    std::this_thread::sleep_for(50ms);
+    EXPECT_TRUE(callback_->levels().empty());
+}
+
+TEST_F(HealthInfoNotifierTest, StopsAndReportsADeadClient) {
+    callback_->SetDead();
+    notifier_->Post(MakeInfo(1));
+    {
+        std::unique_lock<std::mutex> lock(dead_lock_);
+        ASSERT_TRUE(dead_cv_.wait_for(lock, kTimeout, [this] { return !dead_callbacks_.empty(); }));
+        ASSERT_EQ(1u, dead_callbacks_.size());
+        EXPECT_EQ(callback_.get(), dead_callbacks_[0].get());
+    }
+
+    // Nothing is delivered to a dead client anymore.
+    notifier_->Post(MakeInfo(2));
+    EXPECT_TRUE(WaitForExit());
+    EXPECT_EQ(std::vector<int32_t>({1}), callback_->levels());
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V2_0
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
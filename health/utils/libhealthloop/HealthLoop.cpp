@@ -28,6 +28,8 @@
 #include <sys/timerfd.h>
 #include <unistd.h>
 
+#include <algorithm>
+
 #include <android-base/logging.h>
 #include <batteryservice/BatteryService.h>
 #include <cutils/klog.h>
@@ -94,6 +96,7 @@ void HealthLoop::WakeAlarmSetInterval(int interval) {
     itval.it_value.tv_sec = interval;
     itval.it_value.tv_nsec = 0;
 
+    ++stats_.syscalls;
     if (timerfd_settime(wakealarm_fd_, 0, &itval, NULL) == -1)
         KLOG_ERROR(LOG_TAG, "wakealarm_set_interval: timerfd_settime failed\n");
 }
@@ -121,6 +124,18 @@ void HealthLoop::AdjustWakealarmPeriods(bool charger_online) {
 }
 
 void HealthLoop::PeriodicChores() {
+    UpdateBattery();
+}
+
+void HealthLoop::UpdateBattery() {
+    if (uevent_update_pending_) {
+        // The update below covers the pending uevents; disarm the debounce timer.
+        uevent_update_pending_ = false;
+        struct itimerspec itval = {};
+        ++stats_.syscalls;
+        timerfd_settime(uevent_debounce_fd_, 0, &itval, NULL);
+    }
+    ++stats_.battery_updates;
     ScheduleBatteryUpdate();
 }
 
@@ -130,27 +145,82 @@ void HealthLoop::UeventEvent(uint32_t /*epevents*/) {
     // No need to lock because uevent_fd_ is guaranteed to be initialized.
 
     char msg[UEVENT_MSG_LEN + 2];
-    char* cp;
     int n;
+    bool changed = false;
+
+    // Drain the socket so that a burst of uevents costs one wakeup.
+    while (true) {
+        ++stats_.syscalls;
+        n = uevent_kernel_multicast_recv(uevent_fd_, msg, UEVENT_MSG_LEN);
+        if (n <= 0) break;
+        if (n >= UEVENT_MSG_LEN) /* overflow -- discard */
+            continue;
+
+        msg[n] = '\0';
+        msg[n + 1] = '\0';
+        ++stats_.uevents;
+
+        // Cheap check first; most uevents are not from power supplies.
+        if (!memmem(msg, n, "SUBSYSTEM=" POWER_SUPPLY_SUBSYSTEM,
+                    sizeof("SUBSYSTEM=" POWER_SUPPLY_SUBSYSTEM))) {
+            continue;
+        }
+        ++stats_.power_supply_uevents;
+        if (uevent_filter_.IsChanged(msg, n)) {
+            changed = true;
+        } else {
+            ++stats_.unchanged_uevents;
+        }
+    }
+    if (!changed) return;
 
-    n = uevent_kernel_multicast_recv(uevent_fd_, msg, UEVENT_MSG_LEN);
-    if (n <= 0) return;
-    if (n >= UEVENT_MSG_LEN) /* overflow -- discard */
+    if (uevent_debounce_fd_ == -1) {
+        UpdateBattery();
         return;
+    }
 
-    msg[n] = '\0';
-    msg[n + 1] = '\0';
-    cp = msg;
+    // Push the update back until the uevents stop, but not indefinitely.
+    auto now = std::chrono::steady_clock::now();
+    if (!uevent_update_pending_) {
+        uevent_update_pending_ = true;
+        first_pending_uevent_ = now;
+    }
+    auto delay = std::min<std::chrono::steady_clock::duration>(
+            kUeventDebounce, first_pending_uevent_ + kUeventMaxDelay - now);
+    if (delay <= std::chrono::steady_clock::duration::zero()) {
+        UpdateBattery();
+        return;
+    }
+    struct itimerspec itval = {};
+    itval.it_value.tv_sec = std::chrono::duration_cast<std::chrono::seconds>(delay).count();
+    itval.it_value.tv_nsec = (delay % std::chrono::seconds(1)) / std::chrono::nanoseconds(1);
+    ++stats_.syscalls;
+    if (timerfd_settime(uevent_debounce_fd_, 0, &itval, NULL) == -1) {
+        KLOG_ERROR(LOG_TAG, "uevent_event: timerfd_settime failed\n");
+        UpdateBattery();
+    }
+}
 
-    while (*cp) {
-        if (!strcmp(cp, "SUBSYSTEM=" POWER_SUPPLY_SUBSYSTEM)) {
-            ScheduleBatteryUpdate();
-            break;
-        }
+void HealthLoop::UeventDebounceEvent(uint32_t /*epevents*/) {
+    unsigned long long expirations;
+
+    ++stats_.syscalls;
+    if (read(uevent_debounce_fd_, &expirations, sizeof(expirations)) == -1) return;
+
+    if (uevent_update_pending_) UpdateBattery();
+}
+
+void HealthLoop::UeventDebounceInit(void) {
+    // An alarm timer, so that a pending update is not held back by suspend.
+    uevent_debounce_fd_.reset(timerfd_create(CLOCK_BOOTTIME_ALARM, TFD_NONBLOCK | TFD_CLOEXEC));
+    if (uevent_debounce_fd_ == -1) {
+        KLOG_ERROR(LOG_TAG, "uevent_debounce_init: timerfd_create failed\n");
+        return;
+    }
 
-        /* advance to after the next \0 */
-        while (*cp++)
-            ;
+    if (RegisterEvent(uevent_debounce_fd_, &HealthLoop::UeventDebounceEvent, EVENT_WAKEUP_FD)) {
+        KLOG_ERROR(LOG_TAG, "Registration of uevent debounce event failed\n");
+        uevent_debounce_fd_.reset();
     }
 }
 
@@ -172,6 +242,7 @@ void HealthLoop::WakeAlarmEvent(uint32_t /*epevents*/) {
 
     unsigned long long wakeups;
 
+    ++stats_.syscalls;
     if (read(wakealarm_fd_, &wakeups, sizeof(wakeups)) == -1) {
         KLOG_ERROR(LOG_TAG, "wakealarm_event: read wakealarm fd failed\n");
         return;
@@ -210,7 +281,9 @@ void HealthLoop::MainLoop(void) {
 
         mode_timeout = PrepareToWait();
         if (timeout < 0 || (mode_timeout > 0 && mode_timeout < timeout)) timeout = mode_timeout;
+        ++stats_.syscalls;
         nevents = epoll_wait(epollfd_, events, eventct, timeout);
+        ++stats_.wakeups;
         if (nevents == -1) {
             if (errno == EINTR) continue;
             KLOG_ERROR(LOG_TAG, "healthd_mainloop: epoll_wait failed\n");
@@ -241,6 +314,7 @@ int HealthLoop::InitInternal() {
     Init(&healthd_config_);
 
     WakeAlarmInit();
+    UeventDebounceInit();
     UeventInit();
 
     return 0;
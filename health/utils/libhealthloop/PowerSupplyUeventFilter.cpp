@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <health/PowerSupplyUeventFilter.h>
+
+#include <string.h>
+
+#include <string_view>
+
+namespace android {
+namespace hardware {
+namespace health {
+
+namespace {
+
+constexpr std::string_view kSubsystem = "SUBSYSTEM=";
+constexpr std::string_view kAction = "ACTION=";
+constexpr std::string_view kDevpath = "DEVPATH=";
+constexpr std::string_view kPowerSupplyProperty = "POWER_SUPPLY_";
+
+bool StartsWith(std::string_view s, std::string_view prefix) {
+    return s.substr(0, prefix.size()) == prefix;
+}
+
+}  // namespace
+
+bool PowerSupplyUeventFilter::IsChanged(const char* msg, size_t len) {
+    bool is_power_supply = false;
+    std::string_view action;
+    std::string_view devpath;
+    std::string properties;
+
+    const char* end = msg + len;
+    for (const char* cp = msg; cp < end && *cp; cp += strnlen(cp, end - cp) + 1) {
+        std::string_view entry(cp, strnlen(cp, end - cp));
+        if (StartsWith(entry, kSubsystem)) {
+            is_power_supply = entry.substr(kSubsystem.size()) == "power_supply";
+        } else if (StartsWith(entry, kAction)) {
+            action = entry.substr(kAction.size());
+        } else if (StartsWith(entry, kDevpath)) {
+            devpath = entry.substr(kDevpath.size());
+        } else if (StartsWith(entry, kPowerSupplyProperty)) {
+            properties.append(entry);
+            properties.push_back('\0');
+        }
+    }
+
+    if (!is_power_supply) return false;
+    // Without a DEVPATH there is nothing to compare with.
+    if (devpath.empty()) return true;
+
+    std::string key(devpath);
+    if (action != "change") {
+        // add, remove, online, ...: forget what is known about the supply.
+        properties_.erase(key);
+        return true;
+    }
+
+    auto it = properties_.find(key);
+    if (it != properties_.end() && it->second == properties) return false;
+    properties_[key] = std::move(properties);
+    return true;
+}
+
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
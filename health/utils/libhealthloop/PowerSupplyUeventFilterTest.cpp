@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <health/PowerSupplyUeventFilter.h>
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace android {
+namespace hardware {
+namespace health {
+namespace {
+
+// Builds a uevent the way the kernel sends it: NUL-separated entries.
+std::string Uevent(const std::vector<std::string>& entries) {
+    std::string msg;
+    for (const auto& entry : entries) {
+        msg.append(entry);
+        msg.push_back('\0');
+    }
+    return msg;
+}
+
+std::string PowerSupplyUevent(const std::string& action, const std::string& name,
+                              const std::string& online, const std::string& voltage_max) {
+    const std::string devpath = "/devices/platform/soc/charger/power_supply/" + name;
+    return Uevent({action + "@" + devpath, "ACTION=" + action, "DEVPATH=" + devpath,
+                   "SUBSYSTEM=power_supply", "POWER_SUPPLY_NAME=" + name,
+                   "POWER_SUPPLY_ONLINE=" + online, "POWER_SUPPLY_VOLTAGE_MAX=" + voltage_max,
+                   "SEQNUM=" + std::to_string(rand())});
+}
+
+bool IsChanged(PowerSupplyUeventFilter* filter, const std::string& msg) {
+    return filter->IsChanged(msg.data(), msg.size());
+}
+
+TEST(PowerSupplyUeventFilterTest, IgnoresOtherSubsystems) {
+    PowerSupplyUeventFilter filter;
+    EXPECT_FALSE(IsChanged(&filter, Uevent({"change@/devices/virtual/thermal/thermal_zone0",
+                                            "ACTION=change",
+                                            "DEVPATH=/devices/virtual/thermal/thermal_zone0",
+                                            "SUBSYSTEM=thermal"})));
+    EXPECT_EQ(0u, filter.size());
+}
+
+TEST(PowerSupplyUeventFilterTest, DropsRepeatedUevents) {
+    PowerSupplyUeventFilter filter;
+    EXPECT_TRUE(IsChanged(&filter, PowerSupplyUevent("change", "usb", "1", "5000000")));
+    // Only SEQNUM differs.
+    EXPECT_FALSE(IsChanged(&filter, PowerSupplyUevent("change", "usb", "1", "5000000")));
+    EXPECT_FALSE(IsChanged(&filter, PowerSupplyUevent("change", "usb", "1", "5000000")));
+    // Power delivery negotiated a higher voltage.
+    EXPECT_TRUE(IsChanged(&filter, PowerSupplyUevent("change", "usb", "1", "9000000")));
+    EXPECT_FALSE(IsChanged(&filter, PowerSupplyUevent("change", "usb", "1", "9000000")));
+}
+
+TEST(PowerSupplyUeventFilterTest, TracksPowerSuppliesSeparately) {
+    PowerSupplyUeventFilter filter;
+    EXPECT_TRUE(IsChanged(&filter, PowerSupplyUevent("change", "usb", "1", "5000000")));
+    EXPECT_TRUE(IsChanged(&filter, PowerSupplyUevent("change", "battery", "1", "5000000")));
+    EXPECT_FALSE(IsChanged(&filter, PowerSupplyUevent("change", "usb", "1", "5000000")));
+    EXPECT_FALSE(IsChanged(&filter, PowerSupplyUevent("change", "battery", "1", "5000000")));
+    EXPECT_EQ(2u, filter.size());
+}
+
+TEST(PowerSupplyUeventFilterTest, AddAndRemoveAreAlwaysChanges) {
+    PowerSupplyUeventFilter filter;
+    EXPECT_TRUE(IsChanged(&filter, PowerSupplyUevent("change", "wireless", "1", "5000000")));
+    EXPECT_TRUE(IsChanged(&filter, PowerSupplyUevent("remove", "wireless", "1", "5000000")));
+    EXPECT_EQ(0u, filter.size());
+    EXPECT_TRUE(IsChanged(&filter, PowerSupplyUevent("add", "wireless", "1", "5000000")));
+    EXPECT_TRUE(IsChanged(&filter, PowerSupplyUevent("change", "wireless", "1", "5000000")));
+    EXPECT_FALSE(IsChanged(&filter, PowerSupplyUevent("change", "wireless", "1", "5000000")));
+}
+
+TEST(PowerSupplyUeventFilterTest, HandlesTruncatedUevent) {
+    PowerSupplyUeventFilter filter;
+    std::string msg = PowerSupplyUevent("change", "usb", "1", "5000000");
+    // No terminating NUL on the last entry.
+    msg.pop_back();
+    EXPECT_TRUE(IsChanged(&filter, msg));
+    EXPECT_FALSE(IsChanged(&filter, msg));
+    EXPECT_FALSE(filter.IsChanged(msg.data(), 0));
+}
+
+}  // namespace
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
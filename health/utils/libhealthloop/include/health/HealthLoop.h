@@ -15,11 +15,13 @@
  */
 #pragma once
 
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <vector>
 
 #include <android-base/unique_fd.h>
+#include <health/PowerSupplyUeventFilter.h>
 #include <healthd/healthd.h>
 
 namespace android {
@@ -72,6 +74,22 @@ class HealthLoop {
     // then reset wake alarm interval by calling AdjustWakealarmPeriods.
     void AdjustWakealarmPeriods(bool charger_online);
 
+    // Counters of the main loop since it started. Only accessed on the
+    // thread that runs the loop.
+    struct Stats {
+        uint64_t wakeups = 0;
+        // Syscalls made by the loop itself, including epoll_wait.
+        uint64_t syscalls = 0;
+        uint64_t uevents = 0;
+        // power_supply uevents, and those of them that repeated the
+        // previous uevent of their power supply and were dropped.
+        uint64_t power_supply_uevents = 0;
+        uint64_t unchanged_uevents = 0;
+        // Calls to ScheduleBatteryUpdate(), i.e. battery rescans.
+        uint64_t battery_updates = 0;
+    };
+    const Stats& stats() const { return stats_; }
+
   private:
     struct EventHandler {
         HealthLoop* object = nullptr;
@@ -85,19 +103,35 @@ class HealthLoop {
     void WakeAlarmEvent(uint32_t);
     void UeventInit();
     void UeventEvent(uint32_t);
+    void UeventDebounceInit();
+    void UeventDebounceEvent(uint32_t);
     void WakeAlarmSetInterval(int interval);
     void PeriodicChores();
+    // Runs ScheduleBatteryUpdate() and drops any pending uevent update.
+    void UpdateBattery();
 
     // These are fixed after InitInternal() is called.
     struct healthd_config healthd_config_;
     android::base::unique_fd wakealarm_fd_;
     android::base::unique_fd uevent_fd_;
+    android::base::unique_fd uevent_debounce_fd_;
 
     android::base::unique_fd epollfd_;
     std::vector<std::unique_ptr<EventHandler>> event_handlers_;
     int awake_poll_interval_;  // -1 for no epoll timeout
     int wakealarm_wake_interval_;
 
+    // A burst of power_supply uevents (e.g. while a charger negotiates)
+    // results in a single battery update once the uevents stop, or at most
+    // kUeventMaxDelay after the first of them.
+    static constexpr std::chrono::milliseconds kUeventDebounce{100};
+    static constexpr std::chrono::milliseconds kUeventMaxDelay{500};
+    PowerSupplyUeventFilter uevent_filter_;
+    bool uevent_update_pending_ = false;
+    std::chrono::steady_clock::time_point first_pending_uevent_;
+
+    Stats stats_;
+
     // If set to true, future RegisterEvent() will be rejected. This is to ensure all
     // events are registered before StartLoop().
     bool reject_event_register_ = false;
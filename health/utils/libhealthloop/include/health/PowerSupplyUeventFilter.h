@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+#include <unordered_map>
+
+namespace android {
+namespace hardware {
+namespace health {
+
+// Remembers the POWER_SUPPLY_* properties that the last uevent of each power
+// supply reported. The kernel sends a full snapshot of the properties with
+// each uevent, so a uevent that repeats the previous snapshot of its power
+// supply does not need another battery update.
+class PowerSupplyUeventFilter {
+  public:
+    // |msg| is a uevent as received from the kernel: |len| bytes of
+    // NUL-terminated KEY=VALUE strings.
+    // Returns true if |msg| is a power_supply uevent that adds or removes a
+    // power supply, or reports properties that differ from the previous
+    // uevent of that power supply.
+    bool IsChanged(const char* msg, size_t len);
+
+    size_t size() const { return properties_.size(); }
+
+  private:
+    // DEVPATH -> POWER_SUPPLY_* properties of the last uevent
+    std::unordered_map<std::string, std::string> properties_;
+};
+
+}  // namespace health
+}  // namespace hardware
+}  // namespace android
@@ -24,6 +24,8 @@
 
 #include <string.h>
 
+#include <algorithm>
+
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 
@@ -103,6 +105,10 @@ int IdentityCredential::initialize() {
     }
     storageKey_ = storageKeyItem->value();
     credentialPrivKey_ = credentialPrivKeyItem->value();
+    if (!storageKeyDecryptor_.init(storageKey_)) {
+        LOG(ERROR) << "Error setting up decryption with storage key";
+        return IIdentityCredentialStore::STATUS_INVALID_DATA;
+    }
 
     return IIdentityCredentialStore::STATUS_OK;
 }
@@ -172,25 +178,16 @@ ndk::ScopedAStatus IdentityCredential::createAuthChallenge(int64_t* outChallenge
     return ndk::ScopedAStatus::ok();
 }
 
-// TODO: this could be a lot faster if we did all the splitting and pubkey extraction
+// The public keys are extracted by validateProfile() and validateReaderCertificateChain()
 // ahead of time.
-bool checkReaderAuthentication(const SecureAccessControlProfile& profile,
-                               const vector<uint8_t>& readerCertificateChain) {
-    optional<vector<uint8_t>> acpPubKey = support::certificateChainGetTopMostKey(
-            byteStringToUnsigned(profile.readerCertificate.encodedCertificate));
+bool checkReaderAuthentication(const optional<vector<uint8_t>>& acpPubKey,
+                               const vector<optional<vector<uint8_t>>>& readerCertificatePubKeys) {
     if (!acpPubKey) {
         LOG(ERROR) << "Error extracting public key from readerCertificate in profile";
         return false;
     }
 
-    optional<vector<vector<uint8_t>>> certificatesInChain =
-            support::certificateChainSplit(readerCertificateChain);
-    if (!certificatesInChain) {
-        LOG(ERROR) << "Error splitting readerCertificateChain";
-        return false;
-    }
-    for (const vector<uint8_t>& certInChain : certificatesInChain.value()) {
-        optional<vector<uint8_t>> certPubKey = support::certificateChainGetTopMostKey(certInChain);
+    for (const optional<vector<uint8_t>>& certPubKey : readerCertificatePubKeys) {
         if (!certPubKey) {
             LOG(ERROR)
                     << "Error extracting public key from certificate in chain presented by reader";
@@ -255,6 +252,58 @@ bool checkUserAuthentication(const SecureAccessControlProfile& profile,
     return true;
 }
 
+// Profiles are bound to the credential so a handful is the most we expect to see, this only
+// guards against a caller making us remember an unbounded number of them.
+constexpr size_t kMaxValidatedProfiles = 32;
+
+const optional<vector<uint8_t>>* IdentityCredential::validateProfile(
+        const SecureAccessControlProfile& profile) {
+    auto key = std::make_pair(secureAccessControlProfileEncodeCbor(profile), profile.mac);
+    auto it = validatedProfiles_.find(key);
+    if (it != validatedProfiles_.end()) {
+        return &it->second;
+    }
+
+    if (!secureAccessControlProfileCheckMac(key.first, key.second, storageKey_)) {
+        return nullptr;
+    }
+    optional<vector<uint8_t>> acpPubKey;
+    if (profile.readerCertificate.encodedCertificate.size() > 0) {
+        acpPubKey = support::certificateChainGetTopMostKey(
+                byteStringToUnsigned(profile.readerCertificate.encodedCertificate));
+    }
+    if (validatedProfiles_.size() >= kMaxValidatedProfiles) {
+        validatedProfiles_.clear();
+    }
+    return &validatedProfiles_.emplace(std::move(key), std::move(acpPubKey)).first->second;
+}
+
+bool IdentityCredential::validateReaderCertificateChain(
+        const vector<uint8_t>& readerCertificateChain) {
+    if (!validatedReaderCertificateChain_.empty() &&
+        validatedReaderCertificateChain_ == readerCertificateChain) {
+        return true;
+    }
+
+    if (!support::certificateChainValidate(readerCertificateChain)) {
+        return false;
+    }
+    optional<vector<vector<uint8_t>>> certificatesInChain =
+            support::certificateChainSplit(readerCertificateChain);
+    if (!certificatesInChain || certificatesInChain.value().empty()) {
+        LOG(ERROR) << "Error splitting readerCertificateChain";
+        return false;
+    }
+    vector<optional<vector<uint8_t>>> pubKeys;
+    pubKeys.reserve(certificatesInChain.value().size());
+    for (const vector<uint8_t>& certInChain : certificatesInChain.value()) {
+        pubKeys.push_back(support::certificateChainGetTopMostKey(certInChain));
+    }
+    validatedReaderCertificateChain_ = readerCertificateChain;
+    readerCertificatePublicKeys_ = std::move(pubKeys);
+    return true;
+}
+
 ndk::ScopedAStatus IdentityCredential::setRequestedNamespaces(
         const vector<RequestNamespace>& requestNamespaces) {
     requestNamespaces_ = requestNamespaces;
@@ -305,14 +354,13 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
                     "Unable to get reader certificate chain from COSE_Sign1"));
         }
 
-        if (!support::certificateChainValidate(readerCertificateChain.value())) {
+        if (!validateReaderCertificateChain(readerCertificateChain.value())) {
             return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                     IIdentityCredentialStore::STATUS_READER_SIGNATURE_CHECK_FAILED,
                     "Error validating reader certificate chain"));
         }
 
-        optional<vector<uint8_t>> readerPublicKey =
-                support::certificateChainGetTopMostKey(readerCertificateChain.value());
+        const optional<vector<uint8_t>>& readerPublicKey = readerCertificatePublicKeys_[0];
         if (!readerPublicKey) {
             return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                     IIdentityCredentialStore::STATUS_READER_SIGNATURE_CHECK_FAILED,
@@ -469,7 +517,8 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
     // Validate all the access control profiles in the requestData.
     bool haveAuthToken = (authToken.timestamp.milliSeconds != int64_t(0));
     for (const auto& profile : accessControlProfiles) {
-        if (!secureAccessControlProfileCheckMac(profile, storageKey_)) {
+        const optional<vector<uint8_t>>* acpPubKey = validateProfile(profile);
+        if (acpPubKey == nullptr) {
             LOG(ERROR) << "Error checking MAC for profile";
             return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                     IIdentityCredentialStore::STATUS_INVALID_DATA,
@@ -483,7 +532,7 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
             }
         } else if (profile.readerCertificate.encodedCertificate.size() > 0) {
             if (!readerCertificateChain ||
-                !checkReaderAuthentication(profile, readerCertificateChain.value())) {
+                !checkReaderAuthentication(*acpPubKey, readerCertificatePublicKeys_)) {
                 accessControlCheck = IIdentityCredentialStore::STATUS_READER_AUTHENTICATION_FAILED;
             }
         }
@@ -492,6 +541,7 @@ ndk::ScopedAStatus IdentityCredential::startRetrieval(
 
     deviceNameSpacesMap_ = cppbor::Map();
     currentNameSpaceDeviceNameSpacesMap_ = cppbor::Map();
+    retrievedEntryValues_.clear();
 
     requestCountsRemaining_ = requestCounts;
     currentNameSpace_ = "";
@@ -523,7 +573,22 @@ size_t cborNumBytesForTstr(const string& value) {
     return 1 + cborNumBytesForLength(value.size()) + value.size();
 }
 
-size_t IdentityCredential::calcDeviceNameSpacesSize() {
+bool IdentityCredential::isAuthorized(const vector<int32_t>& accessControlProfileIds) const {
+    // Access is granted if at least one of the profiles grants access.
+    //
+    // If an item is configured without any profiles, access is denied.
+    //
+    for (auto id : accessControlProfileIds) {
+        auto it = profileIdToAccessCheckResult_.find(id);
+        if (it != profileIdToAccessCheckResult_.end() &&
+            it->second == IIdentityCredentialStore::STATUS_OK) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t IdentityCredential::calcDeviceNameSpacesSize() const {
     /*
      * This is how DeviceNameSpaces is defined:
      *
@@ -539,67 +604,51 @@ size_t IdentityCredential::calcDeviceNameSpacesSize() {
      *        DataItemValue = any
      *
      * This function will calculate its length using knowledge of how CBOR is
-     * encoded.
+     * encoded, in a single pass over the requested items.
      */
     size_t ret = 0;
     size_t numNamespacesWithValues = 0;
     for (const RequestNamespace& rns : requestNamespaces_) {
-        vector<RequestDataItem> itemsToInclude;
-
-        for (const RequestDataItem& rdi : rns.items) {
-            // If we have a CBOR request message, skip if item isn't in it
-            if (itemsRequest_.size() > 0) {
-                const auto& it = requestedNameSpacesAndNames_.find(rns.namespaceName);
-                if (it == requestedNameSpacesAndNames_.end()) {
-                    continue;
-                }
-                const set<string>& dataItemNames = it->second;
-                if (dataItemNames.find(rdi.name) == dataItemNames.end()) {
-                    continue;
-                }
+        // If we have a CBOR request message, skip items that aren't in it.
+        const set<string>* dataItemNames = nullptr;
+        if (itemsRequest_.size() > 0) {
+            const auto& it = requestedNameSpacesAndNames_.find(rns.namespaceName);
+            if (it == requestedNameSpacesAndNames_.end()) {
+                continue;
             }
+            dataItemNames = &it->second;
+        }
 
-            // Access is granted if at least one of the profiles grants access.
-            //
-            // If an item is configured without any profiles, access is denied.
-            //
-            bool authorized = false;
-            for (auto id : rdi.accessControlProfileIds) {
-                auto it = profileIdToAccessCheckResult_.find(id);
-                if (it != profileIdToAccessCheckResult_.end()) {
-                    int accessControlForProfile = it->second;
-                    if (accessControlForProfile == IIdentityCredentialStore::STATUS_OK) {
-                        authorized = true;
-                        break;
-                    }
-                }
+        size_t numItemsToInclude = 0;
+        size_t itemsSize = 0;
+        for (const RequestDataItem& rdi : rns.items) {
+            if (dataItemNames != nullptr && dataItemNames->find(rdi.name) == dataItemNames->end()) {
+                continue;
             }
-            if (!authorized) {
+            if (!isAuthorized(rdi.accessControlProfileIds)) {
                 continue;
             }
 
-            itemsToInclude.push_back(rdi);
+            // Key: DataItemName
+            itemsSize += cborNumBytesForTstr(rdi.name);
+
+            // Value: DataItemValue - entryData.size is the length of serialized CBOR so we use
+            // that.
+            itemsSize += rdi.size;
+
+            numItemsToInclude++;
         }
 
         // If no entries are to be in the namespace, we don't include it...
-        if (itemsToInclude.size() == 0) {
+        if (numItemsToInclude == 0) {
             continue;
         }
 
         // Key: NameSpace
         ret += cborNumBytesForTstr(rns.namespaceName);
 
-        // Value: Open the DeviceSignedItems map
-        ret += 1 + cborNumBytesForLength(itemsToInclude.size());
-
-        for (const RequestDataItem& item : itemsToInclude) {
-            // Key: DataItemName
-            ret += cborNumBytesForTstr(item.name);
-
-            // Value: DataItemValue - entryData.size is the length of serialized CBOR so we use
-            // that.
-            ret += item.size;
-        }
+        // Value: The DeviceSignedItems map and its entries
+        ret += 1 + cborNumBytesForLength(numItemsToInclude) + itemsSize;
 
         numNamespacesWithValues++;
     }
@@ -623,6 +672,11 @@ ndk::ScopedAStatus IdentityCredential::startRetrieveEntryValue(
                 IIdentityCredentialStore::STATUS_INVALID_DATA, "Name space cannot be empty"));
     }
 
+    if (entrySize < 0) {
+        return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
+                IIdentityCredentialStore::STATUS_INVALID_DATA, "Entry size cannot be negative"));
+    }
+
     if (requestCountsRemaining_.size() == 0) {
         return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                 IIdentityCredentialStore::STATUS_INVALID_DATA,
@@ -707,22 +761,25 @@ ndk::ScopedAStatus IdentityCredential::startRetrieveEntryValue(
 
     currentName_ = name;
     entryRemainingBytes_ = entrySize;
-    entryValue_.resize(0);
+    // entrySize is only what the caller claims, so don't allocate it up front. Start with room
+    // for one chunk and let retrieveEntryValue() grow the buffer as authenticated chunks arrive.
+    entryValue_.clear();
+    entryValue_.reserve(std::min<size_t>(entrySize, IdentityCredentialStore::kGcmChunkSize));
+    entryValidator_ = support::IncrementalCborValidator(entrySize);
 
     return ndk::ScopedAStatus::ok();
 }
 
 ndk::ScopedAStatus IdentityCredential::retrieveEntryValue(const vector<int8_t>& encryptedContentS,
                                                           vector<int8_t>* outContent) {
-    auto encryptedContent = byteStringToUnsigned(encryptedContentS);
-    optional<vector<uint8_t>> content =
-            support::decryptAes128Gcm(storageKey_, encryptedContent, entryAdditionalData_);
-    if (!content) {
+    const uint8_t* encryptedContent = reinterpret_cast<const uint8_t*>(encryptedContentS.data());
+    size_t encryptedContentSize = encryptedContentS.size();
+    if (encryptedContentSize < support::kAesGcmIvSize + support::kAesGcmTagSize) {
         return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                 IIdentityCredentialStore::STATUS_INVALID_DATA, "Error decrypting data"));
     }
 
-    size_t chunkSize = content.value().size();
+    size_t chunkSize = encryptedContentSize - support::kAesGcmIvSize - support::kAesGcmTagSize;
 
     if (chunkSize > entryRemainingBytes_) {
         LOG(ERROR) << "Retrieved chunk of size " << chunkSize
@@ -732,8 +789,7 @@ ndk::ScopedAStatus IdentityCredential::retrieveEntryValue(const vector<int8_t>&
                 "Retrieved chunk is bigger than remaining space"));
     }
 
-    entryRemainingBytes_ -= chunkSize;
-    if (entryRemainingBytes_ > 0) {
+    if (entryRemainingBytes_ > chunkSize) {
         if (chunkSize != IdentityCredentialStore::kGcmChunkSize) {
             return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                     IIdentityCredentialStore::STATUS_INVALID_DATA,
@@ -741,10 +797,35 @@ ndk::ScopedAStatus IdentityCredential::retrieveEntryValue(const vector<int8_t>&
         }
     }
 
-    entryValue_.insert(entryValue_.end(), content.value().begin(), content.value().end());
+    // Decrypt straight into the end of the entry buffer. The buffer only keeps the chunk once it
+    // has been authenticated.
+    size_t offset = entryValue_.size();
+    entryValue_.resize(offset + chunkSize);
+    uint8_t* chunk = entryValue_.data() + offset;
+    if (!storageKeyDecryptor_.decrypt(encryptedContent, encryptedContentSize,
+                                      entryAdditionalData_, chunk)) {
+        entryValue_.resize(offset);
+        return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
+                IIdentityCredentialStore::STATUS_INVALID_DATA, "Error decrypting data"));
+    }
+    entryRemainingBytes_ -= chunkSize;
+
+    // Check the CBOR as it arrives, so that bad data is rejected at the chunk it's in.
+    if (!entryValidator_.update(chunk, chunkSize) ||
+        (entryRemainingBytes_ == 0 && !entryValidator_.isComplete())) {
+        return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
+                IIdentityCredentialStore::STATUS_INVALID_DATA,
+                "Retrieved data which is invalid CBOR"));
+    }
+
+    outContent->assign(chunk, chunk + chunkSize);
 
     if (entryRemainingBytes_ == 0) {
-        auto [entryValueItem, _, message] = cppbor::parse(entryValue_);
+        // Keep the buffer until the next startRetrieval() and parse it with views, so large values
+        // such as portraits aren't copied again into deviceNameSpacesMap_.
+        retrievedEntryValues_.push_back(std::move(entryValue_));
+        entryValue_ = vector<uint8_t>();
+        auto [entryValueItem, _, message] = cppbor::parseWithViews(retrievedEntryValues_.back());
         if (entryValueItem == nullptr) {
             return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                     IIdentityCredentialStore::STATUS_INVALID_DATA,
@@ -753,7 +834,51 @@ ndk::ScopedAStatus IdentityCredential::retrieveEntryValue(const vector<int8_t>&
         currentNameSpaceDeviceNameSpacesMap_.add(currentName_, std::move(entryValueItem));
     }
 
-    *outContent = byteStringToSigned(content.value());
+    return ndk::ScopedAStatus::ok();
+}
+
+ndk::ScopedAStatus IdentityCredential::deriveSessionKey() {
+    // Deriving the key takes an ECDH operation, so it's only done again if one of its inputs
+    // changed since the last presentation.
+    if (!sessionKey_.empty() && sessionKeySigningKeyBlob_ == signingKeyBlob_ &&
+        sessionKeyReaderPublicKey_ == readerPublicKey_ &&
+        sessionKeySessionTranscript_ == sessionTranscript_) {
+        return ndk::ScopedAStatus::ok();
+    }
+
+    vector<uint8_t> docTypeAsBlob(docType_.begin(), docType_.end());
+    optional<vector<uint8_t>> signingKey =
+            support::decryptAes128Gcm(storageKey_, signingKeyBlob_, docTypeAsBlob);
+    if (!signingKey) {
+        return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
+                IIdentityCredentialStore::STATUS_INVALID_DATA, "Error decrypting signingKeyBlob"));
+    }
+
+    optional<vector<uint8_t>> sharedSecret = support::ecdh(readerPublicKey_, signingKey.value());
+    if (!sharedSecret) {
+        return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
+                IIdentityCredentialStore::STATUS_FAILED, "Error doing ECDH"));
+    }
+
+    // Mix-in SessionTranscriptBytes
+    vector<uint8_t> sessionTranscriptBytes = cppbor::Semantic(24, sessionTranscript_).encode();
+    vector<uint8_t> sharedSecretWithSessionTranscriptBytes = sharedSecret.value();
+    std::copy(sessionTranscriptBytes.begin(), sessionTranscriptBytes.end(),
+              std::back_inserter(sharedSecretWithSessionTranscriptBytes));
+
+    vector<uint8_t> salt = {0x00};
+    vector<uint8_t> info = {};
+    optional<vector<uint8_t>> derivedKey =
+            support::hkdf(sharedSecretWithSessionTranscriptBytes, salt, info, 32);
+    if (!derivedKey) {
+        return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
+                IIdentityCredentialStore::STATUS_FAILED, "Error deriving key from shared secret"));
+    }
+
+    sessionKey_ = std::move(derivedKey.value());
+    sessionKeySigningKeyBlob_ = signingKeyBlob_;
+    sessionKeyReaderPublicKey_ = readerPublicKey_;
+    sessionKeySessionTranscript_ = sessionTranscript_;
     return ndk::ScopedAStatus::ok();
 }
 
@@ -763,16 +888,20 @@ ndk::ScopedAStatus IdentityCredential::finishRetrieval(vector<int8_t>* outMac,
         deviceNameSpacesMap_.add(currentNameSpace_,
                                  std::move(currentNameSpaceDeviceNameSpacesMap_));
     }
-    vector<uint8_t> encodedDeviceNameSpaces = deviceNameSpacesMap_.encode();
 
-    if (encodedDeviceNameSpaces.size() != expectedDeviceNameSpacesSize_) {
-        LOG(ERROR) << "encodedDeviceNameSpaces is " << encodedDeviceNameSpaces.size() << " bytes, "
+    // The size was planned at startRetrieval() time, so DeviceNameSpaces is encoded in a single
+    // pass and anything else than exactly that many bytes is an error.
+    vector<uint8_t> encodedDeviceNameSpaces(expectedDeviceNameSpacesSize_);
+    uint8_t* encodedEnd = encodedDeviceNameSpaces.data() + encodedDeviceNameSpaces.size();
+    if (deviceNameSpacesMap_.encode(encodedDeviceNameSpaces.data(), encodedEnd) != encodedEnd) {
+        size_t encodedSize = deviceNameSpacesMap_.encodedSize();
+        LOG(ERROR) << "encodedDeviceNameSpaces is " << encodedSize << " bytes, "
                    << "was expecting " << expectedDeviceNameSpacesSize_;
         return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
                 IIdentityCredentialStore::STATUS_INVALID_DATA,
                 StringPrintf(
                         "Unexpected CBOR size %zd for encodedDeviceNameSpaces, was expecting %zd",
-                        encodedDeviceNameSpaces.size(), expectedDeviceNameSpacesSize_)
+                        encodedSize, expectedDeviceNameSpacesSize_)
                         .c_str()));
     }
 
@@ -785,42 +914,17 @@ ndk::ScopedAStatus IdentityCredential::finishRetrieval(vector<int8_t>* outMac,
         array.add("DeviceAuthentication");
         array.add(sessionTranscriptItem_->clone());
         array.add(docType_);
-        array.add(cppbor::Semantic(24, encodedDeviceNameSpaces));
+        // Refers to encodedDeviceNameSpaces rather than copying it.
+        array.add(cppbor::Semantic(
+                24, cppbor::ViewBstr(encodedDeviceNameSpaces.data(), encodedEnd)));
         vector<uint8_t> deviceAuthenticationBytes = cppbor::Semantic(24, array.encode()).encode();
 
-        vector<uint8_t> docTypeAsBlob(docType_.begin(), docType_.end());
-        optional<vector<uint8_t>> signingKey =
-                support::decryptAes128Gcm(storageKey_, signingKeyBlob_, docTypeAsBlob);
-        if (!signingKey) {
-            return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
-                    IIdentityCredentialStore::STATUS_INVALID_DATA,
-                    "Error decrypting signingKeyBlob"));
-        }
-
-        optional<vector<uint8_t>> sharedSecret =
-                support::ecdh(readerPublicKey_, signingKey.value());
-        if (!sharedSecret) {
-            return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
-                    IIdentityCredentialStore::STATUS_FAILED, "Error doing ECDH"));
-        }
-
-        // Mix-in SessionTranscriptBytes
-        vector<uint8_t> sessionTranscriptBytes = cppbor::Semantic(24, sessionTranscript_).encode();
-        vector<uint8_t> sharedSecretWithSessionTranscriptBytes = sharedSecret.value();
-        std::copy(sessionTranscriptBytes.begin(), sessionTranscriptBytes.end(),
-                  std::back_inserter(sharedSecretWithSessionTranscriptBytes));
-
-        vector<uint8_t> salt = {0x00};
-        vector<uint8_t> info = {};
-        optional<vector<uint8_t>> derivedKey =
-                support::hkdf(sharedSecretWithSessionTranscriptBytes, salt, info, 32);
-        if (!derivedKey) {
-            return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
-                    IIdentityCredentialStore::STATUS_FAILED,
-                    "Error deriving key from shared secret"));
+        ndk::ScopedAStatus status = deriveSessionKey();
+        if (!status.isOk()) {
+            return status;
         }
 
-        mac = support::coseMac0(derivedKey.value(), {},      // payload
+        mac = support::coseMac0(sessionKey_, {},              // payload
                                 deviceAuthenticationBytes);  // detached content
         if (!mac) {
             return ndk::ScopedAStatus(AStatus_fromServiceSpecificErrorWithMessage(
@@ -23,8 +23,10 @@
 #include <android/hardware/identity/support/IdentityCredentialSupport.h>
 
 #include <map>
+#include <optional>
 #include <set>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <cppbor/cppbor.h>
@@ -34,6 +36,8 @@ namespace aidl::android::hardware::identity {
 using ::aidl::android::hardware::keymaster::HardwareAuthToken;
 using ::aidl::android::hardware::keymaster::VerificationToken;
 using ::std::map;
+using ::std::optional;
+using ::std::pair;
 using ::std::set;
 using ::std::string;
 using ::std::vector;
@@ -44,7 +48,8 @@ class IdentityCredential : public BnIdentityCredential {
         : credentialData_(credentialData),
           numStartRetrievalCalls_(0),
           authChallenge_(0),
-          expectedDeviceNameSpacesSize_(0) {}
+          expectedDeviceNameSpacesSize_(0),
+          entryRemainingBytes_(0) {}
 
     // Parses and decrypts credentialData_, return a status code from
     // IIdentityCredentialStore. Must be called right after construction.
@@ -83,6 +88,8 @@ class IdentityCredential : public BnIdentityCredential {
     bool testCredential_;
     vector<uint8_t> storageKey_;
     vector<uint8_t> credentialPrivKey_;
+    // Decrypts with storageKey_, reusing its key schedule for every chunk.
+    ::android::hardware::identity::support::AesGcmDecryptor storageKeyDecryptor_;
 
     // Set by createEphemeralKeyPair()
     vector<uint8_t> ephemeralPublicKey_;
@@ -109,18 +116,51 @@ class IdentityCredential : public BnIdentityCredential {
     map<string, set<string>> requestedNameSpacesAndNames_;
     cppbor::Map deviceNameSpacesMap_;
     cppbor::Map currentNameSpaceDeviceNameSpacesMap_;
+    // Decrypted entry values. The items in the maps above refer to these
+    // buffers instead of holding copies.
+    vector<vector<uint8_t>> retrievedEntryValues_;
 
-    // Calculated at startRetrieval() time.
+    // Calculated at startRetrieval() time, finishRetrieval() encodes DeviceNameSpaces into a
+    // buffer of this size.
     size_t expectedDeviceNameSpacesSize_;
 
+    // Kept across startRetrieval() calls so presenting to the same reader again doesn't redo
+    // the public key operations.
+    //
+    // Access control profiles with a valid MAC, keyed by their CBOR encoding and MAC. The
+    // value is the public key of the profile's reader certificate, if any.
+    map<pair<vector<uint8_t>, vector<int8_t>>, optional<vector<uint8_t>>> validatedProfiles_;
+    // The last reader certificate chain which passed validation, and the public key of each
+    // certificate in it, top-most first.
+    vector<uint8_t> validatedReaderCertificateChain_;
+    vector<optional<vector<uint8_t>>> readerCertificatePublicKeys_;
+    // The key derived by ECDH and HKDF in finishRetrieval() and what it was derived from.
+    vector<uint8_t> sessionKey_;
+    vector<uint8_t> sessionKeySigningKeyBlob_;
+    vector<uint8_t> sessionKeyReaderPublicKey_;
+    vector<uint8_t> sessionKeySessionTranscript_;
+
     // Set at startRetrieveEntryValue() time.
     string currentNameSpace_;
     string currentName_;
     size_t entryRemainingBytes_;
+    // Grows by one chunk per retrieveEntryValue() call, which decrypts the chunk
+    // into it.
     vector<uint8_t> entryValue_;
     vector<uint8_t> entryAdditionalData_;
-
-    size_t calcDeviceNameSpacesSize();
+    ::android::hardware::identity::support::IncrementalCborValidator entryValidator_;
+
+    // Returns the cached result for |profile| or checks its MAC and caches it. Returns nullptr
+    // if the MAC is not valid.
+    const optional<vector<uint8_t>>* validateProfile(const SecureAccessControlProfile& profile);
+    bool validateReaderCertificateChain(const vector<uint8_t>& readerCertificateChain);
+    bool isAuthorized(const vector<int32_t>& accessControlProfileIds) const;
+    size_t calcDeviceNameSpacesSize() const;
+    // Derives sessionKey_ for the current signing key, reader key and SessionTranscript, unless
+    // it was already derived from them.
+    ndk::ScopedAStatus deriveSessionKey();
+
+    friend class IdentityCredentialPeer;
 };
 
 }  // namespace aidl::android::hardware::identity
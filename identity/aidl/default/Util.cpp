@@ -83,18 +83,24 @@ optional<vector<uint8_t>> secureAccessControlProfileCalcMac(
 
 bool secureAccessControlProfileCheckMac(const SecureAccessControlProfile& profile,
                                         const vector<uint8_t>& storageKey) {
-    vector<uint8_t> cborData = secureAccessControlProfileEncodeCbor(profile);
+    return secureAccessControlProfileCheckMac(secureAccessControlProfileEncodeCbor(profile),
+                                              profile.mac, storageKey);
+}
 
-    if (profile.mac.size() < support::kAesGcmIvSize) {
+bool secureAccessControlProfileCheckMac(const vector<uint8_t>& encodedProfile,
+                                        const vector<int8_t>& profileMac,
+                                        const vector<uint8_t>& storageKey) {
+    if (profileMac.size() < support::kAesGcmIvSize) {
         return false;
     }
     vector<uint8_t> nonce =
-            vector<uint8_t>(profile.mac.begin(), profile.mac.begin() + support::kAesGcmIvSize);
-    optional<vector<uint8_t>> mac = support::encryptAes128Gcm(storageKey, nonce, {}, cborData);
+            vector<uint8_t>(profileMac.begin(), profileMac.begin() + support::kAesGcmIvSize);
+    optional<vector<uint8_t>> mac =
+            support::encryptAes128Gcm(storageKey, nonce, {}, encodedProfile);
     if (!mac) {
         return false;
     }
-    if (mac.value() != byteStringToUnsigned(profile.mac)) {
+    if (mac.value() != byteStringToUnsigned(profileMac)) {
         return false;
     }
     return true;
@@ -37,6 +37,9 @@ using ::std::vector;
 // Returns the hardware-bound AES-128 key.
 const vector<uint8_t>& getHardwareBoundKey();
 
+// Returns the CBOR encoding of |profile| which its MAC is calculated over.
+vector<uint8_t> secureAccessControlProfileEncodeCbor(const SecureAccessControlProfile& profile);
+
 // Calculates the MAC for |profile| using |storageKey|.
 optional<vector<uint8_t>> secureAccessControlProfileCalcMac(
         const SecureAccessControlProfile& profile, const vector<uint8_t>& storageKey);
@@ -45,6 +48,11 @@ optional<vector<uint8_t>> secureAccessControlProfileCalcMac(
 bool secureAccessControlProfileCheckMac(const SecureAccessControlProfile& profile,
                                         const vector<uint8_t>& storageKey);
 
+// Like above but for a profile already encoded by secureAccessControlProfileEncodeCbor().
+bool secureAccessControlProfileCheckMac(const vector<uint8_t>& encodedProfile,
+                                        const vector<int8_t>& profileMac,
+                                        const vector<uint8_t>& storageKey);
+
 // Creates the AdditionalData CBOR used in the addEntryValue() HIDL method.
 vector<uint8_t> entryCreateAdditionalData(const string& nameSpace, const string& name,
                                           const vector<int32_t> accessControlProfileIds);
@@ -0,0 +1,391 @@
+/*
+ * Copyright 2020, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <time.h>
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <aidl/android/hardware/identity/IIdentityCredentialStore.h>
+#include <android/hardware/identity/support/IdentityCredentialSupport.h>
+
+#include <cppbor.h>
+
+#include "IdentityCredential.h"
+#include "IdentityCredentialStore.h"
+#include "Util.h"
+
+namespace aidl::android::hardware::identity {
+
+namespace support = ::android::hardware::identity::support;
+
+// Gives the tests access to the caches of an IdentityCredential, without going through
+// initialize() and a full presentation.
+class IdentityCredentialPeer {
+  public:
+    explicit IdentityCredentialPeer(IdentityCredential* credential) : credential_(credential) {}
+
+    void setStorageKey(const vector<uint8_t>& storageKey) { credential_->storageKey_ = storageKey; }
+    void setDocType(const string& docType) { credential_->docType_ = docType; }
+    void setSigningKeyBlob(const vector<uint8_t>& blob) { credential_->signingKeyBlob_ = blob; }
+    void setReaderPublicKey(const vector<uint8_t>& key) { credential_->readerPublicKey_ = key; }
+    void setSessionTranscript(const vector<uint8_t>& transcript) {
+        credential_->sessionTranscript_ = transcript;
+    }
+    void setRequestNamespaces(const vector<RequestNamespace>& requestNamespaces) {
+        credential_->requestNamespaces_ = requestNamespaces;
+    }
+    void setAccessCheckResult(int32_t profileId, int result) {
+        credential_->profileIdToAccessCheckResult_[profileId] = result;
+    }
+
+    const optional<vector<uint8_t>>* validateProfile(const SecureAccessControlProfile& profile) {
+        return credential_->validateProfile(profile);
+    }
+    size_t numValidatedProfiles() const { return credential_->validatedProfiles_.size(); }
+
+    bool validateReaderCertificateChain(const vector<uint8_t>& chain) {
+        return credential_->validateReaderCertificateChain(chain);
+    }
+    const vector<optional<vector<uint8_t>>>& readerCertificatePublicKeys() const {
+        return credential_->readerCertificatePublicKeys_;
+    }
+
+    ndk::ScopedAStatus deriveSessionKey() { return credential_->deriveSessionKey(); }
+    const vector<uint8_t>& sessionKey() const { return credential_->sessionKey_; }
+
+    size_t calcDeviceNameSpacesSize() const { return credential_->calcDeviceNameSpacesSize(); }
+
+    bool initStorageKeyDecryptor() {
+        return credential_->storageKeyDecryptor_.init(credential_->storageKey_);
+    }
+    void setRequestCounts(const vector<int32_t>& requestCounts) {
+        credential_->requestCountsRemaining_ = requestCounts;
+        credential_->currentNameSpace_ = "";
+    }
+    size_t entryValueSize() const { return credential_->entryValue_.size(); }
+    size_t entryValueCapacity() const { return credential_->entryValue_.capacity(); }
+    const vector<vector<uint8_t>>& retrievedEntryValues() const {
+        return credential_->retrievedEntryValues_;
+    }
+
+  private:
+    IdentityCredential* credential_;
+};
+
+namespace {
+
+const vector<uint8_t> kStorageKey(16, 0x42);
+const vector<uint8_t> kOtherStorageKey(16, 0x43);
+const string kDocType = "org.iso.18013-5.2019.mdl";
+
+vector<uint8_t> createEcKeyPair() {
+    optional<vector<uint8_t>> keyPair = support::createEcKeyPair();
+    EXPECT_TRUE(keyPair);
+    return keyPair.value_or(vector<uint8_t>());
+}
+
+vector<uint8_t> publicKey(const vector<uint8_t>& keyPair) {
+    return support::ecKeyPairGetPublicKey(keyPair).value_or(vector<uint8_t>());
+}
+
+vector<uint8_t> privateKey(const vector<uint8_t>& keyPair) {
+    return support::ecKeyPairGetPrivateKey(keyPair).value_or(vector<uint8_t>());
+}
+
+// Returns a certificate for the public key of |keyPair|, signed with |signingKeyPair|.
+vector<uint8_t> createCertificate(const vector<uint8_t>& keyPair,
+                                  const vector<uint8_t>& signingKeyPair, const string& subject,
+                                  const string& issuer) {
+    time_t now = time(nullptr);
+    optional<vector<uint8_t>> certificate = support::ecPublicKeyGenerateCertificate(
+            publicKey(keyPair), privateKey(signingKeyPair), "1", issuer, subject, now,
+            now + 3600);
+    EXPECT_TRUE(certificate);
+    return certificate.value_or(vector<uint8_t>());
+}
+
+// Returns a profile with a valid MAC for |storageKey|.
+SecureAccessControlProfile createProfile(int32_t id, const vector<uint8_t>& readerCertificate,
+                                         const vector<uint8_t>& storageKey) {
+    SecureAccessControlProfile profile;
+    profile.id = id;
+    profile.readerCertificate.encodedCertificate = byteStringToSigned(readerCertificate);
+    profile.userAuthenticationRequired = false;
+    profile.timeoutMillis = 0;
+    profile.secureUserId = 0;
+    optional<vector<uint8_t>> mac = secureAccessControlProfileCalcMac(profile, storageKey);
+    EXPECT_TRUE(mac);
+    profile.mac = byteStringToSigned(mac.value_or(vector<uint8_t>()));
+    return profile;
+}
+
+RequestDataItem createRequestDataItem(const string& name, size_t size,
+                                      const vector<int32_t>& accessControlProfileIds) {
+    RequestDataItem item;
+    item.name = name;
+    item.size = size;
+    item.accessControlProfileIds = accessControlProfileIds;
+    return item;
+}
+
+class IdentityCredentialTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        credential_ = ndk::SharedRefBase::make<IdentityCredential>(vector<uint8_t>());
+        peer_ = std::make_unique<IdentityCredentialPeer>(credential_.get());
+        peer_->setStorageKey(kStorageKey);
+        peer_->setDocType(kDocType);
+
+        // A reader certificate chain: the reader key, certified by a self-signed root.
+        readerKeyPair_ = createEcKeyPair();
+        rootKeyPair_ = createEcKeyPair();
+        rootCertificate_ = createCertificate(rootKeyPair_, rootKeyPair_, "Root", "Root");
+        readerCertificateChain_ = support::certificateChainJoin(
+                {createCertificate(readerKeyPair_, rootKeyPair_, "Reader", "Root"),
+                 rootCertificate_});
+    }
+
+    // Sets up everything deriveSessionKey() needs, with a signing key encrypted by |storageKey|.
+    void setUpSessionKeyInputs(const vector<uint8_t>& storageKey) {
+        signingKeyPair_ = createEcKeyPair();
+        vector<uint8_t> nonce(12, 0x01);
+        vector<uint8_t> docTypeAsBlob(kDocType.begin(), kDocType.end());
+        signingKeyBlob_ = support::encryptAes128Gcm(storageKey, nonce, privateKey(signingKeyPair_),
+                                                    docTypeAsBlob)
+                                  .value_or(vector<uint8_t>());
+        ASSERT_FALSE(signingKeyBlob_.empty());
+        peer_->setSigningKeyBlob(signingKeyBlob_);
+        peer_->setReaderPublicKey(publicKey(createEcKeyPair()));
+        peer_->setSessionTranscript(cppbor::Array("transcript", 1).encode());
+    }
+
+    std::shared_ptr<IdentityCredential> credential_;
+    std::unique_ptr<IdentityCredentialPeer> peer_;
+    vector<uint8_t> readerKeyPair_;
+    vector<uint8_t> rootKeyPair_;
+    vector<uint8_t> rootCertificate_;
+    vector<uint8_t> readerCertificateChain_;
+    vector<uint8_t> signingKeyPair_;
+    vector<uint8_t> signingKeyBlob_;
+};
+
+TEST_F(IdentityCredentialTest, ValidatedProfileIsCached) {
+    SecureAccessControlProfile profile = createProfile(1, rootCertificate_, kStorageKey);
+
+    const optional<vector<uint8_t>>* acpPubKey = peer_->validateProfile(profile);
+    ASSERT_NE(nullptr, acpPubKey);
+    ASSERT_TRUE(*acpPubKey);
+    EXPECT_EQ(publicKey(rootKeyPair_), acpPubKey->value());
+    EXPECT_EQ(1u, peer_->numValidatedProfiles());
+
+    // With a different storage key the MAC no longer checks out, so a profile which is still
+    // accepted must have come from the cache.
+    peer_->setStorageKey(kOtherStorageKey);
+    acpPubKey = peer_->validateProfile(profile);
+    ASSERT_NE(nullptr, acpPubKey);
+    EXPECT_EQ(publicKey(rootKeyPair_), acpPubKey->value());
+    EXPECT_EQ(1u, peer_->numValidatedProfiles());
+}
+
+TEST_F(IdentityCredentialTest, ChangedProfileIsValidatedAgain) {
+    SecureAccessControlProfile profile = createProfile(1, {}, kStorageKey);
+    ASSERT_NE(nullptr, peer_->validateProfile(profile));
+
+    // Same MAC over different content.
+    SecureAccessControlProfile changedProfile = profile;
+    changedProfile.userAuthenticationRequired = true;
+    EXPECT_EQ(nullptr, peer_->validateProfile(changedProfile));
+
+    // Same content with a different MAC.
+    SecureAccessControlProfile changedMac = profile;
+    changedMac.mac[0] ^= 1;
+    EXPECT_EQ(nullptr, peer_->validateProfile(changedMac));
+
+    // A changed profile with its own valid MAC gets an entry of its own.
+    SecureAccessControlProfile otherProfile = createProfile(2, rootCertificate_, kStorageKey);
+    EXPECT_NE(nullptr, peer_->validateProfile(otherProfile));
+    EXPECT_EQ(2u, peer_->numValidatedProfiles());
+}
+
+TEST_F(IdentityCredentialTest, ValidatedProfileCacheIsBounded) {
+    for (int32_t id = 0; id < 100; id++) {
+        ASSERT_NE(nullptr, peer_->validateProfile(createProfile(id, {}, kStorageKey)));
+    }
+    EXPECT_LE(peer_->numValidatedProfiles(), 32u);
+}
+
+TEST_F(IdentityCredentialTest, ReaderCertificateChainKeysAreCached) {
+    ASSERT_TRUE(peer_->validateReaderCertificateChain(readerCertificateChain_));
+    ASSERT_EQ(2u, peer_->readerCertificatePublicKeys().size());
+    EXPECT_EQ(publicKey(readerKeyPair_), peer_->readerCertificatePublicKeys()[0]);
+    EXPECT_EQ(publicKey(rootKeyPair_), peer_->readerCertificatePublicKeys()[1]);
+
+    EXPECT_TRUE(peer_->validateReaderCertificateChain(readerCertificateChain_));
+    EXPECT_EQ(publicKey(readerKeyPair_), peer_->readerCertificatePublicKeys()[0]);
+}
+
+TEST_F(IdentityCredentialTest, ChangedReaderCertificateChainIsValidatedAgain) {
+    ASSERT_TRUE(peer_->validateReaderCertificateChain(readerCertificateChain_));
+
+    // The reader certificate followed by a root which didn't sign it.
+    vector<uint8_t> otherRootKeyPair = createEcKeyPair();
+    vector<uint8_t> brokenChain = support::certificateChainJoin(
+            {createCertificate(readerKeyPair_, rootKeyPair_, "Reader", "Root"),
+             createCertificate(otherRootKeyPair, otherRootKeyPair, "Root", "Root")});
+    EXPECT_FALSE(peer_->validateReaderCertificateChain(brokenChain));
+
+    // A valid chain for another reader replaces the cached keys.
+    vector<uint8_t> otherReaderKeyPair = createEcKeyPair();
+    vector<uint8_t> otherChain = support::certificateChainJoin(
+            {createCertificate(otherReaderKeyPair, rootKeyPair_, "Other reader", "Root"),
+             rootCertificate_});
+    ASSERT_TRUE(peer_->validateReaderCertificateChain(otherChain));
+    ASSERT_EQ(2u, peer_->readerCertificatePublicKeys().size());
+    EXPECT_EQ(publicKey(otherReaderKeyPair), peer_->readerCertificatePublicKeys()[0]);
+}
+
+TEST_F(IdentityCredentialTest, SessionKeyIsCached) {
+    setUpSessionKeyInputs(kStorageKey);
+    ASSERT_TRUE(peer_->deriveSessionKey().isOk());
+    vector<uint8_t> sessionKey = peer_->sessionKey();
+    EXPECT_EQ(32u, sessionKey.size());
+
+    // The signing key blob can't be decrypted anymore, so the key must come from the cache.
+    peer_->setStorageKey(kOtherStorageKey);
+    ASSERT_TRUE(peer_->deriveSessionKey().isOk());
+    EXPECT_EQ(sessionKey, peer_->sessionKey());
+}
+
+TEST_F(IdentityCredentialTest, SessionKeyIsDerivedAgainWhenAnInputChanges) {
+    setUpSessionKeyInputs(kStorageKey);
+    ASSERT_TRUE(peer_->deriveSessionKey().isOk());
+    vector<uint8_t> sessionKey = peer_->sessionKey();
+
+    // A new SessionTranscript misses the cache, which the undecryptable signing key shows.
+    peer_->setStorageKey(kOtherStorageKey);
+    peer_->setSessionTranscript(cppbor::Array("transcript", 2).encode());
+    EXPECT_FALSE(peer_->deriveSessionKey().isOk());
+
+    peer_->setStorageKey(kStorageKey);
+    ASSERT_TRUE(peer_->deriveSessionKey().isOk());
+    EXPECT_NE(sessionKey, peer_->sessionKey());
+    sessionKey = peer_->sessionKey();
+
+    peer_->setReaderPublicKey(publicKey(createEcKeyPair()));
+    ASSERT_TRUE(peer_->deriveSessionKey().isOk());
+    EXPECT_NE(sessionKey, peer_->sessionKey());
+    sessionKey = peer_->sessionKey();
+
+    // A different signing key blob for the same key.
+    vector<uint8_t> nonce(12, 0x02);
+    vector<uint8_t> docTypeAsBlob(kDocType.begin(), kDocType.end());
+    optional<vector<uint8_t>> otherBlob = support::encryptAes128Gcm(
+            kStorageKey, nonce, privateKey(signingKeyPair_), docTypeAsBlob);
+    ASSERT_TRUE(otherBlob);
+    peer_->setStorageKey(kOtherStorageKey);
+    peer_->setSigningKeyBlob(otherBlob.value());
+    EXPECT_FALSE(peer_->deriveSessionKey().isOk());
+}
+
+TEST_F(IdentityCredentialTest, EntryBufferGrowsWithTheRetrievedChunks) {
+    constexpr size_t kChunkSize = IdentityCredentialStore::kGcmChunkSize;
+    ASSERT_TRUE(peer_->initStorageKeyDecryptor());
+    peer_->setAccessCheckResult(1, IIdentityCredentialStore::STATUS_OK);
+    peer_->setRequestCounts({2});
+
+    // The claimed size isn't allocated before any data arrives.
+    ASSERT_TRUE(credential_->startRetrieveEntryValue("ns", "huge", INT32_MAX, {1}).isOk());
+    EXPECT_LE(peer_->entryValueCapacity(), kChunkSize);
+
+    // An entry of two full chunks and a partial one.
+    vector<uint8_t> value = cppbor::Bstr(vector<uint8_t>(2 * kChunkSize + 100, 0x55)).encode();
+    ASSERT_TRUE(credential_->startRetrieveEntryValue("ns", "portrait", value.size(), {1}).isOk());
+    EXPECT_EQ(0u, peer_->entryValueSize());
+    EXPECT_LE(peer_->entryValueCapacity(), kChunkSize);
+
+    vector<uint8_t> additionalData = entryCreateAdditionalData("ns", "portrait", {1});
+    vector<uint8_t> nonce(12, 0x01);
+    vector<vector<int8_t>> encryptedChunks;
+    for (size_t offset = 0; offset < value.size(); offset += kChunkSize) {
+        vector<uint8_t> chunk(value.begin() + offset,
+                              value.begin() + std::min(offset + kChunkSize, value.size()));
+        optional<vector<uint8_t>> encrypted =
+                support::encryptAes128Gcm(kStorageKey, nonce, chunk, additionalData);
+        ASSERT_TRUE(encrypted);
+        encryptedChunks.push_back(byteStringToSigned(encrypted.value()));
+    }
+    ASSERT_EQ(3u, encryptedChunks.size());
+
+    vector<int8_t> content;
+    vector<uint8_t> retrieved;
+    ASSERT_TRUE(credential_->retrieveEntryValue(encryptedChunks[0], &content).isOk());
+    retrieved.insert(retrieved.end(), content.begin(), content.end());
+    EXPECT_EQ(kChunkSize, peer_->entryValueSize());
+
+    // A chunk that fails authentication leaves the buffer as it was.
+    vector<int8_t> tampered = encryptedChunks[1];
+    tampered[tampered.size() / 2] ^= 1;
+    EXPECT_FALSE(credential_->retrieveEntryValue(tampered, &content).isOk());
+    EXPECT_EQ(kChunkSize, peer_->entryValueSize());
+
+    for (size_t i = 1; i < encryptedChunks.size(); i++) {
+        ASSERT_TRUE(credential_->retrieveEntryValue(encryptedChunks[i], &content).isOk());
+        retrieved.insert(retrieved.end(), content.begin(), content.end());
+    }
+    EXPECT_EQ(value, retrieved);
+    ASSERT_EQ(1u, peer_->retrievedEntryValues().size());
+    EXPECT_EQ(value, peer_->retrievedEntryValues().back());
+}
+
+TEST_F(IdentityCredentialTest, PlannedDeviceNameSpacesSizeMatchesEncoding) {
+    peer_->setAccessCheckResult(1, IIdentityCredentialStore::STATUS_OK);
+    peer_->setAccessCheckResult(2, IIdentityCredentialStore::STATUS_READER_AUTHENTICATION_FAILED);
+
+    vector<uint8_t> portrait = cppbor::Bstr(vector<uint8_t>(300, 0x55)).encode();
+    vector<uint8_t> name = cppbor::Tstr("Erika").encode();
+    vector<uint8_t> age = cppbor::Uint(42).encode();
+
+    RequestNamespace mdl;
+    mdl.namespaceName = "org.iso.18013-5.2019";
+    mdl.items = {
+            createRequestDataItem("portrait", portrait.size(), {2, 1}),
+            createRequestDataItem("given_name", name.size(), {1}),
+            createRequestDataItem("denied", 10, {2}),
+    };
+    RequestNamespace denied;
+    denied.namespaceName = "denied.namespace";
+    denied.items = {createRequestDataItem("age", age.size(), {2})};
+    RequestNamespace other;
+    other.namespaceName = "other.namespace";
+    other.items = {createRequestDataItem("age", age.size(), {1})};
+    peer_->setRequestNamespaces({mdl, denied, other});
+
+    cppbor::Map expected;
+    expected.add(mdl.namespaceName,
+                 cppbor::Map().add("portrait", cppbor::Bstr(vector<uint8_t>(300, 0x55)))
+                         .add("given_name", "Erika"));
+    expected.add(other.namespaceName, cppbor::Map().add("age", 42));
+    EXPECT_EQ(expected.encode().size(), peer_->calcDeviceNameSpacesSize());
+}
+
+}  // namespace
+}  // namespace aidl::android::hardware::identity
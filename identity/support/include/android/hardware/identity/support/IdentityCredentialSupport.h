@@ -18,6 +18,7 @@
 #define IDENTITY_SUPPORT_INCLUDE_IDENTITY_CREDENTIAL_UTILS_H_
 
 #include <cstdint>
+#include <memory>
 #include <optional>
 #include <string>
 #include <tuple>
@@ -78,6 +79,40 @@ optional<vector<uint8_t>> decodeHex(const string& hexEncoded);
 string cborPrettyPrint(const vector<uint8_t>& encodedCbor, size_t maxBStrSize = 32,
                        const vector<string>& mapKeysToNotPrint = {});
 
+// Checks, as the data arrives in chunks, that |totalSize| bytes of data are a
+// single well-formed CBOR data item which cppbor::parse() can handle. Only the
+// headers are examined; the contents of byte and text strings are skipped, so
+// the data itself doesn't have to be buffered or parsed.
+//
+// Indefinite lengths, reserved additional info values, simple values other than
+// true/false/null, and negative integers which don't fit in int64_t are
+// rejected, as are counts and lengths which cannot fit in |totalSize|.
+class IncrementalCborValidator {
+  public:
+    explicit IncrementalCborValidator(size_t totalSize = 0);
+
+    // Checks the next |size| bytes. Returns false as soon as the data is known
+    // to be invalid, including data past |totalSize| or past the end of the
+    // item. Once it has returned false, it will keep returning false.
+    bool update(const uint8_t* data, size_t size);
+
+    // Returns true if exactly |totalSize| bytes forming one complete item have
+    // been checked.
+    bool isComplete() const;
+
+  private:
+    bool handleHeader();
+
+    size_t remainingBytes_;
+    bool failed_ = false;
+    // Header of the current item, which may span chunks.
+    vector<uint8_t> header_;
+    // Bytes left in the current byte or text string.
+    uint64_t stringBytesRemaining_ = 0;
+    // Number of items still expected at each nesting level.
+    vector<uint64_t> itemsRemaining_;
+};
+
 // ---------------------------------------------------------------------------
 // Crypto functionality / abstraction.
 // ---------------------------------------------------------------------------
@@ -105,6 +140,38 @@ optional<vector<uint8_t>> encryptAes128Gcm(const vector<uint8_t>& key, const vec
                                            const vector<uint8_t>& data,
                                            const vector<uint8_t>& additionalAuthenticatedData);
 
+// Decrypts data produced by encryptAes128Gcm() with a fixed key. The cipher
+// context and the AES key schedule are set up once by init() and reused for
+// every decrypt() call, which makes it cheaper than decryptAes128Gcm() when
+// many chunks are decrypted with the same key.
+class AesGcmDecryptor {
+  public:
+    AesGcmDecryptor();
+    ~AesGcmDecryptor();
+    AesGcmDecryptor(const AesGcmDecryptor&) = delete;
+    AesGcmDecryptor& operator=(const AesGcmDecryptor&) = delete;
+
+    // Sets the key used by decrypt(). Returns false if |key| is not
+    // kAes128GcmKeySize bytes or the cipher context cannot be set up.
+    bool init(const vector<uint8_t>& key);
+
+    // Decrypts |encryptedDataSize| bytes at |encryptedData|, in the format
+    // produced by encryptAes128Gcm(), and authenticates them together with
+    // |additionalAuthenticatedData|. The plaintext, which is
+    // |encryptedDataSize| - kAesGcmIvSize - kAesGcmTagSize bytes, is written
+    // to |plainText|; it may point at the ciphertext within |encryptedData|
+    // to decrypt in place.
+    //
+    // Returns false if the data is too short or fails authentication, in which
+    // case the contents of |plainText| must not be used.
+    bool decrypt(const uint8_t* encryptedData, size_t encryptedDataSize,
+                 const vector<uint8_t>& additionalAuthenticatedData, uint8_t* plainText);
+
+  private:
+    struct Context;
+    std::unique_ptr<Context> context_;
+};
+
 // ---------------------------------------------------------------------------
 // EC crypto functionality / abstraction (only supports P-256).
 // ---------------------------------------------------------------------------
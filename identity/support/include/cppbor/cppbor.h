@@ -16,12 +16,14 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <iterator>
 #include <memory>
 #include <numeric>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace cppbor {
@@ -58,6 +60,8 @@ class Nint;
 class Int;
 class Tstr;
 class Bstr;
+class ViewTstr;
+class ViewBstr;
 class Simple;
 class Bool;
 class Array;
@@ -116,6 +120,8 @@ class Item {
     virtual const Nint* asNint() const { return nullptr; }
     virtual const Tstr* asTstr() const { return nullptr; }
     virtual const Bstr* asBstr() const { return nullptr; }
+    virtual const ViewTstr* asViewTstr() const { return nullptr; }
+    virtual const ViewBstr* asViewBstr() const { return nullptr; }
     virtual const Simple* asSimple() const { return nullptr; }
     virtual const Map* asMap() const { return nullptr; }
     virtual const Array* asArray() const { return nullptr; }
@@ -161,22 +167,26 @@ class Item {
     }
 
     /**
-     * Encodes the Item into a new std::vector<uint8_t>.
+     * Encodes the Item into a new std::vector<uint8_t>.  The vector is sized once with
+     * encodedSize() and then written in a single pass.  Returns an empty vector if the encoding
+     * does not fill exactly encodedSize() bytes.
      */
     std::vector<uint8_t> encode() const {
-        std::vector<uint8_t> retval;
-        retval.reserve(encodedSize());
-        encode(std::back_inserter(retval));
+        std::vector<uint8_t> retval(encodedSize());
+        uint8_t* end = retval.data() + retval.size();
+        if (encode(retval.data(), end) != end) return {};
         return retval;
     }
 
     /**
-     * Encodes the Item into a new std::string.
+     * Encodes the Item into a new std::string.  The string is sized once with encodedSize() and
+     * then written in a single pass.  Returns an empty string if the encoding does not fill exactly
+     * encodedSize() bytes.
      */
     std::string toString() const {
-        std::string retval;
-        retval.reserve(encodedSize());
-        encode([&](uint8_t v) { retval.push_back(v); });
+        std::string retval(encodedSize(), '\0');
+        uint8_t* data = reinterpret_cast<uint8_t*>(&retval[0]);
+        if (encode(data, data + retval.size()) != data + retval.size()) return {};
         return retval;
     }
 
@@ -382,6 +392,106 @@ class Tstr : public Item {
     std::string mValue;
 };
 
+/**
+ * ByteView is a read-only pointer/size view of a range of bytes, the byte counterpart of
+ * std::string_view.  std::basic_string_view<uint8_t> can't be used instead, as it needs
+ * std::char_traits<uint8_t>, which the standard library doesn't have to provide.
+ */
+class ByteView {
+  public:
+    constexpr ByteView() : mData(nullptr), mSize(0) {}
+    constexpr ByteView(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+    const uint8_t* data() const { return mData; }
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+    const uint8_t* begin() const { return mData; }
+    const uint8_t* end() const { return mData + mSize; }
+    uint8_t operator[](size_t index) const { return mData[index]; }
+
+    bool operator==(const ByteView& other) const {
+        return std::equal(begin(), end(), other.begin(), other.end());
+    }
+    bool operator!=(const ByteView& other) const { return !(*this == other); }
+
+  private:
+    const uint8_t* mData;
+    size_t mSize;
+};
+
+/**
+ * ViewBstr is a read-only version of Bstr backed by a ByteView.  It does not own the bytes it
+ * refers to, so the underlying buffer must outlive it.  parseWithViews() produces ViewBstr items
+ * that point into the parsed buffer instead of copying each byte string.
+ */
+class ViewBstr : public Item {
+  public:
+    static constexpr MajorType kMajorType = BSTR;
+
+    // Construct from a view
+    explicit ViewBstr(ByteView v) : mView(v) {}
+
+    // Construct from a pointer/size pair
+    explicit ViewBstr(const std::pair<const uint8_t*, size_t>& buf)
+        : mView(buf.first, buf.second) {}
+
+    // Construct from a range of bytes
+    ViewBstr(const uint8_t* begin, const uint8_t* end) : mView(begin, end - begin) {}
+
+    bool operator==(const ViewBstr& other) const& { return mView == other.mView; }
+
+    MajorType type() const override { return kMajorType; }
+    const ViewBstr* asViewBstr() const override { return this; }
+    size_t encodedSize() const override { return headerSize(mView.size()) + mView.size(); }
+    using Item::encode;
+    uint8_t* encode(uint8_t* pos, const uint8_t* end) const override;
+    void encode(EncodeCallback encodeCallback) const override;
+
+    ByteView view() const { return mView; }
+
+    virtual std::unique_ptr<Item> clone() const override {
+        return std::make_unique<ViewBstr>(mView);
+    }
+
+  private:
+    ByteView mView;
+};
+
+/**
+ * ViewTstr is a read-only version of Tstr backed by a std::string_view.  It does not own the
+ * characters it refers to, so the underlying buffer must outlive it.  parseWithViews() produces
+ * ViewTstr items that point into the parsed buffer instead of copying each text string.
+ */
+class ViewTstr : public Item {
+  public:
+    static constexpr MajorType kMajorType = TSTR;
+
+    // Construct from a view
+    explicit ViewTstr(std::string_view v) : mView(v) {}
+
+    // Construct from a range of bytes
+    ViewTstr(const uint8_t* begin, const uint8_t* end)
+        : mView(reinterpret_cast<const char*>(begin), end - begin) {}
+
+    bool operator==(const ViewTstr& other) const& { return mView == other.mView; }
+
+    MajorType type() const override { return kMajorType; }
+    const ViewTstr* asViewTstr() const override { return this; }
+    size_t encodedSize() const override { return headerSize(mView.size()) + mView.size(); }
+    using Item::encode;
+    uint8_t* encode(uint8_t* pos, const uint8_t* end) const override;
+    void encode(EncodeCallback encodeCallback) const override;
+
+    std::string_view view() const { return mView; }
+
+    virtual std::unique_ptr<Item> clone() const override {
+        return std::make_unique<ViewTstr>(mView);
+    }
+
+  private:
+    std::string_view mView;
+};
+
 /**
  * CompoundItem is an abstract Item that provides common functionality for Items that contain other
  * items, i.e. Arrays (CBOR type 4) and Maps (CBOR type 5).
@@ -659,6 +769,16 @@ std::unique_ptr<T> downcastItem(std::unique_ptr<Item>&& v) {
                 return nullptr;
             }
         }
+        // Owning strings and views share their major types.
+        if constexpr (std::is_same_v<T, Bstr>) {
+            if (!v->asBstr()) return nullptr;
+        } else if constexpr (std::is_same_v<T, ViewBstr>) {
+            if (!v->asViewBstr()) return nullptr;
+        } else if constexpr (std::is_same_v<T, Tstr>) {
+            if (!v->asTstr()) return nullptr;
+        } else if constexpr (std::is_same_v<T, ViewTstr>) {
+            if (!v->asViewTstr()) return nullptr;
+        }
         return std::unique_ptr<T>(static_cast<T*>(v.release()));
     } else {
         return nullptr;
@@ -66,6 +66,32 @@ inline ParseResult parse(const uint8_t* begin, size_t size) {
     return parse(begin, begin + size);
 }
 
+/**
+ * Parse the first CBOR data item (possibly compound) from the range [begin, end).
+ *
+ * Returns the same tuple as parse(), but byte and text strings are returned as ViewBstr and
+ * ViewTstr items that point into [begin, end) rather than as Bstr and Tstr items holding copies.
+ * The buffer must outlive the returned Item.
+ */
+ParseResult parseWithViews(const uint8_t* begin, const uint8_t* end);
+
+/**
+ * Parse the first CBOR data item (possibly compound) from the byte vector, returning byte and text
+ * strings as views into the vector.  See parseWithViews(const uint8_t*, const uint8_t*).
+ */
+inline ParseResult parseWithViews(const std::vector<uint8_t>& encoding) {
+    return parseWithViews(encoding.data(), encoding.data() + encoding.size());
+}
+
+/**
+ * Parse the first CBOR data item (possibly compound) from the range [begin, begin + size),
+ * returning byte and text strings as views into the buffer.  See parseWithViews(const uint8_t*,
+ * const uint8_t*).
+ */
+inline ParseResult parseWithViews(const uint8_t* begin, size_t size) {
+    return parseWithViews(begin, begin + size);
+}
+
 class ParseClient;
 
 /**
@@ -82,6 +108,13 @@ inline void parse(const std::vector<uint8_t>& encoding, ParseClient* parseClient
     return parse(encoding.data(), encoding.data() + encoding.size(), parseClient);
 }
 
+/**
+ * Parse the CBOR data in the range [begin, end) in streaming fashion, like parse(), but passing
+ * byte and text strings to the ParseClient as ViewBstr and ViewTstr items that point into the
+ * buffer.
+ */
+void parseWithViews(const uint8_t* begin, const uint8_t* end, ParseClient* parseClient);
+
 /**
  * A pure interface that callers of the streaming parse functions must implement.
  */
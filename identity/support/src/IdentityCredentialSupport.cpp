@@ -24,8 +24,10 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <time.h>
+#include <algorithm>
 #include <chrono>
 #include <iomanip>
+#include <limits>
 
 #include <openssl/aes.h>
 #include <openssl/bn.h>
@@ -338,6 +340,131 @@ string cborPrettyPrint(const vector<uint8_t>& encodedCbor, size_t maxBStrSize,
     return out;
 }
 
+IncrementalCborValidator::IncrementalCborValidator(size_t totalSize)
+    : remainingBytes_(totalSize), itemsRemaining_({1}) {
+    header_.reserve(9);
+}
+
+bool IncrementalCborValidator::update(const uint8_t* data, size_t size) {
+    if (failed_) {
+        return false;
+    }
+    if (size > remainingBytes_) {
+        LOG(ERROR) << "CBOR data is longer than expected";
+        failed_ = true;
+        return false;
+    }
+
+    const uint8_t* end = data + size;
+    while (data < end) {
+        if (stringBytesRemaining_ > 0) {
+            size_t n = std::min(stringBytesRemaining_, static_cast<uint64_t>(end - data));
+            stringBytesRemaining_ -= n;
+            remainingBytes_ -= n;
+            data += n;
+            continue;
+        }
+        if (itemsRemaining_.empty()) {
+            LOG(ERROR) << "Trailing data after CBOR data item";
+            failed_ = true;
+            return false;
+        }
+        header_.push_back(*data++);
+        remainingBytes_--;
+        uint8_t addlInfo = header_[0] & 0x1f;
+        if (addlInfo > cppbor::EIGHT_BYTE_LENGTH) {
+            LOG(ERROR) << "Unsupported additional info " << int(addlInfo) << " in CBOR header";
+            failed_ = true;
+            return false;
+        }
+        size_t headerSize = 1;
+        if (addlInfo >= cppbor::ONE_BYTE_LENGTH) {
+            headerSize += 1 << (addlInfo - cppbor::ONE_BYTE_LENGTH);
+        }
+        if (header_.size() < headerSize) {
+            continue;
+        }
+        if (!handleHeader()) {
+            failed_ = true;
+            return false;
+        }
+        header_.clear();
+    }
+    return true;
+}
+
+bool IncrementalCborValidator::handleHeader() {
+    uint8_t addlInfo = header_[0] & 0x1f;
+    uint64_t value = addlInfo;
+    if (addlInfo >= cppbor::ONE_BYTE_LENGTH) {
+        value = 0;
+        for (size_t n = 1; n < header_.size(); n++) {
+            value = (value << 8) | header_[n];
+        }
+    }
+    // Bytes left for the contents of this item and everything after it.
+    uint64_t available = remainingBytes_;
+
+    // This item fills a slot in its parent; close the levels which are now complete.
+    itemsRemaining_.back() -= 1;
+    while (!itemsRemaining_.empty() && itemsRemaining_.back() == 0) {
+        itemsRemaining_.pop_back();
+    }
+
+    uint64_t children = 0;
+    switch (static_cast<cppbor::MajorType>(header_[0] & 0xe0)) {
+        case cppbor::UINT:
+            break;
+        case cppbor::NINT:
+            if (value > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+                LOG(ERROR) << "NINT value doesn't fit in int64_t";
+                return false;
+            }
+            break;
+        case cppbor::BSTR:
+        case cppbor::TSTR:
+            stringBytesRemaining_ = value;
+            break;
+        case cppbor::ARRAY:
+            children = value;
+            break;
+        case cppbor::MAP:
+            if (value > available / 2) {
+                LOG(ERROR) << "CBOR map with " << value << " entries doesn't fit";
+                return false;
+            }
+            children = value * 2;
+            break;
+        case cppbor::SEMANTIC:
+            children = 1;
+            break;
+        case cppbor::SIMPLE:
+            if (value != cppbor::FALSE && value != cppbor::TRUE && value != cppbor::NULL_V) {
+                LOG(ERROR) << "Unsupported CBOR simple value " << value;
+                return false;
+            }
+            break;
+    }
+    if (stringBytesRemaining_ > available) {
+        LOG(ERROR) << "CBOR string of " << stringBytesRemaining_ << " bytes doesn't fit";
+        return false;
+    }
+    // Every item takes at least one byte.
+    if (children > available) {
+        LOG(ERROR) << "CBOR item with " << children << " children doesn't fit";
+        return false;
+    }
+    if (children > 0) {
+        itemsRemaining_.push_back(children);
+    }
+    return true;
+}
+
+bool IncrementalCborValidator::isComplete() const {
+    return !failed_ && remainingBytes_ == 0 && header_.empty() && stringBytesRemaining_ == 0 &&
+           itemsRemaining_.empty();
+}
+
 // ---------------------------------------------------------------------------
 // Crypto functionality / abstraction.
 // ---------------------------------------------------------------------------
@@ -363,84 +490,135 @@ optional<vector<uint8_t>> getRandom(size_t numBytes) {
     return output;
 }
 
-optional<vector<uint8_t>> decryptAes128Gcm(const vector<uint8_t>& key,
-                                           const vector<uint8_t>& encryptedData,
-                                           const vector<uint8_t>& additionalAuthenticatedData) {
-    int cipherTextSize = int(encryptedData.size()) - kAesGcmIvSize - kAesGcmTagSize;
-    if (cipherTextSize < 0) {
-        LOG(ERROR) << "encryptedData too small";
-        return {};
-    }
-    unsigned char* nonce = (unsigned char*)encryptedData.data();
-    unsigned char* cipherText = nonce + kAesGcmIvSize;
-    unsigned char* tag = cipherText + cipherTextSize;
+struct AesGcmDecryptor::Context {
+    EvpCipherCtxPtr ctx;
+};
 
-    vector<uint8_t> plainText;
-    plainText.resize(cipherTextSize);
+AesGcmDecryptor::AesGcmDecryptor() {}
+
+AesGcmDecryptor::~AesGcmDecryptor() {}
+
+bool AesGcmDecryptor::init(const vector<uint8_t>& key) {
+    context_.reset();
+    if (key.size() != kAes128GcmKeySize) {
+        LOG(ERROR) << "key is not kAes128GcmKeySize bytes";
+        return false;
+    }
 
     auto ctx = EvpCipherCtxPtr(EVP_CIPHER_CTX_new());
     if (ctx.get() == nullptr) {
         LOG(ERROR) << "EVP_CIPHER_CTX_new: failed";
-        return {};
+        return false;
     }
 
     if (EVP_DecryptInit_ex(ctx.get(), EVP_aes_128_gcm(), NULL, NULL, NULL) != 1) {
         LOG(ERROR) << "EVP_DecryptInit_ex: failed";
-        return {};
+        return false;
     }
 
     if (EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_IVLEN, kAesGcmIvSize, NULL) != 1) {
         LOG(ERROR) << "EVP_CIPHER_CTX_ctrl: failed setting nonce length";
-        return {};
+        return false;
     }
 
-    if (EVP_DecryptInit_ex(ctx.get(), NULL, NULL, (unsigned char*)key.data(), nonce) != 1) {
-        LOG(ERROR) << "EVP_DecryptInit_ex: failed";
-        return {};
+    // Expands the key schedule once; decrypt() only sets the nonce.
+    if (EVP_DecryptInit_ex(ctx.get(), NULL, NULL, (unsigned char*)key.data(), NULL) != 1) {
+        LOG(ERROR) << "EVP_DecryptInit_ex: failed setting key";
+        return false;
+    }
+
+    context_ = std::make_unique<Context>();
+    context_->ctx = std::move(ctx);
+    return true;
+}
+
+bool AesGcmDecryptor::decrypt(const uint8_t* encryptedData, size_t encryptedDataSize,
+                              const vector<uint8_t>& additionalAuthenticatedData,
+                              uint8_t* plainText) {
+    if (context_ == nullptr) {
+        LOG(ERROR) << "decrypt called without a key";
+        return false;
+    }
+    int cipherTextSize = int(encryptedDataSize) - kAesGcmIvSize - kAesGcmTagSize;
+    if (cipherTextSize < 0) {
+        LOG(ERROR) << "encryptedData too small";
+        return false;
+    }
+    EVP_CIPHER_CTX* ctx = context_->ctx.get();
+    const unsigned char* nonce = encryptedData;
+    const unsigned char* cipherText = nonce + kAesGcmIvSize;
+    // Copy the tag first, decrypting in place overwrites the ciphertext before it.
+    unsigned char tag[kAesGcmTagSize];
+    memcpy(tag, cipherText + cipherTextSize, kAesGcmTagSize);
+
+    if (EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, nonce) != 1) {
+        LOG(ERROR) << "EVP_DecryptInit_ex: failed setting nonce";
+        return false;
     }
 
     int numWritten;
     if (additionalAuthenticatedData.size() > 0) {
-        if (EVP_DecryptUpdate(ctx.get(), NULL, &numWritten,
+        if (EVP_DecryptUpdate(ctx, NULL, &numWritten,
                               (unsigned char*)additionalAuthenticatedData.data(),
                               additionalAuthenticatedData.size()) != 1) {
             LOG(ERROR) << "EVP_DecryptUpdate: failed for additionalAuthenticatedData";
-            return {};
+            return false;
         }
         if ((size_t)numWritten != additionalAuthenticatedData.size()) {
             LOG(ERROR) << "EVP_DecryptUpdate: Unexpected outl=" << numWritten << " (expected "
                        << additionalAuthenticatedData.size() << ") for additionalAuthenticatedData";
-            return {};
+            return false;
         }
     }
 
-    if (EVP_DecryptUpdate(ctx.get(), (unsigned char*)plainText.data(), &numWritten, cipherText,
-                          cipherTextSize) != 1) {
+    if (EVP_DecryptUpdate(ctx, plainText, &numWritten, cipherText, cipherTextSize) != 1) {
         LOG(ERROR) << "EVP_DecryptUpdate: failed";
-        return {};
+        return false;
     }
     if (numWritten != cipherTextSize) {
         LOG(ERROR) << "EVP_DecryptUpdate: Unexpected outl=" << numWritten << " (expected "
                    << cipherTextSize << ")";
-        return {};
+        return false;
     }
 
-    if (!EVP_CIPHER_CTX_ctrl(ctx.get(), EVP_CTRL_GCM_SET_TAG, kAesGcmTagSize, tag)) {
+    if (!EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, kAesGcmTagSize, tag)) {
         LOG(ERROR) << "EVP_CIPHER_CTX_ctrl: failed setting expected tag";
-        return {};
+        return false;
     }
 
-    int ret = EVP_DecryptFinal_ex(ctx.get(), (unsigned char*)plainText.data() + numWritten,
-                                  &numWritten);
+    int ret = EVP_DecryptFinal_ex(ctx, plainText + numWritten, &numWritten);
     if (ret != 1) {
         LOG(ERROR) << "EVP_DecryptFinal_ex: failed";
-        return {};
+        return false;
     }
     if (numWritten != 0) {
         LOG(ERROR) << "EVP_DecryptFinal_ex: Unexpected non-zero outl=" << numWritten;
+        return false;
+    }
+
+    return true;
+}
+
+optional<vector<uint8_t>> decryptAes128Gcm(const vector<uint8_t>& key,
+                                           const vector<uint8_t>& encryptedData,
+                                           const vector<uint8_t>& additionalAuthenticatedData) {
+    int cipherTextSize = int(encryptedData.size()) - kAesGcmIvSize - kAesGcmTagSize;
+    if (cipherTextSize < 0) {
+        LOG(ERROR) << "encryptedData too small";
         return {};
     }
 
+    AesGcmDecryptor decryptor;
+    if (!decryptor.init(key)) {
+        return {};
+    }
+
+    vector<uint8_t> plainText;
+    plainText.resize(cipherTextSize);
+    if (!decryptor.decrypt(encryptedData.data(), encryptedData.size(),
+                           additionalAuthenticatedData, plainText.data())) {
+        return {};
+    }
     return plainText;
 }
 
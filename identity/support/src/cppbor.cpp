@@ -41,6 +41,27 @@ void writeBigEndian(T value, std::function<void(uint8_t)>& cb) {
     }
 }
 
+uint8_t* encodeString(MajorType type, const uint8_t* data, size_t size, uint8_t* pos,
+                      const uint8_t* end) {
+    pos = encodeHeader(type, size, pos, end);
+    if (!pos || end - pos < static_cast<ptrdiff_t>(size)) return nullptr;
+    return std::copy(data, data + size, pos);
+}
+
+// Returns the bytes of a BSTR item, whether it owns them or not.
+ByteView bstrBytes(const Item& item) {
+    if (const Bstr* bstr = item.asBstr()) {
+        return {bstr->value().data(), bstr->value().size()};
+    }
+    return item.asViewBstr()->view();
+}
+
+// Returns the characters of a TSTR item, whether it owns them or not.
+std::string_view tstrChars(const Item& item) {
+    if (const Tstr* tstr = item.asTstr()) return tstr->value();
+    return item.asViewTstr()->view();
+}
+
 }  // namespace
 
 size_t headerSize(uint64_t addlInfo) {
@@ -112,9 +133,9 @@ bool Item::operator==(const Item& other) const& {
         case NINT:
             return *asNint() == *(other.asNint());
         case BSTR:
-            return *asBstr() == *(other.asBstr());
+            return bstrBytes(*this) == bstrBytes(other);
         case TSTR:
-            return *asTstr() == *(other.asTstr());
+            return tstrChars(*this) == tstrChars(other);
         case ARRAY:
             return *asArray() == *(other.asArray());
         case MAP:
@@ -148,9 +169,7 @@ bool Simple::operator==(const Simple& other) const& {
 }
 
 uint8_t* Bstr::encode(uint8_t* pos, const uint8_t* end) const {
-    pos = encodeHeader(mValue.size(), pos, end);
-    if (!pos || end - pos < static_cast<ptrdiff_t>(mValue.size())) return nullptr;
-    return std::copy(mValue.begin(), mValue.end(), pos);
+    return encodeString(kMajorType, mValue.data(), mValue.size(), pos, end);
 }
 
 void Bstr::encodeValue(EncodeCallback encodeCallback) const {
@@ -160,9 +179,8 @@ void Bstr::encodeValue(EncodeCallback encodeCallback) const {
 }
 
 uint8_t* Tstr::encode(uint8_t* pos, const uint8_t* end) const {
-    pos = encodeHeader(mValue.size(), pos, end);
-    if (!pos || end - pos < static_cast<ptrdiff_t>(mValue.size())) return nullptr;
-    return std::copy(mValue.begin(), mValue.end(), pos);
+    return encodeString(kMajorType, reinterpret_cast<const uint8_t*>(mValue.data()), mValue.size(),
+                        pos, end);
 }
 
 void Tstr::encodeValue(EncodeCallback encodeCallback) const {
@@ -171,6 +189,29 @@ void Tstr::encodeValue(EncodeCallback encodeCallback) const {
     }
 }
 
+uint8_t* ViewBstr::encode(uint8_t* pos, const uint8_t* end) const {
+    return encodeString(kMajorType, mView.data(), mView.size(), pos, end);
+}
+
+void ViewBstr::encode(EncodeCallback encodeCallback) const {
+    encodeHeader(mView.size(), encodeCallback);
+    for (auto c : mView) {
+        encodeCallback(c);
+    }
+}
+
+uint8_t* ViewTstr::encode(uint8_t* pos, const uint8_t* end) const {
+    return encodeString(kMajorType, reinterpret_cast<const uint8_t*>(mView.data()), mView.size(),
+                        pos, end);
+}
+
+void ViewTstr::encode(EncodeCallback encodeCallback) const {
+    encodeHeader(mView.size(), encodeCallback);
+    for (auto c : mView) {
+        encodeCallback(static_cast<uint8_t>(c));
+    }
+}
+
 bool CompoundItem::operator==(const CompoundItem& other) const& {
     return type() == other.type()             //
            && addlInfo() == other.addlInfo()  //
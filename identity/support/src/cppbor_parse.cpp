@@ -51,7 +51,7 @@ std::tuple<bool, uint64_t, const uint8_t*> parseLength(const uint8_t* pos, const
 }
 
 std::tuple<const uint8_t*, ParseClient*> parseRecursively(const uint8_t* begin, const uint8_t* end,
-                                                          ParseClient* parseClient);
+                                                          bool emitViews, ParseClient* parseClient);
 
 std::tuple<const uint8_t*, ParseClient*> handleUint(uint64_t value, const uint8_t* hdrBegin,
                                                     const uint8_t* hdrEnd,
@@ -157,14 +157,14 @@ class IncompleteSemantic : public Semantic, public IncompleteItem {
 std::tuple<const uint8_t*, ParseClient*> handleEntries(size_t entryCount, const uint8_t* hdrBegin,
                                                        const uint8_t* pos, const uint8_t* end,
                                                        const std::string& typeName,
-                                                       ParseClient* parseClient) {
+                                                       bool emitViews, ParseClient* parseClient) {
     while (entryCount > 0) {
         --entryCount;
         if (pos == end) {
             parseClient->error(hdrBegin, "Not enough entries for " + typeName + ".");
             return {hdrBegin, nullptr /* end parsing */};
         }
-        std::tie(pos, parseClient) = parseRecursively(pos, end, parseClient);
+        std::tie(pos, parseClient) = parseRecursively(pos, end, emitViews, parseClient);
         if (!parseClient) return {hdrBegin, nullptr};
     }
     return {pos, parseClient};
@@ -173,21 +173,21 @@ std::tuple<const uint8_t*, ParseClient*> handleEntries(size_t entryCount, const
 std::tuple<const uint8_t*, ParseClient*> handleCompound(
         std::unique_ptr<Item> item, uint64_t entryCount, const uint8_t* hdrBegin,
         const uint8_t* valueBegin, const uint8_t* end, const std::string& typeName,
-        ParseClient* parseClient) {
+        bool emitViews, ParseClient* parseClient) {
     parseClient =
             parseClient->item(item, hdrBegin, valueBegin, valueBegin /* don't know the end yet */);
     if (!parseClient) return {hdrBegin, nullptr};
 
     const uint8_t* pos;
     std::tie(pos, parseClient) =
-            handleEntries(entryCount, hdrBegin, valueBegin, end, typeName, parseClient);
+            handleEntries(entryCount, hdrBegin, valueBegin, end, typeName, emitViews, parseClient);
     if (!parseClient) return {hdrBegin, nullptr};
 
     return {pos, parseClient->itemEnd(item, hdrBegin, valueBegin, pos)};
 }
 
 std::tuple<const uint8_t*, ParseClient*> parseRecursively(const uint8_t* begin, const uint8_t* end,
-                                                          ParseClient* parseClient) {
+                                                          bool emitViews, ParseClient* parseClient) {
     const uint8_t* pos = begin;
 
     MajorType type = static_cast<MajorType>(*pos & 0xE0);
@@ -232,22 +232,30 @@ std::tuple<const uint8_t*, ParseClient*> parseRecursively(const uint8_t* begin,
             return handleNint(addlData, begin, pos, parseClient);
 
         case BSTR:
+            if (emitViews) {
+                return handleString<ViewBstr>(addlData, begin, pos, end, "byte string",
+                                              parseClient);
+            }
             return handleString<Bstr>(addlData, begin, pos, end, "byte string", parseClient);
 
         case TSTR:
+            if (emitViews) {
+                return handleString<ViewTstr>(addlData, begin, pos, end, "text string",
+                                              parseClient);
+            }
             return handleString<Tstr>(addlData, begin, pos, end, "text string", parseClient);
 
         case ARRAY:
             return handleCompound(std::make_unique<IncompleteArray>(addlData), addlData, begin, pos,
-                                  end, "array", parseClient);
+                                  end, "array", emitViews, parseClient);
 
         case MAP:
             return handleCompound(std::make_unique<IncompleteMap>(addlData), addlData * 2, begin,
-                                  pos, end, "map", parseClient);
+                                  pos, end, "map", emitViews, parseClient);
 
         case SEMANTIC:
             return handleCompound(std::make_unique<IncompleteSemantic>(addlData), 1, begin, pos,
-                                  end, "semantic", parseClient);
+                                  end, "semantic", emitViews, parseClient);
 
         case SIMPLE:
             switch (addlData) {
@@ -329,7 +337,7 @@ class FullParseClient : public ParseClient {
     }
 
     std::unique_ptr<Item> mTheItem;
-    std::stack<CompoundItem*> mParentStack;
+    std::stack<CompoundItem*, std::vector<CompoundItem*>> mParentStack;
     const uint8_t* mPosition = nullptr;
     std::string mErrorMessage;
 };
@@ -337,7 +345,11 @@ class FullParseClient : public ParseClient {
 }  // anonymous namespace
 
 void parse(const uint8_t* begin, const uint8_t* end, ParseClient* parseClient) {
-    parseRecursively(begin, end, parseClient);
+    parseRecursively(begin, end, false /* emitViews */, parseClient);
+}
+
+void parseWithViews(const uint8_t* begin, const uint8_t* end, ParseClient* parseClient) {
+    parseRecursively(begin, end, true /* emitViews */, parseClient);
 }
 
 std::tuple<std::unique_ptr<Item> /* result */, const uint8_t* /* newPos */,
@@ -348,4 +360,12 @@ parse(const uint8_t* begin, const uint8_t* end) {
     return parseClient.parseResult();
 }
 
+std::tuple<std::unique_ptr<Item> /* result */, const uint8_t* /* newPos */,
+           std::string /* errMsg */>
+parseWithViews(const uint8_t* begin, const uint8_t* end) {
+    FullParseClient parseClient;
+    parseWithViews(begin, end, &parseClient);
+    return parseClient.parseResult();
+}
+
 }  // namespace cppbor
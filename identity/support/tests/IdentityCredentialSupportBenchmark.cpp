@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2020, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <android/hardware/identity/support/IdentityCredentialSupport.h>
+
+#include <cppbor.h>
+#include <cppbor_parse.h>
+
+using std::vector;
+
+namespace android {
+namespace hardware {
+namespace identity {
+namespace {
+
+// Same as IdentityCredentialStore::kGcmChunkSize in the default implementation.
+constexpr size_t kGcmChunkSize = 64 * 1024;
+
+// An entry holding a byte string of |entrySize| bytes, e.g. a portrait or a biometric
+// template, encrypted in kGcmChunkSize chunks the way it's stored by
+// WritableIdentityCredential.
+struct EncryptedEntry {
+    vector<uint8_t> key;
+    vector<uint8_t> additionalData;
+    size_t size;
+    vector<vector<uint8_t>> chunks;
+};
+
+EncryptedEntry makeEncryptedEntry(size_t valueSize) {
+    EncryptedEntry entry;
+    entry.key = vector<uint8_t>(support::kAes128GcmKeySize, 0x42);
+    entry.additionalData = cppbor::Map("Namespace", "org.iso.18013.5.1",  //
+                                       "Name", "portrait",                //
+                                       "AccessControlProfileIds", cppbor::Array(1))
+                                   .encode();
+    vector<uint8_t> value = cppbor::Bstr(vector<uint8_t>(valueSize, 0xa5)).encode();
+    entry.size = value.size();
+    for (size_t offset = 0; offset < value.size(); offset += kGcmChunkSize) {
+        size_t chunkSize = std::min(kGcmChunkSize, value.size() - offset);
+        vector<uint8_t> chunk(value.begin() + offset, value.begin() + offset + chunkSize);
+        vector<uint8_t> nonce = support::getRandom(support::kAesGcmIvSize).value();
+        entry.chunks.push_back(
+                support::encryptAes128Gcm(entry.key, nonce, chunk, entry.additionalData).value());
+    }
+    return entry;
+}
+
+// Decrypts every chunk with a new cipher context, appends it to the entry and parses the whole
+// entry at the end, copying the byte string.
+void BM_RetrieveEntryPerChunkContext(benchmark::State& state) {
+    const EncryptedEntry entry = makeEncryptedEntry(state.range(0));
+    for (auto _ : state) {
+        vector<uint8_t> entryValue;
+        for (const auto& encryptedChunk : entry.chunks) {
+            auto chunk =
+                    support::decryptAes128Gcm(entry.key, encryptedChunk, entry.additionalData);
+            entryValue.insert(entryValue.end(), chunk.value().begin(), chunk.value().end());
+            benchmark::DoNotOptimize(chunk.value().data());
+        }
+        auto [item, _2, message] = cppbor::parse(entryValue);
+        benchmark::DoNotOptimize(item.get());
+    }
+    state.SetBytesProcessed(state.iterations() * entry.size);
+}
+BENCHMARK(BM_RetrieveEntryPerChunkContext)->Arg(1 << 20)->Arg(4 << 20)->Arg(16 << 20);
+
+// Decrypts every chunk into a buffer sized for the entry with a decryptor set up once per
+// credential, validates the CBOR chunk by chunk and parses the entry with views.
+void BM_RetrieveEntryReusedContext(benchmark::State& state) {
+    const EncryptedEntry entry = makeEncryptedEntry(state.range(0));
+    support::AesGcmDecryptor decryptor;
+    if (!decryptor.init(entry.key)) {
+        state.SkipWithError("Cannot set up decryptor");
+        return;
+    }
+    for (auto _ : state) {
+        vector<uint8_t> entryValue(entry.size);
+        support::IncrementalCborValidator validator(entry.size);
+        uint8_t* pos = entryValue.data();
+        for (const auto& encryptedChunk : entry.chunks) {
+            size_t chunkSize =
+                    encryptedChunk.size() - support::kAesGcmIvSize - support::kAesGcmTagSize;
+            decryptor.decrypt(encryptedChunk.data(), encryptedChunk.size(), entry.additionalData,
+                              pos);
+            validator.update(pos, chunkSize);
+            pos += chunkSize;
+        }
+        auto [item, _2, message] = cppbor::parseWithViews(entryValue);
+        benchmark::DoNotOptimize(item.get());
+    }
+    state.SetBytesProcessed(state.iterations() * entry.size);
+}
+BENCHMARK(BM_RetrieveEntryReusedContext)->Arg(1 << 20)->Arg(4 << 20)->Arg(16 << 20);
+
+}  // namespace
+}  // namespace identity
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -436,6 +436,100 @@ TEST(IdentityCredentialSupport, CoseMac0DetachedContent) {
             support::cborPrettyPrint(mac.value()));
 }
 
+TEST(IdentityCredentialSupport, AesGcmDecryptor) {
+    vector<uint8_t> key(support::kAes128GcmKeySize, 0x42);
+    vector<uint8_t> additionalData = {0x01, 0x02};
+
+    support::AesGcmDecryptor decryptor;
+    ASSERT_TRUE(decryptor.init(key));
+    for (size_t size : {0, 1, 1000}) {
+        vector<uint8_t> data(size, 0xa5);
+        vector<uint8_t> nonce = support::getRandom(support::kAesGcmIvSize).value();
+        vector<uint8_t> encrypted =
+                support::encryptAes128Gcm(key, nonce, data, additionalData).value();
+
+        vector<uint8_t> decrypted(size);
+        ASSERT_TRUE(decryptor.decrypt(encrypted.data(), encrypted.size(), additionalData,
+                                      decrypted.data()));
+        EXPECT_EQ(data, decrypted);
+        EXPECT_EQ(data, support::decryptAes128Gcm(key, encrypted, additionalData));
+
+        // Decrypting in place over the ciphertext.
+        uint8_t* cipherText = encrypted.data() + support::kAesGcmIvSize;
+        ASSERT_TRUE(decryptor.decrypt(encrypted.data(), encrypted.size(), additionalData,
+                                      cipherText));
+        EXPECT_EQ(data, vector<uint8_t>(cipherText, cipherText + size));
+    }
+
+    vector<uint8_t> data = {0x10, 0x11, 0x12};
+    vector<uint8_t> nonce(support::kAesGcmIvSize, 0x01);
+    vector<uint8_t> encrypted = support::encryptAes128Gcm(key, nonce, data, additionalData).value();
+    vector<uint8_t> decrypted(data.size());
+    EXPECT_FALSE(decryptor.decrypt(encrypted.data(), encrypted.size(), {}, decrypted.data()));
+    encrypted[support::kAesGcmIvSize] ^= 1;
+    EXPECT_FALSE(decryptor.decrypt(encrypted.data(), encrypted.size(), additionalData,
+                                   decrypted.data()));
+    EXPECT_FALSE(decryptor.decrypt(encrypted.data(), support::kAesGcmTagSize, additionalData,
+                                   decrypted.data()));
+
+    EXPECT_FALSE(decryptor.init({0x01, 0x02}));
+}
+
+// Feeds |data| to an IncrementalCborValidator in chunks of |chunkSize| bytes.
+bool validateCbor(const vector<uint8_t>& data, size_t chunkSize) {
+    support::IncrementalCborValidator validator(data.size());
+    for (size_t n = 0; n < data.size(); n += chunkSize) {
+        if (!validator.update(data.data() + n, std::min(chunkSize, data.size() - n))) {
+            return false;
+        }
+    }
+    return validator.isComplete();
+}
+
+TEST(IdentityCredentialSupport, IncrementalCborValidator) {
+    cppbor::Map map;
+    map.add("portrait", vector<uint8_t>(1000, 0xff));
+    map.add("given_name", "Erika");
+    map.add("age_over_18", true);
+    map.add("issue_date", cppbor::Semantic(0, "2020-01-01"));
+    map.add("driving_privileges", cppbor::Array(cppbor::Map("vehicle_category_code", "A"),
+                                                -5, cppbor::Null()));
+    vector<uint8_t> encoded = map.encode();
+    for (size_t chunkSize : {1, 2, 7, 64, 4096}) {
+        SCOPED_TRACE(chunkSize);
+        EXPECT_TRUE(validateCbor(encoded, chunkSize));
+    }
+
+    // Truncated.
+    vector<uint8_t> truncated(encoded.begin(), encoded.end() - 1);
+    EXPECT_FALSE(validateCbor(truncated, 64));
+
+    // Trailing data.
+    vector<uint8_t> trailing = encoded;
+    trailing.push_back(0x00);
+    EXPECT_FALSE(validateCbor(trailing, 64));
+
+    // More data than expected.
+    support::IncrementalCborValidator validator(1);
+    EXPECT_FALSE(validator.update(encoded.data(), 2));
+    EXPECT_FALSE(validator.update(encoded.data(), 1));
+    EXPECT_FALSE(validator.isComplete());
+
+    // Indefinite length byte string, unsupported simple value, reserved additional info.
+    EXPECT_FALSE(validateCbor({0x5f, 0x41, 0x00, 0xff}, 64));
+    EXPECT_FALSE(validateCbor({0xf7}, 64));
+    EXPECT_FALSE(validateCbor({0x1c}, 64));
+
+    // Lengths and counts which cannot fit.
+    EXPECT_FALSE(validateCbor({0x5a, 0xff, 0xff, 0xff, 0xff}, 64));
+    EXPECT_FALSE(validateCbor({0x9b, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}, 64));
+    EXPECT_FALSE(validateCbor({0xbb, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 64));
+
+    // NINT which doesn't fit in int64_t.
+    EXPECT_FALSE(validateCbor({0x3b, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 64));
+    EXPECT_TRUE(validateCbor({0x3b, 0x7f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff}, 64));
+}
+
 }  // namespace identity
 }  // namespace hardware
 }  // namespace android
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2020, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "cppbor.h"
+#include "cppbor_parse.h"
+
+using namespace cppbor;
+using namespace std;
+
+namespace {
+
+// The nested structure used by FullParserTest.Complex in cppbor_test.
+unique_ptr<Item> makeNestedMap() {
+    vector<uint8_t> vec = {0x01, 0x02, 0x08, 0x03};
+    return make_unique<Map>("Outer1",
+                            Array(Map("Inner1", 99,  //
+                                      "Inner2", vec),
+                                  "foo"),
+                            "Outer2", 10);
+}
+
+// An IssuerSignedItem of ISO 18013-5, wrapped in tag 24 the way it appears in a DeviceResponse.
+Semantic makeIssuerSignedItemBytes(int digestId, const string& name, unique_ptr<Item> value) {
+    Map item;
+    item.add("digestID", digestId);
+    item.add("random", vector<uint8_t>(16, 0x5a));
+    item.add("elementIdentifier", name);
+    item.add("elementValue", std::move(value));
+    return Semantic(24, item.encode());
+}
+
+// A DeviceResponse for an mDL carrying |numElements| data elements and a portrait of
+// |portraitSize| bytes, similar to what IdentityCredential produces for a presentation.
+unique_ptr<Item> makeDeviceResponse(size_t numElements, size_t portraitSize) {
+    Array issuerSignedItems;
+    issuerSignedItems.add(makeIssuerSignedItemBytes(
+            0, "portrait", make_unique<Bstr>(vector<uint8_t>(portraitSize, 0xff))));
+    for (size_t n = 1; n < numElements; n++) {
+        issuerSignedItems.add(makeIssuerSignedItemBytes(
+                n, "element" + to_string(n), make_unique<Tstr>("value of element " + to_string(n))));
+    }
+
+    // COSE_Mac0 over the DeviceAuthentication bytes.
+    Array deviceMac;
+    deviceMac.add(Map(1, 5).encode());
+    deviceMac.add(Map());
+    deviceMac.add(Null());
+    deviceMac.add(vector<uint8_t>(32, 0x11));
+
+    Map document;
+    document.add("docType", "org.iso.18013.5.1.mDL");
+    document.add("issuerSigned",
+                 Map("nameSpaces", Map("org.iso.18013.5.1", std::move(issuerSignedItems))));
+    document.add("deviceSigned",
+                 Map("nameSpaces", Semantic(24, Map().encode()),  //
+                     "deviceAuth", Map("deviceMac", std::move(deviceMac))));
+
+    return make_unique<Map>("version", "1.0",  //
+                            "documents", Array(std::move(document)),  //
+                            "status", 0);
+}
+
+unique_ptr<Item> makeCorpus(int64_t index) {
+    switch (index) {
+        case 0:
+            return makeNestedMap();
+        case 1:
+            return makeDeviceResponse(8, 0);
+        case 2:
+            return makeDeviceResponse(32, 16 * 1024);
+        default:
+            return nullptr;
+    }
+}
+
+void corpusArgs(benchmark::internal::Benchmark* b) {
+    b->ArgName("corpus")->Arg(0)->Arg(1)->Arg(2);
+}
+
+void BM_Parse(benchmark::State& state) {
+    const vector<uint8_t> encoding = makeCorpus(state.range(0))->encode();
+    for (auto _ : state) {
+        auto [item, pos, message] = parse(encoding);
+        benchmark::DoNotOptimize(item.get());
+    }
+    state.SetBytesProcessed(state.iterations() * encoding.size());
+}
+BENCHMARK(BM_Parse)->Apply(corpusArgs);
+
+void BM_ParseWithViews(benchmark::State& state) {
+    const vector<uint8_t> encoding = makeCorpus(state.range(0))->encode();
+    for (auto _ : state) {
+        auto [item, pos, message] = parseWithViews(encoding);
+        benchmark::DoNotOptimize(item.get());
+    }
+    state.SetBytesProcessed(state.iterations() * encoding.size());
+}
+BENCHMARK(BM_ParseWithViews)->Apply(corpusArgs);
+
+// Item::encode(), which sizes the output once and writes it in a single pass.
+void BM_Encode(benchmark::State& state) {
+    const auto item = makeCorpus(state.range(0));
+    for (auto _ : state) {
+        vector<uint8_t> encoding = item->encode();
+        benchmark::DoNotOptimize(encoding.data());
+    }
+    state.SetBytesProcessed(state.iterations() * item->encodedSize());
+}
+BENCHMARK(BM_Encode)->Apply(corpusArgs);
+
+// Encoding through an output iterator, which goes through EncodeCallback for every byte.
+void BM_EncodeWithIterator(benchmark::State& state) {
+    const auto item = makeCorpus(state.range(0));
+    for (auto _ : state) {
+        vector<uint8_t> encoding;
+        encoding.reserve(item->encodedSize());
+        item->encode(back_inserter(encoding));
+        benchmark::DoNotOptimize(encoding.data());
+    }
+    state.SetBytesProcessed(state.iterations() * item->encodedSize());
+}
+BENCHMARK(BM_EncodeWithIterator)->Apply(corpusArgs);
+
+}  // namespace
+
+BENCHMARK_MAIN();
@@ -451,6 +451,40 @@ TEST(EncodingMethodsTest, MapWithTooShortBuf) {
     EXPECT_EQ(nullptr, map.encode(buf.data(), buf.data() + buf.size()));
 }
 
+// A Uint that reports an encoded size which is off by |sizeError| bytes.
+class MisreportedSizeUint : public Uint {
+  public:
+    MisreportedSizeUint(uint64_t value, ssize_t sizeError) : Uint(value), mSizeError(sizeError) {}
+    size_t encodedSize() const override { return Uint::encodedSize() + mSizeError; }
+    std::unique_ptr<Item> clone() const override {
+        return std::make_unique<MisreportedSizeUint>(unsignedValue(), mSizeError);
+    }
+
+  private:
+    ssize_t mSizeError;
+};
+
+TEST(EncodingMethodsTest, EncodingThatOverrunsEncodedSizeIsEmpty) {
+    MisreportedSizeUint val(100000, -1);
+    EXPECT_TRUE(val.encode().empty());
+    EXPECT_TRUE(val.toString().empty());
+
+    Array arr("a", val.clone());
+    EXPECT_TRUE(arr.encode().empty());
+    EXPECT_TRUE(arr.toString().empty());
+}
+
+TEST(EncodingMethodsTest, EncodingThatFallsShortOfEncodedSizeIsEmpty) {
+    MisreportedSizeUint val(100000, 1);
+    EXPECT_TRUE(val.encode().empty());
+    EXPECT_TRUE(val.toString().empty());
+
+    Map map;
+    map.add("key", val.clone());
+    EXPECT_TRUE(map.encode().empty());
+    EXPECT_TRUE(map.toString().empty());
+}
+
 TEST(EqualityTest, Uint) {
     Uint val(99);
     EXPECT_EQ(val, Uint(99));
@@ -1007,6 +1041,97 @@ TEST(FullParserTest, MapWithTruncatedEntry) {
     EXPECT_EQ(encoding.data() + 3, pos);
     EXPECT_EQ("Need 4 byte(s) for length field, have 3.", message);
 }
+TEST(ViewTest, Encoding) {
+    vector<uint8_t> bytes = {0x01, 0x02, 0x03};
+    EXPECT_EQ(Bstr(bytes).encode(), ViewBstr(bytes.data(), bytes.data() + bytes.size()).encode());
+    EXPECT_EQ(Tstr("hello").encode(), ViewTstr("hello"sv).encode());
+
+    ViewTstr val("01234567890123456789012345"sv);
+    vector<uint8_t> buf(val.encodedSize() - 1);
+    EXPECT_EQ(nullptr, val.encode(buf.data(), buf.data() + buf.size()));
+
+    string encoding;
+    val.encode([&](uint8_t c) { encoding.push_back(c); });
+    EXPECT_EQ(val.toString(), encoding);
+}
+
+TEST(ViewTest, Equality) {
+    vector<uint8_t> bytes = {0x01, 0x02, 0x03};
+    ViewBstr view(bytes.data(), bytes.data() + bytes.size());
+    const Item& viewItem = view;
+    EXPECT_TRUE(viewItem == Bstr(bytes));
+    EXPECT_FALSE(viewItem == Bstr("hi"s));
+
+    ViewTstr hello("hello"sv);
+    const Item& helloItem = hello;
+    EXPECT_TRUE(helloItem == Tstr("hello"));
+    EXPECT_FALSE(helloItem == Tstr("world"));
+    EXPECT_FALSE(helloItem == view);
+}
+
+TEST(ViewTest, Downcast) {
+    std::unique_ptr<Item> view = std::make_unique<ViewBstr>(std::make_pair<const uint8_t*>(
+            reinterpret_cast<const uint8_t*>("abc"), size_t{3}));
+    EXPECT_EQ(nullptr, downcastItem<Bstr>(std::move(view)));
+    ASSERT_NE(nullptr, view);
+    EXPECT_NE(nullptr, downcastItem<ViewBstr>(std::move(view)));
+
+    std::unique_ptr<Item> tstr = std::make_unique<Tstr>("abc");
+    EXPECT_EQ(nullptr, downcastItem<ViewTstr>(std::move(tstr)));
+    ASSERT_NE(nullptr, tstr);
+    EXPECT_NE(nullptr, downcastItem<Tstr>(std::move(tstr)));
+}
+
+TEST(ViewParserTest, Strings) {
+    auto encoding = Array(Bstr("bytes"s), "text").encode();
+
+    auto [item, pos, message] = parseWithViews(encoding);
+    ASSERT_NE(nullptr, item);
+    EXPECT_EQ(encoding.data() + encoding.size(), pos);
+    EXPECT_EQ("", message);
+
+    const Array* array = item->asArray();
+    ASSERT_NE(nullptr, array);
+    ASSERT_EQ(nullptr, (*array)[0]->asBstr());
+    const ViewBstr* bstr = (*array)[0]->asViewBstr();
+    ASSERT_NE(nullptr, bstr);
+    EXPECT_EQ(encoding.data() + 2, bstr->view().data());
+    EXPECT_EQ(5u, bstr->view().size());
+
+    const ViewTstr* tstr = (*array)[1]->asViewTstr();
+    ASSERT_NE(nullptr, tstr);
+    EXPECT_EQ(reinterpret_cast<const char*>(encoding.data() + 8), tstr->view().data());
+    EXPECT_EQ("text", tstr->view());
+
+    EXPECT_EQ(encoding, item->encode());
+}
+
+TEST(ViewParserTest, Complex) {
+    vector<uint8_t> vec = {0x01, 0x02, 0x08, 0x03};
+    Map val("Outer1",
+            Array(Map("Inner1", 99,  //
+                      "Inner2", vec),
+                  "foo"),
+            "Outer2", Semantic(24, vec));
+
+    auto encoding = val.encode();
+    auto [item, pos, message] = parseWithViews(encoding);
+    ASSERT_NE(nullptr, item);
+    EXPECT_EQ(encoding.data() + encoding.size(), pos);
+    EXPECT_THAT(item, MatchesItem(ByRef(val)));
+    EXPECT_EQ(encoding, item->encode());
+}
+
+TEST(ViewParserTest, IncompleteString) {
+    Tstr val("hello");
+
+    auto encoding = val.encode();
+    auto [item, pos, message] = parseWithViews(encoding.data(), encoding.size() - 2);
+    EXPECT_EQ(nullptr, item.get());
+    EXPECT_EQ(encoding.data(), pos);
+    EXPECT_EQ("Need 5 byte(s) for text string, have 3.", message);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -17,6 +17,7 @@
 #include <keymasterV4_0/authorization_set.h>
 
 #include <assert.h>
+#include <string.h>
 
 #include <android-base/logging.h>
 
@@ -84,62 +85,76 @@ bool keyParamEqual(const KeyParameter& a, const KeyParameter& b) {
 }
 
 void AuthorizationSet::Sort() {
-    std::sort(data_.begin(), data_.end(), keyParamLess);
+    if (!sorted_) std::sort(data_.begin(), data_.end(), keyParamLess);
+    sorted_ = true;
 }
 
 void AuthorizationSet::Deduplicate() {
     if (data_.empty()) return;
 
     Sort();
-    std::vector<KeyParameter> result;
-
-    auto curr = data_.begin();
-    auto prev = curr++;
-    for (; curr != data_.end(); ++prev, ++curr) {
-        if (prev->tag == Tag::INVALID) continue;
 
-        if (!keyParamEqual(*prev, *curr)) {
-            result.push_back(std::move(*prev));
+    // Keep the last entry of every run of equal entries, compacting in place. INVALID entries are
+    // dropped unless there is nothing else.
+    auto out = data_.begin();
+    for (auto curr = data_.begin(); curr != data_.end(); ++curr) {
+        auto next = curr + 1;
+        if (next == data_.end() || (curr->tag != Tag::INVALID && !keyParamEqual(*curr, *next))) {
+            if (out != curr) *out = std::move(*curr);
+            ++out;
         }
     }
-    result.push_back(std::move(*prev));
-
-    std::swap(data_, result);
+    data_.erase(out, data_.end());
 }
 
 void AuthorizationSet::Union(const AuthorizationSet& other) {
-    data_.insert(data_.end(), other.data_.begin(), other.data_.end());
+    Deduplicate();
+    if (other.empty()) return;
+
+    bool otherSorted = other.sorted_;
+    AuthorizationSet sortedOther;
+    if (!otherSorted) {
+        sortedOther = other;
+        sortedOther.Sort();
+    }
+    const AuthorizationSet& rhs = otherSorted ? other : sortedOther;
+
+    std::vector<KeyParameter> result;
+    result.reserve(data_.size() + rhs.data_.size());
+    std::merge(std::make_move_iterator(data_.begin()), std::make_move_iterator(data_.end()),
+               rhs.data_.begin(), rhs.data_.end(), std::back_inserter(result), keyParamLess);
+    data_ = std::move(result);
     Deduplicate();
 }
 
 void AuthorizationSet::Subtract(const AuthorizationSet& other) {
     Deduplicate();
-
-    auto i = other.begin();
-    while (i != other.end()) {
-        int pos = -1;
-        do {
-            pos = find(i->tag, pos);
-            if (pos != -1 && keyParamEqual(*i, data_[pos])) {
-                data_.erase(data_.begin() + pos);
-                break;
-            }
-        } while (pos != -1);
-        ++i;
+    if (other.empty()) return;
+
+    // Walk both sets in order, sorting pointers to the entries of |other| if need be.
+    std::vector<const KeyParameter*> subtrahend;
+    subtrahend.reserve(other.size());
+    for (const auto& param : other) subtrahend.push_back(&param);
+    if (!other.sorted_) {
+        std::sort(subtrahend.begin(), subtrahend.end(),
+                  [](const KeyParameter* a, const KeyParameter* b) {
+                      return keyParamLess(*a, *b);
+                  });
     }
-}
 
-void AuthorizationSet::Filter(std::function<bool(const KeyParameter&)> doKeep) {
-    std::vector<KeyParameter> result;
-    for (auto& param : data_) {
-        if (doKeep(param)) {
-            result.push_back(std::move(param));
-        }
+    auto sub = subtrahend.begin();
+    auto out = data_.begin();
+    for (auto curr = data_.begin(); curr != data_.end(); ++curr) {
+        while (sub != subtrahend.end() && keyParamLess(**sub, *curr)) ++sub;
+        if (sub != subtrahend.end() && keyParamEqual(**sub, *curr)) continue;
+        if (out != curr) *out = std::move(*curr);
+        ++out;
     }
-    std::swap(data_, result);
+    data_.erase(out, data_.end());
 }
 
 KeyParameter& AuthorizationSet::operator[](int at) {
+    sorted_ = false;
     return data_[at];
 }
 
@@ -149,17 +164,42 @@ const KeyParameter& AuthorizationSet::operator[](int at) const {
 
 void AuthorizationSet::Clear() {
     data_.clear();
+    sorted_ = true;
+}
+
+namespace {
+
+bool tagLess(const KeyParameter& param, Tag tag) {
+    return param.tag < tag;
 }
 
+bool tagGreater(Tag tag, const KeyParameter& param) {
+    return tag < param.tag;
+}
+
+}  // namespace
+
 size_t AuthorizationSet::GetTagCount(Tag tag) const {
-    size_t count = 0;
-    for (int pos = -1; (pos = find(tag, pos)) != -1;) ++count;
-    return count;
+    if (sorted_) {
+        auto first = std::lower_bound(data_.begin(), data_.end(), tag, tagLess);
+        return std::upper_bound(first, data_.end(), tag, tagGreater) - first;
+    }
+    return std::count_if(data_.begin(), data_.end(),
+                         [tag](const KeyParameter& param) { return param.tag == tag; });
 }
 
 int AuthorizationSet::find(Tag tag, int begin) const {
     auto iter = data_.begin() + (1 + begin);
 
+    if (sorted_) {
+        // Entries with the same tag are adjacent, so when walking through them the match is
+        // usually the next entry. Otherwise it's the first one at or after |iter|.
+        if (iter != data_.end() && iter->tag == tag) return iter - data_.begin();
+        iter = std::lower_bound(iter, data_.end(), tag, tagLess);
+        if (iter != data_.end() && iter->tag == tag) return iter - data_.begin();
+        return -1;
+    }
+
     while (iter != data_.end() && iter->tag != tag) ++iter;
 
     if (iter != data_.end()) return iter - data_.begin();
@@ -450,6 +490,199 @@ void AuthorizationSet::Serialize(std::ostream* out) const {
 
 void AuthorizationSet::Deserialize(std::istream* in) {
     deserialize(*in, &data_);
+    sorted_ = std::is_sorted(data_.begin(), data_.end(), keyParamLess);
+}
+
+/**
+ * Serialization straight to and from a byte buffer follows. It produces and accepts the same
+ * persistent format as the stream based code above.
+ */
+
+namespace {
+
+template <typename... T>
+struct known_tags;
+template <TagType... tag_types, Tag... tags>
+struct known_tags<MetaList<TypedTag<tag_types, tags>...>> {
+    static bool contains(Tag tag) { return ((tag == tags) || ...); }
+};
+
+// Returns the number of bytes |param| takes up in the elements section, or 0 if it's skipped.
+size_t serializedElementSize(const KeyParameter& param) {
+    if (param.tag == Tag::INVALID) return 0;
+    if (!known_tags<all_tags_t>::contains(param.tag)) {
+        LOG(WARNING) << "Trying to serialize unknown tag " << unsigned(param.tag)
+                     << ". Did you forget to add it to all_tags_t?";
+        return 0;
+    }
+    switch (typeFromTag(param.tag)) {
+        case TagType::INVALID:
+            return 0;
+        case TagType::ENUM:
+        case TagType::ENUM_REP:
+        case TagType::UINT:
+        case TagType::UINT_REP:
+            return sizeof(Tag) + sizeof(param.f.integer);
+        case TagType::ULONG:
+        case TagType::ULONG_REP:
+            return sizeof(Tag) + sizeof(param.f.longInteger);
+        case TagType::DATE:
+            return sizeof(Tag) + sizeof(param.f.dateTime);
+        case TagType::BOOL:
+            return sizeof(Tag) + sizeof(param.f.boolValue);
+        case TagType::BIGNUM:
+        case TagType::BYTES:
+            return sizeof(Tag) + 2 * sizeof(uint32_t);
+    }
+    return 0;
+}
+
+template <typename T>
+uint8_t* writeValue(uint8_t* pos, const T& value) {
+    memcpy(pos, &value, sizeof(T));
+    return pos + sizeof(T);
+}
+
+template <typename T>
+bool readValue(const uint8_t** pos, const uint8_t* end, T* value) {
+    if (size_t(end - *pos) < sizeof(T)) return false;
+    memcpy(value, *pos, sizeof(T));
+    *pos += sizeof(T);
+    return true;
+}
+
+}  // namespace
+
+bool AuthorizationSet::Serialize(std::vector<uint8_t>* out) const {
+    // Size both sections up front so that the output is allocated once.
+    size_t indirect_size = 0;
+    size_t elements_size = 0;
+    uint32_t element_count = 0;
+    for (const auto& param : data_) {
+        size_t element_size = serializedElementSize(param);
+        if (element_size == 0) continue;
+        elements_size += element_size;
+        ++element_count;
+        auto tag_type = typeFromTag(param.tag);
+        if (tag_type == TagType::BIGNUM || tag_type == TagType::BYTES) {
+            indirect_size += param.blob.size();
+            if (indirect_size > std::numeric_limits<uint32_t>::max()) return false;
+        }
+    }
+    if (elements_size > std::numeric_limits<uint32_t>::max()) return false;
+
+    out->resize(3 * sizeof(uint32_t) + indirect_size + elements_size);
+    uint8_t* indirect = writeValue(out->data(), uint32_t(indirect_size));
+    uint8_t* elements = indirect + indirect_size;
+    elements = writeValue(elements, element_count);
+    elements = writeValue(elements, uint32_t(elements_size));
+
+    uint32_t offset = 0;
+    for (const auto& param : data_) {
+        if (param.tag == Tag::INVALID || !known_tags<all_tags_t>::contains(param.tag)) continue;
+        elements = writeValue(elements, param.tag);
+        switch (typeFromTag(param.tag)) {
+            case TagType::INVALID:
+                break;
+            case TagType::ENUM:
+            case TagType::ENUM_REP:
+            case TagType::UINT:
+            case TagType::UINT_REP:
+                elements = writeValue(elements, param.f.integer);
+                break;
+            case TagType::ULONG:
+            case TagType::ULONG_REP:
+                elements = writeValue(elements, param.f.longInteger);
+                break;
+            case TagType::DATE:
+                elements = writeValue(elements, param.f.dateTime);
+                break;
+            case TagType::BOOL:
+                elements = writeValue(elements, param.f.boolValue);
+                break;
+            case TagType::BIGNUM:
+            case TagType::BYTES:
+                elements = writeValue(elements, uint32_t(param.blob.size()));
+                elements = writeValue(elements, offset);
+                if (param.blob.size()) memcpy(indirect + offset, &param.blob[0], param.blob.size());
+                offset += param.blob.size();
+                break;
+        }
+    }
+    assert(elements == out->data() + out->size());
+    return true;
+}
+
+bool AuthorizationSet::Deserialize(const uint8_t* data, size_t size) {
+    const uint8_t* pos = data;
+    const uint8_t* end = data + size;
+
+    uint32_t indirect_size = 0;
+    if (!readValue(&pos, end, &indirect_size) || size_t(end - pos) < indirect_size) return false;
+    const uint8_t* indirect = pos;
+    pos += indirect_size;
+
+    uint32_t element_count = 0;
+    uint32_t elements_size = 0;
+    if (!readValue(&pos, end, &element_count) || !readValue(&pos, end, &elements_size) ||
+        size_t(end - pos) < elements_size) {
+        return false;
+    }
+    const uint8_t* elements_end = pos + elements_size;
+
+    std::vector<KeyParameter> params;
+    // Every entry takes at least its tag, don't trust element_count beyond that.
+    params.reserve(std::min<size_t>(element_count, elements_size / sizeof(Tag)));
+    for (uint32_t i = 0; i < element_count; ++i) {
+        KeyParameter param = {};
+        if (!readValue(&pos, elements_end, &param.tag)) return false;
+
+        // There are legacy blobs which have invalid tags in them due to a bug during
+        // serialization. They carry no value and are filtered from the result.
+        if (param.tag == Tag::INVALID) continue;
+        if (!known_tags<all_tags_t>::contains(param.tag)) return false;
+
+        bool ok = false;
+        switch (typeFromTag(param.tag)) {
+            case TagType::INVALID:
+                break;
+            case TagType::ENUM:
+            case TagType::ENUM_REP:
+            case TagType::UINT:
+            case TagType::UINT_REP:
+                ok = readValue(&pos, elements_end, &param.f.integer);
+                break;
+            case TagType::ULONG:
+            case TagType::ULONG_REP:
+                ok = readValue(&pos, elements_end, &param.f.longInteger);
+                break;
+            case TagType::DATE:
+                ok = readValue(&pos, elements_end, &param.f.dateTime);
+                break;
+            case TagType::BOOL:
+                ok = readValue(&pos, elements_end, &param.f.boolValue);
+                break;
+            case TagType::BIGNUM:
+            case TagType::BYTES: {
+                uint32_t blob_length = 0;
+                uint32_t offset = 0;
+                ok = readValue(&pos, elements_end, &blob_length) &&
+                     readValue(&pos, elements_end, &offset) && offset <= indirect_size &&
+                     blob_length <= indirect_size - offset;
+                if (ok) {
+                    param.blob.resize(blob_length);
+                    if (blob_length) memcpy(&param.blob[0], indirect + offset, blob_length);
+                }
+                break;
+            }
+        }
+        if (!ok) return false;
+        params.push_back(std::move(param));
+    }
+
+    data_ = std::move(params);
+    sorted_ = std::is_sorted(data_.begin(), data_.end(), keyParamLess);
+    return true;
 }
 
 AuthorizationSetBuilder& AuthorizationSetBuilder::RsaKey(uint32_t key_size,
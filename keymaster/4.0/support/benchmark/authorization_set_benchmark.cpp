@@ -0,0 +1,156 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sstream>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <keymasterV4_0/authorization_set.h>
+
+namespace android {
+namespace hardware {
+namespace keymaster {
+namespace V4_0 {
+namespace {
+
+// Key characteristics of about |size| entries, like keystore passes around for every operation.
+AuthorizationSet makeKeyCharacteristics(size_t size) {
+    AuthorizationSetBuilder set;
+    set.RsaSigningKey(2048, 65537)
+            .Digest(Digest::NONE, Digest::SHA_2_256, Digest::SHA_2_512)
+            .Padding(PaddingMode::NONE, PaddingMode::RSA_PSS, PaddingMode::RSA_PKCS1_1_5_SIGN)
+            .Authorization(TAG_NO_AUTH_REQUIRED)
+            .Authorization(TAG_ORIGIN, KeyOrigin::GENERATED)
+            .Authorization(TAG_OS_VERSION, 110000)
+            .Authorization(TAG_OS_PATCHLEVEL, 202010)
+            .Authorization(TAG_CREATION_DATETIME, 1600000000000ull)
+            .Authorization(TAG_APPLICATION_ID, hidl_vec<uint8_t>(15, 'a'));
+    for (uint64_t sid = 1; set.size() < size; ++sid) {
+        set.Authorization(TAG_USER_SECURE_ID, sid);
+    }
+    return std::move(set);
+}
+
+void sizeArgs(benchmark::internal::Benchmark* b) {
+    b->Arg(10)->Arg(20)->Arg(40);
+}
+
+// The lookups keystore does when beginning an operation, on a set in insertion order and on a
+// sorted one.
+void BM_GetTagValue(benchmark::State& state, bool sorted) {
+    AuthorizationSet set = makeKeyCharacteristics(state.range(0));
+    if (sorted) set.Sort();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(set.GetTagValue(TAG_ALGORITHM));
+        benchmark::DoNotOptimize(set.GetTagValue(TAG_AUTH_TIMEOUT));
+        benchmark::DoNotOptimize(set.GetTagValue(TAG_USAGE_EXPIRE_DATETIME));
+        benchmark::DoNotOptimize(set.GetTagValue(TAG_CREATION_DATETIME));
+        benchmark::DoNotOptimize(set.GetTagCount(TAG_USER_SECURE_ID));
+        benchmark::DoNotOptimize(set.Contains(TAG_PURPOSE, KeyPurpose::VERIFY));
+    }
+}
+BENCHMARK_CAPTURE(BM_GetTagValue, unsorted, false)->Apply(sizeArgs);
+BENCHMARK_CAPTURE(BM_GetTagValue, sorted, true)->Apply(sizeArgs);
+
+void BM_Union(benchmark::State& state) {
+    const AuthorizationSet hardwareEnforced = makeKeyCharacteristics(state.range(0));
+    AuthorizationSet softwareEnforced;
+    softwareEnforced.push_back(TAG_CREATION_DATETIME, 1600000000001ull);
+    softwareEnforced.push_back(TAG_APPLICATION_ID, hidl_vec<uint8_t>(15, 'a'));
+    for (auto _ : state) {
+        AuthorizationSet set = softwareEnforced;
+        set.Union(hardwareEnforced);
+        benchmark::DoNotOptimize(set.data());
+    }
+}
+BENCHMARK(BM_Union)->Apply(sizeArgs);
+
+void BM_Subtract(benchmark::State& state) {
+    const AuthorizationSet characteristics = makeKeyCharacteristics(state.range(0));
+    AuthorizationSet operationParams = AuthorizationSetBuilder()
+                                               .Digest(Digest::SHA_2_256)
+                                               .Padding(PaddingMode::RSA_PSS)
+                                               .Authorization(TAG_PURPOSE, KeyPurpose::SIGN);
+    for (auto _ : state) {
+        AuthorizationSet set = characteristics;
+        set.Subtract(operationParams);
+        benchmark::DoNotOptimize(set.data());
+    }
+}
+BENCHMARK(BM_Subtract)->Apply(sizeArgs);
+
+void BM_Filter(benchmark::State& state) {
+    const AuthorizationSet characteristics = makeKeyCharacteristics(state.range(0));
+    for (auto _ : state) {
+        AuthorizationSet set = characteristics;
+        set.Filter([](const KeyParameter& param) { return param.tag != Tag::USER_SECURE_ID; });
+        benchmark::DoNotOptimize(set.data());
+    }
+}
+BENCHMARK(BM_Filter)->Apply(sizeArgs);
+
+void BM_SerializeStream(benchmark::State& state) {
+    const AuthorizationSet set = makeKeyCharacteristics(state.range(0));
+    for (auto _ : state) {
+        std::stringstream out;
+        set.Serialize(&out);
+        benchmark::DoNotOptimize(out.tellp());
+    }
+}
+BENCHMARK(BM_SerializeStream)->Apply(sizeArgs);
+
+void BM_SerializeBytes(benchmark::State& state) {
+    const AuthorizationSet set = makeKeyCharacteristics(state.range(0));
+    for (auto _ : state) {
+        std::vector<uint8_t> out;
+        set.Serialize(&out);
+        benchmark::DoNotOptimize(out.data());
+    }
+}
+BENCHMARK(BM_SerializeBytes)->Apply(sizeArgs);
+
+void BM_DeserializeStream(benchmark::State& state) {
+    std::stringstream serialized;
+    makeKeyCharacteristics(state.range(0)).Serialize(&serialized);
+    const std::string bytes = serialized.str();
+    for (auto _ : state) {
+        std::stringstream in(bytes);
+        AuthorizationSet set;
+        set.Deserialize(&in);
+        benchmark::DoNotOptimize(set.data());
+    }
+}
+BENCHMARK(BM_DeserializeStream)->Apply(sizeArgs);
+
+void BM_DeserializeBytes(benchmark::State& state) {
+    std::vector<uint8_t> bytes;
+    makeKeyCharacteristics(state.range(0)).Serialize(&bytes);
+    for (auto _ : state) {
+        AuthorizationSet set;
+        set.Deserialize(bytes.data(), bytes.size());
+        benchmark::DoNotOptimize(set.data());
+    }
+}
+BENCHMARK(BM_DeserializeBytes)->Apply(sizeArgs);
+
+}  // namespace
+}  // namespace V4_0
+}  // namespace keymaster
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
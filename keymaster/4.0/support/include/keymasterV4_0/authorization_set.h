@@ -17,6 +17,7 @@
 #ifndef SYSTEM_SECURITY_KEYSTORE_KM4_AUTHORIZATION_SET_H_
 #define SYSTEM_SECURITY_KEYSTORE_KM4_AUTHORIZATION_SET_H_
 
+#include <algorithm>
 #include <vector>
 
 #include <keymasterV4_0/keymaster_tags.h>
@@ -28,10 +29,25 @@ namespace V4_0 {
 
 class AuthorizationSetBuilder;
 
+/**
+ * Strict weak ordering of KeyParameters by tag and then by value, as used by
+ * AuthorizationSet::Sort().
+ */
+bool keyParamLess(const KeyParameter& a, const KeyParameter& b);
+
+/**
+ * Returns true if \p a and \p b have the same tag and value.
+ */
+bool keyParamEqual(const KeyParameter& a, const KeyParameter& b);
+
 /**
  * An ordered collection of KeyParameters. It provides memory ownership and some convenient
  * functionality for sorting, deduplicating, joining, and subtracting sets of KeyParameters.
  * For serialization, wrap the backing store of this structure in a hidl_vec<KeyParameter>.
+ *
+ * The set keeps track of whether its entries are sorted. While they are, lookups by tag use
+ * binary search and Union() and Subtract() merge instead of searching for every entry. Entries
+ * stay sorted when appended in order, e.g. after Sort(), Deduplicate(), Union() or Subtract().
  */
 class AuthorizationSet {
    public:
@@ -43,10 +59,14 @@ class AuthorizationSet {
     AuthorizationSet(){};
 
     // Copy constructor.
-    AuthorizationSet(const AuthorizationSet& other) : data_(other.data_) {}
+    AuthorizationSet(const AuthorizationSet& other)
+        : data_(other.data_), sorted_(other.sorted_) {}
 
     // Move constructor.
-    AuthorizationSet(AuthorizationSet&& other) noexcept : data_(std::move(other.data_)) {}
+    AuthorizationSet(AuthorizationSet&& other) noexcept
+        : data_(std::move(other.data_)), sorted_(other.sorted_) {
+        other.sorted_ = true;
+    }
 
     // Constructor from hidl_vec<KeyParameter>
     AuthorizationSet(const hidl_vec<KeyParameter>& other) { *this = other; }
@@ -54,17 +74,22 @@ class AuthorizationSet {
     // Copy assignment.
     AuthorizationSet& operator=(const AuthorizationSet& other) {
         data_ = other.data_;
+        sorted_ = other.sorted_;
         return *this;
     }
 
     // Move assignment.
     AuthorizationSet& operator=(AuthorizationSet&& other) noexcept {
         data_ = std::move(other.data_);
+        sorted_ = other.sorted_;
+        other.data_.clear();
+        other.sorted_ = true;
         return *this;
     }
 
     AuthorizationSet& operator=(const hidl_vec<KeyParameter>& other) {
         if (other.size() > 0) {
+            sorted_ = false;
             data_.resize(other.size());
             for (size_t i = 0; i < data_.size(); ++i) {
                 /* This makes a deep copy even of embedded blobs.
@@ -143,13 +168,20 @@ class AuthorizationSet {
 
     /**
      * Modifies this Authorization set such that it only keeps the entries for which doKeep
-     * returns true.
+     * returns true. The entries are filtered in place and keep their order.
      */
-    void Filter(std::function<bool(const KeyParameter&)> doKeep);
+    template <typename Predicate>
+    void Filter(Predicate doKeep) {
+        data_.erase(std::remove_if(data_.begin(), data_.end(),
+                                   [&doKeep](const KeyParameter& param) { return !doKeep(param); }),
+                    data_.end());
+    }
+
     /**
      * Returns the nth element of the set.
      * Like for std::vector::operator[] there is no range check performed. Use of out of range
-     * indices is undefined.
+     * indices is undefined. As the entry may be modified through the returned reference, the set
+     * is no longer treated as sorted until Sort() is called again.
      */
     KeyParameter& operator[](int n);
 
@@ -167,8 +199,8 @@ class AuthorizationSet {
 
     template <TagType tag_type, Tag tag, typename ValueT>
     bool Contains(TypedTag<tag_type, tag> ttag, const ValueT& value) const {
-        for (const auto& param : data_) {
-            auto entry = authorizationValue(ttag, param);
+        for (int pos = -1; (pos = find(ttag, pos)) != -1;) {
+            auto entry = authorizationValue(ttag, data_[pos]);
             if (entry.isOk() && static_cast<ValueT>(entry.value()) == value) return true;
         }
         return false;
@@ -185,8 +217,14 @@ class AuthorizationSet {
         return {};
     }
 
-    void push_back(const KeyParameter& param) { data_.push_back(param); }
-    void push_back(KeyParameter&& param) { data_.push_back(std::move(param)); }
+    void push_back(const KeyParameter& param) {
+        sorted_ = sorted_ && (data_.empty() || !keyParamLess(param, data_.back()));
+        data_.push_back(param);
+    }
+    void push_back(KeyParameter&& param) {
+        sorted_ = sorted_ && (data_.empty() || !keyParamLess(param, data_.back()));
+        data_.push_back(std::move(param));
+    }
     void push_back(const AuthorizationSet& set) {
         for (auto& entry : set) {
             push_back(entry);
@@ -222,10 +260,27 @@ class AuthorizationSet {
     void Serialize(std::ostream* out) const;
     void Deserialize(std::istream* in);
 
+    /**
+     * Serializes the set into \p out in the same format as Serialize(std::ostream*), without
+     * going through streams. Returns false if the set is too large for the format.
+     */
+    bool Serialize(std::vector<uint8_t>* out) const;
+
+    /**
+     * Replaces the content of the set with the \p size bytes at \p data, which hold a set
+     * serialized by either of the Serialize() methods. Returns false if the data is malformed, in
+     * which case the set is left unchanged.
+     */
+    bool Deserialize(const uint8_t* data, size_t size);
+
    private:
     NullOr<const KeyParameter&> GetEntry(Tag tag) const;
 
     std::vector<KeyParameter> data_;
+    // True if data_ is known to be ordered by keyParamLess.
+    bool sorted_ = true;
+
+    friend class AuthorizationSetPeer;
 };
 
 class AuthorizationSetBuilder : public AuthorizationSet {
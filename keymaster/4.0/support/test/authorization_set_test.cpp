@@ -0,0 +1,370 @@
+/*
+ * Copyright 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <keymasterV4_0/authorization_set.h>
+
+namespace android {
+namespace hardware {
+namespace keymaster {
+namespace V4_0 {
+
+// Exposes whether a set is known to be sorted, which only shows in the cost of its operations.
+class AuthorizationSetPeer {
+  public:
+    static bool sorted(const AuthorizationSet& set) { return set.sorted_; }
+};
+
+namespace {
+
+// A set with values of every storage type, in insertion order.
+AuthorizationSet makeSet() {
+    AuthorizationSetBuilder set;
+    set.Authorization(TAG_PURPOSE, KeyPurpose::SIGN)
+            .Authorization(TAG_ALGORITHM, Algorithm::RSA)
+            .Authorization(TAG_KEY_SIZE, 2048)
+            .Authorization(TAG_PURPOSE, KeyPurpose::VERIFY)
+            .Authorization(TAG_RSA_PUBLIC_EXPONENT, 65537)
+            .Authorization(TAG_NO_AUTH_REQUIRED)
+            .Authorization(TAG_CREATION_DATETIME, 1600000000000ull)
+            .Authorization(TAG_APPLICATION_ID, hidl_vec<uint8_t>({'a', 'p', 'p'}))
+            .Authorization(TAG_APPLICATION_DATA, hidl_vec<uint8_t>())
+            .Authorization(TAG_USER_SECURE_ID, 42)
+            .Authorization(TAG_USER_SECURE_ID, 7);
+    return std::move(set);
+}
+
+std::vector<uint8_t> serializeToStream(const AuthorizationSet& set) {
+    std::stringstream stream;
+    set.Serialize(&stream);
+    std::string str = stream.str();
+    return std::vector<uint8_t>(str.begin(), str.end());
+}
+
+void expectSameEntries(const AuthorizationSet& expected, const AuthorizationSet& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_TRUE(keyParamEqual(expected[i], actual[i])) << "at index " << i;
+    }
+}
+
+template <typename T>
+void append(std::vector<uint8_t>* out, T value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out->insert(out->end(), bytes, bytes + sizeof(T));
+}
+
+// Builds a serialized set with a single BYTES entry, whose blob is at |offset| in the indirect
+// data and |length| bytes long.
+std::vector<uint8_t> serializedBlobEntry(uint32_t offset, uint32_t length) {
+    const std::string indirect = "blob";
+    std::vector<uint8_t> data;
+    append(&data, uint32_t(indirect.size()));
+    data.insert(data.end(), indirect.begin(), indirect.end());
+    append(&data, uint32_t(1));                                 // element_count
+    append(&data, uint32_t(sizeof(Tag) + 2 * sizeof(uint32_t)));  // elements_size
+    append(&data, Tag::APPLICATION_ID);
+    append(&data, length);
+    append(&data, offset);
+    return data;
+}
+
+TEST(AuthorizationSetTest, SerializeMatchesTheStreamFormat) {
+    AuthorizationSet set = makeSet();
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(set.Serialize(&data));
+    EXPECT_EQ(serializeToStream(set), data);
+
+    AuthorizationSet empty;
+    ASSERT_TRUE(empty.Serialize(&data));
+    EXPECT_EQ(serializeToStream(empty), data);
+}
+
+TEST(AuthorizationSetTest, DeserializeReadsTheStreamFormat) {
+    AuthorizationSet set = makeSet();
+    std::vector<uint8_t> data = serializeToStream(set);
+
+    AuthorizationSet deserialized;
+    ASSERT_TRUE(deserialized.Deserialize(data.data(), data.size()));
+    expectSameEntries(set, deserialized);
+
+    // And the other way around.
+    ASSERT_TRUE(set.Serialize(&data));
+    std::stringstream stream(std::string(data.begin(), data.end()));
+    AuthorizationSet fromStream;
+    fromStream.Deserialize(&stream);
+    expectSameEntries(set, fromStream);
+}
+
+TEST(AuthorizationSetTest, DeserializeRecordsWhetherTheSetIsSorted) {
+    AuthorizationSet set = makeSet();
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(set.Serialize(&data));
+    AuthorizationSet deserialized;
+    ASSERT_TRUE(deserialized.Deserialize(data.data(), data.size()));
+    EXPECT_FALSE(AuthorizationSetPeer::sorted(deserialized));
+
+    set.Sort();
+    ASSERT_TRUE(set.Serialize(&data));
+    ASSERT_TRUE(deserialized.Deserialize(data.data(), data.size()));
+    EXPECT_TRUE(AuthorizationSetPeer::sorted(deserialized));
+}
+
+TEST(AuthorizationSetTest, DeserializeRejectsTruncatedData) {
+    std::vector<uint8_t> data;
+    ASSERT_TRUE(makeSet().Serialize(&data));
+    AuthorizationSet other = AuthorizationSetBuilder().Authorization(TAG_KEY_SIZE, 256);
+
+    for (size_t size = 0; size < data.size(); ++size) {
+        AuthorizationSet set = other;
+        EXPECT_FALSE(set.Deserialize(data.data(), size)) << "truncated to " << size;
+        // The set is left unchanged.
+        expectSameEntries(other, set);
+    }
+}
+
+TEST(AuthorizationSetTest, DeserializeRejectsBlobsOutsideTheIndirectData) {
+    AuthorizationSet set;
+    std::vector<uint8_t> data = serializedBlobEntry(0, 4);
+    ASSERT_TRUE(set.Deserialize(data.data(), data.size()));
+    ASSERT_EQ(1u, set.size());
+    EXPECT_EQ(hidl_vec<uint8_t>({'b', 'l', 'o', 'b'}), set[0].blob);
+
+    data = serializedBlobEntry(0, 5);
+    EXPECT_FALSE(set.Deserialize(data.data(), data.size()));
+    data = serializedBlobEntry(5, 0);
+    EXPECT_FALSE(set.Deserialize(data.data(), data.size()));
+    // Offset and length which wrap around.
+    data = serializedBlobEntry(2, 0xffffffff);
+    EXPECT_FALSE(set.Deserialize(data.data(), data.size()));
+}
+
+TEST(AuthorizationSetTest, DeserializeRejectsMalformedData) {
+    std::vector<uint8_t> valid;
+    ASSERT_TRUE(AuthorizationSetBuilder().Authorization(TAG_KEY_SIZE, 256).Serialize(&valid));
+    AuthorizationSet set;
+    ASSERT_TRUE(set.Deserialize(valid.data(), valid.size()));
+
+    // An unknown tag.
+    std::vector<uint8_t> data = valid;
+    const size_t tagOffset = 3 * sizeof(uint32_t);
+    uint32_t unknownTag = uint32_t(TagType::UINT) | 0xfff;
+    memcpy(&data[tagOffset], &unknownTag, sizeof(unknownTag));
+    EXPECT_FALSE(set.Deserialize(data.data(), data.size()));
+
+    // More entries than there are elements.
+    data = valid;
+    uint32_t elementCount = 2;
+    memcpy(&data[sizeof(uint32_t)], &elementCount, sizeof(elementCount));
+    EXPECT_FALSE(set.Deserialize(data.data(), data.size()));
+
+    // More indirect data than there is data.
+    data = valid;
+    uint32_t indirectSize = data.size();
+    memcpy(&data[0], &indirectSize, sizeof(indirectSize));
+    EXPECT_FALSE(set.Deserialize(data.data(), data.size()));
+}
+
+TEST(AuthorizationSetTest, DeserializeDropsLegacyInvalidEntries) {
+    std::vector<uint8_t> data;
+    append(&data, uint32_t(0));  // indirect_size
+    append(&data, uint32_t(2));  // element_count
+    append(&data, uint32_t(sizeof(Tag) + sizeof(Tag) + sizeof(uint32_t)));
+    append(&data, Tag::INVALID);
+    append(&data, Tag::KEY_SIZE);
+    append(&data, uint32_t(256));
+
+    AuthorizationSet set;
+    ASSERT_TRUE(set.Deserialize(data.data(), data.size()));
+    expectSameEntries(AuthorizationSetBuilder().Authorization(TAG_KEY_SIZE, 256), set);
+}
+
+TEST(AuthorizationSetTest, Deduplicate) {
+    AuthorizationSet set = makeSet();
+    set.push_back(TAG_KEY_SIZE, 2048);
+    set.push_back(TAG_NO_AUTH_REQUIRED);
+    set.push_back(TAG_APPLICATION_ID, hidl_vec<uint8_t>({'a', 'p', 'p'}));
+    set.push_back(KeyParameter());  // INVALID
+
+    AuthorizationSet expected = makeSet();
+    expected.Sort();
+    set.Deduplicate();
+    expectSameEntries(expected, set);
+    EXPECT_TRUE(AuthorizationSetPeer::sorted(set));
+}
+
+TEST(AuthorizationSetTest, DeduplicateKeepsASingleInvalidEntry) {
+    AuthorizationSet set;
+    set.push_back(KeyParameter());
+    set.push_back(KeyParameter());
+    set.Deduplicate();
+    EXPECT_EQ(1u, set.size());
+}
+
+TEST(AuthorizationSetTest, Union) {
+    AuthorizationSet set = AuthorizationSetBuilder()
+                                   .Authorization(TAG_PURPOSE, KeyPurpose::VERIFY)
+                                   .Authorization(TAG_KEY_SIZE, 2048)
+                                   .Authorization(TAG_KEY_SIZE, 2048);
+    // |other| is unsorted, so it gets sorted before the merge.
+    AuthorizationSet other = AuthorizationSetBuilder()
+                                     .Authorization(TAG_KEY_SIZE, 4096)
+                                     .Authorization(TAG_PURPOSE, KeyPurpose::VERIFY)
+                                     .Authorization(TAG_PURPOSE, KeyPurpose::SIGN);
+    AuthorizationSet otherBefore = other;
+    set.Union(other);
+
+    AuthorizationSet expected = AuthorizationSetBuilder()
+                                        .Authorization(TAG_PURPOSE, KeyPurpose::SIGN)
+                                        .Authorization(TAG_PURPOSE, KeyPurpose::VERIFY)
+                                        .Authorization(TAG_KEY_SIZE, 2048)
+                                        .Authorization(TAG_KEY_SIZE, 4096);
+    expected.Sort();
+    expectSameEntries(expected, set);
+    expectSameEntries(otherBefore, other);
+
+    set.Union(AuthorizationSet());
+    expectSameEntries(expected, set);
+}
+
+TEST(AuthorizationSetTest, Subtract) {
+    AuthorizationSet set = makeSet();
+    AuthorizationSet other = AuthorizationSetBuilder()
+                                     .Authorization(TAG_USER_SECURE_ID, 42)
+                                     .Authorization(TAG_KEY_SIZE, 4096)  // not in |set|
+                                     .Authorization(TAG_APPLICATION_ID,
+                                                    hidl_vec<uint8_t>({'a', 'p', 'p'}))
+                                     .Authorization(TAG_PURPOSE, KeyPurpose::SIGN);
+    set.Subtract(other);
+
+    AuthorizationSet expected = AuthorizationSetBuilder()
+                                        .Authorization(TAG_ALGORITHM, Algorithm::RSA)
+                                        .Authorization(TAG_KEY_SIZE, 2048)
+                                        .Authorization(TAG_PURPOSE, KeyPurpose::VERIFY)
+                                        .Authorization(TAG_RSA_PUBLIC_EXPONENT, 65537)
+                                        .Authorization(TAG_NO_AUTH_REQUIRED)
+                                        .Authorization(TAG_CREATION_DATETIME, 1600000000000ull)
+                                        .Authorization(TAG_APPLICATION_DATA, hidl_vec<uint8_t>())
+                                        .Authorization(TAG_USER_SECURE_ID, 7);
+    expected.Sort();
+    expectSameEntries(expected, set);
+
+    set.Subtract(set);
+    EXPECT_TRUE(set.empty());
+}
+
+TEST(AuthorizationSetTest, PushBackTracksWhetherTheSetIsSorted) {
+    AuthorizationSet set;
+    EXPECT_TRUE(AuthorizationSetPeer::sorted(set));
+    set.push_back(TAG_PURPOSE, KeyPurpose::SIGN);
+    set.push_back(TAG_PURPOSE, KeyPurpose::VERIFY);
+    set.push_back(TAG_KEY_SIZE, 2048);
+    EXPECT_TRUE(AuthorizationSetPeer::sorted(set));
+
+    set.push_back(TAG_PURPOSE, KeyPurpose::ENCRYPT);
+    EXPECT_FALSE(AuthorizationSetPeer::sorted(set));
+    set.Sort();
+    EXPECT_TRUE(AuthorizationSetPeer::sorted(set));
+
+    // Erasing keeps the order.
+    ASSERT_TRUE(set.erase(1));
+    EXPECT_TRUE(AuthorizationSetPeer::sorted(set));
+    EXPECT_FALSE(set.erase(set.size()));
+
+    set.Clear();
+    EXPECT_TRUE(AuthorizationSetPeer::sorted(set));
+}
+
+TEST(AuthorizationSetTest, MutableIndexUnsortsTheSetUntilSort) {
+    AuthorizationSet set = makeSet();
+    set.Sort();
+    const AuthorizationSet& constSet = set;
+    KeyParameter first = constSet[0];
+    EXPECT_TRUE(AuthorizationSetPeer::sorted(set));
+
+    EXPECT_TRUE(keyParamEqual(first, set[0]));
+    EXPECT_FALSE(AuthorizationSetPeer::sorted(set));
+
+    set.Sort();
+    EXPECT_TRUE(AuthorizationSetPeer::sorted(set));
+    EXPECT_TRUE(keyParamEqual(first, constSet[0]));
+}
+
+TEST(AuthorizationSetTest, WritingThroughMutableIndexIsNoticed) {
+    AuthorizationSet set = AuthorizationSetBuilder()
+                                   .Authorization(TAG_PURPOSE, KeyPurpose::SIGN)
+                                   .Authorization(TAG_ALGORITHM, Algorithm::RSA)
+                                   .Authorization(TAG_KEY_SIZE, 2048);
+    set.Sort();
+    ASSERT_EQ(0, set.find(Tag::ALGORITHM));
+    KeyParameter& entry = set[0];
+    EXPECT_EQ(-1, set.find(Tag::DIGEST));
+
+    // Replaces the first entry by one which sorts after the second, while the reference is held.
+    entry = Authorization(TAG_DIGEST, Digest::SHA_2_256);
+    EXPECT_EQ(0, set.find(Tag::DIGEST));
+    EXPECT_EQ(1u, set.GetTagCount(Tag::DIGEST));
+    EXPECT_EQ(1, set.find(Tag::PURPOSE));
+    EXPECT_EQ(-1, set.find(Tag::ALGORITHM));
+
+    set.Sort();
+    EXPECT_EQ(0, set.find(Tag::PURPOSE));
+    EXPECT_EQ(1, set.find(Tag::DIGEST));
+}
+
+TEST(AuthorizationSetTest, FindWalksEntriesWithTheSameTag) {
+    AuthorizationSet unsorted = makeSet();
+    AuthorizationSet sorted = makeSet();
+    sorted.Sort();
+
+    for (const AuthorizationSet* set : {&unsorted, &sorted}) {
+        std::vector<uint64_t> sids;
+        for (int pos = -1; (pos = set->find(Tag::USER_SECURE_ID, pos)) != -1;) {
+            EXPECT_EQ(Tag::USER_SECURE_ID, (*set)[pos].tag);
+            sids.push_back((*set)[pos].f.longInteger);
+        }
+        std::sort(sids.begin(), sids.end());
+        EXPECT_EQ(std::vector<uint64_t>({7, 42}), sids);
+        EXPECT_EQ(2u, set->GetTagCount(Tag::USER_SECURE_ID));
+
+        EXPECT_EQ(-1, set->find(Tag::DIGEST));
+        EXPECT_EQ(0u, set->GetTagCount(Tag::DIGEST));
+        EXPECT_NE(-1, set->find(Tag::APPLICATION_DATA));
+        // Searching past the last entry finds nothing.
+        EXPECT_EQ(-1, set->find(Tag::PURPOSE, set->size() - 1));
+    }
+
+    // In a sorted set entries with the same tag are adjacent.
+    int first = sorted.find(Tag::PURPOSE);
+    ASSERT_NE(-1, first);
+    EXPECT_EQ(first + 1, sorted.find(Tag::PURPOSE, first));
+    EXPECT_EQ(-1, sorted.find(Tag::PURPOSE, first + 1));
+    EXPECT_TRUE(sorted.Contains(TAG_USER_SECURE_ID, 42u));
+    EXPECT_FALSE(sorted.Contains(TAG_USER_SECURE_ID, 43u));
+}
+
+}  // namespace
+}  // namespace V4_0
+}  // namespace keymaster
+}  // namespace hardware
+}  // namespace android
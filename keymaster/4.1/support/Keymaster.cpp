@@ -16,7 +16,10 @@
 
 #include <keymasterV4_1/Keymaster.h>
 
+#include <chrono>
+#include <future>
 #include <iomanip>
+#include <sstream>
 
 #include <android-base/logging.h>
 #include <android/hidl/manager/1.2/IServiceManager.h>
@@ -72,6 +75,61 @@ namespace V4_1::support {
 
 using ::android::sp;
 using ::android::hidl::manager::V1_2::IServiceManager;
+using ::std::chrono::steady_clock;
+
+// Calls which take longer than this are reported while still being waited for. Nothing is given
+// up on, as neither keystore nor vold can do without their keymasters.
+constexpr std::chrono::milliseconds kSlowCallTimeout(2000);
+
+static int64_t millisSince(steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(steady_clock::now() - start)
+            .count();
+}
+
+/**
+ * Calls task(i) for every element of labels on a thread of its own, logging how long each call
+ * took, and returns the results in the order of labels.
+ */
+template <typename Task>
+static auto runConcurrently(const char* operation, const std::vector<std::string>& labels,
+                            Task task) -> std::vector<decltype(task(size_t(0)))> {
+    using Result = decltype(task(size_t(0)));
+
+    auto start = steady_clock::now();
+    std::vector<std::future<Result>> futures;
+    futures.reserve(labels.size());
+    for (size_t i = 0; i < labels.size(); ++i) {
+        futures.push_back(std::async(std::launch::async, [&, i] {
+            auto callStart = steady_clock::now();
+            Result result = task(i);
+            LOG(INFO) << operation << " for " << labels[i] << " took " << millisSince(callStart)
+                      << "ms";
+            return result;
+        }));
+    }
+
+    std::vector<Result> results;
+    results.reserve(futures.size());
+    for (size_t i = 0; i < futures.size(); ++i) {
+        while (futures[i].wait_for(kSlowCallTimeout) == std::future_status::timeout) {
+            LOG(WARNING) << operation << " for " << labels[i] << " still running after "
+                         << millisSince(start) << "ms";
+        }
+        results.push_back(futures[i].get());
+    }
+    return results;
+}
+
+static std::vector<std::string> labelsOf(const Keymaster::KeymasterSet& keymasters) {
+    std::vector<std::string> labels;
+    labels.reserve(keymasters.size());
+    for (auto& keymaster : keymasters) {
+        std::ostringstream label;
+        label << *keymaster;
+        labels.push_back(label.str());
+    }
+    return labels;
+}
 
 std::ostream& operator<<(std::ostream& os, const Keymaster& keymaster) {
     auto& version = keymaster.halVersion();
@@ -83,20 +141,30 @@ std::ostream& operator<<(std::ostream& os, const Keymaster& keymaster) {
 
 template <typename Wrapper>
 Keymaster::KeymasterSet enumerateDevices(const sp<IServiceManager>& serviceManager) {
-    Keymaster::KeymasterSet result;
-
     bool foundDefault = false;
     auto& descriptor = Wrapper::WrappedIKeymasterDevice::descriptor;
-    serviceManager->listManifestByInterface(descriptor, [&](const hidl_vec<hidl_string>& names) {
-        for (auto& name : names) {
+    std::vector<hidl_string> names;
+    std::vector<std::string> labels;
+    serviceManager->listManifestByInterface(descriptor, [&](const hidl_vec<hidl_string>& list) {
+        for (auto& name : list) {
             if (name == "default") foundDefault = true;
-            auto device = Wrapper::WrappedIKeymasterDevice::getService(name);
-            CHECK(device) << "Failed to get service for " << descriptor << " with interface name "
-                          << name;
-            result.push_back(new Wrapper(device, name));
+            names.push_back(name);
+            labels.push_back(std::string(descriptor) + "/" + std::string(name));
         }
     });
 
+    // Instances may have to be started before they can be returned, and their version is needed
+    // for sorting them. Get all of them at once.
+    Keymaster::KeymasterSet result =
+            runConcurrently("getService", labels, [&](size_t i) -> sp<Keymaster> {
+                auto device = Wrapper::WrappedIKeymasterDevice::getService(names[i]);
+                CHECK(device) << "Failed to get service for " << descriptor
+                              << " with interface name " << names[i];
+                sp<Keymaster> keymaster = new Wrapper(device, names[i]);
+                keymaster->halVersion();
+                return keymaster;
+            });
+
     if (!foundDefault) {
         // "default" wasn't provided by listManifestByInterface.  Maybe there's a passthrough
         // implementation.
@@ -124,8 +192,10 @@ Keymaster::KeymasterSet Keymaster::enumerateAvailableDevices() {
     auto serviceManager = IServiceManager::getService();
     CHECK(serviceManager) << "Could not retrieve ServiceManager";
 
+    auto km3sFuture = std::async(std::launch::async,
+                                 [&] { return enumerateDevices<Keymaster3>(serviceManager); });
     auto km4s = enumerateDevices<Keymaster4>(serviceManager);
-    auto km3s = enumerateDevices<Keymaster3>(serviceManager);
+    auto km3s = km3sFuture.get();
 
     auto result = std::move(km4s);
     result.insert(result.end(), std::make_move_iterator(km3s.begin()),
@@ -142,18 +212,39 @@ Keymaster::KeymasterSet Keymaster::enumerateAvailableDevices() {
 }
 
 static hidl_vec<HmacSharingParameters> getHmacParameters(
-        const Keymaster::KeymasterSet& keymasters) {
+        const Keymaster::KeymasterSet& keymasters, const std::vector<std::string>& labels) {
+    struct Result {
+        bool called = false;
+        V4_0::ErrorCode error;
+        HmacSharingParameters params;
+        bool ok;
+        std::string description;
+    };
+    auto results = runConcurrently("getHmacSharingParameters", labels, [&](size_t i) {
+        Result result;
+        auto rc = keymasters[i]->getHmacSharingParameters([&](auto error, auto& params) {
+            result.called = true;
+            result.error = error;
+            result.params = params;
+        });
+        result.ok = rc.isOk();
+        if (!result.ok) result.description = rc.description();
+        return result;
+    });
+
     std::vector<HmacSharingParameters> params_vec;
     params_vec.reserve(keymasters.size());
-    for (auto& keymaster : keymasters) {
-        if (keymaster->halVersion().majorVersion < 4) continue;
-        auto rc = keymaster->getHmacSharingParameters([&](auto error, auto& params) {
-            CHECK(error == V4_0::ErrorCode::OK)
-                    << "Failed to get HMAC parameters from " << *keymaster << " error " << error;
-            params_vec.push_back(params);
-        });
-        CHECK(rc.isOk()) << "Failed to communicate with " << *keymaster
-                         << " error: " << rc.description();
+    for (size_t i = 0; i < keymasters.size(); ++i) {
+        auto& keymaster = keymasters[i];
+        auto& result = results[i];
+        if (result.called) {
+            CHECK(result.error == V4_0::ErrorCode::OK)
+                    << "Failed to get HMAC parameters from " << *keymaster << " error "
+                    << result.error;
+            params_vec.push_back(std::move(result.params));
+        }
+        CHECK(result.ok) << "Failed to communicate with " << *keymaster
+                         << " error: " << result.description;
     }
     std::sort(params_vec.begin(), params_vec.end());
 
@@ -161,35 +252,64 @@ static hidl_vec<HmacSharingParameters> getHmacParameters(
 }
 
 static void computeHmac(const Keymaster::KeymasterSet& keymasters,
+                        const std::vector<std::string>& labels,
                         const hidl_vec<HmacSharingParameters>& params) {
     if (!params.size()) return;
 
-    hidl_vec<uint8_t> sharingCheck;
-    bool firstKeymaster = true;
+    struct Result {
+        bool called = false;
+        V4_0::ErrorCode error;
+        hidl_vec<uint8_t> sharingCheck;
+        bool ok;
+        std::string description;
+    };
     LOG(DEBUG) << "Computing HMAC with params " << params;
-    for (auto& keymaster : keymasters) {
-        if (keymaster->halVersion().majorVersion < 4) continue;
-        LOG(DEBUG) << "Computing HMAC for " << *keymaster;
-        auto rc = keymaster->computeSharedHmac(
+    auto results = runConcurrently("computeSharedHmac", labels, [&](size_t i) {
+        Result result;
+        auto rc = keymasters[i]->computeSharedHmac(
                 params, [&](V4_0::ErrorCode error, const hidl_vec<uint8_t>& curSharingCheck) {
-                    CHECK(error == V4_0::ErrorCode::OK) << "Failed to get HMAC parameters from "
-                                                        << *keymaster << " error " << error;
-                    if (firstKeymaster) {
-                        sharingCheck = curSharingCheck;
-                        firstKeymaster = false;
-                    }
-                    if (curSharingCheck != sharingCheck)
-                        LOG(WARNING) << "HMAC computation failed for " << *keymaster  //
-                                     << " Expected: " << sharingCheck                 //
-                                     << " got: " << curSharingCheck;
+                    result.called = true;
+                    result.error = error;
+                    result.sharingCheck = curSharingCheck;
                 });
-        CHECK(rc.isOk()) << "Failed to communicate with " << *keymaster
-                         << " error: " << rc.description();
+        result.ok = rc.isOk();
+        if (!result.ok) result.description = rc.description();
+        return result;
+    });
+
+    // Check the results in the order of |keymasters|, the first one is the reference.
+    hidl_vec<uint8_t> sharingCheck;
+    bool firstKeymaster = true;
+    for (size_t i = 0; i < keymasters.size(); ++i) {
+        auto& keymaster = keymasters[i];
+        auto& result = results[i];
+        if (result.called) {
+            CHECK(result.error == V4_0::ErrorCode::OK)
+                    << "Failed to get HMAC parameters from " << *keymaster << " error "
+                    << result.error;
+            if (firstKeymaster) {
+                sharingCheck = result.sharingCheck;
+                firstKeymaster = false;
+            }
+            if (result.sharingCheck != sharingCheck)
+                LOG(WARNING) << "HMAC computation failed for " << *keymaster  //
+                             << " Expected: " << sharingCheck                 //
+                             << " got: " << result.sharingCheck;
+        }
+        CHECK(result.ok) << "Failed to communicate with " << *keymaster
+                         << " error: " << result.description;
     }
 }
 
 void Keymaster::performHmacKeyAgreement(const KeymasterSet& keymasters) {
-    computeHmac(keymasters, getHmacParameters(keymasters));
+    // Only Keymaster 4 and later take part in the agreement. Each round talks to all of them at
+    // once, StrongBox and TEE are typically slow for different reasons.
+    KeymasterSet km4s;
+    for (auto& keymaster : keymasters) {
+        if (keymaster->halVersion().majorVersion >= 4) km4s.push_back(keymaster);
+    }
+    auto labels = labelsOf(km4s);
+    computeHmac(km4s, labels, getHmacParameters(km4s, labels));
 }
 
 }  // namespace V4_1::support
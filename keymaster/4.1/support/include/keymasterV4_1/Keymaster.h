@@ -77,7 +77,7 @@ class Keymaster : public IKeymasterDevice {
 
     /**
      * Returns all available Keymaster3 and Keymaster4 instances, in order of most secure to least
-     * secure (as defined by VersionResult::operator<).
+     * secure (as defined by VersionResult::operator<).  The instances are looked up concurrently.
      */
     static KeymasterSet enumerateAvailableDevices();
 
@@ -87,6 +87,9 @@ class Keymaster : public IKeymasterDevice {
      * as the same set of Keymaster instances is used each time (and if all of the instances work
      * correctly).  It must be performed once per boot, but should do no harm to be repeated.
      *
+     * Both rounds of the agreement talk to all instances concurrently.  How long each instance
+     * took is logged, and instances which take longer than a couple of seconds are reported.
+     *
      * If key agreement fails, this method will crash the process (with CHECK).
      */
     static void performHmacKeyAgreement(const KeymasterSet& keymasters);
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <keymasterV4_1/Keymaster.h>
+#include <keymasterV4_1/Keymaster4.h>
+#include <keymasterV4_1/keymaster_tags.h>
+
+namespace android::hardware::keymaster::V4_1::support {
+namespace {
+
+using ::android::hardware::hidl_vec;
+using ::android::hardware::Return;
+using ::android::hardware::Void;
+using ::std::chrono::milliseconds;
+using ::std::chrono::steady_clock;
+using V4_0::ErrorCode;
+using V4_0::HmacSharingParameters;
+
+// Number of fake calls in flight, across all devices.
+std::atomic<int> gCallsInFlight;
+std::atomic<int> gMaxCallsInFlight;
+
+class CallScope {
+  public:
+    explicit CallScope(milliseconds latency) {
+        int inFlight = ++gCallsInFlight;
+        int max = gMaxCallsInFlight;
+        while (inFlight > max && !gMaxCallsInFlight.compare_exchange_weak(max, inFlight)) {
+        }
+        std::this_thread::sleep_for(latency);
+    }
+    ~CallScope() { --gCallsInFlight; }
+};
+
+/**
+ * A Keymaster 4.0 device which takes |latency| to answer either round of HMAC key agreement and
+ * records what it was asked to compute the shared HMAC key from.
+ */
+class FakeKeymasterDevice : public V4_0::IKeymasterDevice {
+  public:
+    FakeKeymasterDevice(SecurityLevel securityLevel, uint8_t nonce, milliseconds latency)
+        : securityLevel_(securityLevel), latency_(latency) {
+        params_.seed = hidl_vec<uint8_t>{};
+        std::fill(params_.nonce.data(), params_.nonce.data() + params_.nonce.size(), nonce);
+    }
+
+    const HmacSharingParameters& params() const { return params_; }
+
+    hidl_vec<HmacSharingParameters> receivedParams() const {
+        std::lock_guard<std::mutex> lock(lock_);
+        return receivedParams_;
+    }
+
+    Return<void> getHardwareInfo(getHardwareInfo_cb _hidl_cb) override {
+        _hidl_cb(securityLevel_, "FakeKeymasterDevice", "Google");
+        return Void();
+    }
+
+    Return<void> getHmacSharingParameters(getHmacSharingParameters_cb _hidl_cb) override {
+        CallScope scope(latency_);
+        _hidl_cb(ErrorCode::OK, params_);
+        return Void();
+    }
+
+    Return<void> computeSharedHmac(const hidl_vec<HmacSharingParameters>& params,
+                                   computeSharedHmac_cb _hidl_cb) override {
+        CallScope scope(latency_);
+        {
+            std::lock_guard<std::mutex> lock(lock_);
+            receivedParams_ = params;
+        }
+        // Every device that got the same parameters comes up with the same sharing check.
+        hidl_vec<uint8_t> sharingCheck(params.size());
+        for (size_t i = 0; i < params.size(); ++i) sharingCheck[i] = params[i].nonce[0];
+        _hidl_cb(ErrorCode::OK, sharingCheck);
+        return Void();
+    }
+
+    // Nothing else is used by key agreement.
+    Return<void> verifyAuthorization(uint64_t, const hidl_vec<KeyParameter>&,
+                                     const HardwareAuthToken&, verifyAuthorization_cb) override {
+        return Void();
+    }
+    Return<ErrorCode> addRngEntropy(const hidl_vec<uint8_t>&) override {
+        return ErrorCode::UNIMPLEMENTED;
+    }
+    Return<void> generateKey(const hidl_vec<KeyParameter>&, generateKey_cb) override {
+        return Void();
+    }
+    Return<void> importKey(const hidl_vec<KeyParameter>&, KeyFormat, const hidl_vec<uint8_t>&,
+                           importKey_cb) override {
+        return Void();
+    }
+    Return<void> importWrappedKey(const hidl_vec<uint8_t>&, const hidl_vec<uint8_t>&,
+                                  const hidl_vec<uint8_t>&, const hidl_vec<KeyParameter>&,
+                                  uint64_t, uint64_t, importWrappedKey_cb) override {
+        return Void();
+    }
+    Return<void> getKeyCharacteristics(const hidl_vec<uint8_t>&, const hidl_vec<uint8_t>&,
+                                       const hidl_vec<uint8_t>&,
+                                       getKeyCharacteristics_cb) override {
+        return Void();
+    }
+    Return<void> exportKey(KeyFormat, const hidl_vec<uint8_t>&, const hidl_vec<uint8_t>&,
+                           const hidl_vec<uint8_t>&, exportKey_cb) override {
+        return Void();
+    }
+    Return<void> attestKey(const hidl_vec<uint8_t>&, const hidl_vec<KeyParameter>&,
+                           attestKey_cb) override {
+        return Void();
+    }
+    Return<void> upgradeKey(const hidl_vec<uint8_t>&, const hidl_vec<KeyParameter>&,
+                            upgradeKey_cb) override {
+        return Void();
+    }
+    Return<ErrorCode> deleteKey(const hidl_vec<uint8_t>&) override {
+        return ErrorCode::UNIMPLEMENTED;
+    }
+    Return<ErrorCode> deleteAllKeys() override { return ErrorCode::UNIMPLEMENTED; }
+    Return<ErrorCode> destroyAttestationIds() override { return ErrorCode::UNIMPLEMENTED; }
+    Return<void> begin(KeyPurpose, const hidl_vec<uint8_t>&, const hidl_vec<KeyParameter>&,
+                       const HardwareAuthToken&, begin_cb) override {
+        return Void();
+    }
+    Return<void> update(uint64_t, const hidl_vec<KeyParameter>&, const hidl_vec<uint8_t>&,
+                        const HardwareAuthToken&, const VerificationToken&, update_cb) override {
+        return Void();
+    }
+    Return<void> finish(uint64_t, const hidl_vec<KeyParameter>&, const hidl_vec<uint8_t>&,
+                        const hidl_vec<uint8_t>&, const HardwareAuthToken&,
+                        const VerificationToken&, finish_cb) override {
+        return Void();
+    }
+    Return<ErrorCode> abort(uint64_t) override { return ErrorCode::UNIMPLEMENTED; }
+
+  private:
+    const SecurityLevel securityLevel_;
+    const milliseconds latency_;
+    HmacSharingParameters params_;
+
+    mutable std::mutex lock_;
+    hidl_vec<HmacSharingParameters> receivedParams_;
+};
+
+class HmacKeyAgreementTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        gCallsInFlight = 0;
+        gMaxCallsInFlight = 0;
+    }
+
+    sp<FakeKeymasterDevice> addDevice(SecurityLevel securityLevel, uint8_t nonce,
+                                      milliseconds latency) {
+        sp<FakeKeymasterDevice> device = new FakeKeymasterDevice(securityLevel, nonce, latency);
+        keymasters_.push_back(new Keymaster4(device, "fake" + std::to_string(nonce)));
+        return device;
+    }
+
+    Keymaster::KeymasterSet keymasters_;
+};
+
+TEST_F(HmacKeyAgreementTest, AllDevicesGetSortedParameters) {
+    // Added in the order of enumerateAvailableDevices(), with parameters that sort the other way.
+    auto strongBox = addDevice(SecurityLevel::STRONGBOX, 2, milliseconds(20));
+    auto tee = addDevice(SecurityLevel::TRUSTED_ENVIRONMENT, 1, milliseconds(0));
+
+    Keymaster::performHmacKeyAgreement(keymasters_);
+
+    auto received = strongBox->receivedParams();
+    ASSERT_EQ(2U, received.size());
+    EXPECT_EQ(tee->params(), received[0]);
+    EXPECT_EQ(strongBox->params(), received[1]);
+    EXPECT_EQ(received, tee->receivedParams());
+}
+
+TEST_F(HmacKeyAgreementTest, DevicesAreAskedConcurrently) {
+    constexpr milliseconds kLatency(300);
+    constexpr size_t kNumDevices = 3;
+    std::vector<sp<FakeKeymasterDevice>> devices;
+    for (size_t i = 0; i < kNumDevices; ++i) {
+        devices.push_back(addDevice(SecurityLevel::TRUSTED_ENVIRONMENT, i, kLatency));
+    }
+
+    auto start = steady_clock::now();
+    Keymaster::performHmacKeyAgreement(keymasters_);
+    auto elapsed = steady_clock::now() - start;
+
+    // Two rounds, which would take kNumDevices times as long one device after the other.
+    EXPECT_LT(elapsed, 2 * kLatency * 2);
+    EXPECT_EQ(int(kNumDevices), gMaxCallsInFlight.load());
+    for (auto& device : devices) {
+        EXPECT_EQ(kNumDevices, device->receivedParams().size());
+    }
+}
+
+TEST_F(HmacKeyAgreementTest, NoDevices) {
+    Keymaster::performHmacKeyAgreement(keymasters_);
+    EXPECT_EQ(0, gMaxCallsInFlight.load());
+}
+
+}  // namespace
+}  // namespace android::hardware::keymaster::V4_1::support
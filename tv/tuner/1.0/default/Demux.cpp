@@ -17,7 +17,9 @@
 #define LOG_TAG "android.hardware.tv.tuner@1.0-Demux"
 
 #include "Demux.h"
+#include <stdio.h>
 #include <utils/Log.h>
+#include <algorithm>
 
 namespace android {
 namespace hardware {
@@ -28,6 +30,10 @@ namespace implementation {
 
 #define WAIT_TIMEOUT 3000000000
 
+static uint16_t getTsPid(const uint8_t* packet) {
+    return ((packet[1] & 0x1f) << 8) | (packet[2] & 0xff);
+}
+
 Demux::Demux(uint32_t demuxId, sp<Tuner> tuner) {
     mDemuxId = demuxId;
     mTunerService = tuner;
@@ -73,17 +79,20 @@ Return<void> Demux::openFilter(const DemuxFilterType& type, uint32_t bufferSize,
         return Void();
     }
 
-    mFilters[filterId] = filter;
-    if (filter->isPcrFilter()) {
-        mPcrFilterIds.insert(filterId);
-    }
     bool result = true;
-    if (!filter->isRecordFilter()) {
-        // Only save non-record filters for now. Record filters are saved when the
-        // IDvr.attacheFilter is called.
-        mPlaybackFilterIds.insert(filterId);
-        if (mDvrPlayback != nullptr) {
-            result = mDvrPlayback->addPlaybackFilter(filterId, filter);
+    {
+        std::lock_guard<std::mutex> lock(mFilterIdsLock);
+        mFilters[filterId] = filter;
+        if (filter->isPcrFilter()) {
+            mPcrFilterIds.insert(filterId);
+        }
+        if (!filter->isRecordFilter()) {
+            // Only save non-record filters for now. Record filters are saved when the
+            // IDvr.attacheFilter is called.
+            mPlaybackFilterIds.insert(filterId);
+            if (mDvrPlayback != nullptr) {
+                result = mDvrPlayback->addPlaybackFilter(filterId, filter);
+            }
         }
     }
 
@@ -155,14 +164,25 @@ Return<void> Demux::getAvSyncTime(AvSyncHwId avSyncHwId, getAvSyncTime_cb _hidl_
 Return<Result> Demux::close() {
     ALOGV("%s", __FUNCTION__);
 
-    set<uint32_t>::iterator it;
-    for (it = mPlaybackFilterIds.begin(); it != mPlaybackFilterIds.end(); it++) {
-        mDvrPlayback->removePlaybackFilter(*it);
+    {
+        std::lock_guard<std::mutex> lock(mFilterIdsLock);
+        set<uint32_t>::iterator it;
+        if (mDvrPlayback != nullptr) {
+            for (it = mPlaybackFilterIds.begin(); it != mPlaybackFilterIds.end(); it++) {
+                mDvrPlayback->removePlaybackFilter(*it);
+            }
+        }
+        mPlaybackFilterIds.clear();
+        mRecordFilterIds.clear();
+        mFilters.clear();
     }
-    mPlaybackFilterIds.clear();
-    mRecordFilterIds.clear();
-    mFilters.clear();
     mLastUsedFilterId = -1;
+    {
+        std::lock_guard<std::mutex> lock(mPidFilterLock);
+        for (auto& filters : mPidFilters) {
+            filters.clear();
+        }
+    }
 
     return Result::SUCCESS;
 }
@@ -178,23 +198,33 @@ Return<void> Demux::openDvr(DvrType type, uint32_t bufferSize, const sp<IDvrCall
     }
 
     set<uint32_t>::iterator it;
+    sp<Dvr> dvrPlayback;
+    bool added = true;
     switch (type) {
         case DvrType::PLAYBACK:
-            mDvrPlayback = new Dvr(type, bufferSize, cb, this);
-            if (!mDvrPlayback->createDvrMQ()) {
-                _hidl_cb(Result::UNKNOWN_ERROR, mDvrPlayback);
+            dvrPlayback = new Dvr(type, bufferSize, cb, this);
+            if (!dvrPlayback->createDvrMQ()) {
+                _hidl_cb(Result::UNKNOWN_ERROR, dvrPlayback);
                 return Void();
             }
 
-            for (it = mPlaybackFilterIds.begin(); it != mPlaybackFilterIds.end(); it++) {
-                if (!mDvrPlayback->addPlaybackFilter(*it, mFilters[*it])) {
-                    ALOGE("[Demux] Can't get filter info for DVR playback");
-                    _hidl_cb(Result::UNKNOWN_ERROR, mDvrPlayback);
-                    return Void();
+            {
+                std::lock_guard<std::mutex> lock(mFilterIdsLock);
+                mDvrPlayback = dvrPlayback;
+                for (it = mPlaybackFilterIds.begin(); it != mPlaybackFilterIds.end(); it++) {
+                    if (!mDvrPlayback->addPlaybackFilter(*it, mFilters[*it])) {
+                        added = false;
+                        break;
+                    }
                 }
             }
+            if (!added) {
+                ALOGE("[Demux] Can't get filter info for DVR playback");
+                _hidl_cb(Result::UNKNOWN_ERROR, dvrPlayback);
+                return Void();
+            }
 
-            _hidl_cb(Result::SUCCESS, mDvrPlayback);
+            _hidl_cb(Result::SUCCESS, dvrPlayback);
             return Void();
         case DvrType::RECORD:
             mDvrRecord = new Dvr(type, bufferSize, cb, this);
@@ -228,36 +258,101 @@ Return<Result> Demux::disconnectCiCam() {
 Result Demux::removeFilter(uint32_t filterId) {
     ALOGV("%s", __FUNCTION__);
 
-    if (mDvrPlayback != nullptr) {
-        mDvrPlayback->removePlaybackFilter(filterId);
+    uint16_t tpid = TS_PID_COUNT;
+    {
+        std::lock_guard<std::mutex> lock(mFilterIdsLock);
+        if (mDvrPlayback != nullptr) {
+            mDvrPlayback->removePlaybackFilter(filterId);
+        }
+        auto filter = mFilters.find(filterId);
+        if (filter != mFilters.end()) {
+            tpid = filter->second->getTpid();
+        }
+    }
+    // Takes the filter out of the PID dispatch table if it is a playback filter
+    updateFilterTpid(filterId, tpid, TS_PID_COUNT);
+    {
+        std::lock_guard<std::mutex> lock(mFilterIdsLock);
+        mPlaybackFilterIds.erase(filterId);
+        mRecordFilterIds.erase(filterId);
+        mFilters.erase(filterId);
     }
-    mPlaybackFilterIds.erase(filterId);
-    mRecordFilterIds.erase(filterId);
-    mFilters.erase(filterId);
 
     return Result::SUCCESS;
 }
 
-void Demux::startBroadcastTsFilter(vector<uint8_t> data) {
-    set<uint32_t>::iterator it;
-    uint16_t pid = ((data[1] & 0x1f) << 8) | ((data[2] & 0xff));
-    if (DEBUG_DEMUX) {
-        ALOGW("[Demux] start ts filter pid: %d", pid);
+void Demux::updateFilterTpid(uint32_t filterId, uint16_t oldTpid, uint16_t newTpid) {
+    sp<Filter> filter;
+    {
+        std::lock_guard<std::mutex> lock(mFilterIdsLock);
+        // Record filters get all the data
+        if (mPlaybackFilterIds.find(filterId) == mPlaybackFilterIds.end()) {
+            return;
+        }
+        filter = mFilters[filterId];
     }
-    for (it = mPlaybackFilterIds.begin(); it != mPlaybackFilterIds.end(); it++) {
-        if (pid == mFilters[*it]->getTpid()) {
-            mFilters[*it]->updateFilterOutput(data);
+
+    std::lock_guard<std::mutex> lock(mPidFilterLock);
+    if (oldTpid < TS_PID_COUNT) {
+        vector<sp<Filter>>& filters = mPidFilters[oldTpid];
+        filters.erase(std::remove(filters.begin(), filters.end(), filter), filters.end());
+    }
+    if (newTpid < TS_PID_COUNT) {
+        mPidFilters[newTpid].push_back(filter);
+    }
+}
+
+void Demux::startBroadcastTsFilter(const vector<iovec>& regions, uint32_t packetSize) {
+    std::lock_guard<std::mutex> lock(mPidFilterLock);
+    for (const iovec& region : regions) {
+        const uint8_t* data = static_cast<const uint8_t*>(region.iov_base);
+        for (size_t offset = 0; offset + packetSize <= region.iov_len; offset += packetSize) {
+            uint16_t pid = getTsPid(data + offset);
+            if (DEBUG_DEMUX) {
+                ALOGW("[Demux] start ts filter pid: %d", pid);
+            }
+            for (const sp<Filter>& filter : mPidFilters[pid]) {
+                if (filter->queueFilterOutput(data + offset, packetSize)) {
+                    mQueuedFilters.push_back(filter.get());
+                }
+            }
         }
     }
+
+    // Copy the queued data out before the regions go away
+    for (Filter* filter : mQueuedFilters) {
+        filter->commitFilterOutput();
+    }
+    mQueuedFilters.clear();
 }
 
-void Demux::sendFrontendInputToRecord(vector<uint8_t> data) {
+void Demux::sendFrontendInputToRecord(const vector<iovec>& regions) {
     set<uint32_t>::iterator it;
     if (DEBUG_DEMUX) {
         ALOGW("[Demux] update record filter output");
     }
     for (it = mRecordFilterIds.begin(); it != mRecordFilterIds.end(); it++) {
-        mFilters[*it]->updateRecordOutput(data);
+        for (const iovec& region : regions) {
+            mFilters[*it]->updateRecordOutput(static_cast<const uint8_t*>(region.iov_base),
+                                              region.iov_len);
+        }
+    }
+}
+
+void Demux::dump(int fd) {
+    size_t playbackFilters;
+    size_t recordFilters;
+    sp<Dvr> dvrPlayback;
+    {
+        std::lock_guard<std::mutex> lock(mFilterIdsLock);
+        playbackFilters = mPlaybackFilterIds.size();
+        recordFilters = mRecordFilterIds.size();
+        dvrPlayback = mDvrPlayback;
+    }
+    dprintf(fd, "Demux %u: %zu playback filters, %zu record filters\n", mDemuxId,
+            playbackFilters, recordFilters);
+    if (dvrPlayback != nullptr) {
+        dvrPlayback->dump(fd);
     }
 }
 
@@ -290,14 +385,6 @@ Result Demux::startFilterHandler(uint32_t filterId) {
     return mFilters[filterId]->startFilterHandler();
 }
 
-void Demux::updateFilterOutput(uint16_t filterId, vector<uint8_t> data) {
-    mFilters[filterId]->updateFilterOutput(data);
-}
-
-uint16_t Demux::getFilterTpid(uint32_t filterId) {
-    return mFilters[filterId]->getTpid();
-}
-
 void Demux::startFrontendInputLoop() {
     pthread_create(&mFrontendInputThread, NULL, __threadLoopFrontend, this);
     pthread_setname_np(mFrontendInputThread, "frontend_input_thread");
@@ -347,6 +434,7 @@ void Demux::setIsRecording(bool isRecording) {
 }
 
 bool Demux::attachRecordFilter(int filterId) {
+    std::lock_guard<std::mutex> lock(mFilterIdsLock);
     if (mFilters[filterId] == nullptr || mDvrRecord == nullptr ||
         !mFilters[filterId]->isRecordFilter()) {
         return false;
@@ -359,6 +447,7 @@ bool Demux::attachRecordFilter(int filterId) {
 }
 
 bool Demux::detachRecordFilter(int filterId) {
+    std::lock_guard<std::mutex> lock(mFilterIdsLock);
     if (mFilters[filterId] == nullptr || mDvrRecord == nullptr) {
         return false;
     }
@@ -20,6 +20,8 @@
 #include <android/hardware/tv/tuner/1.0/IDemux.h>
 #include <fmq/MessageQueue.h>
 #include <math.h>
+#include <sys/uio.h>
+#include <array>
 #include <set>
 #include "Dvr.h"
 #include "Filter.h"
@@ -86,8 +88,10 @@ class Demux : public IDemux {
     bool attachRecordFilter(int filterId);
     bool detachRecordFilter(int filterId);
     Result startFilterHandler(uint32_t filterId);
-    void updateFilterOutput(uint16_t filterId, vector<uint8_t> data);
-    uint16_t getFilterTpid(uint32_t filterId);
+    /**
+     * Moves a playback filter to the dispatch list of the TS PID it is configured with.
+     */
+    void updateFilterTpid(uint32_t filterId, uint16_t oldTpid, uint16_t newTpid);
     void setIsRecording(bool isRecording);
     void startFrontendInputLoop();
 
@@ -97,11 +101,19 @@ class Demux : public IDemux {
      * Note that recording filters are not included.
      */
     bool startBroadcastFilterDispatcher();
-    void startBroadcastTsFilter(vector<uint8_t> data);
+    /**
+     * Hands the TS packets in |regions| to the playback filters of their PIDs. The length of
+     * each region is a multiple of |packetSize|. The regions are only used until this returns.
+     */
+    void startBroadcastTsFilter(const vector<iovec>& regions, uint32_t packetSize);
 
-    void sendFrontendInputToRecord(vector<uint8_t> data);
+    void sendFrontendInputToRecord(const vector<iovec>& regions);
     bool startRecordFilterDispatcher();
 
+    void dump(int fd);
+
+    static const uint32_t TS_PID_COUNT = 8192;
+
   private:
     // Tuner service
     sp<Tuner> mTunerService;
@@ -151,6 +163,13 @@ class Demux : public IDemux {
      * The array number is the filter ID.
      */
     std::map<uint32_t, sp<Filter>> mFilters;
+    /**
+     * The configured playback filters of each TS PID, so that dispatching a packet does not
+     * have to look at every filter.
+     */
+    std::array<vector<sp<Filter>>, TS_PID_COUNT> mPidFilters;
+    // The filters that got data in the batch being dispatched
+    vector<Filter*> mQueuedFilters;
 
     /**
      * Local reference to the opened Timer Filter instance.
@@ -182,6 +201,15 @@ class Demux : public IDemux {
      * Lock to protect writes to the input status
      */
     std::mutex mFrontendInputThreadLock;
+    /**
+     * Lock to protect the PID dispatch table
+     */
+    std::mutex mPidFilterLock;
+    /**
+     * Lock to protect changes to mFilters, the filter id sets and mDvrPlayback from the
+     * binder threads, so that dump() can read them. Not held together with mPidFilterLock.
+     */
+    std::mutex mFilterIdsLock;
 
     // temp handle single PES filter
     // TODO handle mulptiple Pes filters
@@ -17,6 +17,9 @@
 #define LOG_TAG "android.hardware.tv.tuner@1.0-Dvr"
 
 #include "Dvr.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
 #include <utils/Log.h>
 
 namespace android {
@@ -239,41 +242,81 @@ PlaybackStatus Dvr::checkPlaybackStatusChange(uint32_t availableToWrite, uint32_
 }
 
 bool Dvr::readPlaybackFMQ(bool isVirtualFrontend, bool isRecording) {
-    // Read playback data from the input FMQ
-    int size = mDvrMQ->availableToRead();
-    int playbackPacketSize = mDvrSettings.playback().packetSize;
-    vector<uint8_t> dataOutputBuffer;
-    dataOutputBuffer.resize(playbackPacketSize);
-    // Dispatch the packet to the PID matching filter output buffer
-    for (int i = 0; i < size / playbackPacketSize; i++) {
-        if (!mDvrMQ->read(dataOutputBuffer.data(), playbackPacketSize)) {
-            return false;
-        }
-        if (isVirtualFrontend) {
-            if (isRecording) {
-                mDemux->sendFrontendInputToRecord(dataOutputBuffer);
-            } else {
-                mDemux->startBroadcastTsFilter(dataOutputBuffer);
-            }
-        } else {
-            startTpidFilter(dataOutputBuffer);
-        }
+    uint32_t playbackPacketSize = mDvrSettings.playback().packetSize;
+    if (playbackPacketSize == 0) {
+        ALOGE("[Dvr] playback packet size is not configured");
+        return false;
+    }
+    // Demux all the complete packets in the input FMQ in place
+    size_t size = mDvrMQ->availableToRead() / playbackPacketSize * playbackPacketSize;
+    if (size == 0) {
+        return true;
+    }
+    auto start = std::chrono::steady_clock::now();
+    DvrMQ::MemTransaction transaction;
+    if (!mDvrMQ->beginRead(size, &transaction)) {
+        return false;
+    }
+    if (DEBUG_DVR) {
+        ALOGW("[Dvr] read %zu bytes of playback data", size);
     }
 
+    // The data wraps around the end of the FMQ into the second region
+    const auto& first = transaction.getFirstRegion();
+    const auto& second = transaction.getSecondRegion();
+    size_t firstPackets = first.getLength() / playbackPacketSize * playbackPacketSize;
+    size_t splitSize = first.getLength() - firstPackets;
+    size_t secondOffset = splitSize > 0 ? playbackPacketSize - splitSize : 0;
+    mPlaybackRegions.clear();
+    if (firstPackets > 0) {
+        mPlaybackRegions.push_back({first.getAddress(), firstPackets});
+    }
+    if (splitSize > 0) {
+        mSplitPacket.resize(playbackPacketSize);
+        memcpy(mSplitPacket.data(), first.getAddress() + firstPackets, splitSize);
+        memcpy(mSplitPacket.data() + splitSize, second.getAddress(), secondOffset);
+        mPlaybackRegions.push_back({mSplitPacket.data(), playbackPacketSize});
+    }
+    if (second.getLength() > secondOffset) {
+        mPlaybackRegions.push_back(
+                {second.getAddress() + secondOffset, second.getLength() - secondOffset});
+    }
+
+    // Dispatch the packets to the PID matching filter output buffers
+    if (isVirtualFrontend && isRecording) {
+        mDemux->sendFrontendInputToRecord(mPlaybackRegions);
+    } else {
+        mDemux->startBroadcastTsFilter(mPlaybackRegions, playbackPacketSize);
+    }
+    if (!mDvrMQ->commitRead(size)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mIngestStatsLock);
+    if (mIngestStats.reads == 0) {
+        mIngestStats.firstRead = start;
+    }
+    mIngestStats.bytes += size;
+    mIngestStats.reads++;
+    mIngestStats.busyTime += std::chrono::steady_clock::now() - start;
     return true;
 }
 
-void Dvr::startTpidFilter(vector<uint8_t> data) {
-    std::map<uint32_t, sp<IFilter>>::iterator it;
-    for (it = mFilters.begin(); it != mFilters.end(); it++) {
-        uint16_t pid = ((data[1] & 0x1f) << 8) | ((data[2] & 0xff));
-        if (DEBUG_DVR) {
-            ALOGW("[Dvr] start ts filter pid: %d", pid);
-        }
-        if (pid == mDemux->getFilterTpid(it->first)) {
-            mDemux->updateFilterOutput(it->first, data);
-        }
+void Dvr::dump(int fd) {
+    std::lock_guard<std::mutex> lock(mIngestStatsLock);
+    if (mIngestStats.reads == 0) {
+        dprintf(fd, "  Playback: no data yet\n");
+        return;
     }
+    double megabytes = mIngestStats.bytes / 1e6;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                   mIngestStats.firstRead)
+                             .count();
+    double busySeconds = std::chrono::duration<double>(mIngestStats.busyTime).count();
+    dprintf(fd,
+            "  Playback: %.1f MB in %" PRIu64 " reads, %.2f MB/s since the first read, "
+            "%.2f MB/s while ingesting\n",
+            megabytes, mIngestStats.reads, megabytes / seconds, megabytes / busySeconds);
 }
 
 bool Dvr::startFilterDispatcher(bool isVirtualFrontend, bool isRecording) {
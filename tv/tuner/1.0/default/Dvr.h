@@ -20,6 +20,8 @@
 #include <android/hardware/tv/tuner/1.0/IDvr.h>
 #include <fmq/MessageQueue.h>
 #include <math.h>
+#include <sys/uio.h>
+#include <chrono>
 #include <set>
 #include "Demux.h"
 #include "Frontend.h"
@@ -86,6 +88,7 @@ class Dvr : public IDvr {
     bool readPlaybackFMQ(bool isVirtualFrontend, bool isRecording);
     bool startFilterDispatcher(bool isVirtualFrontend, bool isRecording);
     EventFlag* getDvrEventFlag();
+    void dump(int fd);
 
   private:
     // Demux service
@@ -104,11 +107,6 @@ class Dvr : public IDvr {
                                              uint32_t highThreshold, uint32_t lowThreshold);
     RecordStatus checkRecordStatusChange(uint32_t availableToWrite, uint32_t availableToRead,
                                          uint32_t highThreshold, uint32_t lowThreshold);
-    /**
-     * A dispatcher to read and dispatch input data to all the started filters.
-     * Each filter handler handles the data filtering/output writing/filterEvent updating.
-     */
-    void startTpidFilter(vector<uint8_t> data);
     static void* __threadLoopPlayback(void* user);
     static void* __threadLoopRecord(void* user);
     void playbackThreadLoop();
@@ -116,6 +114,12 @@ class Dvr : public IDvr {
 
     unique_ptr<DvrMQ> mDvrMQ;
     EventFlag* mDvrEventFlag;
+    /**
+     * The parts of the playback FMQ being demuxed in place. Only a packet wrapping around the
+     * end of the FMQ is copied, into mSplitPacket.
+     */
+    vector<iovec> mPlaybackRegions;
+    vector<uint8_t> mSplitPacket;
     /**
      * Demux callbacks used on filter events or IO buffer status
      */
@@ -144,6 +148,18 @@ class Dvr : public IDvr {
     std::mutex mRecordStatusLock;
     std::mutex mDvrThreadLock;
 
+    /**
+     * Playback input statistics for the debug dump
+     */
+    struct IngestStats {
+        uint64_t bytes = 0;
+        uint64_t reads = 0;
+        std::chrono::steady_clock::duration busyTime{0};
+        std::chrono::steady_clock::time_point firstRead;
+    };
+    IngestStats mIngestStats;
+    std::mutex mIngestStatsLock;
+
     const bool DEBUG_DVR = false;
 
     // Booleans to check if recording is running.
@@ -104,6 +104,7 @@ Return<Result> Filter::configure(const DemuxFilterSettings& settings) {
     mFilterSettings = settings;
     switch (mType.mainType) {
         case DemuxFilterMainType::TS:
+            mDemux->updateFilterTpid(mFilterId, mTpid, settings.ts().tpid);
             mTpid = settings.ts().tpid;
             break;
         case DemuxFilterMainType::MMTP:
@@ -147,6 +148,10 @@ Return<Result> Filter::flush() {
     delete[] buffer;
     mFilterStatus = DemuxFilterStatus::DATA_READY;
 
+    // Drop the demuxed data that has not been handled yet
+    std::lock_guard<std::mutex> lock(mFilterOutputLock);
+    mFilterOutput.clear();
+
     return Result::SUCCESS;
 }
 
@@ -312,14 +317,39 @@ uint16_t Filter::getTpid() {
     return mTpid;
 }
 
-void Filter::updateFilterOutput(vector<uint8_t> data) {
+bool Filter::queueFilterOutput(const uint8_t* data, size_t size) {
+    if (mQueuedOutput.empty()) {
+        mQueuedOutput.push_back({const_cast<uint8_t*>(data), size});
+        return true;
+    }
+    // Consecutive packets of the same PID extend the last entry
+    iovec& last = mQueuedOutput.back();
+    if (static_cast<uint8_t*>(last.iov_base) + last.iov_len == data) {
+        last.iov_len += size;
+    } else {
+        mQueuedOutput.push_back({const_cast<uint8_t*>(data), size});
+    }
+    return false;
+}
+
+void Filter::commitFilterOutput() {
+    size_t size = 0;
+    for (const iovec& entry : mQueuedOutput) {
+        size += entry.iov_len;
+    }
+
     std::lock_guard<std::mutex> lock(mFilterOutputLock);
-    mFilterOutput.insert(mFilterOutput.end(), data.begin(), data.end());
+    mFilterOutput.reserve(mFilterOutput.size() + size);
+    for (const iovec& entry : mQueuedOutput) {
+        const uint8_t* data = static_cast<const uint8_t*>(entry.iov_base);
+        mFilterOutput.insert(mFilterOutput.end(), data, data + entry.iov_len);
+    }
+    mQueuedOutput.clear();
 }
 
-void Filter::updateRecordOutput(vector<uint8_t> data) {
+void Filter::updateRecordOutput(const uint8_t* data, size_t size) {
     std::lock_guard<std::mutex> lock(mRecordFilterOutputLock);
-    mRecordFilterOutput.insert(mRecordFilterOutput.end(), data.begin(), data.end());
+    mRecordFilterOutput.insert(mRecordFilterOutput.end(), data, data + size);
 }
 
 Result Filter::startFilterHandler() {
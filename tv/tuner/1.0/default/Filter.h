@@ -21,6 +21,7 @@
 #include <fmq/MessageQueue.h>
 #include <ion/ion.h>
 #include <math.h>
+#include <sys/uio.h>
 #include <set>
 #include "Demux.h"
 #include "Dvr.h"
@@ -82,8 +83,15 @@ class Filter : public IFilter {
      */
     bool createFilterMQ();
     uint16_t getTpid();
-    void updateFilterOutput(vector<uint8_t> data);
-    void updateRecordOutput(vector<uint8_t> data);
+    /**
+     * Queues demux input for the filter output without copying it. The data must stay valid
+     * until commitFilterOutput() appends everything queued.
+     *
+     * Return true if nothing was queued before.
+     */
+    bool queueFilterOutput(const uint8_t* data, size_t size);
+    void commitFilterOutput();
+    void updateRecordOutput(const uint8_t* data, size_t size);
     Result startFilterHandler();
     Result startRecordFilterHandler();
     void attachFilterToRecord(const sp<Dvr> dvr);
@@ -111,10 +119,16 @@ class Filter : public IFilter {
     bool mIsRecordFilter = false;
     DemuxFilterSettings mFilterSettings;
 
-    uint16_t mTpid;
+    // Out of the 13-bit PID range until configured
+    uint16_t mTpid = 0xFFFF;
     sp<IFilter> mDataSource;
     bool mIsDataSourceDemux = true;
     vector<uint8_t> mFilterOutput;
+    /**
+     * Demux input queued for mFilterOutput, as a scatter list. Only used on the demux input
+     * thread.
+     */
+    vector<iovec> mQueuedOutput;
     vector<uint8_t> mRecordFilterOutput;
     unique_ptr<FilterMQ> mFilterMQ;
     bool mIsUsingFMQ = false;
@@ -199,6 +213,8 @@ class Filter : public IFilter {
     std::map<uint64_t, int> mDataId2Avfd;
     uint64_t mLastUsedDataId = 1;
     int mAvBufferCopyCount = 0;
+
+    friend class FilterPeer;
 };
 
 }  // namespace implementation
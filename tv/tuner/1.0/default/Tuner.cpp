@@ -125,10 +125,15 @@ Return<void> Tuner::openFrontendById(uint32_t frontendId, openFrontendById_cb _h
 Return<void> Tuner::openDemux(openDemux_cb _hidl_cb) {
     ALOGV("%s", __FUNCTION__);
 
-    DemuxId demuxId = mLastUsedId + 1;
-    mLastUsedId += 1;
-    sp<Demux> demux = new Demux(demuxId, this);
-    mDemuxes[demuxId] = demux;
+    DemuxId demuxId;
+    sp<Demux> demux;
+    {
+        std::lock_guard<std::mutex> lock(mDemuxesLock);
+        demuxId = mLastUsedId + 1;
+        mLastUsedId += 1;
+        demux = new Demux(demuxId, this);
+        mDemuxes[demuxId] = demux;
+    }
 
     _hidl_cb(Result::SUCCESS, demuxId, demux);
     return Void();
@@ -229,10 +234,36 @@ Return<void> Tuner::openLnbByName(const hidl_string& /*lnbName*/, openLnbByName_
     return Void();
 }
 
+Return<void> Tuner::debug(const hidl_handle& fd, const hidl_vec<hidl_string>& /* options */) {
+    ALOGV("%s", __FUNCTION__);
+    if (fd == nullptr || fd->numFds == 0) {
+        ALOGE("%s: No fd to write to", __FUNCTION__);
+        return Void();
+    }
+
+    // Dump outside of the lock, the demuxes take their own locks
+    vector<sp<Demux>> demuxes;
+    {
+        std::lock_guard<std::mutex> lock(mDemuxesLock);
+        for (const auto& demux : mDemuxes) {
+            if (demux.second != nullptr) {
+                demuxes.push_back(demux.second);
+            }
+        }
+    }
+    for (const sp<Demux>& demux : demuxes) {
+        demux->dump(fd->data[0]);
+    }
+    return Void();
+}
+
 void Tuner::setFrontendAsDemuxSource(uint32_t frontendId, uint32_t demuxId) {
     mFrontendToDemux[frontendId] = demuxId;
     if (mFrontends[frontendId] != nullptr && mFrontends[frontendId]->isLocked()) {
-        mDemuxes[demuxId]->startFrontendInputLoop();
+        sp<Demux> demux = getDemux(demuxId);
+        if (demux != nullptr) {
+            demux->startFrontendInputLoop();
+        }
     }
 }
 
@@ -241,7 +272,10 @@ void Tuner::frontendStopTune(uint32_t frontendId) {
     uint32_t demuxId;
     if (it != mFrontendToDemux.end()) {
         demuxId = it->second;
-        mDemuxes[demuxId]->stopFrontendInput();
+        sp<Demux> demux = getDemux(demuxId);
+        if (demux != nullptr) {
+            demux->stopFrontendInput();
+        }
     }
 }
 
@@ -250,10 +284,19 @@ void Tuner::frontendStartTune(uint32_t frontendId) {
     uint32_t demuxId;
     if (it != mFrontendToDemux.end()) {
         demuxId = it->second;
-        mDemuxes[demuxId]->startFrontendInputLoop();
+        sp<Demux> demux = getDemux(demuxId);
+        if (demux != nullptr) {
+            demux->startFrontendInputLoop();
+        }
     }
 }
 
+sp<Demux> Tuner::getDemux(uint32_t demuxId) {
+    std::lock_guard<std::mutex> lock(mDemuxesLock);
+    auto it = mDemuxes.find(demuxId);
+    return it != mDemuxes.end() ? it->second : nullptr;
+}
+
 }  // namespace implementation
 }  // namespace V1_0
 }  // namespace tuner
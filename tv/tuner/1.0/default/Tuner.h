@@ -19,6 +19,7 @@
 
 #include <android/hardware/tv/tuner/1.0/ITuner.h>
 #include <map>
+#include <mutex>
 #include "Demux.h"
 #include "Frontend.h"
 #include "Lnb.h"
@@ -59,6 +60,9 @@ class Tuner : public ITuner {
     virtual Return<void> openLnbByName(const hidl_string& lnbName,
                                        openLnbByName_cb _hidl_cb) override;
 
+    virtual Return<void> debug(const hidl_handle& fd,
+                               const hidl_vec<hidl_string>& options) override;
+
     sp<Frontend> getFrontendById(uint32_t frontendId);
 
     void setFrontendAsDemuxSource(uint32_t frontendId, uint32_t demuxId);
@@ -68,6 +72,7 @@ class Tuner : public ITuner {
 
   private:
     virtual ~Tuner();
+    sp<Demux> getDemux(uint32_t demuxId);
     // Static mFrontends array to maintain local frontends information
     vector<sp<Frontend>> mFrontends;
     vector<FrontendInfo::FrontendCapabilities> mFrontendCaps;
@@ -78,6 +83,8 @@ class Tuner : public ITuner {
     // The last used demux id. Initial value is -1.
     // First used id will be 0.
     int mLastUsedId = -1;
+    // Lock to protect mDemuxes and mLastUsedId
+    std::mutex mDemuxesLock;
     vector<sp<Lnb>> mLnbs;
 };
 
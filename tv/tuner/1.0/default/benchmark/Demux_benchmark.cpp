@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "../Demux.h"
+
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+namespace V1_0 {
+namespace implementation {
+namespace {
+
+const uint32_t TS_PACKET_SIZE = 188;
+// About what the frontend input thread gets from one read of a 1MB playback FMQ
+const uint32_t PACKETS_PER_READ = 5000;
+const uint32_t FILTER_BUFFER_SIZE = 1024 * 1024;
+
+class FilterCallback : public IFilterCallback {
+  public:
+    virtual Return<void> onFilterEvent(const DemuxFilterEvent& /*filterEvent*/) override {
+        return Void();
+    }
+    virtual Return<void> onFilterStatus(const DemuxFilterStatus /*status*/) override {
+        return Void();
+    }
+};
+
+uint16_t getVideoPid(uint32_t program) {
+    return 0x100 + program * 0x10;
+}
+
+uint16_t getAudioPid(uint32_t program) {
+    return getVideoPid(program) + 1;
+}
+
+void appendPacket(vector<uint8_t>& stream, uint16_t pid) {
+    size_t offset = stream.size();
+    stream.resize(offset + TS_PACKET_SIZE, 0xff);
+    stream[offset] = 0x47;
+    stream[offset + 1] = (pid >> 8) & 0x1f;
+    stream[offset + 2] = pid & 0xff;
+    stream[offset + 3] = 0x10;
+}
+
+/**
+ * A multi-program transport stream: runs of video packets and single audio packets of every
+ * program in turn, with the PAT, the PMTs and some stuffing in between.
+ */
+vector<uint8_t> makeTransportStream(uint32_t programs) {
+    vector<uint8_t> stream;
+    stream.reserve(PACKETS_PER_READ * TS_PACKET_SIZE);
+    uint32_t program = 0;
+    while (stream.size() < PACKETS_PER_READ * TS_PACKET_SIZE) {
+        size_t packets = stream.size() / TS_PACKET_SIZE;
+        if (packets % 500 == 0) {
+            appendPacket(stream, 0x0000);
+            appendPacket(stream, getVideoPid(program) - 1);
+        } else if (packets % 97 == 0) {
+            appendPacket(stream, 0x1fff);
+        }
+        for (int i = 0; i < 6; i++) {
+            appendPacket(stream, getVideoPid(program));
+        }
+        appendPacket(stream, getAudioPid(program));
+        program = (program + 1) % programs;
+    }
+    stream.resize(PACKETS_PER_READ * TS_PACKET_SIZE);
+    return stream;
+}
+
+sp<IFilter> openTsFilter(const sp<Demux>& demux, uint16_t tpid) {
+    DemuxFilterType type;
+    type.mainType = DemuxFilterMainType::TS;
+    type.subType.tsFilterType(DemuxTsFilterType::TS);
+
+    sp<IFilter> filter;
+    demux->openFilter(type, FILTER_BUFFER_SIZE, new FilterCallback(),
+                      [&](Result result, const sp<IFilter>& newFilter) {
+                          if (result == Result::SUCCESS) {
+                              filter = newFilter;
+                          }
+                      });
+    if (filter == nullptr) {
+        return nullptr;
+    }
+
+    DemuxFilterSettings settings;
+    settings.ts().tpid = tpid;
+    settings.ts().filterSettings.noinit({});
+    filter->configure(settings);
+    return filter;
+}
+
+// Dispatching one FMQ read worth of packets to audio and video filters of every program.
+void BM_BroadcastTsFilter(benchmark::State& state) {
+    const uint32_t programs = state.range(0);
+    sp<Demux> demux = new Demux(0 /*demuxId*/, nullptr);
+    vector<sp<IFilter>> filters;
+    for (uint32_t program = 0; program < programs; program++) {
+        filters.push_back(openTsFilter(demux, getVideoPid(program)));
+        filters.push_back(openTsFilter(demux, getAudioPid(program)));
+        if (filters[filters.size() - 2] == nullptr || filters.back() == nullptr) {
+            state.SkipWithError("Can't open filters");
+            return;
+        }
+    }
+    vector<uint8_t> stream = makeTransportStream(programs);
+    // The whole read as a single FMQ region
+    vector<iovec> regions = {{stream.data(), stream.size()}};
+
+    for (auto _ : state) {
+        demux->startBroadcastTsFilter(regions, TS_PACKET_SIZE);
+
+        state.PauseTiming();
+        for (const sp<IFilter>& filter : filters) {
+            filter->flush();
+        }
+        state.ResumeTiming();
+    }
+
+    state.counters["packets/s"] = benchmark::Counter(
+            static_cast<double>(state.iterations()) * PACKETS_PER_READ, benchmark::Counter::kIsRate);
+    state.SetBytesProcessed(state.iterations() * stream.size());
+    demux->close();
+}
+BENCHMARK(BM_BroadcastTsFilter)->Arg(1)->Arg(8)->Arg(32);
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "../Demux.h"
+#include "../Dvr.h"
+#include "../Filter.h"
+
+namespace android {
+namespace hardware {
+namespace tv {
+namespace tuner {
+namespace V1_0 {
+namespace implementation {
+
+// Gives the tests access to the data a filter got from the demux.
+class FilterPeer {
+  public:
+    static vector<uint8_t> filterOutput(const sp<IFilter>& filter) {
+        Filter* self = static_cast<Filter*>(filter.get());
+        std::lock_guard<std::mutex> lock(self->mFilterOutputLock);
+        return self->mFilterOutput;
+    }
+};
+
+namespace {
+
+const uint8_t TS_PACKET_SIZE = 188;
+const uint16_t PID_A = 0x100;
+const uint16_t PID_B = 0x101;
+const uint16_t PID_NULL = 0x1fff;
+// Five packets and part of a sixth, so that packets wrap around the end of the FMQ
+const uint32_t DVR_BUFFER_SIZE = 5 * TS_PACKET_SIZE + 100;
+const uint32_t FILTER_BUFFER_SIZE = 64 * 1024;
+
+class FilterCallback : public IFilterCallback {
+  public:
+    virtual Return<void> onFilterEvent(const DemuxFilterEvent& /*filterEvent*/) override {
+        return Void();
+    }
+    virtual Return<void> onFilterStatus(const DemuxFilterStatus /*status*/) override {
+        return Void();
+    }
+};
+
+class DvrCallback : public IDvrCallback {
+  public:
+    virtual Return<void> onRecordStatus(RecordStatus /*status*/) override { return Void(); }
+    virtual Return<void> onPlaybackStatus(PlaybackStatus /*status*/) override { return Void(); }
+};
+
+// A TS packet with a payload derived from |seed|, so that misplaced bytes show.
+vector<uint8_t> makePacket(uint16_t pid, uint8_t seed) {
+    vector<uint8_t> packet(TS_PACKET_SIZE);
+    packet[0] = 0x47;
+    packet[1] = (pid >> 8) & 0x1f;
+    packet[2] = pid & 0xff;
+    packet[3] = 0x10;
+    for (size_t i = 4; i < packet.size(); i++) {
+        packet[i] = static_cast<uint8_t>(seed * 31 + i);
+    }
+    return packet;
+}
+
+class DvrPlaybackTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        mDemux = new Demux(0 /*demuxId*/, nullptr);
+        mFilterA = openTsFilter(PID_A);
+        mFilterB = openTsFilter(PID_B);
+        ASSERT_NE(nullptr, mFilterA.get());
+        ASSERT_NE(nullptr, mFilterB.get());
+
+        mDemux->openDvr(DvrType::PLAYBACK, DVR_BUFFER_SIZE, new DvrCallback(),
+                        [&](Result result, const sp<IDvr>& dvr) {
+                            ASSERT_EQ(Result::SUCCESS, result);
+                            mDvr = static_cast<Dvr*>(dvr.get());
+                        });
+        ASSERT_NE(nullptr, mDvr.get());
+
+        PlaybackSettings playback{};
+        playback.packetSize = TS_PACKET_SIZE;
+        DvrSettings settings;
+        settings.playback(playback);
+        Result result = mDvr->configure(settings);
+        ASSERT_EQ(Result::SUCCESS, result);
+
+        // Write to the playback FMQ the way a client does
+        mDvr->getQueueDesc([&](Result result, const MQDescriptorSync<uint8_t>& desc) {
+            ASSERT_EQ(Result::SUCCESS, result);
+            mClientMQ = std::make_unique<DvrMQ>(desc);
+        });
+        ASSERT_TRUE(mClientMQ != nullptr && mClientMQ->isValid());
+    }
+
+    void TearDown() override {
+        if (mDemux != nullptr) {
+            mDemux->close();
+        }
+    }
+
+    sp<IFilter> openTsFilter(uint16_t tpid) {
+        DemuxFilterType type;
+        type.mainType = DemuxFilterMainType::TS;
+        type.subType.tsFilterType(DemuxTsFilterType::TS);
+
+        sp<IFilter> filter;
+        mDemux->openFilter(type, FILTER_BUFFER_SIZE, new FilterCallback(),
+                           [&](Result result, const sp<IFilter>& newFilter) {
+                               if (result == Result::SUCCESS) {
+                                   filter = newFilter;
+                               }
+                           });
+        if (filter == nullptr) {
+            return nullptr;
+        }
+
+        DemuxFilterSettings settings;
+        settings.ts().tpid = tpid;
+        settings.ts().filterSettings.noinit({});
+        filter->configure(settings);
+        return filter;
+    }
+
+    // Writes the packets to the FMQ and demuxes them, keeping what each filter should get.
+    void play(const vector<uint16_t>& pids) {
+        vector<uint8_t> data;
+        for (uint16_t pid : pids) {
+            vector<uint8_t> packet = makePacket(pid, mPacketCount++);
+            data.insert(data.end(), packet.begin(), packet.end());
+            if (pid == PID_A) {
+                mExpectedA.insert(mExpectedA.end(), packet.begin(), packet.end());
+            } else if (pid == PID_B) {
+                mExpectedB.insert(mExpectedB.end(), packet.begin(), packet.end());
+            }
+        }
+        ASSERT_TRUE(mClientMQ->write(data.data(), data.size()));
+        ASSERT_TRUE(mDvr->readPlaybackFMQ(false /*isVirtualFrontend*/, false /*isRecording*/));
+        EXPECT_EQ(0u, mClientMQ->availableToRead());
+    }
+
+    sp<Demux> mDemux;
+    sp<IFilter> mFilterA;
+    sp<IFilter> mFilterB;
+    sp<Dvr> mDvr;
+    std::unique_ptr<DvrMQ> mClientMQ;
+    uint8_t mPacketCount = 0;
+    vector<uint8_t> mExpectedA;
+    vector<uint8_t> mExpectedB;
+};
+
+TEST_F(DvrPlaybackTest, DemuxesContiguousPackets) {
+    play({PID_A, PID_B, PID_NULL});
+
+    EXPECT_EQ(mExpectedA, FilterPeer::filterOutput(mFilterA));
+    EXPECT_EQ(mExpectedB, FilterPeer::filterOutput(mFilterB));
+}
+
+TEST_F(DvrPlaybackTest, DemuxesPacketsWrappingAroundTheEndOfTheQueue) {
+    // Leaves 2 packets and 100 bytes of room before the end of the FMQ
+    play({PID_A, PID_B, PID_NULL});
+
+    // The first region holds 2 packets and the first 100 bytes of a PID_A packet, the second
+    // region the rest of it and a PID_B packet.
+    play({PID_A, PID_B, PID_A, PID_B});
+
+    EXPECT_EQ(3u * TS_PACKET_SIZE, mExpectedA.size());
+    EXPECT_EQ(mExpectedA, FilterPeer::filterOutput(mFilterA));
+    EXPECT_EQ(mExpectedB, FilterPeer::filterOutput(mFilterB));
+}
+
+TEST_F(DvrPlaybackTest, DemuxesPacketsSplitAtManyOffsets) {
+    // Each read moves the read position by 3 packets, which isn't a multiple of the FMQ size,
+    // so the offset at which the packet wrapping around the end is split keeps changing.
+    for (int i = 0; i < 2 * TS_PACKET_SIZE; i++) {
+        play({i % 2 ? PID_A : PID_B, PID_NULL, i % 3 ? PID_B : PID_A});
+        ASSERT_FALSE(HasFailure()) << "after " << i << " reads";
+    }
+
+    EXPECT_EQ(mExpectedA, FilterPeer::filterOutput(mFilterA));
+    EXPECT_EQ(mExpectedB, FilterPeer::filterOutput(mFilterB));
+}
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V1_0
+}  // namespace tuner
+}  // namespace tv
+}  // namespace hardware
+}  // namespace android
@@ -51,6 +51,7 @@ LOCAL_SRC_FILES := \
     hidl_struct_util.cpp \
     hidl_sync_util.cpp \
     ringbuffer.cpp \
+    ringbuffer_archiver.cpp \
     wifi.cpp \
     wifi_ap_iface.cpp \
     wifi_chip.cpp \
@@ -163,10 +164,12 @@ LOCAL_SRC_FILES := \
     tests/mock_wifi_iface_util.cpp \
     tests/mock_wifi_legacy_hal.cpp \
     tests/mock_wifi_mode_controller.cpp \
+    tests/ringbuffer_archiver_unit_tests.cpp \
     tests/ringbuffer_unit_tests.cpp \
     tests/wifi_nan_iface_unit_tests.cpp \
     tests/wifi_chip_unit_tests.cpp \
-    tests/wifi_iface_util_unit_tests.cpp
+    tests/wifi_iface_util_unit_tests.cpp \
+    tests/wifi_legacy_hal_unit_tests.cpp
 LOCAL_STATIC_LIBRARIES := \
     libgmock \
     libgtest \
@@ -186,3 +189,31 @@ LOCAL_SHARED_LIBRARIES := \
     libwifi-hal \
     libwifi-system-iface
 include $(BUILD_NATIVE_TEST)
+
+###
+### android.hardware.wifi benchmarks.
+###
+include $(CLEAR_VARS)
+LOCAL_MODULE := android.hardware.wifi@1.0-service-benchmarks
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_CPPFLAGS := -Wall -Werror -Wextra
+LOCAL_SRC_FILES := \
+    tests/hidl_struct_util_benchmark.cpp \
+    tests/ringbuffer_benchmark.cpp
+LOCAL_STATIC_LIBRARIES := \
+    android.hardware.wifi@1.0-service-lib
+LOCAL_SHARED_LIBRARIES := \
+    libbase \
+    libcutils \
+    libhidlbase \
+    liblog \
+    libnl \
+    libutils \
+    libwifi-hal \
+    libwifi-system-iface \
+    android.hardware.wifi@1.0 \
+    android.hardware.wifi@1.1 \
+    android.hardware.wifi@1.2 \
+    android.hardware.wifi@1.3 \
+    android.hardware.wifi@1.4
+include $(BUILD_NATIVE_BENCHMARK)
@@ -529,30 +529,47 @@ bool convertHidlGscanParamsToLegacy(
     return true;
 }
 
+// Resizes |vec| only if its size changes, since hidl_vec::resize() always
+// reallocates.
+template <typename T>
+void resizeHidlVec(hidl_vec<T>* vec, size_t size) {
+    if (vec->size() != size) {
+        vec->resize(size);
+    }
+}
+
+// Copies |size| bytes from |data| into |vec|, reusing its buffer when the size
+// has not changed.
+void copyIntoHidlVec(const uint8_t* data, size_t size, hidl_vec<uint8_t>* vec) {
+    resizeHidlVec(vec, size);
+    if (size > 0) {
+        memcpy(vec->data(), data, size);
+    }
+}
+
 bool convertLegacyIeToHidl(
     const legacy_hal::wifi_information_element& legacy_ie,
     WifiInformationElement* hidl_ie) {
     if (!hidl_ie) {
         return false;
     }
-    *hidl_ie = {};
     hidl_ie->id = legacy_ie.id;
-    hidl_ie->data =
-        std::vector<uint8_t>(legacy_ie.data, legacy_ie.data + legacy_ie.len);
+    copyIntoHidlVec(legacy_ie.data, legacy_ie.len, &hidl_ie->data);
     return true;
 }
 
 bool convertLegacyIeBlobToHidl(const uint8_t* ie_blob, uint32_t ie_blob_len,
-                               std::vector<WifiInformationElement>* hidl_ies) {
+                               hidl_vec<WifiInformationElement>* hidl_ies) {
     if (!ie_blob || !hidl_ies) {
         return false;
     }
-    *hidl_ies = {};
     const uint8_t* ies_begin = ie_blob;
     const uint8_t* ies_end = ie_blob + ie_blob_len;
-    const uint8_t* next_ie = ies_begin;
     using wifi_ie = legacy_hal::wifi_information_element;
     constexpr size_t kIeHeaderLen = sizeof(wifi_ie);
+    // Count the IEs first, so that |hidl_ies| is sized only once.
+    size_t num_ies = 0;
+    const uint8_t* next_ie = ies_begin;
     // Each IE should atleast have the header (i.e |id| & |len| fields).
     while (next_ie + kIeHeaderLen <= ies_end) {
         const wifi_ie& legacy_ie = (*reinterpret_cast<const wifi_ie*>(next_ie));
@@ -563,13 +580,7 @@ bool convertLegacyIeBlobToHidl(const uint8_t* ie_blob, uint32_t ie_blob_len,
                        << ", IEs End: " << (void*)ies_end;
             break;
         }
-        WifiInformationElement hidl_ie;
-        if (!convertLegacyIeToHidl(legacy_ie, &hidl_ie)) {
-            LOG(ERROR) << "Error converting IE. Id: " << legacy_ie.id
-                       << ", len: " << legacy_ie.len;
-            break;
-        }
-        hidl_ies->push_back(std::move(hidl_ie));
+        num_ies++;
         next_ie += curr_ie_len;
     }
     // Check if the blob has been fully consumed.
@@ -577,6 +588,13 @@ bool convertLegacyIeBlobToHidl(const uint8_t* ie_blob, uint32_t ie_blob_len,
         LOG(ERROR) << "Failed to fully parse IE blob. Next IE: "
                    << (void*)next_ie << ", IEs End: " << (void*)ies_end;
     }
+    resizeHidlVec(hidl_ies, num_ies);
+    next_ie = ies_begin;
+    for (size_t i = 0; i < num_ies; i++) {
+        const wifi_ie& legacy_ie = (*reinterpret_cast<const wifi_ie*>(next_ie));
+        convertLegacyIeToHidl(legacy_ie, &(*hidl_ies)[i]);
+        next_ie += kIeHeaderLen + legacy_ie.len;
+    }
     return true;
 }
 
@@ -586,12 +604,11 @@ bool convertLegacyGscanResultToHidl(
     if (!hidl_scan_result) {
         return false;
     }
-    *hidl_scan_result = {};
     hidl_scan_result->timeStampInUs = legacy_scan_result.ts;
-    hidl_scan_result->ssid = std::vector<uint8_t>(
-        legacy_scan_result.ssid,
-        legacy_scan_result.ssid + strnlen(legacy_scan_result.ssid,
-                                          sizeof(legacy_scan_result.ssid) - 1));
+    copyIntoHidlVec(
+        reinterpret_cast<const uint8_t*>(legacy_scan_result.ssid),
+        strnlen(legacy_scan_result.ssid, sizeof(legacy_scan_result.ssid) - 1),
+        &hidl_scan_result->ssid);
     memcpy(hidl_scan_result->bssid.data(), legacy_scan_result.bssid,
            hidl_scan_result->bssid.size());
     hidl_scan_result->frequency = legacy_scan_result.channel;
@@ -599,24 +616,106 @@ bool convertLegacyGscanResultToHidl(
     hidl_scan_result->beaconPeriodInMs = legacy_scan_result.beacon_period;
     hidl_scan_result->capability = legacy_scan_result.capability;
     if (has_ie_data) {
-        std::vector<WifiInformationElement> ies;
         if (!convertLegacyIeBlobToHidl(
                 reinterpret_cast<const uint8_t*>(legacy_scan_result.ie_data),
-                legacy_scan_result.ie_length, &ies)) {
+                legacy_scan_result.ie_length,
+                &hidl_scan_result->informationElements)) {
             return false;
         }
-        hidl_scan_result->informationElements = std::move(ies);
+    } else {
+        resizeHidlVec(&hidl_scan_result->informationElements, 0);
     }
     return true;
 }
 
+// Copies |src| into |dst|, reusing the buffers of |dst| when the sizes match.
+void copyScanResult(const StaScanResult& src, StaScanResult* dst) {
+    dst->timeStampInUs = src.timeStampInUs;
+    copyIntoHidlVec(src.ssid.data(), src.ssid.size(), &dst->ssid);
+    dst->bssid = src.bssid;
+    dst->rssi = src.rssi;
+    dst->frequency = src.frequency;
+    dst->beaconPeriodInMs = src.beaconPeriodInMs;
+    dst->capability = src.capability;
+    resizeHidlVec(&dst->informationElements, src.informationElements.size());
+    for (size_t i = 0; i < src.informationElements.size(); i++) {
+        const auto& src_ie = src.informationElements[i];
+        auto& dst_ie = dst->informationElements[i];
+        dst_ie.id = src_ie.id;
+        copyIntoHidlVec(src_ie.data.data(), src_ie.data.size(), &dst_ie.data);
+    }
+}
+
+ScanResultCache::ScanResultCache(size_t max_entries)
+    : max_entries_(max_entries) {}
+
+bool ScanResultCache::convert(
+    const legacy_hal::wifi_scan_result& legacy_scan_result, bool has_ie_data,
+    StaScanResult* hidl_scan_result) {
+    if (!hidl_scan_result) {
+        return false;
+    }
+    Key key;
+    memcpy(key.bssid.data(), legacy_scan_result.bssid, key.bssid.size());
+    key.timestamp = legacy_scan_result.ts;
+    key.has_ie_data = has_ie_data;
+    auto it = entries_.find(key);
+    if (it != entries_.end() &&
+        isSameScan(legacy_scan_result, has_ie_data, it->second)) {
+        hits_++;
+    } else {
+        misses_++;
+        if (it == entries_.end()) {
+            if (entries_.size() >= max_entries_) {
+                // Only happens if evictUnused() is not called regularly. The
+                // cache is just a shortcut, so start over.
+                entries_.clear();
+            }
+            it = entries_.emplace(key, Entry{}).first;
+        }
+        Entry& entry = it->second;
+        if (!convertLegacyGscanResultToHidl(legacy_scan_result, has_ie_data,
+                                            &entry.result)) {
+            entries_.erase(it);
+            return false;
+        }
+        entry.ie_length = has_ie_data ? legacy_scan_result.ie_length : 0;
+    }
+    it->second.used = true;
+    copyScanResult(it->second.result, hidl_scan_result);
+    return true;
+}
+
+void ScanResultCache::evictUnused() {
+    for (auto it = entries_.begin(); it != entries_.end();) {
+        if (!it->second.used) {
+            it = entries_.erase(it);
+        } else {
+            it->second.used = false;
+            ++it;
+        }
+    }
+}
+
+bool ScanResultCache::isSameScan(
+    const legacy_hal::wifi_scan_result& legacy_scan_result, bool has_ie_data,
+    const Entry& entry) {
+    // The BSSID and timestamp identify a scan result. The fields which can be
+    // compared cheaply guard against a driver reusing a timestamp.
+    return entry.result.rssi == legacy_scan_result.rssi &&
+           entry.result.frequency ==
+               static_cast<uint32_t>(legacy_scan_result.channel) &&
+           entry.result.capability == legacy_scan_result.capability &&
+           entry.ie_length ==
+               (has_ie_data ? legacy_scan_result.ie_length : 0u);
+}
+
 bool convertLegacyCachedGscanResultsToHidl(
     const legacy_hal::wifi_cached_scan_results& legacy_cached_scan_result,
-    StaScanData* hidl_scan_data) {
+    StaScanData* hidl_scan_data, ScanResultCache* cache) {
     if (!hidl_scan_data) {
         return false;
     }
-    *hidl_scan_data = {};
     hidl_scan_data->flags = 0;
     for (const auto flag : {legacy_hal::WIFI_SCAN_FLAG_INTERRUPTED}) {
         if (legacy_cached_scan_result.flags & flag) {
@@ -629,36 +728,40 @@ bool convertLegacyCachedGscanResultsToHidl(
 
     CHECK(legacy_cached_scan_result.num_results >= 0 &&
           legacy_cached_scan_result.num_results <= MAX_AP_CACHE_PER_SCAN);
-    std::vector<StaScanResult> hidl_scan_results;
+    resizeHidlVec(&hidl_scan_data->results,
+                  legacy_cached_scan_result.num_results);
     for (int32_t result_idx = 0;
          result_idx < legacy_cached_scan_result.num_results; result_idx++) {
-        StaScanResult hidl_scan_result;
-        if (!convertLegacyGscanResultToHidl(
-                legacy_cached_scan_result.results[result_idx], false,
-                &hidl_scan_result)) {
+        const auto& legacy_scan_result =
+            legacy_cached_scan_result.results[result_idx];
+        StaScanResult* hidl_scan_result = &hidl_scan_data->results[result_idx];
+        const bool success =
+            cache ? cache->convert(legacy_scan_result, false, hidl_scan_result)
+                  : convertLegacyGscanResultToHidl(legacy_scan_result, false,
+                                                   hidl_scan_result);
+        if (!success) {
             return false;
         }
-        hidl_scan_results.push_back(hidl_scan_result);
     }
-    hidl_scan_data->results = std::move(hidl_scan_results);
     return true;
 }
 
 bool convertLegacyVectorOfCachedGscanResultsToHidl(
     const std::vector<legacy_hal::wifi_cached_scan_results>&
         legacy_cached_scan_results,
-    std::vector<StaScanData>* hidl_scan_datas) {
+    std::vector<StaScanData>* hidl_scan_datas, ScanResultCache* cache) {
     if (!hidl_scan_datas) {
         return false;
     }
-    *hidl_scan_datas = {};
-    for (const auto& legacy_cached_scan_result : legacy_cached_scan_results) {
-        StaScanData hidl_scan_data;
-        if (!convertLegacyCachedGscanResultsToHidl(legacy_cached_scan_result,
-                                                   &hidl_scan_data)) {
+    hidl_scan_datas->resize(legacy_cached_scan_results.size());
+    for (size_t i = 0; i < legacy_cached_scan_results.size(); i++) {
+        if (!convertLegacyCachedGscanResultsToHidl(
+                legacy_cached_scan_results[i], &(*hidl_scan_datas)[i], cache)) {
             return false;
         }
-        hidl_scan_datas->push_back(hidl_scan_data);
+    }
+    if (cache) {
+        cache->evictUnused();
     }
     return true;
 }
@@ -815,15 +918,16 @@ bool convertLegacyLinkLayerRadioStatsToHidl(
     if (!hidl_radio_stat) {
         return false;
     }
-    *hidl_radio_stat = {};
-
     hidl_radio_stat->V1_0.onTimeInMs = legacy_radio_stat.stats.on_time;
     hidl_radio_stat->V1_0.txTimeInMs = legacy_radio_stat.stats.tx_time;
     hidl_radio_stat->V1_0.rxTimeInMs = legacy_radio_stat.stats.rx_time;
     hidl_radio_stat->V1_0.onTimeInMsForScan =
         legacy_radio_stat.stats.on_time_scan;
-    hidl_radio_stat->V1_0.txTimeInMsPerLevel =
-        legacy_radio_stat.tx_time_per_levels;
+    resizeHidlVec(&hidl_radio_stat->V1_0.txTimeInMsPerLevel,
+                  legacy_radio_stat.tx_time_per_levels.size());
+    std::copy(legacy_radio_stat.tx_time_per_levels.begin(),
+              legacy_radio_stat.tx_time_per_levels.end(),
+              hidl_radio_stat->V1_0.txTimeInMsPerLevel.data());
     hidl_radio_stat->onTimeInMsForNanScan = legacy_radio_stat.stats.on_time_nbd;
     hidl_radio_stat->onTimeInMsForBgScan =
         legacy_radio_stat.stats.on_time_gscan;
@@ -834,10 +938,12 @@ bool convertLegacyLinkLayerRadioStatsToHidl(
     hidl_radio_stat->onTimeInMsForHs20Scan =
         legacy_radio_stat.stats.on_time_hs20;
 
-    std::vector<V1_3::WifiChannelStats> hidl_channel_stats;
-
-    for (const auto& channel_stat : legacy_radio_stat.channel_stats) {
-        V1_3::WifiChannelStats hidl_channel_stat;
+    resizeHidlVec(&hidl_radio_stat->channelStats,
+                  legacy_radio_stat.channel_stats.size());
+    for (size_t i = 0; i < legacy_radio_stat.channel_stats.size(); i++) {
+        const auto& channel_stat = legacy_radio_stat.channel_stats[i];
+        V1_3::WifiChannelStats& hidl_channel_stat =
+            hidl_radio_stat->channelStats[i];
         hidl_channel_stat.onTimeInMs = channel_stat.on_time;
         hidl_channel_stat.ccaBusyTimeInMs = channel_stat.cca_busy_time;
         /*
@@ -850,11 +956,8 @@ bool convertLegacyLinkLayerRadioStatsToHidl(
             channel_stat.channel.center_freq0;
         hidl_channel_stat.channel.centerFreq1 =
             channel_stat.channel.center_freq1;
-        hidl_channel_stats.push_back(hidl_channel_stat);
     }
 
-    hidl_radio_stat->channelStats = hidl_channel_stats;
-
     return true;
 }
 
@@ -864,7 +967,6 @@ bool convertLegacyLinkLayerStatsToHidl(
     if (!hidl_stats) {
         return false;
     }
-    *hidl_stats = {};
     // iface legacy_stats conversion.
     hidl_stats->iface.beaconRx = legacy_stats.iface.beacon_rx;
     hidl_stats->iface.avgRssiMgmt = legacy_stats.iface.rssi_mgmt;
@@ -901,16 +1003,13 @@ bool convertLegacyLinkLayerStatsToHidl(
     hidl_stats->iface.wmeVoPktStats.retries =
         legacy_stats.iface.ac[legacy_hal::WIFI_AC_VO].retries;
     // radio legacy_stats conversion.
-    std::vector<V1_3::StaLinkLayerRadioStats> hidl_radios_stats;
-    for (const auto& legacy_radio_stats : legacy_stats.radios) {
-        V1_3::StaLinkLayerRadioStats hidl_radio_stats;
-        if (!convertLegacyLinkLayerRadioStatsToHidl(legacy_radio_stats,
-                                                    &hidl_radio_stats)) {
+    resizeHidlVec(&hidl_stats->radios, legacy_stats.radios.size());
+    for (size_t i = 0; i < legacy_stats.radios.size(); i++) {
+        if (!convertLegacyLinkLayerRadioStatsToHidl(legacy_stats.radios[i],
+                                                    &hidl_stats->radios[i])) {
             return false;
         }
-        hidl_radios_stats.push_back(hidl_radio_stats);
     }
-    hidl_stats->radios = hidl_radios_stats;
     // Timestamp in the HAL wrapper here since it's not provided in the legacy
     // HAL API.
     hidl_stats->timeStampInMs = uptimeMillis();
@@ -17,6 +17,9 @@
 #ifndef HIDL_STRUCT_UTIL_H_
 #define HIDL_STRUCT_UTIL_H_
 
+#include <array>
+#include <map>
+#include <tuple>
 #include <vector>
 
 #include <android/hardware/wifi/1.0/IWifiChip.h>
@@ -82,16 +85,72 @@ legacy_hal::wifi_band convertHidlWifiBandToLegacy(V1_0::WifiBand band);
 bool convertHidlGscanParamsToLegacy(
     const StaBackgroundScanParameters& hidl_scan_params,
     legacy_hal::wifi_scan_cmd_params* legacy_scan_params);
+// The scan result and link layer stats conversions below overwrite the
+// output in place and reuse the buffers it already holds, so repeatedly
+// converting into the same object does not allocate while the sizes stay the
+// same.
+//
 // |has_ie_data| indicates whether or not the wifi_scan_result includes 802.11
 // Information Elements (IEs)
 bool convertLegacyGscanResultToHidl(
     const legacy_hal::wifi_scan_result& legacy_scan_result, bool has_ie_data,
     StaScanResult* hidl_scan_result);
+
+// Keeps the conversions of recently seen scan results, keyed by BSSID and
+// timestamp, so that results reported again unchanged are copied instead of
+// converted again.
+// Not thread safe.
+class ScanResultCache {
+   public:
+    static constexpr size_t kDefaultMaxEntries = 1024;
+
+    explicit ScanResultCache(size_t max_entries = kDefaultMaxEntries);
+
+    // Same as convertLegacyGscanResultToHidl().
+    bool convert(const legacy_hal::wifi_scan_result& legacy_scan_result,
+                 bool has_ie_data, StaScanResult* hidl_scan_result);
+    // Drops the results which were not converted since the previous call.
+    void evictUnused();
+
+    size_t size() const { return entries_.size(); }
+    uint64_t hits() const { return hits_; }
+    uint64_t misses() const { return misses_; }
+
+   private:
+    struct Key {
+        std::array<uint8_t, 6> bssid;
+        uint64_t timestamp;
+        bool has_ie_data;
+
+        bool operator<(const Key& other) const {
+            return std::tie(timestamp, bssid, has_ie_data) <
+                   std::tie(other.timestamp, other.bssid, other.has_ie_data);
+        }
+    };
+    struct Entry {
+        StaScanResult result;
+        uint32_t ie_length = 0;
+        bool used = false;
+    };
+
+    static bool isSameScan(
+        const legacy_hal::wifi_scan_result& legacy_scan_result,
+        bool has_ie_data, const Entry& entry);
+
+    const size_t max_entries_;
+    std::map<Key, Entry> entries_;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+};
+
 // |cached_results| is assumed to not include IEs.
+// |cache| is optional; when set, results are converted through it and the
+// results missing from |legacy_cached_scan_results| are evicted.
 bool convertLegacyVectorOfCachedGscanResultsToHidl(
     const std::vector<legacy_hal::wifi_cached_scan_results>&
         legacy_cached_scan_results,
-    std::vector<StaScanData>* hidl_scan_datas);
+    std::vector<StaScanData>* hidl_scan_datas,
+    ScanResultCache* cache = nullptr);
 bool convertLegacyLinkLayerStatsToHidl(
     const legacy_hal::LinkLayerStats& legacy_stats,
     V1_3::StaLinkLayerStats* hidl_stats);
@@ -17,7 +17,11 @@
 #include "hidl_sync_util.h"
 
 namespace {
+using android::hardware::wifi::V1_4::implementation::hidl_sync_util::Subsystem;
+
 std::recursive_mutex g_mutex;
+std::recursive_mutex g_subsystem_mutexes[static_cast<size_t>(
+    Subsystem::kNumSubsystems)];
 }  // namespace
 
 namespace android {
@@ -31,6 +35,12 @@ std::unique_lock<std::recursive_mutex> acquireGlobalLock() {
     return std::unique_lock<std::recursive_mutex>{g_mutex};
 }
 
+std::unique_lock<std::recursive_mutex> acquireSubsystemLock(
+    Subsystem subsystem) {
+    return std::unique_lock<std::recursive_mutex>{
+        g_subsystem_mutexes[static_cast<size_t>(subsystem)]};
+}
+
 }  // namespace hidl_sync_util
 }  // namespace implementation
 }  // namespace V1_4
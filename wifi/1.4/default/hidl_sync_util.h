@@ -17,9 +17,13 @@
 #ifndef HIDL_SYNC_UTIL_H_
 #define HIDL_SYNC_UTIL_H_
 
+#include <functional>
+#include <memory>
 #include <mutex>
 
-// Utility that provides a global lock to synchronize access between
+#include <android-base/macros.h>
+
+// Utility that provides the locks used to synchronize access between
 // the HIDL thread and the legacy HAL's event loop.
 namespace android {
 namespace hardware {
@@ -27,7 +31,65 @@ namespace wifi {
 namespace V1_4 {
 namespace implementation {
 namespace hidl_sync_util {
+// Subsystems whose state is shared with the legacy HAL's asynchronous
+// callbacks. Each subsystem has its own lock, so that an event for one
+// subsystem is not held up by a slow HIDL call into another.
+//
+// Lock order: the global lock before a subsystem lock. Never hold two
+// subsystem locks at once.
+enum class Subsystem {
+    kChip,  // Ring buffer data, error alerts and radio mode changes.
+    kSta,   // Gscan and RSSI monitoring events.
+    kNan,   // NAN responses and events.
+    kRtt,   // RTT results.
+    kNumSubsystems,
+};
+
+// Serializes the HIDL methods and the legacy HAL start/stop sequence.
 std::unique_lock<std::recursive_mutex> acquireGlobalLock();
+// Serializes the asynchronous callbacks of |subsystem| with the HIDL objects
+// they are delivered to.
+std::unique_lock<std::recursive_mutex> acquireSubsystemLock(
+    Subsystem subsystem);
+
+// Holds a "std::function" callback which the HIDL thread replaces while the
+// legacy HAL event loop may be invoking it. The callback is swapped
+// atomically and every invocation holds its own reference, so resetting the
+// slot never destroys a callback that is still running.
+template <typename Signature>
+class AtomicCallback {
+   public:
+    using Function = std::function<Signature>;
+
+    AtomicCallback() = default;
+
+    AtomicCallback& operator=(Function function) {
+        std::shared_ptr<const Function> ptr;
+        if (function) {
+            ptr = std::make_shared<const Function>(std::move(function));
+        }
+        std::atomic_store(&function_, std::move(ptr));
+        return *this;
+    }
+
+    explicit operator bool() const { return load() != nullptr; }
+
+    // Returns the current callback, or null if the slot is empty.
+    std::shared_ptr<const Function> load() const {
+        return std::atomic_load(&function_);
+    }
+
+    // Returns the current callback and empties the slot.
+    std::shared_ptr<const Function> take() {
+        return std::atomic_exchange(&function_,
+                                    std::shared_ptr<const Function>());
+    }
+
+   private:
+    std::shared_ptr<const Function> function_;
+
+    DISALLOW_COPY_AND_ASSIGN(AtomicCallback);
+};
 }  // namespace hidl_sync_util
 }  // namespace implementation
 }  // namespace V1_4
@@ -14,6 +14,10 @@
  * limitations under the License.
  */
 
+#include <string.h>
+
+#include <algorithm>
+
 #include <android-base/logging.h>
 
 #include "ringbuffer.h"
@@ -24,27 +28,64 @@ namespace wifi {
 namespace V1_4 {
 namespace implementation {
 
-Ringbuffer::Ringbuffer(size_t maxSize) : size_(0), maxSize_(maxSize) {}
+// The buffer is left uninitialized, so that the pages of a large buffer are
+// only committed once logging actually fills them.
+Ringbuffer::Ringbuffer(size_t maxSize)
+    : data_(new uint8_t[maxSize]),
+      head_(0),
+      size_(0),
+      maxSize_(maxSize) {}
 
 void Ringbuffer::append(const std::vector<uint8_t>& input) {
-    if (input.size() == 0) {
+    append(input.data(), input.size());
+}
+
+void Ringbuffer::append(const uint8_t* data, size_t size) {
+    if (size == 0) {
         return;
     }
-    if (input.size() > maxSize_) {
-        LOG(INFO) << "Oversized message of " << input.size()
-                  << " bytes is dropped";
+    if (size > maxSize_) {
+        LOG(INFO) << "Oversized message of " << size << " bytes is dropped";
         return;
     }
-    data_.push_back(input);
-    size_ += input.size() * sizeof(input[0]);
-    while (size_ > maxSize_) {
-        size_ -= data_.front().size() * sizeof(data_.front()[0]);
-        data_.pop_front();
+    while (size_ + size > maxSize_) {
+        const Record& oldest = records_.front();
+        head_ = (head_ + oldest.size) % maxSize_;
+        size_ -= oldest.size;
+        records_.pop_front();
+    }
+    if (records_.empty()) {
+        head_ = 0;
     }
+    const size_t tail = (head_ + size_) % maxSize_;
+    const size_t first_chunk = std::min(size, maxSize_ - tail);
+    memcpy(&data_[tail], data, first_chunk);
+    if (first_chunk < size) {
+        memcpy(&data_[0], data + first_chunk, size - first_chunk);
+    }
+    records_.push_back({tail, size});
+    size_ += size;
+}
+
+void Ringbuffer::clear() {
+    records_.clear();
+    head_ = 0;
+    size_ = 0;
 }
 
-const std::list<std::vector<uint8_t>>& Ringbuffer::getData() const {
-    return data_;
+int Ringbuffer::getDataSegments(struct iovec iov[2]) const {
+    if (size_ == 0) {
+        return 0;
+    }
+    const size_t first_chunk = std::min(size_, maxSize_ - head_);
+    iov[0].iov_base = &data_[head_];
+    iov[0].iov_len = first_chunk;
+    if (first_chunk == size_) {
+        return 1;
+    }
+    iov[1].iov_base = &data_[0];
+    iov[1].iov_len = size_ - first_chunk;
+    return 2;
 }
 
 }  // namespace implementation
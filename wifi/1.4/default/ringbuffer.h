@@ -17,7 +17,10 @@
 #ifndef RINGBUFFER_H_
 #define RINGBUFFER_H_
 
-#include <list>
+#include <sys/uio.h>
+
+#include <deque>
+#include <memory>
 #include <vector>
 
 namespace android {
@@ -27,19 +30,48 @@ namespace V1_4 {
 namespace implementation {
 
 /**
- * Ringbuffer object used to store debug data.
+ * Circular byte buffer holding the most recent records of a debug ring.
+ *
+ * The records are stored back to back in a single buffer of |maxSize| bytes
+ * allocated up front, so appending a record only copies it, and evicting the
+ * oldest records only moves the start offset. The stored data is always made
+ * of at most two contiguous segments, which RingbufferArchiver writes out with
+ * writev(). Clearing the buffer keeps its memory, for reuse.
  */
 class Ringbuffer {
    public:
     explicit Ringbuffer(size_t maxSize);
+    Ringbuffer(Ringbuffer&&) = default;
+    Ringbuffer& operator=(Ringbuffer&&) = default;
 
     // Appends the data buffer and deletes from the front until buffer is
     // within |maxSize_|.
     void append(const std::vector<uint8_t>& input);
-    const std::list<std::vector<uint8_t>>& getData() const;
+    void append(const uint8_t* data, size_t size);
+
+    // Drops all the records.
+    void clear();
+
+    bool empty() const { return records_.empty(); }
+    size_t getNumRecords() const { return records_.size(); }
+    // Total size in bytes of the stored records.
+    size_t getSize() const { return size_; }
+    size_t getMaxSize() const { return maxSize_; }
+    // Fills |iov| with the segments holding the stored records, oldest first,
+    // and returns the number of segments used.
+    int getDataSegments(struct iovec iov[2]) const;
 
    private:
-    std::list<std::vector<uint8_t>> data_;
+    struct Record {
+        size_t offset;
+        size_t size;
+    };
+
+    std::unique_ptr<uint8_t[]> data_;
+    // Record boundaries, only used to evict whole records.
+    std::deque<Record> records_;
+    // Offset of the oldest record.
+    size_t head_;
     size_t size_;
     size_t maxSize_;
 };
@@ -0,0 +1,414 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+
+#include "ringbuffer_archiver.h"
+
+namespace {
+using android::base::unique_fd;
+
+constexpr char kCpioMagic[] = "070701";
+constexpr size_t kMaxRingBufferFileSizeBytes = 1024 * 1024 * 3;
+constexpr time_t kMaxRingBufferFileAgeSeconds = 60 * 60 * 10;
+constexpr size_t kMaxRingBufferFileNum = 20;
+
+// Helper function for |writeCpioArchive|
+bool cpioWriteHeader(int out_fd, struct stat& st, const char* file_name,
+                     size_t file_name_len) {
+    std::array<char, 128> header_buf;
+    ssize_t llen = snprintf(
+        header_buf.data(), header_buf.size(),
+        "%s%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X%08X", kCpioMagic,
+        static_cast<int>(st.st_ino), st.st_mode, st.st_uid, st.st_gid,
+        static_cast<int>(st.st_nlink), static_cast<int>(st.st_mtime),
+        static_cast<int>(st.st_size), major(st.st_dev), minor(st.st_dev),
+        major(st.st_rdev), minor(st.st_rdev),
+        static_cast<uint32_t>(file_name_len), 0);
+    if (!android::base::WriteFully(out_fd, header_buf.data(), llen)) {
+        PLOG(ERROR) << "Error writing cpio header to file " << file_name;
+        return false;
+    }
+    if (!android::base::WriteFully(out_fd, file_name, file_name_len)) {
+        PLOG(ERROR) << "Error writing filename to file " << file_name;
+        return false;
+    }
+
+    // NUL Pad header up to 4 multiple bytes.
+    llen = (llen + file_name_len) % 4;
+    if (llen != 0) {
+        const uint32_t zero = 0;
+        if (!android::base::WriteFully(out_fd, &zero, 4 - llen)) {
+            PLOG(ERROR) << "Error padding 0s to file " << file_name;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Helper function for |cpioWriteFileContent|, used when the kernel can not
+// send the file content directly.
+bool cpioCopyFileContent(int fd_read, int out_fd, off_t offset, off_t size) {
+    std::array<char, 32 * 1024> read_buf;
+    while (offset < size) {
+        ssize_t bytes_read = TEMP_FAILURE_RETRY(
+            pread(fd_read, read_buf.data(),
+                  std::min<off_t>(read_buf.size(), size - offset), offset));
+        if (bytes_read <= 0) {
+            PLOG(ERROR) << "Error reading file";
+            return false;
+        }
+        if (!android::base::WriteFully(out_fd, read_buf.data(), bytes_read)) {
+            PLOG(ERROR) << "Error writing data to file";
+            return false;
+        }
+        offset += bytes_read;
+    }
+    return true;
+}
+
+// Helper function for |writeCpioArchive|
+size_t cpioWriteFileContent(int fd_read, int out_fd, struct stat& st) {
+    // The file content goes straight from the page cache to |out_fd|.
+    off_t offset = 0;
+    while (offset < st.st_size) {
+        ssize_t bytes_sent = TEMP_FAILURE_RETRY(
+            sendfile(out_fd, fd_read, &offset, st.st_size - offset));
+        if (bytes_sent == -1 && (errno == EINVAL || errno == ENOSYS)) {
+            if (!cpioCopyFileContent(fd_read, out_fd, offset, st.st_size)) {
+                return 1;
+            }
+            break;
+        }
+        if (bytes_sent <= 0) {
+            PLOG(ERROR) << "Error sending file content";
+            return 1;
+        }
+    }
+    const off_t llen = st.st_size % 4;
+    if (llen != 0) {
+        const uint32_t zero = 0;
+        if (!android::base::WriteFully(out_fd, &zero, 4 - llen)) {
+            PLOG(ERROR) << "Error padding 0s to file";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Helper function for |writeCpioArchive|
+bool cpioWriteFileTrailer(int out_fd) {
+    std::array<char, 4096> read_buf;
+    read_buf.fill(0);
+    if (!android::base::WriteFully(
+            out_fd, read_buf.data(),
+            sprintf(read_buf.data(), "070701%040X%056X%08XTRAILER!!!", 1, 0x0b,
+                    0) +
+                4)) {
+        PLOG(ERROR) << "Error writing trailing bytes";
+        return false;
+    }
+    return true;
+}
+
+// Same as WriteFully, for the |iovcnt| segments of |iov|, which are updated
+// as they are written.
+bool writevFully(int fd, struct iovec* iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t bytes_written = TEMP_FAILURE_RETRY(writev(fd, iov, iovcnt));
+        if (bytes_written <= 0) {
+            return false;
+        }
+        size_t remaining = bytes_written;
+        while (iovcnt > 0 && remaining >= iov->iov_len) {
+            remaining -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + remaining;
+            iov->iov_len -= remaining;
+        }
+    }
+    return true;
+}
+
+// Helper function to create a non-const char*.
+std::vector<char> makeCharVec(const std::string& str) {
+    std::vector<char> vec(str.begin(), str.end());
+    vec.push_back('\0');
+    return vec;
+}
+
+}  // namespace
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_4 {
+namespace implementation {
+
+RingbufferArchiver::RingbufferArchiver(const std::string& dir_path)
+    : RingbufferArchiver(dir_path,
+                         {kMaxRingBufferFileSizeBytes, kMaxRingBufferFileNum,
+                          kMaxRingBufferFileAgeSeconds}) {}
+
+RingbufferArchiver::RingbufferArchiver(const std::string& dir_path,
+                                       const Limits& limits)
+    : dir_path_(dir_path),
+      limits_(limits),
+      busy_(false),
+      stopping_(false),
+      index_loaded_(false) {}
+
+RingbufferArchiver::~RingbufferArchiver() {
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void RingbufferArchiver::append(const std::string& ring_name,
+                                Ringbuffer&& ring) {
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        // The thread is only started once there is something to write.
+        if (!thread_.joinable()) {
+            thread_ = std::thread(&RingbufferArchiver::threadLoop, this);
+        }
+        jobs_.push_back({ring_name, std::move(ring)});
+    }
+    cv_.notify_all();
+}
+
+Ringbuffer RingbufferArchiver::takeSpareRing(size_t max_size) {
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        for (auto it = spare_rings_.begin(); it != spare_rings_.end(); ++it) {
+            if (it->getMaxSize() == max_size) {
+                Ringbuffer ring = std::move(*it);
+                spare_rings_.erase(it);
+                return ring;
+            }
+        }
+    }
+    // Only until each ring has a spare.
+    return Ringbuffer(max_size);
+}
+
+void RingbufferArchiver::flush() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    cv_.wait(lk, [this] { return jobs_.empty() && !busy_; });
+}
+
+void RingbufferArchiver::threadLoop() {
+    std::unique_lock<std::mutex> lk(mutex_);
+    while (true) {
+        cv_.wait(lk, [this] { return stopping_ || !jobs_.empty(); });
+        if (jobs_.empty()) {
+            break;  // Stopping, and all the data has been written.
+        }
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        busy_ = true;
+        lk.unlock();
+        writeJob(job);
+        lk.lock();
+        busy_ = false;
+        cv_.notify_all();
+    }
+}
+
+void RingbufferArchiver::writeJob(Job& job) {
+    const size_t size = job.ring.getSize();
+    int fd;
+    FileList::iterator entry;
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        loadIndexLocked();
+        auto it = ring_files_.find(job.ring_name);
+        RingFile* ring_file = nullptr;
+        if (it != ring_files_.end() &&
+            it->second.entry->size + size <= limits_.max_file_size) {
+            ring_file = &it->second;
+        } else {
+            ring_file = openRingFileLocked(job.ring_name);
+            if (ring_file == nullptr) {
+                job.ring.clear();
+                spare_rings_.push_back(std::move(job.ring));
+                return;
+            }
+        }
+        fd = ring_file->fd.get();
+        entry = ring_file->entry;
+    }
+    // Only this thread writes and closes the files, so the file can be
+    // written without holding the lock.
+    struct iovec iov[2];
+    if (!writevFully(fd, iov, job.ring.getDataSegments(iov))) {
+        PLOG(ERROR) << "Error writing to file";
+    }
+    job.ring.clear();
+    std::unique_lock<std::mutex> lk(mutex_);
+    spare_rings_.push_back(std::move(job.ring));
+    entry->size += size;
+    entry->mtime = time(0);
+    files_.splice(files_.end(), files_, entry);
+    removeOldFilesLocked();
+}
+
+RingbufferArchiver::RingFile* RingbufferArchiver::openRingFileLocked(
+    const std::string& ring_name) {
+    ring_files_.erase(ring_name);
+    std::vector<char> file_path =
+        makeCharVec(dir_path_ + ring_name + "XXXXXXXXXX");
+    unique_fd fd(mkstemp(file_path.data()));
+    if (fd == -1) {
+        PLOG(ERROR) << "create file failed";
+        return nullptr;
+    }
+    const std::string file_name(file_path.data() + dir_path_.size());
+    auto entry = files_.insert(files_.end(), FileEntry{file_name, time(0), 0});
+    RingFile& ring_file = ring_files_[ring_name];
+    ring_file.fd = std::move(fd);
+    ring_file.entry = entry;
+    return &ring_file;
+}
+
+// Lists the files left by a previous instance of the service, oldest first.
+void RingbufferArchiver::loadIndexLocked() {
+    if (index_loaded_) {
+        return;
+    }
+    index_loaded_ = true;
+    std::unique_ptr<DIR, decltype(&closedir)> dir_dump(
+        opendir(dir_path_.c_str()), closedir);
+    if (!dir_dump) {
+        PLOG(ERROR) << "Failed to open directory";
+        return;
+    }
+    struct dirent* dp;
+    std::vector<FileEntry> found_files;
+    while ((dp = readdir(dir_dump.get()))) {
+        if (dp->d_type != DT_REG) {
+            continue;
+        }
+        std::string cur_file_name(dp->d_name);
+        struct stat cur_file_stat;
+        std::string cur_file_path = dir_path_ + cur_file_name;
+        if (stat(cur_file_path.c_str(), &cur_file_stat) == -1) {
+            PLOG(ERROR) << "Failed to get file stat for " << cur_file_path;
+            continue;
+        }
+        found_files.push_back({cur_file_name, cur_file_stat.st_mtime,
+                               static_cast<size_t>(cur_file_stat.st_size)});
+    }
+    std::sort(found_files.begin(), found_files.end(),
+              [](const FileEntry& a, const FileEntry& b) {
+                  return a.mtime < b.mtime;
+              });
+    files_.insert(files_.begin(), found_files.begin(), found_files.end());
+    removeOldFilesLocked();
+}
+
+// delete files that meet either conditions:
+// 1. older than a predefined time in the wifi tombstone dir.
+// 2. Files in excess to a predefined amount, starting from the oldest ones
+void RingbufferArchiver::removeOldFilesLocked() {
+    const time_t delete_files_before = time(0) - limits_.max_file_age_seconds;
+    while (!files_.empty() && (files_.size() > limits_.max_file_num ||
+                               files_.front().mtime < delete_files_before)) {
+        const std::string file_path = dir_path_ + files_.front().name;
+        if (unlink(file_path.c_str()) != 0) {
+            PLOG(ERROR) << "Error deleting file " << file_path;
+        }
+        for (auto it = ring_files_.begin(); it != ring_files_.end(); ++it) {
+            if (it->second.entry == files_.begin()) {
+                ring_files_.erase(it);
+                break;
+            }
+        }
+        files_.pop_front();
+    }
+}
+
+// Logic obtained from //external/toybox/toys/posix/cpio.c "Output cpio archive"
+// portion
+size_t RingbufferArchiver::writeCpioArchive(int out_fd) {
+    std::vector<std::string> file_names;
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        loadIndexLocked();
+        for (const auto& file : files_) {
+            file_names.push_back(file.name);
+        }
+    }
+    size_t n_error = 0;
+    for (const auto& cur_file_name : file_names) {
+        // string.size() does not include the null terminator. The cpio FreeBSD
+        // file header expects the null character to be included in the length.
+        const size_t file_name_len = cur_file_name.size() + 1;
+        const std::string cur_file_path = dir_path_ + cur_file_name;
+        unique_fd fd_read(open(cur_file_path.c_str(), O_RDONLY | O_CLOEXEC));
+        if (fd_read == -1) {
+            // The file may have been rotated out in the meantime.
+            PLOG(ERROR) << "Failed to open file " << cur_file_path;
+            n_error++;
+            continue;
+        }
+        struct stat st;
+        if (fstat(fd_read, &st) == -1) {
+            PLOG(ERROR) << "Failed to get file stat for " << cur_file_path;
+            n_error++;
+            continue;
+        }
+        if (!cpioWriteHeader(out_fd, st, cur_file_name.c_str(),
+                             file_name_len)) {
+            return ++n_error;
+        }
+        size_t write_error = cpioWriteFileContent(fd_read, out_fd, st);
+        if (write_error) {
+            return n_error + write_error;
+        }
+    }
+    if (!cpioWriteFileTrailer(out_fd)) {
+        return ++n_error;
+    }
+    return n_error;
+}
+
+}  // namespace implementation
+}  // namespace V1_4
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
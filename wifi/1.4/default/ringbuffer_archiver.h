@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RINGBUFFER_ARCHIVER_H_
+#define RINGBUFFER_ARCHIVER_H_
+
+#include <time.h>
+
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <android-base/unique_fd.h>
+
+#include "ringbuffer.h"
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_4 {
+namespace implementation {
+
+/**
+ * Writes the debug ring data to the tombstone directory on a background
+ * thread.
+ *
+ * Each ring appends to its own rolling file, and a new file is started once
+ * the current one reaches the size of a ring. The files are tracked in an
+ * in-memory index ordered by last modification, which is used to delete the
+ * old files and to build the cpio archive without scanning the directory.
+ *
+ * The rings handed over are written out as they are, and kept once written,
+ * so that the caller can swap its rings for spare ones without allocating.
+ */
+class RingbufferArchiver {
+   public:
+    // Rotation and retention limits of the archived files.
+    struct Limits {
+        // A ring starts a new file once its current one would exceed this.
+        size_t max_file_size;
+        // The oldest files are deleted beyond this number of files.
+        size_t max_file_num;
+        // Files not modified for this long are deleted.
+        time_t max_file_age_seconds;
+    };
+
+    explicit RingbufferArchiver(const std::string& dir_path);
+    RingbufferArchiver(const std::string& dir_path, const Limits& limits);
+    ~RingbufferArchiver();
+
+    // Queues the records of |ring| to be appended to the file of |ring_name|.
+    void append(const std::string& ring_name, Ringbuffer&& ring);
+    // Returns an empty ring of |max_size| bytes, reusing one already written
+    // out when possible.
+    Ringbuffer takeSpareRing(size_t max_size);
+    // Waits until all the queued data has been written.
+    void flush();
+    // Writes a cpio archive of the archived files into |out_fd|, and returns
+    // the number of errors.
+    size_t writeCpioArchive(int out_fd);
+
+   private:
+    struct Job {
+        std::string ring_name;
+        Ringbuffer ring;
+    };
+    struct FileEntry {
+        std::string name;
+        time_t mtime;
+        size_t size;
+    };
+    using FileList = std::list<FileEntry>;
+    struct RingFile {
+        android::base::unique_fd fd;
+        FileList::iterator entry;
+    };
+
+    void threadLoop();
+    void writeJob(Job& job);
+    // Opens a new rolling file for |ring_name| and adds it to the index.
+    RingFile* openRingFileLocked(const std::string& ring_name);
+    void loadIndexLocked();
+    void removeOldFilesLocked();
+
+    const std::string dir_path_;
+    const Limits limits_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Job> jobs_;     // guarded by mutex_
+    bool busy_;                // guarded by mutex_
+    bool stopping_;            // guarded by mutex_
+    bool index_loaded_;        // guarded by mutex_
+    FileList files_;           // guarded by mutex_, oldest first
+    std::map<std::string, RingFile> ring_files_;  // guarded by mutex_
+    std::vector<Ringbuffer> spare_rings_;         // guarded by mutex_
+    std::thread thread_;
+
+    DISALLOW_COPY_AND_ASSIGN(RingbufferArchiver);
+};
+
+}  // namespace implementation
+}  // namespace V1_4
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
+
+#endif  // RINGBUFFER_ARCHIVER_H_
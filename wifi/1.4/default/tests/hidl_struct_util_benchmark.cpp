@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#undef NAN
+#include "hidl_struct_util.h"
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_4 {
+namespace implementation {
+namespace {
+
+// Typical dual band chip: 2 radios reporting every 2.4GHz and 5GHz channel.
+constexpr size_t kNumRadios = 2;
+constexpr size_t kNumChannelsPerRadio = 38;
+constexpr size_t kNumTxPowerLevels = 8;
+// Size of the IEs of a typical beacon, a multiple of 32.
+constexpr size_t kIeBlobSize = 320;
+
+legacy_hal::LinkLayerStats makeLinkLayerStats() {
+    legacy_hal::LinkLayerStats stats{};
+    stats.radios.resize(kNumRadios);
+    for (auto& radio : stats.radios) {
+        radio.stats.on_time = 1000;
+        radio.tx_time_per_levels.assign(kNumTxPowerLevels, 10);
+        radio.channel_stats.resize(kNumChannelsPerRadio);
+        for (size_t i = 0; i < radio.channel_stats.size(); i++) {
+            radio.channel_stats[i].channel.center_freq = 2412 + 5 * i;
+            radio.channel_stats[i].on_time = i;
+        }
+    }
+    return stats;
+}
+
+std::vector<legacy_hal::wifi_cached_scan_results> makeCachedScanResults(
+    int num_results) {
+    std::vector<legacy_hal::wifi_cached_scan_results> results(1);
+    results[0] = {};
+    results[0].num_results = num_results;
+    for (int i = 0; i < num_results; i++) {
+        auto& result = results[0].results[i];
+        result.bssid[4] = i >> 8;
+        result.bssid[5] = i & 0xff;
+        result.ts = 1000000 + i;
+        result.rssi = -40 - (i % 50);
+        result.channel = 2412;
+        strcpy(result.ssid, "benchmark-ssid");
+    }
+    return results;
+}
+
+// Scan result followed by |kIeBlobSize| bytes of IEs.
+std::vector<uint8_t> makeFullScanResult() {
+    std::vector<uint8_t> storage(sizeof(legacy_hal::wifi_scan_result) +
+                                 kIeBlobSize);
+    auto* result =
+        reinterpret_cast<legacy_hal::wifi_scan_result*>(storage.data());
+    strcpy(result->ssid, "benchmark-ssid");
+    result->ie_length = kIeBlobSize;
+    // Vendor specific IEs with 30 bytes of payload each.
+    for (size_t offset = 0; offset < kIeBlobSize; offset += 32) {
+        result->ie_data[offset] = static_cast<char>(0xdd);
+        result->ie_data[offset + 1] = 30;
+    }
+    return storage;
+}
+
+// Arg: 0 converts into a new object every time, as before, 1 reuses the
+// output object like WifiStaIface does.
+void BM_ConvertLinkLayerStats(benchmark::State& state) {
+    const auto legacy_stats = makeLinkLayerStats();
+    V1_3::StaLinkLayerStats reused;
+    for (auto _ : state) {
+        if (state.range(0)) {
+            hidl_struct_util::convertLegacyLinkLayerStatsToHidl(legacy_stats,
+                                                                &reused);
+            benchmark::DoNotOptimize(reused.radios.data());
+        } else {
+            V1_3::StaLinkLayerStats hidl_stats;
+            hidl_struct_util::convertLegacyLinkLayerStatsToHidl(legacy_stats,
+                                                                &hidl_stats);
+            benchmark::DoNotOptimize(hidl_stats.radios.data());
+        }
+    }
+}
+BENCHMARK(BM_ConvertLinkLayerStats)->Arg(0)->Arg(1);
+
+// Args: number of results, then 0 without and 1 with a ScanResultCache.
+void BM_ConvertCachedScanResults(benchmark::State& state) {
+    const auto legacy_results = makeCachedScanResults(state.range(0));
+    hidl_struct_util::ScanResultCache cache;
+    std::vector<StaScanData> hidl_results;
+    for (auto _ : state) {
+        hidl_struct_util::convertLegacyVectorOfCachedGscanResultsToHidl(
+            legacy_results, &hidl_results,
+            state.range(1) ? &cache : nullptr);
+        benchmark::DoNotOptimize(hidl_results.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ConvertCachedScanResults)
+    ->Args({16, 0})
+    ->Args({16, 1})
+    ->Args({MAX_AP_CACHE_PER_SCAN, 0})
+    ->Args({MAX_AP_CACHE_PER_SCAN, 1});
+
+// Arg: 0 converts into a new object every time, 1 reuses the output object.
+void BM_ConvertFullScanResult(benchmark::State& state) {
+    const auto storage = makeFullScanResult();
+    const auto& legacy_result =
+        *reinterpret_cast<const legacy_hal::wifi_scan_result*>(storage.data());
+    StaScanResult reused;
+    for (auto _ : state) {
+        if (state.range(0)) {
+            hidl_struct_util::convertLegacyGscanResultToHidl(legacy_result,
+                                                             true, &reused);
+            benchmark::DoNotOptimize(reused.informationElements.data());
+        } else {
+            StaScanResult hidl_result;
+            hidl_struct_util::convertLegacyGscanResultToHidl(
+                legacy_result, true, &hidl_result);
+            benchmark::DoNotOptimize(hidl_result.informationElements.data());
+        }
+    }
+}
+BENCHMARK(BM_ConvertFullScanResult)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V1_4
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
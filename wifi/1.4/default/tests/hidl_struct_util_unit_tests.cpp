@@ -287,6 +287,117 @@ TEST_F(HidlStructUtilTest, CanConvertLegacyFeaturesToHidl) {
                   HidlChipCaps::DEBUG_MEMORY_DRIVER_DUMP,
               hidle_caps);
 }
+
+TEST_F(HidlStructUtilTest, CanReuseLinkLayerStatsBuffers) {
+    legacy_hal::LinkLayerStats legacy_stats{};
+    legacy_stats.radios.resize(2);
+    for (auto& radio : legacy_stats.radios) {
+        radio.stats.on_time = rand();
+        radio.tx_time_per_levels = {1, 2, 3};
+        radio.channel_stats.resize(2);
+    }
+    V1_3::StaLinkLayerStats converted{};
+    ASSERT_TRUE(hidl_struct_util::convertLegacyLinkLayerStatsToHidl(
+        legacy_stats, &converted));
+    const auto* radios_data = converted.radios.data();
+    const auto* channels_data = converted.radios[0].channelStats.data();
+
+    // Same sizes, the buffers are kept and the values updated.
+    legacy_stats.radios[0].stats.on_time++;
+    legacy_stats.radios[0].channel_stats[1].on_time = 0x1234;
+    ASSERT_TRUE(hidl_struct_util::convertLegacyLinkLayerStatsToHidl(
+        legacy_stats, &converted));
+    EXPECT_EQ(radios_data, converted.radios.data());
+    EXPECT_EQ(channels_data, converted.radios[0].channelStats.data());
+    EXPECT_EQ(legacy_stats.radios[0].stats.on_time,
+              converted.radios[0].V1_0.onTimeInMs);
+    EXPECT_EQ(0x1234u, converted.radios[0].channelStats[1].onTimeInMs);
+
+    // Fewer radios and channels, nothing stale is left behind.
+    legacy_stats.radios.resize(1);
+    legacy_stats.radios[0].channel_stats.resize(1);
+    legacy_stats.radios[0].tx_time_per_levels.clear();
+    ASSERT_TRUE(hidl_struct_util::convertLegacyLinkLayerStatsToHidl(
+        legacy_stats, &converted));
+    ASSERT_EQ(1u, converted.radios.size());
+    EXPECT_EQ(1u, converted.radios[0].channelStats.size());
+    EXPECT_EQ(0u, converted.radios[0].V1_0.txTimeInMsPerLevel.size());
+}
+
+TEST_F(HidlStructUtilTest, CanConvertLegacyGscanResultIntoReusedResult) {
+    const uint8_t kIes[] = {0x00, 0x03, 'f', 'o', 'o', 0xdd, 0x01, 0x42};
+    std::vector<uint8_t> storage(sizeof(legacy_hal::wifi_scan_result) +
+                                 sizeof(kIes));
+    auto* legacy_result =
+        reinterpret_cast<legacy_hal::wifi_scan_result*>(storage.data());
+    strcpy(legacy_result->ssid, "guest");
+    legacy_result->ts = 1000;
+    legacy_result->rssi = -60;
+    legacy_result->ie_length = sizeof(kIes);
+    memcpy(legacy_result->ie_data, kIes, sizeof(kIes));
+
+    StaScanResult converted;
+    ASSERT_TRUE(hidl_struct_util::convertLegacyGscanResultToHidl(
+        *legacy_result, true, &converted));
+    EXPECT_EQ(std::vector<uint8_t>({'g', 'u', 'e', 's', 't'}),
+              std::vector<uint8_t>(converted.ssid));
+    ASSERT_EQ(2u, converted.informationElements.size());
+    EXPECT_EQ(0x00, converted.informationElements[0].id);
+    EXPECT_EQ(std::vector<uint8_t>({'f', 'o', 'o'}),
+              std::vector<uint8_t>(converted.informationElements[0].data));
+    EXPECT_EQ(0xdd, converted.informationElements[1].id);
+    EXPECT_EQ(std::vector<uint8_t>({0x42}),
+              std::vector<uint8_t>(converted.informationElements[1].data));
+
+    // Converting a result without IEs into the same object drops the IEs.
+    strcpy(legacy_result->ssid, "home");
+    ASSERT_TRUE(hidl_struct_util::convertLegacyGscanResultToHidl(
+        *legacy_result, false, &converted));
+    EXPECT_EQ(std::vector<uint8_t>({'h', 'o', 'm', 'e'}),
+              std::vector<uint8_t>(converted.ssid));
+    EXPECT_EQ(0u, converted.informationElements.size());
+}
+
+TEST_F(HidlStructUtilTest, ScanResultCacheReusesUnchangedResults) {
+    std::vector<legacy_hal::wifi_cached_scan_results> legacy_results(1);
+    auto& legacy_scan = legacy_results[0];
+    legacy_scan = {};
+    legacy_scan.num_results = 2;
+    for (int i = 0; i < legacy_scan.num_results; i++) {
+        auto& result = legacy_scan.results[i];
+        result.bssid[5] = i;
+        result.ts = 1000 + i;
+        result.rssi = -50 - i;
+        result.channel = 2412;
+        strcpy(result.ssid, "ssid");
+    }
+    hidl_struct_util::ScanResultCache cache;
+    std::vector<StaScanData> converted;
+    ASSERT_TRUE(hidl_struct_util::convertLegacyVectorOfCachedGscanResultsToHidl(
+        legacy_results, &converted, &cache));
+    EXPECT_EQ(0u, cache.hits());
+    EXPECT_EQ(2u, cache.misses());
+
+    ASSERT_TRUE(hidl_struct_util::convertLegacyVectorOfCachedGscanResultsToHidl(
+        legacy_results, &converted, &cache));
+    EXPECT_EQ(2u, cache.hits());
+    EXPECT_EQ(2u, cache.misses());
+
+    // A new observation of a BSS is converted again and replaces the old one.
+    legacy_scan.results[1].ts = 2000;
+    legacy_scan.results[1].rssi = -40;
+    ASSERT_TRUE(hidl_struct_util::convertLegacyVectorOfCachedGscanResultsToHidl(
+        legacy_results, &converted, &cache));
+    EXPECT_EQ(3u, cache.hits());
+    EXPECT_EQ(3u, cache.misses());
+    EXPECT_EQ(2u, cache.size());
+    ASSERT_EQ(1u, converted.size());
+    ASSERT_EQ(2u, converted[0].results.size());
+    EXPECT_EQ(2000u, converted[0].results[1].timeStampInUs);
+    EXPECT_EQ(-40, converted[0].results[1].rssi);
+    EXPECT_EQ(0, converted[0].results[0].bssid[5]);
+    EXPECT_EQ(1, converted[0].results[1].bssid[5]);
+}
 }  // namespace implementation
 }  // namespace V1_4
 }  // namespace wifi
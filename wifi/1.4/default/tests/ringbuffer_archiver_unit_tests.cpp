@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) 2020, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <gmock/gmock.h>
+
+#include "ringbuffer_archiver.h"
+
+using testing::Test;
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_4 {
+namespace implementation {
+
+namespace {
+// Returns a ring holding |str| as a single record.
+Ringbuffer toRing(const std::string& str) {
+    Ringbuffer ring(str.size());
+    ring.append(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+    return ring;
+}
+
+bool startsWith(const std::string& str, const std::string& prefix) {
+    return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+// One entry of a "newc" cpio archive.
+struct CpioEntry {
+    std::string name;
+    std::string data;
+};
+
+// Parses a "newc" cpio archive, up to and including the trailer entry.
+bool parseCpioArchive(const std::string& archive,
+                      std::vector<CpioEntry>* entries) {
+    constexpr size_t kHeaderSize = 110;
+    auto align4 = [](size_t offset) { return (offset + 3) & ~size_t(3); };
+    size_t offset = 0;
+    while (offset + kHeaderSize <= archive.size()) {
+        if (archive.compare(offset, 6, "070701") != 0) {
+            return false;
+        }
+        // The fields are 8 hex digits each, the file size is the 7th and the
+        // name size the 12th.
+        auto field = [&](int index) {
+            return std::stoul(archive.substr(offset + 6 + index * 8, 8),
+                              nullptr, 16);
+        };
+        const size_t data_size = field(6);
+        const size_t name_size = field(11);
+        if (name_size == 0 ||
+            offset + kHeaderSize + name_size > archive.size()) {
+            return false;
+        }
+        CpioEntry entry;
+        entry.name = archive.substr(offset + kHeaderSize, name_size - 1);
+        offset = align4(offset + kHeaderSize + name_size);
+        if (offset + data_size > archive.size()) {
+            return false;
+        }
+        entry.data = archive.substr(offset, data_size);
+        offset = align4(offset + data_size);
+        entries->push_back(entry);
+        if (entry.name == "TRAILER!!!") {
+            return true;
+        }
+    }
+    return false;
+}
+}  // namespace
+
+class RingbufferArchiverTest : public Test {
+   protected:
+    // Small limits, so that rotation and retention take little data.
+    const RingbufferArchiver::Limits limits_{100, 3, 60 * 60};
+    TemporaryDir dir_;
+
+    std::string dirPath() const { return std::string(dir_.path) + "/"; }
+
+    // Returns the content of the files in the directory, by file name.
+    std::map<std::string, std::string> readFiles() const {
+        std::map<std::string, std::string> files;
+        DIR* dir = opendir(dir_.path);
+        if (dir == nullptr) {
+            return files;
+        }
+        struct dirent* dp;
+        while ((dp = readdir(dir))) {
+            if (dp->d_type != DT_REG) {
+                continue;
+            }
+            std::string content;
+            android::base::ReadFileToString(dirPath() + dp->d_name, &content);
+            files[dp->d_name] = content;
+        }
+        closedir(dir);
+        return files;
+    }
+
+    void writeFile(const std::string& name, const std::string& content,
+                   time_t age_seconds) {
+        const std::string path = dirPath() + name;
+        ASSERT_TRUE(android::base::WriteStringToFile(content, path));
+        struct timeval times[2];
+        times[0].tv_sec = times[1].tv_sec = time(0) - age_seconds;
+        times[0].tv_usec = times[1].tv_usec = 0;
+        ASSERT_EQ(0, utimes(path.c_str(), times));
+    }
+};
+
+TEST_F(RingbufferArchiverTest, AppendsToTheCurrentFileOfARing) {
+    RingbufferArchiver archiver(dirPath(), limits_);
+    archiver.append("ringA", toRing("first"));
+    archiver.append("ringA", toRing("second"));
+    archiver.append("ringB", toRing("other"));
+    archiver.flush();
+
+    const auto files = readFiles();
+    ASSERT_EQ(2u, files.size());
+    for (const auto& file : files) {
+        if (startsWith(file.first, "ringA")) {
+            EXPECT_EQ("firstsecond", file.second);
+        } else {
+            EXPECT_TRUE(startsWith(file.first, "ringB"));
+            EXPECT_EQ("other", file.second);
+        }
+    }
+}
+
+TEST_F(RingbufferArchiverTest, StartsANewFileWhenTheCurrentOneIsFull) {
+    RingbufferArchiver archiver(dirPath(), limits_);
+    const std::string first(60, 'a');
+    const std::string second(40, 'b');
+    const std::string third(1, 'c');
+    archiver.append("ring", toRing(first));
+    archiver.append("ring", toRing(second));
+    archiver.append("ring", toRing(third));
+    archiver.flush();
+
+    std::vector<std::string> contents;
+    for (const auto& file : readFiles()) {
+        contents.push_back(file.second);
+    }
+    EXPECT_THAT(contents,
+                testing::UnorderedElementsAre(first + second, third));
+}
+
+TEST_F(RingbufferArchiverTest, KeepsTheNewestFilesUpToTheFileLimit) {
+    RingbufferArchiver archiver(dirPath(), limits_);
+    // Each write needs a new file.
+    for (char c = 'a'; c < 'f'; ++c) {
+        archiver.append("ring", toRing(std::string(60, c)));
+    }
+    archiver.flush();
+
+    std::vector<std::string> contents;
+    for (const auto& file : readFiles()) {
+        contents.push_back(file.second);
+    }
+    EXPECT_THAT(contents, testing::UnorderedElementsAre(std::string(60, 'c'),
+                                                        std::string(60, 'd'),
+                                                        std::string(60, 'e')));
+}
+
+TEST_F(RingbufferArchiverTest, DeletesOldFilesOfAPreviousRun) {
+    writeFile("expired", "x", 2 * 60 * 60);
+    writeFile("oldest", "o", 50 * 60);
+    writeFile("older", "o", 40 * 60);
+    writeFile("recent", "r", 30 * 60);
+    RingbufferArchiver archiver(dirPath(), limits_);
+    archiver.append("ring", toRing("new"));
+    archiver.flush();
+
+    const auto files = readFiles();
+    EXPECT_EQ(3u, files.size());
+    EXPECT_EQ(0u, files.count("expired"));
+    EXPECT_EQ(0u, files.count("oldest"));
+    EXPECT_EQ(1u, files.count("older"));
+    EXPECT_EQ(1u, files.count("recent"));
+}
+
+TEST_F(RingbufferArchiverTest, WritesTheRecordsOfAWrappedRingInOrder) {
+    RingbufferArchiver archiver(dirPath(), limits_);
+    Ringbuffer ring(8);
+    ring.append({'0', '1', '2', '3'});
+    ring.append({'4', '5', '6', '7'});
+    ring.append({'8', '9', 'A', 'B'});
+    archiver.append("ring", std::move(ring));
+    archiver.flush();
+
+    const auto files = readFiles();
+    ASSERT_EQ(1u, files.size());
+    EXPECT_EQ("456789AB", files.begin()->second);
+}
+
+TEST_F(RingbufferArchiverTest, ReusesTheWrittenRingsAsSpares) {
+    RingbufferArchiver archiver(dirPath(), limits_);
+    Ringbuffer ring = archiver.takeSpareRing(16);
+    ring.append({'a'});
+    struct iovec iov[2];
+    ASSERT_EQ(1, ring.getDataSegments(iov));
+    const void* data = iov[0].iov_base;
+    archiver.append("ring", std::move(ring));
+    archiver.flush();
+
+    // Only a ring of the same size is reused.
+    EXPECT_TRUE(archiver.takeSpareRing(32).empty());
+    Ringbuffer spare = archiver.takeSpareRing(16);
+    EXPECT_TRUE(spare.empty());
+    spare.append({'b'});
+    ASSERT_EQ(1, spare.getDataSegments(iov));
+    EXPECT_EQ(data, iov[0].iov_base);
+}
+
+TEST_F(RingbufferArchiverTest, WritesTheFilesOldestFirstToACpioArchive) {
+    writeFile("previous", "from a previous run", 60);
+    RingbufferArchiver archiver(dirPath(), limits_);
+    // Not a multiple of 4 bytes, so that the data is padded.
+    archiver.append("ringA", toRing("hello"));
+    archiver.flush();
+    archiver.append("ringB", toRing("world!"));
+    archiver.flush();
+
+    TemporaryFile out;
+    EXPECT_EQ(0u, archiver.writeCpioArchive(out.fd));
+    std::string archive;
+    ASSERT_TRUE(android::base::ReadFileToString(out.path, &archive));
+    EXPECT_EQ(0u, archive.size() % 4);
+
+    std::vector<CpioEntry> entries;
+    ASSERT_TRUE(parseCpioArchive(archive, &entries));
+    ASSERT_EQ(4u, entries.size());
+    EXPECT_EQ("previous", entries[0].name);
+    EXPECT_EQ("from a previous run", entries[0].data);
+    EXPECT_TRUE(startsWith(entries[1].name, "ringA"));
+    EXPECT_EQ("hello", entries[1].data);
+    EXPECT_TRUE(startsWith(entries[2].name, "ringB"));
+    EXPECT_EQ("world!", entries[2].data);
+    EXPECT_EQ("TRAILER!!!", entries[3].name);
+    EXPECT_EQ("", entries[3].data);
+}
+
+TEST_F(RingbufferArchiverTest, WritesAnEmptyCpioArchive) {
+    RingbufferArchiver archiver(dirPath(), limits_);
+    TemporaryFile out;
+    EXPECT_EQ(0u, archiver.writeCpioArchive(out.fd));
+    std::string archive;
+    ASSERT_TRUE(android::base::ReadFileToString(out.path, &archive));
+
+    std::vector<CpioEntry> entries;
+    ASSERT_TRUE(parseCpioArchive(archive, &entries));
+    ASSERT_EQ(1u, entries.size());
+    EXPECT_EQ("TRAILER!!!", entries[0].name);
+}
+}  // namespace implementation
+}  // namespace V1_4
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "ringbuffer.h"
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_4 {
+namespace implementation {
+namespace {
+
+// Same size as the rings created by WifiChip.
+constexpr size_t kRingSizeBytes = 1024 * 1024 * 3;
+
+// Sustained appends to a full ring, so that each append also evicts.
+void BM_RingbufferAppend(benchmark::State& state) {
+    Ringbuffer buffer(kRingSizeBytes);
+    const std::vector<uint8_t> record(state.range(0), 'x');
+    for (auto _ : state) {
+        buffer.append(record);
+    }
+    state.SetBytesProcessed(state.iterations() * record.size());
+}
+
+BENCHMARK(BM_RingbufferAppend)->RangeMultiplier(4)->Range(1024, 64 * 1024);
+
+}  // namespace
+}  // namespace implementation
+}  // namespace V1_4
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
+
+BENCHMARK_MAIN();
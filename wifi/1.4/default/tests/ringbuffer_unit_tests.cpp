@@ -31,10 +31,28 @@ class RingbufferTest : public Test {
    public:
     const uint32_t maxBufferSize_ = 10;
     Ringbuffer buffer_{maxBufferSize_};
+
+    // Returns the stored records, oldest first, as written out.
+    std::vector<uint8_t> contents() const {
+        struct iovec iov[2];
+        const int iovcnt = buffer_.getDataSegments(iov);
+        std::vector<uint8_t> output;
+        for (int i = 0; i < iovcnt; ++i) {
+            const uint8_t* base = static_cast<const uint8_t*>(iov[i].iov_base);
+            output.insert(output.end(), base, base + iov[i].iov_len);
+        }
+        return output;
+    }
+
+    static std::vector<uint8_t> concat(std::vector<uint8_t> a,
+                                       const std::vector<uint8_t>& b) {
+        a.insert(a.end(), b.begin(), b.end());
+        return a;
+    }
 };
 
 TEST_F(RingbufferTest, CreateEmptyBuffer) {
-    ASSERT_TRUE(buffer_.getData().empty());
+    ASSERT_TRUE(buffer_.empty());
 }
 
 TEST_F(RingbufferTest, CanUseFullBufferCapacity) {
@@ -42,9 +60,8 @@ TEST_F(RingbufferTest, CanUseFullBufferCapacity) {
     const std::vector<uint8_t> input2(maxBufferSize_ / 2, '1');
     buffer_.append(input);
     buffer_.append(input2);
-    ASSERT_EQ(2u, buffer_.getData().size());
-    EXPECT_EQ(input, buffer_.getData().front());
-    EXPECT_EQ(input2, buffer_.getData().back());
+    ASSERT_EQ(2u, buffer_.getNumRecords());
+    EXPECT_EQ(concat(input, input2), contents());
 }
 
 TEST_F(RingbufferTest, OldDataIsRemovedOnOverflow) {
@@ -54,9 +71,8 @@ TEST_F(RingbufferTest, OldDataIsRemovedOnOverflow) {
     buffer_.append(input);
     buffer_.append(input2);
     buffer_.append(input3);
-    ASSERT_EQ(2u, buffer_.getData().size());
-    EXPECT_EQ(input2, buffer_.getData().front());
-    EXPECT_EQ(input3, buffer_.getData().back());
+    ASSERT_EQ(2u, buffer_.getNumRecords());
+    EXPECT_EQ(concat(input2, input3), contents());
 }
 
 TEST_F(RingbufferTest, MultipleOldDataIsRemovedOnOverflow) {
@@ -66,20 +82,20 @@ TEST_F(RingbufferTest, MultipleOldDataIsRemovedOnOverflow) {
     buffer_.append(input);
     buffer_.append(input2);
     buffer_.append(input3);
-    ASSERT_EQ(1u, buffer_.getData().size());
-    EXPECT_EQ(input3, buffer_.getData().front());
+    ASSERT_EQ(1u, buffer_.getNumRecords());
+    EXPECT_EQ(input3, contents());
 }
 
 TEST_F(RingbufferTest, AppendingEmptyBufferDoesNotAddGarbage) {
     const std::vector<uint8_t> input = {};
     buffer_.append(input);
-    ASSERT_TRUE(buffer_.getData().empty());
+    ASSERT_TRUE(buffer_.empty());
 }
 
 TEST_F(RingbufferTest, OversizedAppendIsDropped) {
     const std::vector<uint8_t> input(maxBufferSize_ + 1, '0');
     buffer_.append(input);
-    ASSERT_TRUE(buffer_.getData().empty());
+    ASSERT_TRUE(buffer_.empty());
 }
 
 TEST_F(RingbufferTest, OversizedAppendDoesNotDropExistingData) {
@@ -87,8 +103,61 @@ TEST_F(RingbufferTest, OversizedAppendDoesNotDropExistingData) {
     const std::vector<uint8_t> input2(maxBufferSize_ + 1, '1');
     buffer_.append(input);
     buffer_.append(input2);
-    ASSERT_EQ(1u, buffer_.getData().size());
-    EXPECT_EQ(input, buffer_.getData().front());
+    ASSERT_EQ(1u, buffer_.getNumRecords());
+    EXPECT_EQ(input, contents());
+}
+
+TEST_F(RingbufferTest, RecordsWrapAroundTheEndOfTheBuffer) {
+    const std::vector<uint8_t> input = {'0', '1', '2', '3'};
+    const std::vector<uint8_t> input2 = {'4', '5', '6', '7'};
+    const std::vector<uint8_t> input3 = {'8', '9', 'A', 'B'};
+    buffer_.append(input);
+    buffer_.append(input2);
+    buffer_.append(input3);
+    ASSERT_EQ(2u, buffer_.getNumRecords());
+
+    struct iovec iov[2];
+    ASSERT_EQ(2, buffer_.getDataSegments(iov));
+    std::vector<uint8_t> output(static_cast<uint8_t*>(iov[0].iov_base),
+                                static_cast<uint8_t*>(iov[0].iov_base) +
+                                    iov[0].iov_len);
+    output.insert(output.end(), static_cast<uint8_t*>(iov[1].iov_base),
+                  static_cast<uint8_t*>(iov[1].iov_base) + iov[1].iov_len);
+    const std::vector<uint8_t> expected = {'4', '5', '6', '7',
+                                           '8', '9', 'A', 'B'};
+    EXPECT_EQ(expected, output);
+}
+
+TEST_F(RingbufferTest, DataSegmentsFollowRecordOrder) {
+    const std::vector<uint8_t> input = {'0', '1', '2'};
+    const std::vector<uint8_t> input2 = {'3', '4'};
+    buffer_.append(input);
+    buffer_.append(input2);
+    EXPECT_EQ(5u, buffer_.getSize());
+
+    struct iovec iov[2];
+    ASSERT_EQ(1, buffer_.getDataSegments(iov));
+    const std::vector<uint8_t> expected = {'0', '1', '2', '3', '4'};
+    EXPECT_EQ(expected,
+              std::vector<uint8_t>(static_cast<uint8_t*>(iov[0].iov_base),
+                                   static_cast<uint8_t*>(iov[0].iov_base) +
+                                       iov[0].iov_len));
+}
+
+TEST_F(RingbufferTest, ClearKeepsTheBufferForNewRecords) {
+    const std::vector<uint8_t> input = {'0', '1', '2', '3', '4', '5'};
+    const std::vector<uint8_t> input2 = {'6', '7', '8'};
+    buffer_.append(input);
+    buffer_.clear();
+    EXPECT_TRUE(buffer_.empty());
+    EXPECT_EQ(0u, buffer_.getSize());
+
+    // The new records start over at the front, instead of wrapping around.
+    buffer_.append(input2);
+    buffer_.append(input2);
+    struct iovec iov[2];
+    EXPECT_EQ(1, buffer_.getDataSegments(iov));
+    EXPECT_EQ(concat(input2, input2), contents());
 }
 }  // namespace implementation
 }  // namespace V1_4
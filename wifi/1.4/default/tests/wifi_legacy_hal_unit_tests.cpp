@@ -0,0 +1,229 @@
+/*
+ * Copyright (C) 2020, The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include "hidl_sync_util.h"
+#include "wifi_legacy_hal.h"
+#include "wifi_legacy_hal_stubs.h"
+
+using testing::Test;
+
+namespace {
+constexpr char kIfaceName[] = "wlan0";
+constexpr wifi_request_id kCmdId = 7;
+constexpr int8_t kRssi = -70;
+constexpr int kNumIterations = 2000;
+constexpr std::chrono::seconds kTimeout(5);
+}  // namespace
+
+namespace android {
+namespace hardware {
+namespace wifi {
+namespace V1_4 {
+namespace implementation {
+namespace legacy_hal {
+namespace {
+// Handler passed to the last |wifi_start_rssi_monitoring| call, invoked by the
+// tests the way the legacy HAL event loop would.
+std::atomic<void (*)(wifi_request_id, uint8_t*, int8_t)> g_rssi_handler;
+
+wifi_error fakeStartRssiMonitoring(wifi_request_id /* id */,
+                                   wifi_interface_handle /* iface */,
+                                   int8_t /* max_rssi */,
+                                   int8_t /* min_rssi */,
+                                   wifi_rssi_event_handler handler) {
+    g_rssi_handler = handler.on_rssi_threshold_breached;
+    return WIFI_SUCCESS;
+}
+
+wifi_error fakeStopRssiMonitoring(wifi_request_id /* id */,
+                                  wifi_interface_handle /* iface */) {
+    return WIFI_SUCCESS;
+}
+
+void fireRssiThresholdBreached() {
+    uint8_t bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    const auto handler = g_rssi_handler.load();
+    if (handler) {
+        handler(kCmdId, bssid, kRssi);
+    }
+}
+
+}  // namespace
+
+// Legacy HAL backed by the stub function table, with RSSI monitoring
+// redirected to the fakes above.
+class StubbedWifiLegacyHal : public WifiLegacyHal {
+   public:
+    StubbedWifiLegacyHal()
+        : WifiLegacyHal(std::weak_ptr<wifi_system::InterfaceTool>()) {
+        initHalFuncTableWithStubs(&global_func_table_);
+        global_func_table_.wifi_start_rssi_monitoring = fakeStartRssiMonitoring;
+        global_func_table_.wifi_stop_rssi_monitoring = fakeStopRssiMonitoring;
+        iface_name_to_handle_[kIfaceName] = nullptr;
+    }
+};
+
+class WifiLegacyHalTest : public Test {
+   protected:
+    void TearDown() override {
+        legacy_hal_.stopRssiMonitoring(kIfaceName, kCmdId);
+        g_rssi_handler = nullptr;
+    }
+
+    StubbedWifiLegacyHal legacy_hal_;
+};
+
+TEST(AtomicCallbackTest, ResetWhileInvoking) {
+    hidl_sync_util::AtomicCallback<void(int)> slot;
+    std::atomic<bool> done{false};
+    std::atomic<int> num_invocations{0};
+
+    std::thread invoker([&] {
+        while (!done) {
+            if (const auto callback = slot.load()) {
+                (*callback)(1);
+            }
+        }
+    });
+    for (int i = 0; i < kNumIterations; i++) {
+        // The captured state is released as soon as the slot is reset, unless
+        // an invocation still holds the callback.
+        auto state = std::make_shared<std::vector<int>>(64, i);
+        slot = [state, &num_invocations](int value) {
+            EXPECT_EQ(64u, state->size());
+            num_invocations += value;
+        };
+        slot = nullptr;
+        EXPECT_FALSE(slot);
+    }
+    done = true;
+    invoker.join();
+}
+
+TEST(AtomicCallbackTest, TakeEmptiesSlot) {
+    hidl_sync_util::AtomicCallback<void()> slot;
+    int num_invocations = 0;
+    slot = [&num_invocations] { num_invocations++; };
+    ASSERT_TRUE(slot);
+    const auto callback = slot.take();
+    ASSERT_NE(nullptr, callback);
+    EXPECT_FALSE(slot);
+    EXPECT_EQ(nullptr, slot.take());
+    (*callback)();
+    EXPECT_EQ(1, num_invocations);
+}
+
+// Restarts RSSI monitoring from this thread while another thread delivers
+// events, as the HIDL thread and the legacy HAL event loop do.
+TEST_F(WifiLegacyHalTest, RestartRssiMonitoringWhileDeliveringEvents) {
+    std::atomic<bool> done{false};
+    std::atomic<int> num_events{0};
+
+    std::thread event_loop([&] {
+        while (!done) {
+            fireRssiThresholdBreached();
+        }
+    });
+    for (int i = 0; i < kNumIterations; i++) {
+        auto generation = std::make_shared<int>(i);
+        EXPECT_EQ(WIFI_SUCCESS,
+                  legacy_hal_.startRssiMonitoring(
+                      kIfaceName, kCmdId, -50, -80,
+                      [generation, &num_events](wifi_request_id id,
+                                                std::array<uint8_t, 6> bssid,
+                                                int8_t rssi) {
+                          EXPECT_LE(0, *generation);
+                          EXPECT_EQ(kCmdId, id);
+                          EXPECT_EQ(0x01, bssid[5]);
+                          EXPECT_EQ(kRssi, rssi);
+                          num_events++;
+                      }));
+        EXPECT_EQ(WIFI_SUCCESS,
+                  legacy_hal_.stopRssiMonitoring(kIfaceName, kCmdId));
+    }
+    done = true;
+    event_loop.join();
+}
+
+// A HIDL method holding the global lock, e.g. a slow getLinkLayerStats(),
+// must not delay the delivery of asynchronous events.
+TEST_F(WifiLegacyHalTest, EventsAreNotBlockedByGlobalLock) {
+    std::atomic<int> num_events{0};
+    ASSERT_EQ(WIFI_SUCCESS,
+              legacy_hal_.startRssiMonitoring(
+                  kIfaceName, kCmdId, -50, -80,
+                  [&num_events](wifi_request_id, std::array<uint8_t, 6>,
+                                int8_t) { num_events++; }));
+
+    const auto lock = hidl_sync_util::acquireGlobalLock();
+    auto delivered = std::async(std::launch::async, [] {
+        for (int i = 0; i < kNumIterations; i++) {
+            fireRssiThresholdBreached();
+        }
+    });
+    ASSERT_EQ(std::future_status::ready, delivered.wait_for(kTimeout));
+    EXPECT_EQ(kNumIterations, num_events.load());
+}
+
+// Holding the subsystem lock, as the HIDL objects do while they are being
+// invalidated, holds back the events of that subsystem until it is released.
+TEST_F(WifiLegacyHalTest, EventsWaitForSubsystemLock) {
+    std::atomic<int> num_events{0};
+    ASSERT_EQ(WIFI_SUCCESS,
+              legacy_hal_.startRssiMonitoring(
+                  kIfaceName, kCmdId, -50, -80,
+                  [&num_events](wifi_request_id, std::array<uint8_t, 6>,
+                                int8_t) { num_events++; }));
+
+    auto lock =
+        hidl_sync_util::acquireSubsystemLock(hidl_sync_util::Subsystem::kSta);
+    auto delivered =
+        std::async(std::launch::async, [] { fireRssiThresholdBreached(); });
+    EXPECT_EQ(std::future_status::timeout,
+              delivered.wait_for(std::chrono::milliseconds(50)));
+    EXPECT_EQ(0, num_events.load());
+
+    // Events of the other subsystems are not held back.
+    {
+        auto nan_lock = std::async(std::launch::async, [] {
+            return hidl_sync_util::acquireSubsystemLock(
+                       hidl_sync_util::Subsystem::kNan)
+                .owns_lock();
+        });
+        ASSERT_EQ(std::future_status::ready, nan_lock.wait_for(kTimeout));
+        EXPECT_TRUE(nan_lock.get());
+    }
+
+    lock.unlock();
+    ASSERT_EQ(std::future_status::ready, delivered.wait_for(kTimeout));
+    EXPECT_EQ(1, num_events.load());
+}
+}  // namespace legacy_hal
+}  // namespace implementation
+}  // namespace V1_4
+}  // namespace wifi
+}  // namespace hardware
+}  // namespace android
@@ -27,6 +27,7 @@
 
 #include "hidl_callback_util.h"
 #include "ringbuffer.h"
+#include "ringbuffer_archiver.h"
 #include "wifi_ap_iface.h"
 #include "wifi_feature_flags.h"
 #include "wifi_legacy_hal.h"
@@ -269,7 +270,8 @@ class WifiChip : public V1_4::IWifiChip {
     std::vector<sp<WifiP2pIface>> p2p_ifaces_;
     std::vector<sp<WifiStaIface>> sta_ifaces_;
     std::vector<sp<WifiRttController>> rtt_controllers_;
-    std::map<std::string, Ringbuffer> ringbuffer_map_;
+    std::map<std::string, Ringbuffer> ringbuffer_map_;  // guarded by lock_t
+    RingbufferArchiver ringbuffer_archiver_;
     bool is_valid_;
     // Members pertaining to chip configuration.
     uint32_t current_mode_id_;
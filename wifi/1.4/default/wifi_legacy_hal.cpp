@@ -54,124 +54,129 @@ namespace wifi {
 namespace V1_4 {
 namespace implementation {
 namespace legacy_hal {
+using hidl_sync_util::AtomicCallback;
+using hidl_sync_util::Subsystem;
+
 // Legacy HAL functions accept "C" style function pointers, so use global
 // functions to pass to the legacy HAL function and store the corresponding
 // std::function methods to be invoked.
+// The asynchronous callbacks only acquire the lock of their own subsystem, so
+// they are not blocked by HIDL calls into other subsystems. See
+// THREADING.README.
 //
 // Callback to be invoked once |stop| is complete
-std::function<void(wifi_handle handle)> on_stop_complete_internal_callback;
+AtomicCallback<void(wifi_handle handle)> on_stop_complete_internal_callback;
 void onAsyncStopComplete(wifi_handle handle) {
     const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_stop_complete_internal_callback) {
-        on_stop_complete_internal_callback(handle);
-        // Invalidate this callback since we don't want this firing again.
-        on_stop_complete_internal_callback = nullptr;
+    // Invalidate this callback since we don't want this firing again.
+    if (const auto callback = on_stop_complete_internal_callback.take()) {
+        (*callback)(handle);
     }
 }
 
 // Callback to be invoked for driver dump.
-std::function<void(char*, int)> on_driver_memory_dump_internal_callback;
+AtomicCallback<void(char*, int)> on_driver_memory_dump_internal_callback;
 void onSyncDriverMemoryDump(char* buffer, int buffer_size) {
-    if (on_driver_memory_dump_internal_callback) {
-        on_driver_memory_dump_internal_callback(buffer, buffer_size);
+    if (const auto callback = on_driver_memory_dump_internal_callback.load()) {
+        (*callback)(buffer, buffer_size);
     }
 }
 
 // Callback to be invoked for firmware dump.
-std::function<void(char*, int)> on_firmware_memory_dump_internal_callback;
+AtomicCallback<void(char*, int)> on_firmware_memory_dump_internal_callback;
 void onSyncFirmwareMemoryDump(char* buffer, int buffer_size) {
-    if (on_firmware_memory_dump_internal_callback) {
-        on_firmware_memory_dump_internal_callback(buffer, buffer_size);
+    const auto callback = on_firmware_memory_dump_internal_callback.load();
+    if (callback) {
+        (*callback)(buffer, buffer_size);
     }
 }
 
 // Callback to be invoked for Gscan events.
-std::function<void(wifi_request_id, wifi_scan_event)>
+AtomicCallback<void(wifi_request_id, wifi_scan_event)>
     on_gscan_event_internal_callback;
 void onAsyncGscanEvent(wifi_request_id id, wifi_scan_event event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_gscan_event_internal_callback) {
-        on_gscan_event_internal_callback(id, event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kSta);
+    if (const auto callback = on_gscan_event_internal_callback.load()) {
+        (*callback)(id, event);
     }
 }
 
 // Callback to be invoked for Gscan full results.
-std::function<void(wifi_request_id, wifi_scan_result*, uint32_t)>
+AtomicCallback<void(wifi_request_id, wifi_scan_result*, uint32_t)>
     on_gscan_full_result_internal_callback;
 void onAsyncGscanFullResult(wifi_request_id id, wifi_scan_result* result,
                             uint32_t buckets_scanned) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_gscan_full_result_internal_callback) {
-        on_gscan_full_result_internal_callback(id, result, buckets_scanned);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kSta);
+    if (const auto callback = on_gscan_full_result_internal_callback.load()) {
+        (*callback)(id, result, buckets_scanned);
     }
 }
 
 // Callback to be invoked for link layer stats results.
-std::function<void((wifi_request_id, wifi_iface_stat*, int, wifi_radio_stat*))>
+AtomicCallback<void((wifi_request_id, wifi_iface_stat*, int, wifi_radio_stat*))>
     on_link_layer_stats_result_internal_callback;
 void onSyncLinkLayerStatsResult(wifi_request_id id, wifi_iface_stat* iface_stat,
                                 int num_radios, wifi_radio_stat* radio_stat) {
-    if (on_link_layer_stats_result_internal_callback) {
-        on_link_layer_stats_result_internal_callback(id, iface_stat, num_radios,
-                                                     radio_stat);
+    const auto callback = on_link_layer_stats_result_internal_callback.load();
+    if (callback) {
+        (*callback)(id, iface_stat, num_radios, radio_stat);
     }
 }
 
 // Callback to be invoked for rssi threshold breach.
-std::function<void((wifi_request_id, uint8_t*, int8_t))>
+AtomicCallback<void((wifi_request_id, uint8_t*, int8_t))>
     on_rssi_threshold_breached_internal_callback;
 void onAsyncRssiThresholdBreached(wifi_request_id id, uint8_t* bssid,
                                   int8_t rssi) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_rssi_threshold_breached_internal_callback) {
-        on_rssi_threshold_breached_internal_callback(id, bssid, rssi);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kSta);
+    const auto callback = on_rssi_threshold_breached_internal_callback.load();
+    if (callback) {
+        (*callback)(id, bssid, rssi);
     }
 }
 
 // Callback to be invoked for ring buffer data indication.
-std::function<void(char*, char*, int, wifi_ring_buffer_status*)>
+AtomicCallback<void(char*, char*, int, wifi_ring_buffer_status*)>
     on_ring_buffer_data_internal_callback;
 void onAsyncRingBufferData(char* ring_name, char* buffer, int buffer_size,
                            wifi_ring_buffer_status* status) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_ring_buffer_data_internal_callback) {
-        on_ring_buffer_data_internal_callback(ring_name, buffer, buffer_size,
-                                              status);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kChip);
+    if (const auto callback = on_ring_buffer_data_internal_callback.load()) {
+        (*callback)(ring_name, buffer, buffer_size, status);
     }
 }
 
 // Callback to be invoked for error alert indication.
-std::function<void(wifi_request_id, char*, int, int)>
+AtomicCallback<void(wifi_request_id, char*, int, int)>
     on_error_alert_internal_callback;
 void onAsyncErrorAlert(wifi_request_id id, char* buffer, int buffer_size,
                        int err_code) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_error_alert_internal_callback) {
-        on_error_alert_internal_callback(id, buffer, buffer_size, err_code);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kChip);
+    if (const auto callback = on_error_alert_internal_callback.load()) {
+        (*callback)(id, buffer, buffer_size, err_code);
     }
 }
 
 // Callback to be invoked for radio mode change indication.
-std::function<void(wifi_request_id, uint32_t, wifi_mac_info*)>
+AtomicCallback<void(wifi_request_id, uint32_t, wifi_mac_info*)>
     on_radio_mode_change_internal_callback;
 void onAsyncRadioModeChange(wifi_request_id id, uint32_t num_macs,
                             wifi_mac_info* mac_infos) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_radio_mode_change_internal_callback) {
-        on_radio_mode_change_internal_callback(id, num_macs, mac_infos);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kChip);
+    if (const auto callback = on_radio_mode_change_internal_callback.load()) {
+        (*callback)(id, num_macs, mac_infos);
     }
 }
 
 // Callback to be invoked for rtt results results.
-std::function<void(wifi_request_id, unsigned num_results,
-                   wifi_rtt_result* rtt_results[])>
+AtomicCallback<void(wifi_request_id, unsigned num_results,
+                    wifi_rtt_result* rtt_results[])>
     on_rtt_results_internal_callback;
 void onAsyncRttResults(wifi_request_id id, unsigned num_results,
                        wifi_rtt_result* rtt_results[]) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_rtt_results_internal_callback) {
-        on_rtt_results_internal_callback(id, num_results, rtt_results);
-        on_rtt_results_internal_callback = nullptr;
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kRtt);
+    if (const auto callback = on_rtt_results_internal_callback.take()) {
+        (*callback)(id, num_results, rtt_results);
     }
 }
 
@@ -179,157 +184,175 @@ void onAsyncRttResults(wifi_request_id id, unsigned num_results,
 // NOTE: These have very little conversions to perform before invoking the user
 // callbacks.
 // So, handle all of them here directly to avoid adding an unnecessary layer.
-std::function<void(transaction_id, const NanResponseMsg&)>
+AtomicCallback<void(transaction_id, const NanResponseMsg&)>
     on_nan_notify_response_user_callback;
 void onAysncNanNotifyResponse(transaction_id id, NanResponseMsg* msg) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_notify_response_user_callback && msg) {
-        on_nan_notify_response_user_callback(id, *msg);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_notify_response_user_callback.load();
+    if (callback && msg) {
+        (*callback)(id, *msg);
     }
 }
 
-std::function<void(const NanPublishRepliedInd&)>
+AtomicCallback<void(const NanPublishRepliedInd&)>
     on_nan_event_publish_replied_user_callback;
 void onAysncNanEventPublishReplied(NanPublishRepliedInd* /* event */) {
     LOG(ERROR) << "onAysncNanEventPublishReplied triggered";
 }
 
-std::function<void(const NanPublishTerminatedInd&)>
+AtomicCallback<void(const NanPublishTerminatedInd&)>
     on_nan_event_publish_terminated_user_callback;
 void onAysncNanEventPublishTerminated(NanPublishTerminatedInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_publish_terminated_user_callback && event) {
-        on_nan_event_publish_terminated_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_publish_terminated_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanMatchInd&)> on_nan_event_match_user_callback;
+AtomicCallback<void(const NanMatchInd&)> on_nan_event_match_user_callback;
 void onAysncNanEventMatch(NanMatchInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_match_user_callback && event) {
-        on_nan_event_match_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_match_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanMatchExpiredInd&)>
+AtomicCallback<void(const NanMatchExpiredInd&)>
     on_nan_event_match_expired_user_callback;
 void onAysncNanEventMatchExpired(NanMatchExpiredInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_match_expired_user_callback && event) {
-        on_nan_event_match_expired_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_match_expired_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanSubscribeTerminatedInd&)>
+AtomicCallback<void(const NanSubscribeTerminatedInd&)>
     on_nan_event_subscribe_terminated_user_callback;
 void onAysncNanEventSubscribeTerminated(NanSubscribeTerminatedInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_subscribe_terminated_user_callback && event) {
-        on_nan_event_subscribe_terminated_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback =
+        on_nan_event_subscribe_terminated_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanFollowupInd&)> on_nan_event_followup_user_callback;
+AtomicCallback<void(const NanFollowupInd&)> on_nan_event_followup_user_callback;
 void onAysncNanEventFollowup(NanFollowupInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_followup_user_callback && event) {
-        on_nan_event_followup_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_followup_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanDiscEngEventInd&)>
+AtomicCallback<void(const NanDiscEngEventInd&)>
     on_nan_event_disc_eng_event_user_callback;
 void onAysncNanEventDiscEngEvent(NanDiscEngEventInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_disc_eng_event_user_callback && event) {
-        on_nan_event_disc_eng_event_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_disc_eng_event_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanDisabledInd&)> on_nan_event_disabled_user_callback;
+AtomicCallback<void(const NanDisabledInd&)> on_nan_event_disabled_user_callback;
 void onAysncNanEventDisabled(NanDisabledInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_disabled_user_callback && event) {
-        on_nan_event_disabled_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_disabled_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanTCAInd&)> on_nan_event_tca_user_callback;
+AtomicCallback<void(const NanTCAInd&)> on_nan_event_tca_user_callback;
 void onAysncNanEventTca(NanTCAInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_tca_user_callback && event) {
-        on_nan_event_tca_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_tca_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanBeaconSdfPayloadInd&)>
+AtomicCallback<void(const NanBeaconSdfPayloadInd&)>
     on_nan_event_beacon_sdf_payload_user_callback;
 void onAysncNanEventBeaconSdfPayload(NanBeaconSdfPayloadInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_beacon_sdf_payload_user_callback && event) {
-        on_nan_event_beacon_sdf_payload_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_beacon_sdf_payload_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanDataPathRequestInd&)>
+AtomicCallback<void(const NanDataPathRequestInd&)>
     on_nan_event_data_path_request_user_callback;
 void onAysncNanEventDataPathRequest(NanDataPathRequestInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_data_path_request_user_callback && event) {
-        on_nan_event_data_path_request_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_data_path_request_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
-std::function<void(const NanDataPathConfirmInd&)>
+AtomicCallback<void(const NanDataPathConfirmInd&)>
     on_nan_event_data_path_confirm_user_callback;
 void onAysncNanEventDataPathConfirm(NanDataPathConfirmInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_data_path_confirm_user_callback && event) {
-        on_nan_event_data_path_confirm_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_data_path_confirm_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanDataPathEndInd&)>
+AtomicCallback<void(const NanDataPathEndInd&)>
     on_nan_event_data_path_end_user_callback;
 void onAysncNanEventDataPathEnd(NanDataPathEndInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_data_path_end_user_callback && event) {
-        on_nan_event_data_path_end_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_data_path_end_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanTransmitFollowupInd&)>
+AtomicCallback<void(const NanTransmitFollowupInd&)>
     on_nan_event_transmit_follow_up_user_callback;
 void onAysncNanEventTransmitFollowUp(NanTransmitFollowupInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_transmit_follow_up_user_callback && event) {
-        on_nan_event_transmit_follow_up_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_transmit_follow_up_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanRangeRequestInd&)>
+AtomicCallback<void(const NanRangeRequestInd&)>
     on_nan_event_range_request_user_callback;
 void onAysncNanEventRangeRequest(NanRangeRequestInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_range_request_user_callback && event) {
-        on_nan_event_range_request_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_range_request_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanRangeReportInd&)>
+AtomicCallback<void(const NanRangeReportInd&)>
     on_nan_event_range_report_user_callback;
 void onAysncNanEventRangeReport(NanRangeReportInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_range_report_user_callback && event) {
-        on_nan_event_range_report_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_range_report_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 
-std::function<void(const NanDataPathScheduleUpdateInd&)>
+AtomicCallback<void(const NanDataPathScheduleUpdateInd&)>
     on_nan_event_schedule_update_user_callback;
 void onAsyncNanEventScheduleUpdate(NanDataPathScheduleUpdateInd* event) {
-    const auto lock = hidl_sync_util::acquireGlobalLock();
-    if (on_nan_event_schedule_update_user_callback && event) {
-        on_nan_event_schedule_update_user_callback(*event);
+    const auto lock = hidl_sync_util::acquireSubsystemLock(Subsystem::kNan);
+    const auto callback = on_nan_event_schedule_update_user_callback.load();
+    if (callback && event) {
+        (*callback)(*event);
     }
 }
 // End of the free-standing "C" style callbacks.
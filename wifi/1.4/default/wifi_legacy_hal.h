@@ -376,6 +376,9 @@ class WifiLegacyHal {
     virtual wifi_error deleteVirtualInterface(const std::string& ifname);
 
    private:
+    // Runs the unit tests on the legacy HAL stubs.
+    friend class StubbedWifiLegacyHal;
+
     // Retrieve interface handles for all the available interfaces.
     wifi_error retrieveIfaceHandles();
     wifi_interface_handle getIfaceHandle(const std::string& iface_name);
@@ -18,6 +18,7 @@
 
 #include "hidl_return_util.h"
 #include "hidl_struct_util.h"
+#include "hidl_sync_util.h"
 #include "wifi_nan_iface.h"
 #include "wifi_status_util.h"
 
@@ -542,10 +543,16 @@ void WifiNanIface::invalidate() {
     legacy_hal_.lock()->nanDataInterfaceDelete(ifname_, 0xFFFE, "aware_data0");
     legacy_hal_.lock()->nanDataInterfaceDelete(ifname_, 0xFFFD, "aware_data1");
     iface_util_.lock()->unregisterIfaceEventHandlers(ifname_);
-    legacy_hal_.reset();
-    event_cb_handler_.invalidate();
-    event_cb_handler_1_2_.invalidate();
-    is_valid_ = false;
+    {
+        // Waits for a NAN event that is being delivered to complete. Later
+        // events see that the iface is no longer valid.
+        const auto lock = hidl_sync_util::acquireSubsystemLock(
+            hidl_sync_util::Subsystem::kNan);
+        legacy_hal_.reset();
+        event_cb_handler_.invalidate();
+        event_cb_handler_1_2_.invalidate();
+        is_valid_ = false;
+    }
     if (is_dedicated_iface_) {
         // If using a dedicated iface, set the iface down.
         iface_util_.lock()->setUpState(ifname_, false);
@@ -748,6 +755,8 @@ std::pair<WifiStatus, IfaceType> WifiNanIface::getTypeInternal() {
 
 WifiStatus WifiNanIface::registerEventCallbackInternal(
     const sp<V1_0::IWifiNanIfaceEventCallback>& callback) {
+    const auto lock =
+        hidl_sync_util::acquireSubsystemLock(hidl_sync_util::Subsystem::kNan);
     if (!event_cb_handler_.addCallback(callback)) {
         return createWifiStatus(WifiStatusCode::ERROR_UNKNOWN);
     }
@@ -879,6 +888,8 @@ WifiStatus WifiNanIface::terminateDataPathRequestInternal(
 WifiStatus WifiNanIface::registerEventCallback_1_2Internal(
     const sp<V1_2::IWifiNanIfaceEventCallback>& callback) {
     sp<V1_0::IWifiNanIfaceEventCallback> callback_1_0 = callback;
+    const auto lock =
+        hidl_sync_util::acquireSubsystemLock(hidl_sync_util::Subsystem::kNan);
     if (!event_cb_handler_.addCallback(callback_1_0)) {
         return createWifiStatus(WifiStatusCode::ERROR_UNKNOWN);
     }
@@ -18,6 +18,7 @@
 
 #include "hidl_return_util.h"
 #include "hidl_struct_util.h"
+#include "hidl_sync_util.h"
 #include "wifi_rtt_controller.h"
 #include "wifi_status_util.h"
 
@@ -37,6 +38,8 @@ WifiRttController::WifiRttController(
       is_valid_(true) {}
 
 void WifiRttController::invalidate() {
+    const auto lock =
+        hidl_sync_util::acquireSubsystemLock(hidl_sync_util::Subsystem::kRtt);
     legacy_hal_.reset();
     event_callbacks_.clear();
     is_valid_ = false;
@@ -254,6 +257,8 @@ WifiStatus WifiRttController::disableResponderInternal(uint32_t cmd_id) {
 WifiStatus WifiRttController::registerEventCallbackInternal_1_4(
     const sp<IWifiRttControllerEventCallback>& callback) {
     // TODO(b/31632518): remove the callback when the client is destroyed
+    const auto lock =
+        hidl_sync_util::acquireSubsystemLock(hidl_sync_util::Subsystem::kRtt);
     event_callbacks_.emplace_back(callback);
     return createWifiStatus(WifiStatusCode::SUCCESS);
 }
@@ -18,6 +18,7 @@
 
 #include "hidl_return_util.h"
 #include "hidl_struct_util.h"
+#include "hidl_sync_util.h"
 #include "wifi_sta_iface.h"
 #include "wifi_status_util.h"
 
@@ -46,6 +47,8 @@ WifiStaIface::WifiStaIface(
 }
 
 void WifiStaIface::invalidate() {
+    const auto lock =
+        hidl_sync_util::acquireSubsystemLock(hidl_sync_util::Subsystem::kSta);
     legacy_hal_.reset();
     event_cb_handler_.invalidate();
     is_valid_ = false;
@@ -276,6 +279,8 @@ std::pair<WifiStatus, IfaceType> WifiStaIface::getTypeInternal() {
 
 WifiStatus WifiStaIface::registerEventCallbackInternal(
     const sp<IWifiStaIfaceEventCallback>& callback) {
+    const auto lock =
+        hidl_sync_util::acquireSubsystemLock(hidl_sync_util::Subsystem::kSta);
     if (!event_cb_handler_.addCallback(callback)) {
         return createWifiStatus(WifiStatusCode::ERROR_UNKNOWN);
     }
@@ -398,10 +403,12 @@ WifiStatus WifiStaIface::startBackgroundScanInternal(
                 LOG(ERROR) << "Callback invoked on an invalid object";
                 return;
             }
-            std::vector<StaScanData> hidl_scan_datas;
+            std::vector<StaScanData>& hidl_scan_datas =
+                shared_ptr_this->gscan_results_;
             if (!hidl_struct_util::
                     convertLegacyVectorOfCachedGscanResultsToHidl(
-                        results, &hidl_scan_datas)) {
+                        results, &hidl_scan_datas,
+                        &shared_ptr_this->gscan_result_cache_)) {
                 LOG(ERROR) << "Failed to convert scan results to HIDL structs";
                 return;
             }
@@ -423,7 +430,7 @@ WifiStatus WifiStaIface::startBackgroundScanInternal(
             LOG(ERROR) << "Callback invoked on an invalid object";
             return;
         }
-        StaScanResult hidl_scan_result;
+        StaScanResult& hidl_scan_result = shared_ptr_this->gscan_full_result_;
         if (!hidl_struct_util::convertLegacyGscanResultToHidl(
                 *result, true, &hidl_scan_result)) {
             LOG(ERROR) << "Failed to convert full scan results to HIDL structs";
@@ -468,21 +475,26 @@ WifiStaIface::getLinkLayerStatsInternal() {
     return {createWifiStatus(WifiStatusCode::ERROR_NOT_SUPPORTED), {}};
 }
 
-std::pair<WifiStatus, V1_3::StaLinkLayerStats>
+std::pair<WifiStatus, const V1_3::StaLinkLayerStats&>
 WifiStaIface::getLinkLayerStatsInternal_1_3() {
     legacy_hal::wifi_error legacy_status;
     legacy_hal::LinkLayerStats legacy_stats;
     std::tie(legacy_status, legacy_stats) =
         legacy_hal_.lock()->getLinkLayerStats(ifname_);
     if (legacy_status != legacy_hal::WIFI_SUCCESS) {
-        return {createWifiStatusFromLegacyError(legacy_status), {}};
+        link_layer_stats_ = {};
+        return {createWifiStatusFromLegacyError(legacy_status),
+                link_layer_stats_};
     }
-    V1_3::StaLinkLayerStats hidl_stats;
-    if (!hidl_struct_util::convertLegacyLinkLayerStatsToHidl(legacy_stats,
-                                                             &hidl_stats)) {
-        return {createWifiStatus(WifiStatusCode::ERROR_UNKNOWN), {}};
+    // Converted into the member, so that the HIDL vectors are only
+    // reallocated when the number of radios or channels changes.
+    if (!hidl_struct_util::convertLegacyLinkLayerStatsToHidl(
+            legacy_stats, &link_layer_stats_)) {
+        link_layer_stats_ = {};
+        return {createWifiStatus(WifiStatusCode::ERROR_UNKNOWN),
+                link_layer_stats_};
     }
-    return {createWifiStatus(WifiStatusCode::SUCCESS), hidl_stats};
+    return {createWifiStatus(WifiStatusCode::SUCCESS), link_layer_stats_};
 }
 
 WifiStatus WifiStaIface::startRssiMonitoringInternal(uint32_t cmd_id,
@@ -22,6 +22,7 @@
 #include <android/hardware/wifi/1.3/IWifiStaIface.h>
 
 #include "hidl_callback_util.h"
+#include "hidl_struct_util.h"
 #include "wifi_iface_util.h"
 #include "wifi_legacy_hal.h"
 
@@ -136,7 +137,7 @@ class WifiStaIface : public V1_3::IWifiStaIface {
     WifiStatus enableLinkLayerStatsCollectionInternal(bool debug);
     WifiStatus disableLinkLayerStatsCollectionInternal();
     std::pair<WifiStatus, V1_0::StaLinkLayerStats> getLinkLayerStatsInternal();
-    std::pair<WifiStatus, V1_3::StaLinkLayerStats>
+    std::pair<WifiStatus, const V1_3::StaLinkLayerStats&>
     getLinkLayerStatsInternal_1_3();
     WifiStatus startRssiMonitoringInternal(uint32_t cmd_id, int32_t max_rssi,
                                            int32_t min_rssi);
@@ -167,6 +168,14 @@ class WifiStaIface : public V1_3::IWifiStaIface {
     bool is_valid_;
     hidl_callback_util::HidlCallbackHandler<IWifiStaIfaceEventCallback>
         event_cb_handler_;
+    // Conversion buffers reused across calls, the framework polls the link
+    // layer stats every few seconds. Only used on the HIDL thread.
+    V1_3::StaLinkLayerStats link_layer_stats_;
+    // Conversion buffers reused across gscan events. Only used from the gscan
+    // callbacks, which are serialized by the STA subsystem lock.
+    std::vector<StaScanData> gscan_results_;
+    StaScanResult gscan_full_result_;
+    hidl_struct_util::ScanResultCache gscan_result_cache_;
 
     DISALLOW_COPY_AND_ASSIGN(WifiStaIface);
 };